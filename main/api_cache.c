@@ -0,0 +1,331 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_cache.c                                        *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: ETag/TTL cache for API lookups (RAM + NVS)  *
+ ************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "api_cache.h"
+#include "device_config.h"
+
+static const char *TAG = "API_Cache";
+
+#define API_CACHE_RECORD_VERSION  1
+
+// How long a decoded result is trusted without asking the server at all.
+// Pending counts are always revalidated (If-None-Match makes that a cheap
+// 304 when nothing changed); idUser never changes for a given token.
+static const uint32_t s_ttl_s[API_CACHE_SLOT_COUNT] = {
+    [API_CACHE_ACCOUNT]        = 24 * 3600,
+    [API_CACHE_PENDING_SIGNER] = 0,
+    [API_CACHE_PENDING_EDITOR] = 0,
+    [API_CACHE_RELEASE]        = 30 * 60,
+};
+
+static const char *const s_nvs_keys[API_CACHE_SLOT_COUNT] = {
+    [API_CACHE_ACCOUNT]        = "account",
+    [API_CACHE_PENDING_SIGNER] = "signer",
+    [API_CACHE_PENDING_EDITOR] = "editor",
+    [API_CACHE_RELEASE]        = "release",
+};
+
+// Persisted form of an entry (NVS blob)
+typedef struct {
+    uint8_t version;
+    uint8_t valid;
+    uint16_t data_len;
+    uint32_t fingerprint;       // Configuration the entry belongs to
+    char etag[API_CACHE_ETAG_SIZE];
+    char last_modified[API_CACHE_LAST_MOD_SIZE];
+    uint8_t data[API_CACHE_DATA_SIZE];
+} api_cache_record_t;
+
+typedef struct {
+    api_cache_record_t rec;
+    int64_t fetched_us;         // 0 = age unknown (restored from NVS)
+} api_cache_entry_t;
+
+static api_cache_entry_t s_cache[API_CACHE_SLOT_COUNT];
+static SemaphoreHandle_t s_cache_mutex = NULL;
+
+// AskMeSign entries belong to one server + credentials; the GitHub release
+// entry does not depend on the device configuration
+static uint32_t api_cache_fingerprint(api_cache_slot_t slot)
+{
+    if (slot == API_CACHE_RELEASE) {
+        return 0x52454C31u;
+    }
+    return device_config_fingerprint();
+}
+
+static void api_cache_persist(api_cache_slot_t slot)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(API_CACHE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Cannot open NVS for cache: %s", esp_err_to_name(err));
+        return;
+    }
+    if (s_cache[slot].rec.valid) {
+        err = nvs_set_blob(handle, s_nvs_keys[slot], &s_cache[slot].rec, sizeof(api_cache_record_t));
+    } else {
+        err = nvs_erase_key(handle, s_nvs_keys[slot]);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Failed to persist cache entry '%s': %s", s_nvs_keys[slot], esp_err_to_name(err));
+    }
+}
+
+esp_err_t api_cache_init(void)
+{
+    if (s_cache_mutex != NULL) {
+        return ESP_OK;
+    }
+    memset(s_cache, 0, sizeof(s_cache));
+
+    nvs_handle_t handle;
+    if (nvs_open(API_CACHE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        ESP_LOGI(TAG, "No persisted API cache yet");
+    } else {
+        for (int i = 0; i < API_CACHE_SLOT_COUNT; i++) {
+            size_t len = sizeof(api_cache_record_t);
+            api_cache_record_t *rec = &s_cache[i].rec;
+            if (nvs_get_blob(handle, s_nvs_keys[i], rec, &len) != ESP_OK ||
+                len != sizeof(api_cache_record_t) ||
+                rec->version != API_CACHE_RECORD_VERSION ||
+                rec->data_len > API_CACHE_DATA_SIZE) {
+                memset(rec, 0, sizeof(*rec));
+                continue;
+            }
+            rec->etag[API_CACHE_ETAG_SIZE - 1] = '\0';
+            rec->last_modified[API_CACHE_LAST_MOD_SIZE - 1] = '\0';
+            ESP_LOGI(TAG, "📦 Restored cache entry '%s' (etag: %s)", s_nvs_keys[i],
+                     rec->etag[0] ? rec->etag : "-");
+        }
+        nvs_close(handle);
+    }
+
+    // Created last: until then every lookup misses
+    s_cache_mutex = xSemaphoreCreateMutex();
+    if (s_cache_mutex == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for the API cache lock");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// False before api_cache_init(): the cache then acts as empty
+static bool api_cache_lock(void)
+{
+    if (s_cache_mutex == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    return true;
+}
+
+static void api_cache_unlock(void)
+{
+    xSemaphoreGive(s_cache_mutex);
+}
+
+// Returns the entry if it holds a value for the current configuration.
+// Entries left over from another token/user/server are dropped here.
+static api_cache_entry_t *api_cache_lookup(api_cache_slot_t slot)
+{
+    api_cache_entry_t *entry = &s_cache[slot];
+    if (!entry->rec.valid) {
+        return NULL;
+    }
+    if (entry->rec.fingerprint != api_cache_fingerprint(slot)) {
+        ESP_LOGI(TAG, "🗑️ Configuration changed, dropping cache entry '%s'", s_nvs_keys[slot]);
+        memset(entry, 0, sizeof(*entry));
+        api_cache_persist(slot);
+        return NULL;
+    }
+    return entry;
+}
+
+static bool api_cache_copy_out(const api_cache_entry_t *entry, void *data, size_t len)
+{
+    if (entry->rec.data_len != len) {
+        return false;
+    }
+    memcpy(data, entry->rec.data, len);
+    return true;
+}
+
+bool api_cache_get_fresh(api_cache_slot_t slot, void *data, size_t len)
+{
+    bool hit = false;
+
+    if (slot >= API_CACHE_SLOT_COUNT || s_ttl_s[slot] == 0) {
+        return false;
+    }
+    if (!api_cache_lock()) {
+        return false;
+    }
+    api_cache_entry_t *entry = api_cache_lookup(slot);
+    if (entry != NULL && entry->fetched_us != 0) {
+        int64_t age_s = (esp_timer_get_time() - entry->fetched_us) / 1000000;
+        if (age_s < s_ttl_s[slot]) {
+            hit = api_cache_copy_out(entry, data, len);
+            if (hit) {
+                ESP_LOGI(TAG, "✅ Cache hit '%s' (age %lld s, ttl %lu s)", s_nvs_keys[slot],
+                         age_s, (unsigned long)s_ttl_s[slot]);
+            }
+        }
+    }
+    api_cache_unlock();
+    return hit;
+}
+
+bool api_cache_get(api_cache_slot_t slot, void *data, size_t len)
+{
+    bool hit = false;
+
+    if (slot >= API_CACHE_SLOT_COUNT) {
+        return false;
+    }
+    if (!api_cache_lock()) {
+        return false;
+    }
+    api_cache_entry_t *entry = api_cache_lookup(slot);
+    if (entry != NULL) {
+        hit = api_cache_copy_out(entry, data, len);
+    }
+    api_cache_unlock();
+    return hit;
+}
+
+void api_cache_conditional_headers(api_cache_slot_t slot, char *buf, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    buf[0] = '\0';
+    if (slot >= API_CACHE_SLOT_COUNT) {
+        return;
+    }
+    if (!api_cache_lock()) {
+        return;
+    }
+    api_cache_entry_t *entry = api_cache_lookup(slot);
+    if (entry != NULL) {
+        size_t used = 0;
+        if (entry->rec.etag[0] != '\0') {
+            used = snprintf(buf, size, "If-None-Match: %s\r\n", entry->rec.etag);
+        }
+        if (entry->rec.last_modified[0] != '\0' && used < size) {
+            snprintf(buf + used, size - used, "If-Modified-Since: %s\r\n", entry->rec.last_modified);
+        }
+    }
+    api_cache_unlock();
+}
+
+bool api_cache_get_validators(api_cache_slot_t slot, char *etag, size_t etag_size,
+                              char *last_modified, size_t last_modified_size)
+{
+    bool found = false;
+
+    if (etag_size > 0) {
+        etag[0] = '\0';
+    }
+    if (last_modified_size > 0) {
+        last_modified[0] = '\0';
+    }
+    if (slot >= API_CACHE_SLOT_COUNT) {
+        return false;
+    }
+    if (!api_cache_lock()) {
+        return false;
+    }
+    api_cache_entry_t *entry = api_cache_lookup(slot);
+    if (entry != NULL) {
+        strlcpy(etag, entry->rec.etag, etag_size);
+        strlcpy(last_modified, entry->rec.last_modified, last_modified_size);
+        found = true;
+    }
+    api_cache_unlock();
+    return found;
+}
+
+void api_cache_store(api_cache_slot_t slot, const char *etag, const char *last_modified,
+                     const void *data, size_t len)
+{
+    api_cache_record_t rec;
+
+    if (slot >= API_CACHE_SLOT_COUNT || len > API_CACHE_DATA_SIZE) {
+        return;
+    }
+    memset(&rec, 0, sizeof(rec));
+    rec.version = API_CACHE_RECORD_VERSION;
+    rec.valid = 1;
+    rec.data_len = (uint16_t)len;
+    rec.fingerprint = api_cache_fingerprint(slot);
+    strlcpy(rec.etag, etag ? etag : "", sizeof(rec.etag));
+    strlcpy(rec.last_modified, last_modified ? last_modified : "", sizeof(rec.last_modified));
+    memcpy(rec.data, data, len);
+
+    if (!api_cache_lock()) {
+        return;
+    }
+    api_cache_entry_t *entry = &s_cache[slot];
+    // Only hit flash when something actually changed
+    bool changed = memcmp(&entry->rec, &rec, sizeof(rec)) != 0;
+    entry->rec = rec;
+    entry->fetched_us = esp_timer_get_time();
+    if (changed) {
+        api_cache_persist(slot);
+        ESP_LOGI(TAG, "💾 Cache entry '%s' updated (etag: %s)", s_nvs_keys[slot],
+                 rec.etag[0] ? rec.etag : "-");
+    }
+    api_cache_unlock();
+}
+
+void api_cache_touch(api_cache_slot_t slot)
+{
+    if (slot >= API_CACHE_SLOT_COUNT) {
+        return;
+    }
+    if (!api_cache_lock()) {
+        return;
+    }
+    if (s_cache[slot].rec.valid) {
+        s_cache[slot].fetched_us = esp_timer_get_time();
+    }
+    api_cache_unlock();
+}
+
+void api_cache_invalidate_all(void)
+{
+    if (!api_cache_lock()) {
+        return;
+    }
+    memset(s_cache, 0, sizeof(s_cache));
+
+    nvs_handle_t handle;
+    if (nvs_open(API_CACHE_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_all(handle);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+    ESP_LOGI(TAG, "🗑️ API cache invalidated");
+    api_cache_unlock();
+}
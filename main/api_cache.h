@@ -0,0 +1,78 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_cache.h                                        *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: ETag/TTL cache for API lookups (RAM + NVS)  *
+ ************************************************************/
+
+#ifndef API_CACHE_H
+#define API_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define API_CACHE_NVS_NAMESPACE   "api_cache"
+#define API_CACHE_ETAG_SIZE       72
+#define API_CACHE_LAST_MOD_SIZE   40
+#define API_CACHE_DATA_SIZE       704     // Fits the decoded GitHub release
+
+// One slot per cached endpoint
+typedef enum {
+    API_CACHE_ACCOUNT = 0,      // /api/v2/account -> idUser
+    API_CACHE_PENDING_SIGNER,   // web_url -> totalElements
+    API_CACHE_PENDING_EDITOR,   // /api/v2/files -> totalElements
+    API_CACHE_RELEASE,          // GitHub latest release -> decoded release info
+    API_CACHE_SLOT_COUNT
+} api_cache_slot_t;
+
+/**
+ * @brief Creates the cache lock and restores the entries persisted in NVS
+ *
+ * Called by api_manager_init(); until then the cache behaves as empty.
+ */
+esp_err_t api_cache_init(void);
+
+/**
+ * @brief Returns the cached value if it is still within the slot TTL
+ *
+ * Entries restored from NVS after a reboot have an unknown age and are never
+ * fresh: they are only used to revalidate with If-None-Match.
+ */
+bool api_cache_get_fresh(api_cache_slot_t slot, void *data, size_t len);
+
+// Returns the cached value regardless of age (used on 304 Not Modified)
+bool api_cache_get(api_cache_slot_t slot, void *data, size_t len);
+
+/**
+ * @brief Formats the conditional request headers for a slot
+ *
+ * Writes "If-None-Match: ...\r\n" and/or "If-Modified-Since: ...\r\n" into
+ * buf (empty string when nothing is cached).
+ */
+void api_cache_conditional_headers(api_cache_slot_t slot, char *buf, size_t size);
+
+// Copies the validators of the cached entry ("" when absent); false if nothing is cached
+bool api_cache_get_validators(api_cache_slot_t slot, char *etag, size_t etag_size,
+                              char *last_modified, size_t last_modified_size);
+
+// Stores a freshly decoded value with its validators (persisted if changed)
+void api_cache_store(api_cache_slot_t slot, const char *etag, const char *last_modified,
+                     const void *data, size_t len);
+
+// Marks the cached value as just revalidated (304 Not Modified)
+void api_cache_touch(api_cache_slot_t slot);
+
+// Drops every cached entry from RAM and NVS
+void api_cache_invalidate_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // API_CACHE_H
@@ -0,0 +1,281 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_endpoints.c                                    *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: AskMeSign endpoint health and selection     *
+ ************************************************************/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "api_endpoints.h"
+#include "device_config.h"
+
+static const char *TAG = "API_Endpoints";
+
+// Health of one endpoint
+typedef struct {
+    char host[WEB_SERVER_SIZE];
+    char port[WEB_PORT_SIZE];
+    uint32_t ewma_ms;           // Latency average (0 = not measured yet)
+    uint32_t fail_score;        // API_EP_FAIL_UNIT per failure, halved by a success
+    int64_t fail_at_us;         // When fail_score was last raised (decay reference)
+    int64_t used_us;            // Last request or probe
+    uint32_t requests;
+    uint32_t failures;
+} api_ep_state_t;
+
+static api_ep_state_t s_eps[API_ENDPOINTS_MAX];
+static uint8_t s_count = 0;
+static uint8_t s_selected = 0;
+static uint32_t s_switches = 0;
+// A mutex, not a critical section: syncing with the configuration
+// compares and copies host names
+static SemaphoreHandle_t s_mutex = NULL;
+
+esp_err_t api_endpoints_init(void)
+{
+    if (s_mutex != NULL) {
+        return ESP_OK;
+    }
+    s_mutex = xSemaphoreCreateMutex();
+    if (s_mutex == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for the endpoint table lock");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// False before api_endpoints_init(): web_server:web_port is then used alone
+static bool api_ep_lock(void)
+{
+    if (s_mutex == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    return true;
+}
+
+static void api_ep_unlock(void)
+{
+    xSemaphoreGive(s_mutex);
+}
+
+// The configured endpoint, with no health record to choose by
+static void api_ep_configured(api_endpoint_t *ep)
+{
+    ep->index = 0;
+    strlcpy(ep->host, web_server, sizeof(ep->host));
+    strlcpy(ep->port, web_port, sizeof(ep->port));
+}
+
+// Caller holds the lock. Follows the configuration: an entry whose host or
+// port changed starts again with a clean record.
+static void api_ep_sync(void)
+{
+    const char *hosts[API_ENDPOINTS_MAX];
+    const char *ports[API_ENDPOINTS_MAX];
+    uint8_t count = 1 + extra_endpoint_count;
+
+    hosts[0] = web_server;
+    ports[0] = web_port;
+    for (uint8_t i = 0; i < extra_endpoint_count && i < EXTRA_ENDPOINTS_MAX; i++) {
+        hosts[1 + i] = extra_endpoints[i].host;
+        ports[1 + i] = extra_endpoints[i].port;
+    }
+    if (count > API_ENDPOINTS_MAX) {
+        count = API_ENDPOINTS_MAX;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        api_ep_state_t *e = &s_eps[i];
+        if (i >= s_count || strcmp(e->host, hosts[i]) != 0 || strcmp(e->port, ports[i]) != 0) {
+            memset(e, 0, sizeof(*e));
+            strlcpy(e->host, hosts[i], sizeof(e->host));
+            strlcpy(e->port, ports[i], sizeof(e->port));
+        }
+    }
+    s_count = count;
+    if (s_selected >= s_count) {
+        s_selected = 0;
+    }
+}
+
+// Failure score after its time decay
+static uint32_t api_ep_score(const api_ep_state_t *e, int64_t now_us)
+{
+    if (e->fail_score == 0) {
+        return 0;
+    }
+    int64_t halvings = (now_us - e->fail_at_us) / ((int64_t)API_EP_FAIL_HALF_LIFE_MS * 1000);
+    return (halvings >= 16) ? 0 : e->fail_score >> halvings;
+}
+
+static void api_ep_copy(uint8_t index, api_endpoint_t *ep)
+{
+    ep->index = index;
+    strlcpy(ep->host, s_eps[index].host, sizeof(ep->host));
+    strlcpy(ep->port, s_eps[index].port, sizeof(ep->port));
+}
+
+void api_endpoints_select(api_endpoint_t *ep)
+{
+    int64_t now = esp_timer_get_time();
+    int best = -1;
+    uint8_t previous;
+
+    if (!api_ep_lock()) {
+        api_ep_configured(ep);
+        return;
+    }
+    api_ep_sync();
+    previous = s_selected;
+    for (uint8_t i = 0; i < s_count; i++) {
+        const api_ep_state_t *e = &s_eps[i];
+        if (api_ep_score(e, now) >= API_EP_UNHEALTHY_SCORE) {
+            continue;
+        }
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        // An unmeasured endpoint never displaces one earlier in the list
+        uint32_t best_ms = s_eps[best].ewma_ms;
+        if (e->ewma_ms != 0 && best_ms != 0 &&
+            (uint64_t)e->ewma_ms * (100 + API_EP_SWITCH_MARGIN_PCT) < (uint64_t)best_ms * 100) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        // Nothing healthy: the least bad one
+        best = 0;
+        for (uint8_t i = 1; i < s_count; i++) {
+            if (api_ep_score(&s_eps[i], now) < api_ep_score(&s_eps[best], now)) {
+                best = i;
+            }
+        }
+    }
+    s_selected = (uint8_t)best;
+    if (s_selected != previous) {
+        s_switches++;
+    }
+    api_ep_copy(s_selected, ep);
+    api_ep_unlock();
+
+    if (ep->index != previous) {
+        ESP_LOGW(TAG, "🔀 Endpoint %s:%s selected (was #%u)", ep->host, ep->port, previous);
+    }
+}
+
+void api_endpoints_current(api_endpoint_t *ep)
+{
+    if (!api_ep_lock()) {
+        api_ep_configured(ep);
+        return;
+    }
+    api_ep_sync();
+    api_ep_copy(s_selected, ep);
+    api_ep_unlock();
+}
+
+void api_endpoints_report(uint8_t index, bool ok, uint32_t latency_ms)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (!api_ep_lock()) {
+        return;
+    }
+    if (index < s_count) {
+        api_ep_state_t *e = &s_eps[index];
+        uint32_t score = api_ep_score(e, now);
+        e->used_us = now;
+        e->requests++;
+        if (ok) {
+            if (latency_ms == 0) {
+                latency_ms = 1;
+            }
+            if (e->ewma_ms == 0) {
+                e->ewma_ms = latency_ms;
+            } else {
+                int32_t delta = ((int32_t)latency_ms - (int32_t)e->ewma_ms) / API_EP_EWMA_WEIGHT;
+                e->ewma_ms = (uint32_t)((int32_t)e->ewma_ms + delta);
+            }
+            e->fail_score = score / 2;
+        } else {
+            e->failures++;
+            score += API_EP_FAIL_UNIT;
+            e->fail_score = (score > API_EP_FAIL_MAX) ? API_EP_FAIL_MAX : score;
+        }
+        e->fail_at_us = now;
+    }
+    api_ep_unlock();
+}
+
+bool api_endpoints_probe_due(api_endpoint_t *ep)
+{
+    int64_t now = esp_timer_get_time();
+    bool due = false;
+
+    if (!api_ep_lock()) {
+        return false;
+    }
+    api_ep_sync();
+    for (uint8_t i = 0; i < s_count && s_count > 1; i++) {
+        if (i == s_selected) {
+            continue;
+        }
+        if (s_eps[i].used_us == 0 ||
+            now - s_eps[i].used_us >= (int64_t)API_EP_PROBE_INTERVAL_MS * 1000) {
+            api_ep_copy(i, ep);
+            due = true;
+            break;
+        }
+    }
+    api_ep_unlock();
+    return due;
+}
+
+void api_endpoints_probe_started(uint8_t index)
+{
+    if (!api_ep_lock()) {
+        return;
+    }
+    if (index < s_count) {
+        s_eps[index].used_us = esp_timer_get_time();
+    }
+    api_ep_unlock();
+}
+
+void api_endpoints_log_summary(void)
+{
+    api_ep_state_t eps[API_ENDPOINTS_MAX];
+    uint8_t count;
+    uint8_t selected;
+    uint32_t switches;
+    int64_t now = esp_timer_get_time();
+
+    if (!api_ep_lock()) {
+        return;
+    }
+    count = s_count;
+    selected = s_selected;
+    switches = s_switches;
+    memcpy(eps, s_eps, sizeof(eps));
+    api_ep_unlock();
+
+    if (count < 2) {
+        return;     // Nothing to choose from
+    }
+    ESP_LOGI(TAG, "🔀 Endpoints (%lu switch(es)):", switches);
+    for (uint8_t i = 0; i < count; i++) {
+        uint32_t score = api_ep_score(&eps[i], now);
+        ESP_LOGI(TAG, "  %c #%u %s:%s  ewma %lu ms  score %lu.%02lu%s  req %lu fail %lu",
+                 (i == selected) ? '*' : ' ', i, eps[i].host, eps[i].port, eps[i].ewma_ms,
+                 score / API_EP_FAIL_UNIT, (score % API_EP_FAIL_UNIT) / 10,
+                 (score >= API_EP_UNHEALTHY_SCORE) ? " (unhealthy)" : "",
+                 eps[i].requests, eps[i].failures);
+    }
+}
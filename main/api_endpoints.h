@@ -0,0 +1,77 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_endpoints.h                                    *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: AskMeSign endpoint health and selection     *
+ ************************************************************/
+
+#ifndef API_ENDPOINTS_H
+#define API_ENDPOINTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "device_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define API_ENDPOINTS_MAX              (1 + EXTRA_ENDPOINTS_MAX)
+#define API_EP_EWMA_WEIGHT             4       // New latency sample counts 1/4 of the average
+#define API_EP_FAIL_UNIT               1000    // Score added by one failure
+#define API_EP_FAIL_MAX                8000
+#define API_EP_UNHEALTHY_SCORE         1000    // At or above: skipped while another endpoint is healthy
+#define API_EP_FAIL_HALF_LIFE_MS       120000  // Failure score halves this often without new failures
+#define API_EP_SWITCH_MARGIN_PCT       25      // A later endpoint must be this much faster to win
+#define API_EP_PROBE_INTERVAL_MS       300000  // Background probe of each endpoint not in use
+
+// One endpoint as handed to the HTTP client
+typedef struct {
+    uint8_t index;                  // 0 = web_server:web_port, then extra_endpoints in order
+    char host[WEB_SERVER_SIZE];
+    char port[WEB_PORT_SIZE];
+} api_endpoint_t;
+
+// Creates the endpoint table lock (called by api_manager_init(); until then
+// every call goes to web_server:web_port and nothing is recorded)
+esp_err_t api_endpoints_init(void);
+
+/**
+ * @brief Picks the endpoint for the next request
+ *
+ * Among the healthy endpoints (failure score below API_EP_UNHEALTHY_SCORE)
+ * the configured order wins unless a later one has a latency average at
+ * least API_EP_SWITCH_MARGIN_PCT lower. With none healthy, the one with the
+ * lowest failure score is used. The list follows the configuration.
+ *
+ * @param ep Output endpoint
+ */
+void api_endpoints_select(api_endpoint_t *ep);
+
+/**
+ * @brief Records the outcome of a request on an endpoint
+ *
+ * @param index      Endpoint index (api_endpoint_t.index)
+ * @param ok         false for DNS/connect/TLS failures, timeouts and 5xx answers
+ * @param latency_ms Request written -> response headers (ok only)
+ */
+void api_endpoints_report(uint8_t index, bool ok, uint32_t latency_ms);
+
+// Endpoint picked by the last api_endpoints_select(), without re-evaluating
+void api_endpoints_current(api_endpoint_t *ep);
+
+// Endpoint whose background probe is due (false = none, or a single endpoint)
+bool api_endpoints_probe_due(api_endpoint_t *ep);
+
+// Marks the probe of an endpoint as started (whatever its outcome)
+void api_endpoints_probe_started(uint8_t index);
+
+// Logs latency average, failure score and selection of every endpoint
+void api_endpoints_log_summary(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // API_ENDPOINTS_H
@@ -0,0 +1,276 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_loopback.c                                     *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Recorded-response backend for the HTTP client *
+ ************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/ssl.h"
+
+#include "api_loopback.h"
+
+static const char *TAG = "API_Loopback";
+
+static const char s_not_found[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}";
+
+// One answer queued behind a request
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    int64_t ready_us;           // When its first byte may be read
+    bool close_after;           // The "server" closes once it is sent
+} api_loopback_answer_t;
+
+// One connection (api_transport_t.state)
+typedef struct {
+    char request[API_LOOPBACK_REQUEST_SIZE + 1];    // Head being received (NUL-terminated)
+    size_t request_len;
+    api_loopback_answer_t queue[API_LOOPBACK_QUEUE];
+    uint8_t head;
+    uint8_t count;
+    bool closed;                // An answer with close_after was read to the end
+} api_loopback_conn_t;
+
+static const api_loopback_record_t *s_records = NULL;
+static size_t s_record_count = 0;
+static uint32_t s_connections = 0;
+static uint32_t s_requests = 0;
+static uint32_t s_unmatched = 0;
+
+void api_loopback_load(const api_loopback_record_t *records, size_t count)
+{
+    s_records = records;
+    s_record_count = (records != NULL) ? count : 0;
+    ESP_LOGI(TAG, "🔁 %u recorded response(s) loaded", (unsigned)s_record_count);
+}
+
+void api_loopback_get_stats(uint32_t *connections, uint32_t *requests, uint32_t *unmatched)
+{
+    if (connections) {
+        *connections = s_connections;
+    }
+    if (requests) {
+        *requests = s_requests;
+    }
+    if (unmatched) {
+        *unmatched = s_unmatched;
+    }
+}
+
+// Case-insensitive search for line (e.g. "Content-Length:") at the start of
+// a header line of response
+static bool api_loopback_has_header(const uint8_t *data, size_t len, const char *line)
+{
+    size_t line_len = strlen(line);
+
+    for (size_t i = 0; i + 2 + line_len <= len; i++) {
+        if (data[i] == '\r' && data[i + 1] == '\n') {
+            if (i + 3 < len && data[i + 2] == '\r' && data[i + 3] == '\n') {
+                return false;       // End of the headers
+            }
+            if (strncasecmp((const char *)data + i + 2, line, line_len) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Queues the answer to one complete request head
+static int api_loopback_answer(api_loopback_conn_t *c, const char *head)
+{
+    const uint8_t *data = (const uint8_t *)s_not_found;
+    size_t len = sizeof(s_not_found) - 1;
+    uint32_t delay_ms = 0;
+    bool matched = false;
+
+    if (c->count >= API_LOOPBACK_QUEUE) {
+        ESP_LOGE(TAG, "More than %d requests pipelined", API_LOOPBACK_QUEUE);
+        return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    }
+    for (size_t i = 0; i < s_record_count; i++) {
+        const api_loopback_record_t *r = &s_records[i];
+        if (r->match == NULL || strstr(head, r->match) != NULL) {
+            data = (const uint8_t *)r->response;
+            len = (r->len != 0) ? r->len : strlen(r->response);
+            delay_ms = r->delay_ms;
+            matched = true;
+            break;
+        }
+    }
+    s_requests++;
+    if (!matched) {
+        s_unmatched++;
+        ESP_LOGW(TAG, "No recorded response for: %.*s", (int)strcspn(head, "\r"), head);
+    }
+
+    api_loopback_answer_t *a = &c->queue[(c->head + c->count) % API_LOOPBACK_QUEUE];
+    a->data = data;
+    a->len = len;
+    a->pos = 0;
+    // Pipelined answers follow each other: the delay runs from the previous one
+    int64_t start_us = esp_timer_get_time();
+    if (c->count > 0) {
+        int64_t prev_us = c->queue[(c->head + c->count - 1) % API_LOOPBACK_QUEUE].ready_us;
+        if (prev_us > start_us) {
+            start_us = prev_us;
+        }
+    }
+    a->ready_us = start_us + (int64_t)delay_ms * 1000;
+    // Without framing the body runs until the connection closes
+    a->close_after = api_loopback_has_header(data, len, "Connection: close") ||
+                     (!api_loopback_has_header(data, len, "Content-Length:") &&
+                      !api_loopback_has_header(data, len, "Transfer-Encoding:"));
+    c->count++;
+    return 0;
+}
+
+static api_error_class_t api_loopback_open(api_transport_t *t, const char *host, const char *port,
+                                           api_metrics_req_t *metrics)
+{
+    api_loopback_conn_t *c = calloc(1, sizeof(*c));
+
+    if (c == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for a loopback connection");
+        return API_ERR_CONNECT;
+    }
+    t->state = c;
+    s_connections++;
+    ESP_LOGI(TAG, "🔁 Loopback connection for %s:%s", host, port);
+    return API_ERR_NONE;
+}
+
+static int api_loopback_send(api_transport_t *t, const uint8_t *buf, size_t len)
+{
+    api_loopback_conn_t *c = (api_loopback_conn_t *)t->state;
+
+    if (c->closed) {
+        return MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    if (c->request_len + len > API_LOOPBACK_REQUEST_SIZE) {
+        ESP_LOGE(TAG, "Request head longer than %d bytes", API_LOOPBACK_REQUEST_SIZE);
+        return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    }
+    memcpy(c->request + c->request_len, buf, len);
+    c->request_len += len;
+    c->request[c->request_len] = '\0';
+
+    // Requests are bodiless GETs: each ends at its empty line
+    char *end;
+    while ((end = strstr(c->request, "\r\n\r\n")) != NULL) {
+        end += 4;
+        char saved = *end;
+        *end = '\0';
+        int ret = api_loopback_answer(c, c->request);
+        *end = saved;
+        if (ret != 0) {
+            return ret;
+        }
+        c->request_len -= end - c->request;
+        memmove(c->request, end, c->request_len + 1);
+    }
+    return 0;
+}
+
+// Sleeps until the first queued answer may be read, checking the deadline
+// every NET_CANCEL_SLICE_MS. limit_ms (0 = none) bounds the wait.
+// Returns true once it is readable.
+static bool api_loopback_wait(api_transport_t *t, uint32_t limit_ms)
+{
+    api_loopback_conn_t *c = (api_loopback_conn_t *)t->state;
+    uint32_t waited_ms = 0;
+
+    while (true) {
+        int64_t left_us = c->queue[c->head].ready_us - esp_timer_get_time();
+        if (left_us <= 0) {
+            return true;
+        }
+        if (net_deadline_over(t->deadline) || (limit_ms != 0 && waited_ms >= limit_ms)) {
+            return false;
+        }
+        uint32_t slice_ms = (left_us < NET_CANCEL_SLICE_MS * 1000) ? (uint32_t)(left_us / 1000) + 1
+                                                                   : NET_CANCEL_SLICE_MS;
+        vTaskDelay(pdMS_TO_TICKS(slice_ms) > 0 ? pdMS_TO_TICKS(slice_ms) : 1);
+        waited_ms += slice_ms;
+    }
+}
+
+static int api_loopback_recv(api_transport_t *t, uint8_t *buf, size_t len)
+{
+    api_loopback_conn_t *c = (api_loopback_conn_t *)t->state;
+
+    if (c->count == 0) {
+        // A real server would leave the read hanging until its timeout
+        return c->closed ? 0 : MBEDTLS_ERR_SSL_TIMEOUT;
+    }
+    if (!api_loopback_wait(t, API_TRANSPORT_READ_TIMEOUT_MS)) {
+        return MBEDTLS_ERR_SSL_TIMEOUT;
+    }
+
+    api_loopback_answer_t *a = &c->queue[c->head];
+    size_t n = a->len - a->pos;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(buf, a->data + a->pos, n);
+    a->pos += n;
+    if (a->pos == a->len) {
+        c->head = (c->head + 1) % API_LOOPBACK_QUEUE;
+        c->count--;
+        if (a->close_after) {
+            c->closed = true;
+            c->count = 0;       // Requests behind it are never answered
+        }
+    }
+    return (int)n;
+}
+
+static int api_loopback_poll(api_transport_t *t, uint32_t timeout_ms)
+{
+    api_loopback_conn_t *c = (api_loopback_conn_t *)t->state;
+
+    if (c->count == 0) {
+        if (c->closed) {
+            return 1;           // EOF is readable
+        }
+        if (timeout_ms > 0) {
+            vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        }
+        return 0;
+    }
+    if (timeout_ms == 0) {
+        return (c->queue[c->head].ready_us <= esp_timer_get_time()) ? 1 : 0;
+    }
+    return api_loopback_wait(t, timeout_ms) ? 1 : 0;
+}
+
+static const char *api_loopback_alpn(api_transport_t *t)
+{
+    return NULL;
+}
+
+static void api_loopback_close(api_transport_t *t)
+{
+    free(t->state);
+    t->state = NULL;
+}
+
+const api_transport_ops_t api_loopback_transport = {
+    .name = "loopback",
+    .open = api_loopback_open,
+    .send = api_loopback_send,
+    .recv = api_loopback_recv,
+    .poll = api_loopback_poll,
+    .alpn = api_loopback_alpn,
+    .close = api_loopback_close,
+};
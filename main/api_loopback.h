@@ -0,0 +1,49 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_loopback.h                                     *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Recorded-response backend for the HTTP client *
+ ************************************************************/
+
+#ifndef API_LOOPBACK_H
+#define API_LOOPBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "api_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Answers every request from a table of recorded HTTP/1.1 responses
+// instead of a server, so the API calls, the GitHub check and the OTA
+// download run unchanged (pool, pipelining, chunked and compressed bodies,
+// JSON streaming, metrics) with no network. Select it with
+// api_manager_set_transport(&api_loopback_transport); see TRANSPORT_GUIDE.md.
+
+#define API_LOOPBACK_REQUEST_SIZE   2048    // Longest request head accepted (signed download URLs are long)
+#define API_LOOPBACK_QUEUE          8       // Pipelined requests waiting for their answer
+
+typedef struct {
+    const char *match;      // Text the request head must contain, e.g. "GET /api/v2/account"
+                            // or "X-SignUser: bob" (NULL = any request). First match wins.
+    const char *response;   // Raw response: status line, headers, empty line, body
+    size_t len;             // Length of response (0 = strlen)
+    uint32_t delay_ms;      // Server time before the first byte of the answer
+} api_loopback_record_t;
+
+extern const api_transport_ops_t api_loopback_transport;
+
+// Serves records from now on. They are used in place, not copied: keep them
+// valid while the loopback is selected. A request no record matches gets a 404.
+void api_loopback_load(const api_loopback_record_t *records, size_t count);
+
+// Connections opened, requests answered and requests that matched no record
+void api_loopback_get_stats(uint32_t *connections, uint32_t *requests, uint32_t *unmatched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // API_LOOPBACK_H
@@ -7,586 +7,3607 @@
  #include <stdio.h>
  #include <string.h>
  #include <stdlib.h>
+ #include <strings.h>
+ #include <ctype.h>
+ #include <errno.h>
+ #include <time.h>
  #include "esp_log.h"
  #include "esp_err.h"
  #include "freertos/FreeRTOS.h"
  #include "freertos/task.h"
- #include "mbedtls/platform.h"
- #include "mbedtls/net_sockets.h"
- #include "mbedtls/esp_debug.h"
+ #include "freertos/semphr.h"
+ #include "esp_timer.h"
+ #include "esp_http_client.h"     // ESP_ERR_HTTP_* codes only
  #include "mbedtls/ssl.h"
- #include "mbedtls/entropy.h"
- #include "mbedtls/ctr_drbg.h"
- #include "mbedtls/error.h"
- #ifdef CONFIG_MBEDTLS_SSL_PROTO_TLS1_3
-     #include "psa/crypto.h"
- #endif
- #include "esp_crt_bundle.h"
- #include "mbedtls/x509_crt.h"
-#include "cJSON.h"
-#include "esp_http_client.h"
+#include "json_stream.h"
+#include "api_cache.h"
+#include "dns_cache.h"
+#include "api_metrics.h"
+#include "api_endpoints.h"
+#include "api_transport.h"
+#include "http2.h"
+#include "inflate_stream.h"
 #include "device_config.h"  // Contiene web_server, web_port, web_url, api_token, askmesign_user
 #include "ota_manager.h"    // Per ota_version_info_t
+#include "api_manager.h"
+#include "doc_list.h"
  
  static const char *TAG = "API_Manager";
- #define BUFFER_SIZE 8000
  int totalElements = 0;
- 
- // Function to extract the JSON body from the HTTP response
- const char *extract_json_body(const char *response) {
-     const char *json_start = strstr(response, "\r\n\r\n");
-     if (json_start) {
-         return json_start + 4;
+
+ // Offers gzip/deflate bodies (Accept-Encoding), decoded as they stream in.
+ // 0 = identity only, no decoder memory
+ #define API_HTTP_COMPRESSION       1
+
+ #define API_GITHUB_CHUNK_SIZE      1024    // Decoded release JSON read per step
+
+ // Backend of every new connection: TLS, or the loopback for bench runs
+ // (api_manager_set_transport)
+ static const api_transport_ops_t *s_transport = &api_transport_tls;
+ static SemaphoreHandle_t s_pool_mutex = NULL;     // Guards the connection pool
+
+ esp_err_t api_manager_init(void)
+ {
+     if (s_pool_mutex != NULL) {
+         return ESP_OK;
+     }
+     s_pool_mutex = xSemaphoreCreateMutex();
+     if (s_pool_mutex == NULL) {
+         ESP_LOGE(TAG, "❌ No memory for the connection pool lock");
+         return ESP_ERR_NO_MEM;
      }
-     return NULL;
+     esp_err_t err = api_transport_init();
+     if (err == ESP_OK) {
+         err = api_endpoints_init();
+     }
+     if (err == ESP_OK) {
+         err = dns_cache_init();
+     }
+     if (err == ESP_OK) {
+         err = api_cache_init();
+     }
+     return err;
  }
- 
- int api_manager_check_practices(void)
+
+ // ---------------------------------------------------------------------------
+ // Keep-alive connection pool
+ // ---------------------------------------------------------------------------
+ // AskMeSign calls go to the selected endpoint (web_server:web_port unless
+ // it failed over, see api_endpoints.h), so one authenticated HTTP/1.1
+ // keep-alive connection is kept open across polls and shared by the
+ // signer and editor requests. Slots are keyed by host:port; an idle
+ // connection is checked for half-open state before reuse and a request
+ // that fails on a reused connection is transparently retried on a new one.
+ // The GitHub check and the OTA download borrow a slot of their own
+ // (api_manager_http_open), so they never evict the warm API connection.
+
+ #define API_CONN_POOL_SIZE       3
+ #define API_CONN_MAX_IDLE_MS     55000   // Most front ends drop idle keep-alives after ~60 s
+ #define API_HTTP_REQUEST_SIZE    768
+ #define API_HTTP_LINE_SIZE       256
+ #define API_HTTP_URL_SIZE        1280    // Generic GETs: longest URL, redirect targets included
+ #define API_HTTP_MAX_REDIRECTS   3
+ #define API_HTTP_DRAIN_LIMIT     16384   // Max unread body we drain to keep a connection reusable
+ #define API_USER_AGENT           "Firminia/3.6.1"
+ #define API_JSON_CHUNK_SIZE      128     // Body slice fed to the JSON tokenizer per read
+ #define API_PIPELINE_DEPTH       3       // GETs in flight on one connection
+ #define API_PUSH_SLICE_MS        1000    // Push stream: how often a silent connection checks for stop
+ #define API_PUSH_IDLE_TIMEOUT_MS 90000   // Push stream: silence (no event, no heartbeat) before reconnecting
+ #define API_WARM_MARGIN_MS       5000    // Pre-connect: replace a warm connection this close to its idle limit
+ #define API_H2_HEADER_BLOCK_SIZE 1536    // Largest response header block decoded (HTTP/2)
+ #define API_H2_CREDIT_BYTES      16384   // DATA consumed before a WINDOW_UPDATE is sent (HTTP/2)
+ #define API_H2_BATCH_MAX         (1 + EXTRA_ACCOUNTS_MAX)   // Streams of one count batch (HTTP/2)
+ #define API_INFLATE_IN_SIZE      512     // Compressed bytes read per decoder refill
+ #if API_HTTP_COMPRESSION
+ #define API_ACCEPT_ENCODING      "Accept-Encoding: gzip, deflate\r\n"
+ #else
+ #define API_ACCEPT_ENCODING      ""
+ #endif
+
+ typedef struct {
+     bool connected;
+     bool busy;
+     char host[WEB_SERVER_SIZE];
+     char port[WEB_PORT_SIZE];
+     api_transport_t t;          // Backend stream (s_transport when opened)
+     int64_t last_used_us;
+     bool h2;                    // ALPN picked HTTP/2
+     bool h2_goaway;             // Server is shutting the connection down
+     uint32_t h2_next_stream;    // Next client stream id (odd)
+     uint32_t h2_max_streams;    // Server SETTINGS_MAX_CONCURRENT_STREAMS
+     uint32_t h2_last_stream;    // GOAWAY: last stream the server still answers
+     uint32_t h2_unacked;        // Connection-level DATA not yet credited back
+ } api_conn_t;
+
+ static api_conn_t s_pool[API_CONN_POOL_SIZE];
+ static uint32_t s_conn_opened = 0;
+ static uint32_t s_conn_reused = 0;
+
+ // Failure class of the last AskMeSign call. The first cause recorded wins,
+ // so a failed DNS lookup is not reported again as a connect error. Kept per
+ // task: the push stream runs next to the network worker.
+ static __thread api_error_class_t s_last_error = API_ERR_NONE;
+ static __thread int s_last_status = 0;
+
+ // Deadline of the call in progress on this task, set by every entry point
+ // and checked by every wait below it (NULL = unbounded, not cancellable)
+ static __thread const net_deadline_t *s_deadline = NULL;
+
+ // Endpoint the call in progress on this task talks to, picked by every
+ // entry point so one call never mixes servers
+ static __thread api_endpoint_t s_ep;
+
+ static const char *const s_error_names[API_ERR_CLASS_COUNT] = {
+     [API_ERR_NONE]     = "none",
+     [API_ERR_DNS]      = "dns",
+     [API_ERR_CONNECT]  = "connect",
+     [API_ERR_TLS]      = "tls",
+     [API_ERR_AUTH]     = "auth",
+     [API_ERR_HTTP_4XX] = "http-4xx",
+     [API_ERR_HTTP_5XX] = "http-5xx",
+     [API_ERR_PARSE]    = "parse",
+     [API_ERR_CANCELLED] = "cancelled",
+ };
+
+ static void api_error_reset(void)
+ {
+     s_last_error = API_ERR_NONE;
+     s_last_status = 0;
+ }
+
+ static void api_error_set(api_error_class_t cls)
+ {
+     if (s_last_error == API_ERR_NONE) {
+         s_last_error = cls;
+     }
+ }
+
+ static void api_error_from_status(int status)
+ {
+     s_last_status = status;
+     if (status == 401 || status == 403) {
+         api_error_set(API_ERR_AUTH);
+     } else if (status >= 500 || status == 408 || status == 429) {
+         api_error_set(API_ERR_HTTP_5XX);
+     } else {
+         api_error_set(API_ERR_HTTP_4XX);
+     }
+ }
+
+ // Starts an entry point: clears the last failure, adopts its deadline
+ // and picks the endpoint
+ static void api_call_begin(const net_deadline_t *deadline)
+ {
+     api_error_reset();
+     s_deadline = deadline;
+     api_endpoints_select(&s_ep);
+ }
+
+ // True, with the failure recorded, once the current call has run out of
+ // time or was cancelled
+ static bool api_deadline_over(void)
+ {
+     if (!net_deadline_over(s_deadline)) {
+         return false;
+     }
+     api_error_set(net_deadline_cancelled(s_deadline) ? API_ERR_CANCELLED : API_ERR_CONNECT);
+     return true;
+ }
+
+ api_error_class_t api_manager_last_error(int *http_status)
+ {
+     if (http_status) {
+         *http_status = s_last_status;
+     }
+     return s_last_error;
+ }
+
+ const char *api_manager_error_name(api_error_class_t cls)
+ {
+     return (cls < API_ERR_CLASS_COUNT) ? s_error_names[cls] : "?";
+ }
+
+ // Called while a push stream waits for data; returning false stops it
+ typedef bool (*api_resp_idle_cb_t)(void *ctx);
+
+ typedef enum {
+     API_ENCODING_IDENTITY = 0,
+     API_ENCODING_GZIP,
+     API_ENCODING_DEFLATE,
+     API_ENCODING_UNSUPPORTED    // Nothing we offered: the body cannot be read
+ } api_encoding_t;
+
+ // Streaming view of one HTTP/1.1 response on a pooled connection
+ typedef struct {
+     api_conn_t *conn;
+     int status_code;
+     int64_t content_length;     // -1 when the server did not send one
+     bool chunked;
+     bool conn_close;
+     int64_t body_left;          // Bytes left in the current chunk / body
+     bool body_done;
+     size_t bytes_in;
+     char etag[API_CACHE_ETAG_SIZE];
+     char last_modified[API_CACHE_LAST_MOD_SIZE];
+     int64_t range_start;        // Content-Range of a 206: first byte sent (-1 = none)
+     int64_t range_total;        // and the length of the whole entity (-1 = none or "*")
+     api_metrics_req_t *metrics;  // Timing spans of the request (may be NULL)
+     bool event_stream;          // Content-Type: text/event-stream
+     api_resp_idle_cb_t idle_cb; // Push streams only: reads wait in slices instead of timing out
+     void *idle_ctx;
+     bool stopped;               // idle_cb asked to stop
+     uint8_t encoding;           // api_encoding_t of the body
+     inflate_stream_t *inflate;  // Decoder of a compressed body, created on the first read
+     uint8_t *z_in;              // Its input: API_INFLATE_IN_SIZE wire bytes
+     size_t z_in_len;
+     size_t z_in_pos;
+     uint32_t h2_stream;         // HTTP/2 stream of this response (0 = HTTP/1.1)
+     uint32_t h2_data_left;      // HTTP/2: payload left in the current DATA frame
+     uint8_t h2_pad_left;        // HTTP/2: padding after it
+     bool h2_end_after;          // HTTP/2: that DATA frame ends the stream
+     uint32_t h2_unacked;        // HTTP/2: stream DATA not yet credited back
+     char *location;             // Generic GETs: receives a redirect's target (API_HTTP_URL_SIZE)
+     bool bad_length;            // HTTP/2: content-length or content-range did not parse
+     unsigned char rbuf[512];
+     size_t rlen;
+     size_t rpos;
+ } api_http_resp_t;
+
+ static void api_conn_close(api_conn_t *conn)
+ {
+     if (conn->connected) {
+         conn->t.ops->close(&conn->t);
+     }
+     conn->connected = false;
+ }
+
+ // Writes all of buf. Returns 0 or <0 (a missed deadline is recorded)
+ static int api_conn_send(api_conn_t *conn, const void *buf, size_t len)
+ {
+     int ret = conn->t.ops->send(&conn->t, buf, len);
+     if (ret < 0) {
+         api_deadline_over();
+     }
+     return ret;
+ }
+
+ // Reads what is available, up to len. Returns bytes read, 0 once the
+ // server closed the connection, <0 on error (a missed deadline is recorded)
+ static int api_conn_recv(api_conn_t *conn, void *buf, size_t len)
+ {
+     int ret = conn->t.ops->recv(&conn->t, buf, len);
+     if (ret < 0) {
+         api_deadline_over();
+     }
+     return ret;
+ }
+
+ // ---------------------------------------------------------------------------
+ // HTTP/2 connection
+ // ---------------------------------------------------------------------------
+ // On a connection where ALPN picked h2 every request is a stream of its
+ // own: single requests use the same api_http_resp_t reader as HTTP/1.1
+ // and the counts of a cycle go out as concurrent streams
+ // (api_h2_fetch_counts). A protocol error turns HTTP/2 off until reboot.
+
+ #if API_HTTP2
+ static void api_h2_disable(const char *why)
+ {
+     // Only read by handshakes: connections already open keep their protocol
+     if (api_transport_tls_disable_h2()) {
+         ESP_LOGW(TAG, "⚠️ HTTP/2 turned off (%s), falling back to HTTP/1.1", why);
+     }
+ }
+ #else
+ static void api_h2_disable(const char *why)
+ {
+     (void)why;
+ }
+ #endif
+
+ static int api_h2_write(api_conn_t *conn, const uint8_t *buf, size_t len)
+ {
+     return api_conn_send(conn, buf, len);
+ }
+
+ // Reads exactly len bytes (frames are small: mbedTLS serves them from the decrypted record)
+ static int api_h2_recv(api_conn_t *conn, void *buf, size_t len, size_t *bytes_in)
+ {
+     size_t got = 0;
+
+     while (got < len) {
+         int ret = api_conn_recv(conn, (uint8_t *)buf + got, len - got);
+         if (ret == 0) {
+             ESP_LOGW(TAG, "HTTP/2 connection closed by server");
+             return -1;
+         }
+         if (ret < 0) {
+             return ret;
+         }
+         got += ret;
+     }
+     if (bytes_in != NULL) {
+         *bytes_in += len;
+     }
+     return 0;
+ }
+
+ static int api_h2_skip(api_conn_t *conn, uint32_t len, size_t *bytes_in)
+ {
+     uint8_t scratch[64];
+
+     while (len > 0) {
+         uint32_t n = (len < sizeof(scratch)) ? len : sizeof(scratch);
+         if (api_h2_recv(conn, scratch, n, bytes_in) != 0) {
+             return -1;
+         }
+         len -= n;
+     }
+     return 0;
+ }
+
+ // Hands consumed DATA back to the server's flow-control windows
+ // (stream_unacked NULL = the stream is over, connection window only)
+ static int api_h2_credit(api_conn_t *conn, uint32_t stream_id, uint32_t *stream_unacked, uint32_t len)
+ {
+     uint8_t frames[2 * HTTP2_WINDOW_UPDATE_SIZE];
+     size_t n = 0;
+
+     conn->h2_unacked += len;
+     if (conn->h2_unacked >= API_H2_CREDIT_BYTES) {
+         n += http2_window_update(frames + n, 0, conn->h2_unacked);
+         conn->h2_unacked = 0;
+     }
+     if (stream_unacked != NULL) {
+         *stream_unacked += len;
+         if (*stream_unacked >= API_H2_CREDIT_BYTES) {
+             n += http2_window_update(frames + n, stream_id, *stream_unacked);
+             *stream_unacked = 0;
+         }
+     }
+     return (n > 0) ? api_h2_write(conn, frames, n) : 0;
+ }
+
+ // Frames addressed to the connection (stream 0) or to a stream nobody
+ // reads any more. Returns 0, or <0 once the connection is unusable.
+ static int api_h2_control(api_conn_t *conn, const http2_frame_t *f, size_t *bytes_in)
+ {
+     uint8_t payload[8];
+     uint8_t out[HTTP2_PING_SIZE];
+
+     switch (f->type) {
+         case HTTP2_FRAME_SETTINGS:
+             if (f->flags & HTTP2_FLAG_ACK) {
+                 return api_h2_skip(conn, f->length, bytes_in);
+             }
+             if (f->length % 6 != 0) {
+                 api_h2_disable("bad SETTINGS");
+                 return -1;
+             }
+             for (uint32_t left = f->length; left > 0; left -= 6) {
+                 if (api_h2_recv(conn, payload, 6, bytes_in) != 0) {
+                     return -1;
+                 }
+                 uint16_t id = ((uint16_t)payload[0] << 8) | payload[1];
+                 uint32_t value = ((uint32_t)payload[2] << 24) | ((uint32_t)payload[3] << 16) |
+                                  ((uint32_t)payload[4] << 8) | payload[5];
+                 if (id == HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS) {
+                     conn->h2_max_streams = value;
+                 }
+             }
+             return api_h2_write(conn, out, http2_settings_ack(out));
+         case HTTP2_FRAME_PING:
+             if (f->length != 8 || api_h2_recv(conn, payload, 8, bytes_in) != 0) {
+                 return -1;
+             }
+             if (f->flags & HTTP2_FLAG_ACK) {
+                 return 0;
+             }
+             return api_h2_write(conn, out, http2_ping_ack(out, payload));
+         case HTTP2_FRAME_GOAWAY:
+             if (f->length < 8 || api_h2_recv(conn, payload, 8, bytes_in) != 0) {
+                 return -1;
+             }
+             conn->h2_goaway = true;
+             conn->h2_last_stream = (((uint32_t)payload[0] << 24) | ((uint32_t)payload[1] << 16) |
+                                     ((uint32_t)payload[2] << 8) | payload[3]) & HTTP2_MAX_STREAM_ID;
+             ESP_LOGW(TAG, "HTTP/2 GOAWAY from server (last stream %lu, error %lu)", conn->h2_last_stream,
+                      ((uint32_t)payload[4] << 24) | ((uint32_t)payload[5] << 16) |
+                      ((uint32_t)payload[6] << 8) | payload[7]);
+             return api_h2_skip(conn, f->length - 8, bytes_in);
+         case HTTP2_FRAME_DATA:
+             // Tail of a stream we are done with: still counts against the connection window
+             if (api_h2_skip(conn, f->length, bytes_in) != 0) {
+                 return -1;
+             }
+             return api_h2_credit(conn, 0, NULL, f->length);
+         case HTTP2_FRAME_PUSH_PROMISE:
+             api_h2_disable("push promised although disabled");
+             return -1;
+         default:
+             // WINDOW_UPDATE (we never send DATA), PRIORITY, RST_STREAM of a
+             // finished stream, headers nobody waits for (no HPACK state to keep)
+             return api_h2_skip(conn, f->length, bytes_in);
+     }
+ }
+
+ #if API_HTTP2
+ // Client preface, then the server's: a SETTINGS frame
+ static int api_h2_start(api_conn_t *conn)
+ {
+     uint8_t buf[64];
+     http2_frame_t f;
+
+     conn->h2_goaway = false;
+     conn->h2_next_stream = 1;
+     conn->h2_max_streams = HTTP2_DEFAULT_MAX_STREAMS;
+     conn->h2_last_stream = 0;
+     conn->h2_unacked = 0;
+
+     if (api_h2_write(conn, buf, http2_client_preface(buf, sizeof(buf))) != 0 ||
+         api_h2_recv(conn, buf, HTTP2_FRAME_HEADER_SIZE, NULL) != 0) {
+         return -1;
+     }
+     http2_frame_header_decode(buf, &f);
+     if (f.type != HTTP2_FRAME_SETTINGS || (f.flags & HTTP2_FLAG_ACK)) {
+         api_h2_disable("no server preface");
+         return -1;
+     }
+     return api_h2_control(conn, &f, NULL);
+ }
+ #endif
+
+ // An idle HTTP/2 connection legitimately receives frames (SETTINGS ACK,
+ // PING, the tail of a stream we reset): handle them. false = unusable
+ static bool api_h2_service_idle(api_conn_t *conn)
+ {
+     uint8_t hdr[HTTP2_FRAME_HEADER_SIZE];
+     http2_frame_t f;
+
+     while (!conn->h2_goaway && conn->t.ops->poll(&conn->t, 0) > 0) {
+         if (api_h2_recv(conn, hdr, sizeof(hdr), NULL) != 0) {
+             return false;
+         }
+         http2_frame_header_decode(hdr, &f);
+         if (api_h2_control(conn, &f, NULL) != 0) {
+             return false;
+         }
+     }
+     // Stream ids are never reused: retire the connection well before they run out
+     return !conn->h2_goaway && conn->h2_next_stream < HTTP2_MAX_STREAM_ID / 2;
+ }
+
+ // True when an idle keep-alive connection can no longer be used: the peer
+ // closed it (FIN / close_notify pending), reset it, or it sat idle too long
+ static bool api_conn_is_stale(api_conn_t *conn)
+ {
+     int64_t idle_ms = (esp_timer_get_time() - conn->last_used_us) / 1000;
+     if (idle_ms > API_CONN_MAX_IDLE_MS) {
+         ESP_LOGI(TAG, "♻️ Pooled connection idle for %lld ms, reconnecting", idle_ms);
+         return true;
+     }
+     if (conn->h2) {
+         if (!api_h2_service_idle(conn)) {
+             ESP_LOGI(TAG, "♻️ Pooled HTTP/2 connection closing, reconnecting");
+             return true;
+         }
+         return false;
+     }
+     // Nothing should be readable on an idle HTTP connection: if the stream
+     // polls readable the server has sent an alert, a FIN or a RST
+     int ret = conn->t.ops->poll(&conn->t, 0);
+     if (ret != 0) {
+         ESP_LOGI(TAG, "♻️ Pooled connection half-open (poll=%d), reconnecting", ret);
+         return true;
+     }
+     return false;
+ }
+
+ static int api_conn_open(api_conn_t *conn, const char *host, const char *port, bool foreign,
+                          api_metrics_req_t *metrics)
+ {
+     memset(&conn->t, 0, sizeof(conn->t));
+     conn->t.ops = s_transport;
+     conn->t.deadline = s_deadline;
+     conn->t.foreign = foreign;
+     conn->h2 = false;
+
+     ESP_LOGI(TAG, "Connecting to %s:%s (%s)...", host, port, s_transport->name);
+     api_metrics_mark(metrics);
+     api_error_class_t cls = s_transport->open(&conn->t, host, port, metrics);
+     if (cls != API_ERR_NONE) {
+         // A call cut short reports that, not the step it was in
+         api_deadline_over();
+         api_error_set(cls);
+         conn->connected = false;
+         return -1;
+     }
+
+ #if API_HTTP2
+     const char *alpn = s_transport->alpn(&conn->t);
+     conn->h2 = (alpn != NULL && strcmp(alpn, HTTP2_ALPN) == 0);
+     if (conn->h2) {
+         if (api_h2_start(conn) != 0) {
+             ESP_LOGE(TAG, "HTTP/2 connection setup failed");
+             api_deadline_over();
+             api_error_set(API_ERR_CONNECT);
+             s_transport->close(&conn->t);
+             conn->connected = false;
+             return -1;
+         }
+         ESP_LOGI(TAG, "🚀 HTTP/2 (max %lu concurrent streams)", conn->h2_max_streams);
+     }
+ #endif
+
+     strlcpy(conn->host, host, sizeof(conn->host));
+     strlcpy(conn->port, port, sizeof(conn->port));
+     conn->connected = true;
+     conn->last_used_us = esp_timer_get_time();
+     s_conn_opened++;
+     return 0;
+ }
+
+ // Hands a busy slot back without using it
+ static void api_conn_unbusy(api_conn_t *conn)
+ {
+     xSemaphoreTake(s_pool_mutex, portMAX_DELAY);
+     conn->t.deadline = NULL;
+     conn->busy = false;
+     xSemaphoreGive(s_pool_mutex);
+ }
+
+ // Closes the idle pooled connections for which keep() is false, with
+ // close_notify bounded by deadline. Each one is marked busy under the
+ // pool lock and closed after releasing it
+ static void api_conn_close_idle(bool (*keep)(const api_conn_t *conn), const net_deadline_t *deadline)
+ {
+     for (int i = 0; i < API_CONN_POOL_SIZE; i++) {
+         api_conn_t *c = &s_pool[i];
+         bool evict = false;
+         xSemaphoreTake(s_pool_mutex, portMAX_DELAY);
+         if (c->connected && !c->busy && (keep == NULL || !keep(c))) {
+             c->busy = true;
+             evict = true;
+         }
+         xSemaphoreGive(s_pool_mutex);
+         if (evict) {
+             c->t.deadline = deadline;
+             api_conn_close(c);
+             api_conn_unbusy(c);
+         }
+     }
+ }
+
+ // Hands out a connection to host:port, reusing a live pooled one if
+ // possible. ep is the AskMeSign endpoint they name, NULL for any other
+ // host (see api_transport_t.foreign); a connection to an endpoint that
+ // cannot be opened counts against it.
+ static api_conn_t *api_conn_get(const char *host, const char *port, const api_endpoint_t *ep,
+                                 bool *reused, api_metrics_req_t *metrics)
+ {
+     bool foreign = (ep == NULL);
+     api_conn_t *conn = NULL;
+     *reused = false;
+
+     if (api_deadline_over()) {
+         return NULL;
+     }
+     if (s_pool_mutex == NULL) {
+         ESP_LOGE(TAG, "❌ api_manager_init() was not called");
+         api_error_set(API_ERR_CONNECT);
+         return NULL;
+     }
+     // The lock only covers picking a slot and marking it busy: checking
+     // an idle connection (HTTP/2 control frames) and closing one
+     // (close_notify) are I/O, done on this call's deadline without it
+     while (true) {
+         api_conn_t *idle = NULL;
+         xSemaphoreTake(s_pool_mutex, portMAX_DELAY);
+         for (int i = 0; i < API_CONN_POOL_SIZE; i++) {
+             api_conn_t *c = &s_pool[i];
+             if (c->connected && !c->busy && c->t.ops == s_transport && c->t.foreign == foreign &&
+                 strcmp(c->host, host) == 0 && strcmp(c->port, port) == 0) {
+                 idle = c;
+                 idle->busy = true;
+                 break;
+             }
+         }
+         xSemaphoreGive(s_pool_mutex);
+         if (idle == NULL) {
+             break;
+         }
+         idle->t.deadline = s_deadline;
+         if (!api_conn_is_stale(idle)) {
+             s_conn_reused++;
+             *reused = true;
+             ESP_LOGI(TAG, "♻️ Reusing keep-alive connection to %s:%s", host, port);
+             return idle;
+         }
+         api_conn_close(idle);
+         api_conn_unbusy(idle);
+     }
+
+     // Prefer an empty slot, otherwise evict the least recently used idle one
+     xSemaphoreTake(s_pool_mutex, portMAX_DELAY);
+     for (int i = 0; i < API_CONN_POOL_SIZE; i++) {
+         api_conn_t *c = &s_pool[i];
+         if (c->busy) {
+             continue;
+         }
+         if (!c->connected) {
+             conn = c;
+             break;
+         }
+         if (conn == NULL || c->last_used_us < conn->last_used_us) {
+             conn = c;
+         }
+     }
+     if (conn != NULL) {
+         conn->busy = true;
+     }
+     xSemaphoreGive(s_pool_mutex);
+
+     if (conn == NULL) {
+         ESP_LOGE(TAG, "❌ No free slot in connection pool");
+         return NULL;
+     }
+     if (conn->connected) {
+         conn->t.deadline = s_deadline;
+         api_conn_close(conn);
+     }
+
+     if (api_conn_open(conn, host, port, foreign, metrics) != 0) {
+         if (ep != NULL && !net_deadline_cancelled(s_deadline)) {
+             api_endpoints_report(ep->index, false, 0);
+         }
+         api_conn_unbusy(conn);
+         return NULL;
+     }
+     return conn;
+ }
+
+ static api_conn_t *api_conn_acquire(const api_endpoint_t *ep, bool *reused,
+                                     api_metrics_req_t *metrics)
+ {
+     return api_conn_get(ep->host, ep->port, ep, reused, metrics);
+ }
+
+ // Returns a connection to the pool, or closes it if it cannot be reused
+ static void api_conn_release(api_conn_t *conn, bool reusable)
+ {
+     if (conn == NULL) {
+         return;
+     }
+     // Still busy: nobody else touches it while close_notify goes out
+     if (!reusable) {
+         api_conn_close(conn);
+     }
+     xSemaphoreTake(s_pool_mutex, portMAX_DELAY);
+     if (reusable) {
+         conn->last_used_us = esp_timer_get_time();
+     }
+     conn->t.deadline = NULL;
+     conn->busy = false;
+     xSemaphoreGive(s_pool_mutex);
+ }
+
+ // Push streams stay silent between events: wait for data in slices so the
+ // owner can stop the stream (token at once, idle_cb every API_PUSH_SLICE_MS),
+ // and give up after API_PUSH_IDLE_TIMEOUT_MS without even a heartbeat (the
+ // connection is probably dead)
+ static int api_resp_wait_stream(api_http_resp_t *resp)
+ {
+     uint32_t idle_ms = 0;
+     uint32_t slice_ms = 0;
+
+     while (true) {
+         if (api_deadline_over()) {
+             resp->stopped = true;
+             return MBEDTLS_ERR_SSL_TIMEOUT;
+         }
+         int ready = resp->conn->t.ops->poll(&resp->conn->t, NET_CANCEL_SLICE_MS);
+         if (ready < 0) {
+             return ready;
+         }
+         if (ready > 0) {
+             break;
+         }
+         slice_ms += NET_CANCEL_SLICE_MS;
+         if (slice_ms < API_PUSH_SLICE_MS) {
+             continue;
+         }
+         slice_ms = 0;
+         if (!resp->idle_cb(resp->idle_ctx)) {
+             resp->stopped = true;
+             return MBEDTLS_ERR_SSL_TIMEOUT;
+         }
+         idle_ms += API_PUSH_SLICE_MS;
+         if (idle_ms >= API_PUSH_IDLE_TIMEOUT_MS) {
+             ESP_LOGW(TAG, "📡 Push stream silent for %lu ms, dropping it", idle_ms);
+             return MBEDTLS_ERR_SSL_TIMEOUT;
+         }
+     }
+     return 0;
+ }
+
+ // Refills the response read-ahead buffer. Returns bytes read, 0 on EOF, <0 on error
+ static int api_resp_fill(api_http_resp_t *resp)
  {
      int ret;
-     size_t offset = 0;
-     char *buffer = NULL;
-     int practices_found = -1;
+     if (resp->idle_cb != NULL && (ret = api_resp_wait_stream(resp)) != 0) {
+         return ret;
+     }
+     ret = api_conn_recv(resp->conn, resp->rbuf, sizeof(resp->rbuf));
+     if (ret <= 0) {
+         return ret;
+     }
+     resp->rlen = ret;
+     resp->rpos = 0;
+     resp->bytes_in += ret;
+     return ret;
+ }
+
+ // Reads one CRLF-terminated line (CRLF stripped). Returns length or -1
+ static int api_resp_read_line(api_http_resp_t *resp, char *line, size_t size)
+ {
+     size_t len = 0;
+     while (true) {
+         if (resp->rpos >= resp->rlen && api_resp_fill(resp) <= 0) {
+             return -1;
+         }
+         char c = (char)resp->rbuf[resp->rpos++];
+         if (c == '\n') {
+             break;
+         }
+         if (c != '\r' && len < size - 1) {
+             line[len++] = c;
+         }
+     }
+     line[len] = '\0';
+     return (int)len;
+ }
+
+ // Case-insensitive search for token inside a header value
+ static bool api_header_has_token(const char *value, const char *token)
+ {
+     size_t token_len = strlen(token);
+     for (; *value != '\0'; value++) {
+         if (strncasecmp(value, token, token_len) == 0) {
+             return true;
+         }
+     }
+     return false;
+ }
+
+ // Copies a header value without its leading whitespace
+ static void api_header_copy_value(char *dst, size_t size, const char *value)
+ {
+     while (*value == ' ' || *value == '\t') {
+         value++;
+     }
+     strlcpy(dst, value, size);
+ }
+
+ static uint8_t api_header_encoding(const char *value)
+ {
+     while (*value == ' ' || *value == '\t') {
+         value++;
+     }
+     if (*value == '\0' || api_header_has_token(value, "identity")) {
+         return API_ENCODING_IDENTITY;
+     }
+     if (api_header_has_token(value, "gzip")) {
+         return API_ENCODING_GZIP;       // Also x-gzip
+     }
+     if (api_header_has_token(value, "deflate")) {
+         return API_ENCODING_DEFLATE;
+     }
+     return API_ENCODING_UNSUPPORTED;
+ }
+
+ // Number sent by the server in a length header or chunk line: digits of
+ // base only (no sign, blank or "0x"), below INT64_MAX, which stands for
+ // "until close". *end gets the byte after it
+ static bool api_parse_length(const char *s, int base, const char **end, int64_t *out)
+ {
+     char *stop = NULL;
+
+     errno = 0;
+     long long v = strtoll(s, &stop, base);
+     if (stop == s || errno == ERANGE || v < 0 || v >= INT64_MAX) {
+         return false;
+     }
+     for (const char *p = s; p < stop; p++) {
+         if (!((base == 16) ? isxdigit((unsigned char)*p) : isdigit((unsigned char)*p))) {
+             return false;
+         }
+     }
+     *end = stop;
+     *out = v;
+     return true;
+ }
+
+ // Content-Length: the number alone
+ static bool api_header_length(const char *value, int64_t *out)
+ {
+     const char *end;
+
+     while (*value == ' ' || *value == '\t') {
+         value++;
+     }
+     if (!api_parse_length(value, 10, &end, out)) {
+         return false;
+     }
+     while (*end == ' ' || *end == '\t') {
+         end++;
+     }
+     return *end == '\0';
+ }
+
+ // "bytes first-last/length" of a partial answer (length may be "*").
+ // False when its numbers are malformed or inconsistent
+ static bool api_header_content_range(api_http_resp_t *resp, const char *value)
+ {
+     int64_t first = 0;
+     int64_t last = 0;
+     int64_t total = -1;
+     const char *p;
+
+     while (*value == ' ' || *value == '\t') {
+         value++;
+     }
+     if (strncmp(value, "bytes ", 6) != 0 || value[6] == '*') {
+         return true;        // Other unit, or the "*/length" of a 416: no range sent
+     }
+     if (!api_parse_length(value + 6, 10, &p, &first) || *p != '-' ||
+         !api_parse_length(p + 1, 10, &p, &last) || *p != '/' || last < first) {
+         return false;
+     }
+     if (p[1] == '*') {
+         p += 2;
+     } else if (!api_parse_length(p + 1, 10, &p, &total) || total <= last) {
+         return false;
+     }
+     while (*p == ' ' || *p == '\t') {
+         p++;
+     }
+     if (*p != '\0') {
+         return false;
+     }
+     resp->range_start = first;
+     resp->range_total = total;
+     return true;
+ }
+
+ // ---------------------------------------------------------------------------
+ // HTTP/2 response
+ // ---------------------------------------------------------------------------
+ // resp->h2_stream != 0: the reader below replaces the HTTP/1.1 parsing.
+ // Any error leaves the connection out of frame sync, so it is closed.
+
+ // Reads the header block that starts with the HEADERS frame f: its payload
+ // without padding and priority, then the CONTINUATION frames.
+ // Returns the block length, or -1 (connection unusable)
+ static int api_h2_read_header_block(api_conn_t *conn, const http2_frame_t *f, uint8_t *block,
+                                     size_t *bytes_in)
+ {
+     uint8_t hdr[HTTP2_FRAME_HEADER_SIZE];
+     http2_frame_t cur = *f;
+     size_t len = 0;
+
+     while (true) {
+         uint32_t payload = cur.length;
+         uint8_t pad = 0;
+
+         if (cur.type == HTTP2_FRAME_HEADERS && (cur.flags & HTTP2_FLAG_PADDED)) {
+             if (payload < 1 || api_h2_recv(conn, &pad, 1, bytes_in) != 0) {
+                 return -1;
+             }
+             payload--;
+         }
+         if (cur.type == HTTP2_FRAME_HEADERS && (cur.flags & HTTP2_FLAG_PRIORITY)) {
+             if (payload < 5 || api_h2_skip(conn, 5, bytes_in) != 0) {
+                 return -1;
+             }
+             payload -= 5;
+         }
+         if (pad > payload) {
+             return -1;
+         }
+         payload -= pad;
+         if (len + payload > API_H2_HEADER_BLOCK_SIZE) {
+             ESP_LOGE(TAG, "HTTP/2 header block larger than %d bytes", API_H2_HEADER_BLOCK_SIZE);
+             return -1;
+         }
+         if (api_h2_recv(conn, block + len, payload, bytes_in) != 0 ||
+             api_h2_skip(conn, pad, bytes_in) != 0) {
+             return -1;
+         }
+         len += payload;
+         if (cur.flags & HTTP2_FLAG_END_HEADERS) {
+             return (int)len;
+         }
+         if (api_h2_recv(conn, hdr, sizeof(hdr), bytes_in) != 0) {
+             return -1;
+         }
+         http2_frame_header_decode(hdr, &cur);
+         if (cur.type != HTTP2_FRAME_CONTINUATION || cur.stream_id != f->stream_id) {
+             api_h2_disable("header block interrupted");
+             return -1;
+         }
+     }
+ }
+
+ // The headers api_resp_read_headers() looks at
+ static void api_h2_resp_header(const char *name, const char *value, void *ctx)
+ {
+     api_http_resp_t *resp = (api_http_resp_t *)ctx;
+
+     if (strcmp(name, ":status") == 0) {
+         resp->status_code = atoi(value);
+     } else if (strcmp(name, "content-length") == 0) {
+         if (!api_header_length(value, &resp->content_length)) {
+             resp->bad_length = true;
+         }
+     } else if (strcmp(name, "content-encoding") == 0) {
+         resp->encoding = api_header_encoding(value);
+     } else if (strcmp(name, "content-type") == 0) {
+         resp->event_stream = api_header_has_token(value, "text/event-stream");
+     } else if (strcmp(name, "content-range") == 0) {
+         if (!api_header_content_range(resp, value)) {
+             resp->bad_length = true;
+         }
+     } else if (strcmp(name, "etag") == 0) {
+         strlcpy(resp->etag, value, sizeof(resp->etag));
+     } else if (strcmp(name, "last-modified") == 0) {
+         strlcpy(resp->last_modified, value, sizeof(resp->last_modified));
+     } else if (strcmp(name, "location") == 0 && resp->location != NULL) {
+         strlcpy(resp->location, value, API_HTTP_URL_SIZE);
+     }
+ }
+
+ // Next frame of the response's stream; connection frames and leftovers of
+ // other streams are handled on the way. Returns 0 with its header in f, or <0
+ static int api_h2_next_frame(api_http_resp_t *resp, http2_frame_t *f)
+ {
+     api_conn_t *conn = resp->conn;
+     uint8_t hdr[HTTP2_FRAME_HEADER_SIZE];
+     int ret;
+
+     while (true) {
+         if (resp->idle_cb != NULL && (ret = api_resp_wait_stream(resp)) != 0) {
+             return ret;
+         }
+         if (api_h2_recv(conn, hdr, sizeof(hdr), &resp->bytes_in) != 0) {
+             return -1;
+         }
+         http2_frame_header_decode(hdr, f);
+         if (f->stream_id == resp->h2_stream &&
+             (f->type == HTTP2_FRAME_HEADERS || f->type == HTTP2_FRAME_DATA)) {
+             return 0;
+         }
+         if (f->stream_id == resp->h2_stream && f->type == HTTP2_FRAME_RST_STREAM) {
+             ESP_LOGW(TAG, "HTTP/2 stream %lu reset by server", resp->h2_stream);
+             return -1;
+         }
+         if (api_h2_control(conn, f, &resp->bytes_in) != 0) {
+             return -1;
+         }
+         if (conn->h2_goaway && resp->h2_stream > conn->h2_last_stream) {
+             ESP_LOGW(TAG, "HTTP/2 stream %lu dropped by GOAWAY", resp->h2_stream);
+             return -1;
+         }
+     }
+ }
+
+ // HTTP/2 counterpart of api_resp_read_headers(): the HEADERS of the
+ // stream (interim 1xx answers skipped)
+ static int api_h2_resp_headers(api_http_resp_t *resp)
+ {
+     http2_frame_t f;
+     int ret = -1;
+     uint8_t *block = malloc(API_H2_HEADER_BLOCK_SIZE);
+
+     if (block == NULL) {
+         ESP_LOGE(TAG, "❌ No memory for the HTTP/2 header block");
+         resp->conn_close = true;
+         return -1;
+     }
+     while (api_h2_next_frame(resp, &f) == 0) {
+         if (f.type != HTTP2_FRAME_HEADERS) {
+             ESP_LOGE(TAG, "HTTP/2 DATA before the response headers");
+             api_error_set(API_ERR_PARSE);
+             break;
+         }
+         int len = api_h2_read_header_block(resp->conn, &f, block, &resp->bytes_in);
+         if (len < 0) {
+             break;
+         }
+         resp->status_code = 0;
+         if (http2_decode_headers(block, len, api_h2_resp_header, resp) != 0) {
+             api_h2_disable("HPACK decoding failed");
+             api_error_set(API_ERR_PARSE);
+             break;
+         }
+         if (resp->bad_length) {
+             ESP_LOGE(TAG, "HTTP/2 response with a malformed length");
+             api_error_set(API_ERR_PARSE);
+             break;
+         }
+         if (resp->status_code >= 100 && resp->status_code < 200) {
+             continue;
+         }
+         if (resp->status_code == 0) {
+             ESP_LOGE(TAG, "HTTP/2 response without :status");
+             api_error_set(API_ERR_PARSE);
+             break;
+         }
+         resp->body_done = (f.flags & HTTP2_FLAG_END_STREAM) != 0;
+         ret = 0;
+         break;
+     }
+     free(block);
+     if (ret != 0) {
+         resp->conn_close = true;
+     }
+     return ret;
+ }
+
+ // HTTP/2 counterpart of api_resp_read_raw(): payload of the stream's
+ // DATA frames, trailers ignored
+ static int api_h2_resp_body(api_http_resp_t *resp, char *buf, size_t len)
+ {
+     api_conn_t *conn = resp->conn;
+     http2_frame_t f;
+
+     while (resp->h2_data_left == 0) {
+         if (resp->h2_pad_left > 0) {
+             if (api_h2_skip(conn, resp->h2_pad_left, &resp->bytes_in) != 0) {
+                 goto fail;
+             }
+             resp->h2_pad_left = 0;
+         }
+         if (resp->h2_end_after) {
+             resp->body_done = true;
+             return 0;
+         }
+         if (api_h2_next_frame(resp, &f) != 0) {
+             goto fail;
+         }
+         if (f.type == HTTP2_FRAME_HEADERS) {
+             uint8_t *block = malloc(API_H2_HEADER_BLOCK_SIZE);
+             int ret = (block != NULL) ? api_h2_read_header_block(conn, &f, block, &resp->bytes_in) : -1;
+             free(block);
+             if (ret < 0 || !(f.flags & HTTP2_FLAG_END_STREAM)) {
+                 goto fail;
+             }
+             resp->body_done = true;
+             return 0;
+         }
+
+         uint32_t payload = f.length;
+         uint8_t pad = 0;
+         if (f.flags & HTTP2_FLAG_PADDED) {
+             if (payload < 1 || api_h2_recv(conn, &pad, 1, &resp->bytes_in) != 0 || pad > payload - 1) {
+                 goto fail;
+             }
+             payload -= 1;
+         }
+         resp->h2_data_left = payload - pad;
+         resp->h2_pad_left = pad;
+         resp->h2_end_after = (f.flags & HTTP2_FLAG_END_STREAM) != 0;
+         // The whole frame counts against the windows, padding included
+         if (api_h2_credit(conn, resp->h2_stream, resp->h2_end_after ? NULL : &resp->h2_unacked,
+                           f.length) != 0) {
+             goto fail;
+         }
+     }
+
+     size_t n = (len < resp->h2_data_left) ? len : resp->h2_data_left;
+     if (api_h2_recv(conn, buf, n, &resp->bytes_in) != 0) {
+         goto fail;
+     }
+     resp->h2_data_left -= n;
+     return (int)n;
+
+ fail:
+     resp->conn_close = true;
+     return -1;
+ }
+
+ // Sends request (HTTP/1.1 text, one GET) as a new stream on resp's
+ // connection. Returns the bytes written or -1
+ static int api_h2_open_stream(api_http_resp_t *resp, const char *request, size_t len)
+ {
+     api_conn_t *conn = resp->conn;
+     size_t frame_size = API_HTTP_REQUEST_SIZE + HTTP2_FRAME_HEADER_SIZE;
+     size_t consumed = 0;
+     int ret = -1;
+     uint8_t *frame = malloc(frame_size);
+
+     if (frame == NULL) {
+         ESP_LOGE(TAG, "❌ No memory for the HTTP/2 request");
+         return -1;
+     }
+     int frame_len = http2_request_from_http1(request, len, &consumed, conn->h2_next_stream,
+                                             frame, frame_size);
+     if (frame_len < 0) {
+         ESP_LOGE(TAG, "Request cannot be sent as an HTTP/2 stream");
+     } else if (api_h2_write(conn, frame, frame_len) == 0) {
+         resp->h2_stream = conn->h2_next_stream;
+         conn->h2_next_stream += 2;
+         ret = frame_len;
+     }
+     free(frame);
+     return ret;
+ }
+
+ // Parses the status line and the headers we care about, a line at a
+ // time into line
+ static int api_resp_parse_head(api_http_resp_t *resp, char *line, size_t line_size)
+ {
+     int http_minor = 1;
+
+     if (api_resp_read_line(resp, line, line_size) < 0) {
+         return -1;
+     }
+     if (sscanf(line, "HTTP/1.%d %d", &http_minor, &resp->status_code) != 2) {
+         ESP_LOGE(TAG, "Malformed HTTP status line: %s", line);
+         api_error_set(API_ERR_PARSE);
+         return -1;
+     }
+     // HTTP/1.0 servers close after the response unless told otherwise
+     resp->conn_close = (http_minor == 0);
+
+     while (true) {
+         int len = api_resp_read_line(resp, line, line_size);
+         if (len < 0) {
+             return -1;
+         }
+         if (len == 0) {
+             break;
+         }
+         if (strncasecmp(line, "Content-Length:", 15) == 0) {
+             if (!api_header_length(line + 15, &resp->content_length)) {
+                 ESP_LOGE(TAG, "Malformed Content-Length: %s", line + 15);
+                 api_error_set(API_ERR_PARSE);
+                 return -1;
+             }
+         } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+             resp->chunked = api_header_has_token(line + 18, "chunked");
+         } else if (strncasecmp(line, "Content-Encoding:", 17) == 0) {
+             resp->encoding = api_header_encoding(line + 17);
+         } else if (strncasecmp(line, "Connection:", 11) == 0) {
+             if (api_header_has_token(line + 11, "close")) {
+                 resp->conn_close = true;
+             } else if (api_header_has_token(line + 11, "keep-alive")) {
+                 resp->conn_close = false;
+             }
+         } else if (strncasecmp(line, "Content-Type:", 13) == 0) {
+             resp->event_stream = api_header_has_token(line + 13, "text/event-stream");
+         } else if (strncasecmp(line, "Content-Range:", 14) == 0) {
+             if (!api_header_content_range(resp, line + 14)) {
+                 ESP_LOGE(TAG, "Malformed Content-Range: %s", line + 14);
+                 api_error_set(API_ERR_PARSE);
+                 return -1;
+             }
+         } else if (strncasecmp(line, "ETag:", 5) == 0) {
+             api_header_copy_value(resp->etag, sizeof(resp->etag), line + 5);
+         } else if (strncasecmp(line, "Last-Modified:", 14) == 0) {
+             api_header_copy_value(resp->last_modified, sizeof(resp->last_modified), line + 14);
+         } else if (strncasecmp(line, "Location:", 9) == 0 && resp->location != NULL) {
+             api_header_copy_value(resp->location, API_HTTP_URL_SIZE, line + 9);
+         }
+     }
+
+     if (resp->chunked) {
+         resp->body_left = 0;
+     } else if (resp->content_length >= 0) {
+         resp->body_left = resp->content_length;
+         resp->body_done = (resp->content_length == 0);
+     } else {
+         // No framing: body runs until the server closes the connection
+         resp->conn_close = true;
+         resp->body_left = INT64_MAX;
+     }
+     if (resp->status_code == 204 || resp->status_code == 304) {
+         resp->body_done = true;
+     }
+     return 0;
+ }
+
+ static int api_resp_read_headers(api_http_resp_t *resp)
+ {
+     char line_buf[API_HTTP_LINE_SIZE];
+     char *line = line_buf;
+     size_t line_size = sizeof(line_buf);
+
+     if (resp->h2_stream != 0) {
+         return api_h2_resp_headers(resp);
+     }
+     if (resp->location != NULL) {
+         // Redirect targets (signed download URLs) run far past a header line
+         resp->location[0] = '\0';
+         line_size = API_HTTP_URL_SIZE + sizeof("Location: ");
+         line = malloc(line_size);
+         if (line == NULL) {
+             ESP_LOGE(TAG, "❌ No memory for the response headers");
+             return -1;
+         }
+     }
+     int ret = api_resp_parse_head(resp, line, line_size);
+     if (line != line_buf) {
+         free(line);
+     }
+     return ret;
+ }
+
+ // Reads up to len body bytes as sent (de-chunked, still compressed).
+ // Returns bytes read, 0 at end of body, <0 on error
+ static int api_resp_read_raw(api_http_resp_t *resp, char *buf, size_t len)
+ {
+     char line[32];
+
+     if (resp->body_done || len == 0) {
+         return 0;
+     }
+     if (resp->h2_stream != 0) {
+         return api_h2_resp_body(resp, buf, len);
+     }
+
+     if (resp->chunked && resp->body_left == 0) {
+         if (api_resp_read_line(resp, line, sizeof(line)) < 0) {
+             return -1;
+         }
+         const char *end;
+         if (!api_parse_length(line, 16, &end, &resp->body_left)) {
+             goto bad_chunk;
+         }
+         while (*end == ' ' || *end == '\t') {
+             end++;
+         }
+         if (*end != '\0' && *end != ';') {
+             goto bad_chunk;     // Only chunk extensions may follow the size
+         }
+         if (resp->body_left == 0) {
+             // Last chunk: skip optional trailers up to the empty line
+             while (api_resp_read_line(resp, line, sizeof(line)) > 0) {
+             }
+             resp->body_done = true;
+             return 0;
+         }
+     }
+
+     if (resp->rpos >= resp->rlen) {
+         int ret = api_resp_fill(resp);
+         if (ret == 0 && resp->body_left == INT64_MAX) {
+             resp->body_done = true;
+             return 0;
+         }
+         if (ret <= 0) {
+             return -1;
+         }
+     }
+
+     size_t n = resp->rlen - resp->rpos;
+     if (n > len) {
+         n = len;
+     }
+     if ((int64_t)n > resp->body_left) {
+         n = (size_t)resp->body_left;
+     }
+     memcpy(buf, resp->rbuf + resp->rpos, n);
+     resp->rpos += n;
+     if (resp->body_left != INT64_MAX) {
+         resp->body_left -= n;
+     }
+
+     if (resp->body_left == 0) {
+         if (resp->chunked) {
+             // CRLF that terminates the chunk data
+             if (api_resp_read_line(resp, line, sizeof(line)) < 0) {
+                 return -1;
+             }
+         } else {
+             resp->body_done = true;
+         }
+     }
+     return (int)n;
+
+ bad_chunk:
+     ESP_LOGE(TAG, "Malformed chunk size: %s", line);
+     api_error_set(API_ERR_PARSE);
+     resp->body_left = 0;
+     resp->conn_close = true;
+     return -1;
+ }
+
+ // Frees the decoder of a compressed body and records what it saved
+ static void api_resp_inflate_end(api_http_resp_t *resp)
+ {
+     if (resp->inflate != NULL) {
+         api_metrics_add_saved(resp->metrics, inflate_stream_total_in(resp->inflate),
+                               inflate_stream_total_out(resp->inflate));
+         inflate_stream_free(resp->inflate);
+         resp->inflate = NULL;
+     }
+     free(resp->z_in);
+     resp->z_in = NULL;
+     resp->z_in_len = 0;
+     resp->z_in_pos = 0;
+ }
+
+ // Reads up to len body bytes, decoded when the server compressed them.
+ // Memory stays at one decoder window however large the document is.
+ // Returns bytes read, 0 at end of body, <0 on error
+ static int api_resp_read_body(api_http_resp_t *resp, char *buf, size_t len)
+ {
+     if (resp->encoding == API_ENCODING_IDENTITY || len == 0) {
+         return api_resp_read_raw(resp, buf, len);
+     }
+     if (resp->encoding == API_ENCODING_UNSUPPORTED) {
+         ESP_LOGE(TAG, "Response body in an encoding we did not offer");
+         api_error_set(API_ERR_PARSE);
+         return -1;
+     }
+     if (resp->inflate == NULL) {
+         if (resp->body_done) {
+             return 0;
+         }
+         resp->inflate = inflate_stream_create((resp->encoding == API_ENCODING_GZIP) ?
+                                               INFLATE_STREAM_GZIP : INFLATE_STREAM_DEFLATE);
+         resp->z_in = malloc(API_INFLATE_IN_SIZE);
+         if (resp->inflate == NULL || resp->z_in == NULL) {
+             ESP_LOGE(TAG, "❌ No memory to decode the %s body",
+                      (resp->encoding == API_ENCODING_GZIP) ? "gzip" : "deflate");
+             api_resp_inflate_end(resp);
+             return -1;
+         }
+     }
+
+     while (true) {
+         size_t in_len = resp->z_in_len - resp->z_in_pos;
+         size_t out_len = len;
+         inflate_stream_result_t r = inflate_stream_run(resp->inflate, resp->z_in + resp->z_in_pos,
+                                                        &in_len, (uint8_t *)buf, &out_len);
+         resp->z_in_pos += in_len;
+         if (r == INFLATE_STREAM_ERROR) {
+             api_error_set(API_ERR_PARSE);
+             resp->conn_close = true;
+             return -1;
+         }
+         if (out_len > 0) {
+             return (int)out_len;
+         }
+         if (r == INFLATE_STREAM_DONE) {
+             return 0;      // Anything after the compressed stream is drained as usual
+         }
+         int n = api_resp_read_raw(resp, (char *)resp->z_in, API_INFLATE_IN_SIZE);
+         if (n < 0) {
+             return -1;
+         }
+         if (n == 0) {
+             ESP_LOGE(TAG, "Compressed body ends before its end marker");
+             api_error_set(API_ERR_PARSE);
+             return -1;
+         }
+         resp->z_in_len = n;
+         resp->z_in_pos = 0;
+     }
+ }
+
+ // Reads what is left of a small body so the connection stays in sync
+ static void api_resp_drain(api_http_resp_t *resp)
+ {
+     char drain[128];
+     size_t drained = 0;
+
+     while (!resp->body_done && !resp->conn_close && drained < API_HTTP_DRAIN_LIMIT) {
+         int n = api_resp_read_raw(resp, drain, sizeof(drain));
+         if (n < 0) {
+             break;
+         }
+         drained += n;
+     }
+ }
+
+ // HTTP/2: an unfinished stream is cancelled instead of drained. Only the
+ // rest of the current DATA frame is read, to stay in frame sync; what the
+ // server had already sent is skipped when the connection is next used.
+ static bool api_h2_resp_finish(api_http_resp_t *resp)
+ {
+     api_conn_t *conn = resp->conn;
+     uint8_t rst[HTTP2_RST_STREAM_SIZE];
+
+     if (resp->conn_close || conn->h2_goaway) {
+         return false;
+     }
+     if (resp->body_done) {
+         return true;
+     }
+     if (api_h2_skip(conn, resp->h2_data_left + resp->h2_pad_left, &resp->bytes_in) != 0) {
+         return false;
+     }
+     resp->h2_data_left = 0;
+     resp->h2_pad_left = 0;
+     if (resp->h2_end_after) {
+         return true;
+     }
+     return api_h2_write(conn, rst, http2_rst_stream(rst, resp->h2_stream, HTTP2_CANCEL)) == 0;
+ }
+
+ // Finishes a response: drains what is left of a small body so the
+ // connection stays in sync, then returns it to the pool (or closes it)
+ static void api_resp_finish(api_http_resp_t *resp)
+ {
+     bool reusable;
+
+     api_resp_inflate_end(resp);
+     if (resp->conn == NULL) {
+         return;
+     }
+     if (resp->h2_stream != 0) {
+         reusable = api_h2_resp_finish(resp);
+     } else {
+         api_resp_drain(resp);
+         reusable = resp->body_done && !resp->conn_close && resp->rpos >= resp->rlen;
+     }
+     api_metrics_add_bytes(resp->metrics, resp->bytes_in, 0);
+     api_conn_release(resp->conn, reusable);
+     resp->conn = NULL;
+ }
+
+ // Moves on to the next pipelined response on the same connection and
+ // parses its headers. Fails (and releases the connection) if the current
+ // body cannot be drained or the server announced it is closing, in which
+ // case the later requests were never answered.
+ static int api_resp_next(api_http_resp_t *resp)
+ {
+     if (resp->conn == NULL) {
+         return -1;
+     }
+     api_resp_inflate_end(resp);
+     if (resp->h2_stream != 0) {
+         // One request per stream: nothing was pipelined behind it
+         api_resp_finish(resp);
+         return -1;
+     }
+     api_resp_drain(resp);
+     if (!resp->body_done || resp->conn_close) {
+         api_resp_finish(resp);
+         return -1;
+     }
+
+     resp->status_code = 0;
+     resp->content_length = -1;
+     resp->range_start = -1;
+     resp->range_total = -1;
+     resp->bad_length = false;
+     resp->chunked = false;
+     resp->encoding = API_ENCODING_IDENTITY;
+     resp->body_left = 0;
+     resp->body_done = false;
+     resp->etag[0] = '\0';
+     resp->last_modified[0] = '\0';
+
+     api_metrics_mark(resp->metrics);
+     if (api_resp_read_headers(resp) != 0) {
+         api_metrics_add_bytes(resp->metrics, resp->bytes_in, 0);
+         api_conn_release(resp->conn, false);
+         resp->conn = NULL;
+         return -1;
+     }
+     api_metrics_phase(resp->metrics, API_PHASE_TTFB);
+     return 0;
+ }
+
+ // Formats a GET for target to the call's endpoint, authenticated as
+ // token/user. extra_headers (may be NULL) holds additional CRLF-terminated
+ // header lines, e.g. conditional ones, and may override Accept-Encoding.
+ // Returns the request length or -1 if it does not fit.
+ static int api_http_build_request(const char *target, const char *extra_headers,
+                                   const char *token, const char *user,
+                                   char *request, size_t size)
+ {
+     char host_header[WEB_SERVER_SIZE + WEB_PORT_SIZE + 1];
+     const char *accept_encoding = API_ACCEPT_ENCODING;
+
+     if (extra_headers != NULL && strstr(extra_headers, "Accept-Encoding:") != NULL) {
+         accept_encoding = "";
+     }
+     if (strcmp(s_ep.port, "443") == 0) {
+         strlcpy(host_header, s_ep.host, sizeof(host_header));
+     } else {
+         snprintf(host_header, sizeof(host_header), "%s:%s", s_ep.host, s_ep.port);
+     }
+     // An absolute URL (web_url) names web_server: a fallback endpoint gets its path only
+     if (s_ep.index != 0 && strncmp(target, "https://", 8) == 0) {
+         const char *path = strchr(target + 8, '/');
+         target = (path != NULL) ? path : "/";
+     }
+
+     #pragma GCC diagnostic push
+     #pragma GCC diagnostic ignored "-Wformat-truncation"
+
+     int request_len = snprintf(request, size,
+              "GET %s HTTP/1.1\r\n"
+              "Host: %s\r\n"
+              "User-Agent: " API_USER_AGENT "\r\n"
+              "X-SignToken: %s\r\n"
+              "X-SignUser: %s\r\n"
+              "Accept: application/json\r\n"
+              "%s"
+              "Connection: keep-alive\r\n"
+              "%s"
+              "\r\n",
+              target, host_header, token, user, accept_encoding,
+              extra_headers ? extra_headers : "");
+
+     #pragma GCC diagnostic pop
+
+     if (request_len <= 0 || request_len >= (int)size) {
+         ESP_LOGE(TAG, "HTTP request too long for %s", target);
+         return -1;
+     }
+     ESP_LOGI(TAG, "HTTP Request: GET %s (Host: %s)", target, host_header);
+     return request_len;
+ }
+
+ // Writes one or more requests (back to back = HTTP/1.1 pipelining) on a
+ // pooled connection and parses the headers of the first response.
+ // A request that fails on a reused connection before any response byte
+ // arrived is retried once on a fresh connection (the server may have
+ // closed the idle socket meanwhile). idle_cb (may be NULL) turns the
+ // response into a push stream, see api_resp_wait_stream().
+ // Plain requests to an endpoint (ep) feed its health: time to the
+ // response headers (a 5xx answer or a failed exchange counts as a failure).
+ // ep NULL: host:port is not an AskMeSign endpoint, see api_conn_get().
+ // location (may be NULL) receives the target of a redirect.
+ static int api_http_exchange(const char *host, const char *port, const api_endpoint_t *ep,
+                              const char *request, int request_len, api_http_resp_t *resp,
+                              char *location, api_metrics_req_t *metrics,
+                              api_resp_idle_cb_t idle_cb, void *idle_ctx)
+ {
+     for (int attempt = 0; attempt < 2; attempt++) {
+         bool reused = false;
+         memset(resp, 0, sizeof(*resp));
+         resp->content_length = -1;
+         resp->range_start = -1;
+         resp->range_total = -1;
+         resp->metrics = metrics;
+         resp->idle_cb = idle_cb;
+         resp->idle_ctx = idle_ctx;
+         resp->location = location;
+
+         resp->conn = api_conn_get(host, port, ep, &reused, metrics);
+         if (resp->conn == NULL) {
+             api_error_set(API_ERR_CONNECT);
+             return -1;
+         }
+
+         int ret = 0;
+         size_t written = 0;
+         int64_t sent_us = esp_timer_get_time();
+         api_metrics_mark(metrics);
+         if (resp->conn->h2) {
+             ret = api_h2_open_stream(resp, request, request_len);
+             written = (ret > 0) ? (size_t)ret : 0;
+         }
+         if (!resp->conn->h2) {
+             ret = api_conn_send(resp->conn, request, request_len);
+             written = (ret == 0) ? (size_t)request_len : 0;
+         }
+
+         if (ret >= 0) {
+             ESP_LOGI(TAG, "Request sent (%d bytes)", (int)written);
+             api_metrics_add_bytes(metrics, 0, written);
+             if (api_resp_read_headers(resp) == 0) {
+                 api_metrics_phase(metrics, API_PHASE_TTFB);
+                 if (idle_cb == NULL && ep != NULL) {
+                     api_endpoints_report(ep->index, resp->status_code < 500,
+                                          (uint32_t)((esp_timer_get_time() - sent_us) / 1000));
+                 }
+                 return 0;
+             }
+         }
+
+         api_metrics_add_bytes(metrics, resp->bytes_in, 0);
+         api_conn_release(resp->conn, false);
+         resp->conn = NULL;
+         if (resp->stopped || !(reused && resp->bytes_in == 0) || api_deadline_over()) {
+             if (idle_cb == NULL && ep != NULL && !resp->stopped && !net_deadline_cancelled(s_deadline)) {
+                 api_endpoints_report(ep->index, false, 0);
+             }
+             break;
+         }
+         ESP_LOGW(TAG, "♻️ Keep-alive connection dropped by server, retrying on a new one");
+     }
+     if (!resp->stopped) {
+         api_error_set(API_ERR_CONNECT);
+     }
+     return -1;
+ }
+
+ // Exchange with the call's endpoint
+ static int api_http_send_ex(const char *request, int request_len, api_http_resp_t *resp,
+                             api_metrics_req_t *metrics, api_resp_idle_cb_t idle_cb, void *idle_ctx)
+ {
+     return api_http_exchange(s_ep.host, s_ep.port, &s_ep, request, request_len, resp, NULL,
+                              metrics, idle_cb, idle_ctx);
+ }
+
+ static int api_http_send(const char *request, int request_len, api_http_resp_t *resp,
+                          api_metrics_req_t *metrics)
+ {
+     return api_http_send_ex(request, request_len, resp, metrics, NULL, NULL);
+ }
+
+ // Sends an authenticated GET for target and parses the response headers
+ static int api_http_get(const char *target, const char *extra_headers, api_http_resp_t *resp,
+                         api_metrics_req_t *metrics)
+ {
+     char request[API_HTTP_REQUEST_SIZE];
+
+     int request_len = api_http_build_request(target, extra_headers, api_token, askmesign_user,
+                                              request, sizeof(request));
+     if (request_len < 0) {
+         return -1;
+     }
+     return api_http_send(request, request_len, resp, metrics);
+ }
+
+ // Streams the response body through the incremental JSON tokenizer until
+ // cb stops it or the document ends; the remaining bytes (if any) are
+ // drained or the connection is dropped by api_resp_finish(). Returns the
+ // last tokenizer result (JSON_STREAM_CONTINUE: the body ended first) or -1
+ // on error.
+ static int api_resp_stream_json(api_http_resp_t *resp, json_stream_cb_t cb, void *ctx)
+ {
+     json_stream_t js;
+     char chunk[API_JSON_CHUNK_SIZE];
+     json_stream_result_t r = JSON_STREAM_CONTINUE;
+
+     json_stream_init(&js, cb, ctx);
+     api_metrics_mark(resp->metrics);
+     while (true) {
+         int n = api_resp_read_body(resp, chunk, sizeof(chunk));
+         api_metrics_phase(resp->metrics, API_PHASE_BODY);
+         if (n < 0) {
+             api_error_set(API_ERR_CONNECT);
+             return -1;
+         }
+         if (n == 0) {
+             break;
+         }
+         r = json_stream_feed(&js, chunk, n);
+         api_metrics_phase(resp->metrics, API_PHASE_PARSE);
+         if (r == JSON_STREAM_ERROR) {
+             api_error_set(API_ERR_PARSE);
+             return -1;
+         }
+         if (r == JSON_STREAM_STOPPED || r == JSON_STREAM_COMPLETE) {
+             ESP_LOGI(TAG, "📄 JSON fields extracted after %u body bytes", (unsigned)js.offset);
+             break;
+         }
+     }
+     return (int)r;
+ }
+
+ // Stops reading as soon as all requested top-level fields are found.
+ // Returns the number of fields found or -1 on error.
+ static int api_resp_extract_fields(api_http_resp_t *resp, json_stream_fields_t *fields)
+ {
+     if (api_resp_stream_json(resp, json_stream_fields_cb, fields) < 0) {
+         return -1;
+     }
+     return (int)fields->found_count;
+ }
+
+ void api_manager_log_summary(void)
+ {
+     uint32_t full = 0;
+     uint32_t resumed = 0;
+
+     api_transport_tls_get_stats(&full, &resumed);
+     ESP_LOGI(TAG, "  connections opened %lu reused %lu, TLS handshakes full %lu resumed %lu",
+              s_conn_opened, s_conn_reused, full, resumed);
+ }
+
+ void api_manager_set_transport(const struct api_transport_ops *ops)
+ {
+     s_transport = (ops != NULL) ? ops : &api_transport_tls;
+     ESP_LOGI(TAG, "🔌 HTTP transport: %s", s_transport->name);
+     if (s_pool_mutex == NULL) {
+         return;
+     }
+     // Ones in use no longer match once released and are evicted in turn
+     api_conn_close_idle(NULL, NULL);
+ }
+
+ // Idle time left on a pooled connection before it counts as stale (caller holds the pool lock)
+ static uint32_t api_conn_warm_left_ms(const api_conn_t *conn)
+ {
+     int64_t idle_ms = (esp_timer_get_time() - conn->last_used_us) / 1000;
+     return (idle_ms < API_CONN_MAX_IDLE_MS) ? (uint32_t)(API_CONN_MAX_IDLE_MS - idle_ms) : 0;
+ }
+
+ static bool api_conn_stays_warm(const api_conn_t *conn)
+ {
+     return api_conn_warm_left_ms(conn) >= API_WARM_MARGIN_MS;
+ }
+
+ uint32_t api_manager_warm_ms(void)
+ {
+     api_endpoint_t ep;
+     uint32_t best = 0;
+
+     if (s_pool_mutex == NULL) {
+         return 0;
+     }
+     api_endpoints_current(&ep);
+     xSemaphoreTake(s_pool_mutex, portMAX_DELAY);
+     for (int i = 0; i < API_CONN_POOL_SIZE; i++) {
+         const api_conn_t *c = &s_pool[i];
+         if (c->connected && !c->busy &&
+             strcmp(c->host, ep.host) == 0 && strcmp(c->port, ep.port) == 0) {
+             uint32_t left = api_conn_warm_left_ms(c);
+             if (left > best) {
+                 best = left;
+             }
+         }
+     }
+     xSemaphoreGive(s_pool_mutex);
+     return best;
+ }
+
+ esp_err_t api_manager_preconnect(const net_deadline_t* deadline)
+ {
+     api_metrics_req_t metrics;
+     bool reused = false;
+
+     if (s_pool_mutex != NULL) {
+         // A connection about to hit its idle limit would not outlive the wait
+         api_conn_close_idle(api_conn_stays_warm, deadline);
+     }
+
+     api_call_begin(deadline);
+     api_metrics_begin(&metrics, "preconnect");
+     api_conn_t *conn = api_conn_acquire(&s_ep, &reused, &metrics);
+     api_metrics_end(&metrics, conn != NULL);
+     if (conn == NULL) {
+         ESP_LOGW(TAG, "🔥 Pre-connect to %s:%s failed (%s)", s_ep.host, s_ep.port,
+                  api_manager_error_name(s_last_error));
+         return ESP_FAIL;
+     }
+     if (reused) {
+         // Nothing was sent: the server's idle clock still runs from the last request
+         api_conn_unbusy(conn);
+         return ESP_OK;
+     }
+     ESP_LOGI(TAG, "🔥 Connection to %s:%s warmed up", s_ep.host, s_ep.port);
+     api_conn_release(conn, true);
+     return ESP_OK;
+ }
+
+ esp_err_t api_manager_probe_endpoint(const net_deadline_t* deadline)
+ {
+     api_endpoint_t ep;
+     api_http_resp_t resp;
+     api_metrics_req_t metrics;
+
+     if (!api_endpoints_probe_due(&ep)) {
+         return ESP_ERR_NOT_FOUND;
+     }
+     api_endpoints_probe_started(ep.index);
+
+     api_call_begin(deadline);
+     s_ep = ep;
+     ESP_LOGI(TAG, "🩺 Probing endpoint %s:%s", ep.host, ep.port);
+     api_metrics_begin(&metrics, "probe");
+     // Uncached signer list: a full answer is what a failover would get
+     if (api_http_get(web_url, NULL, &resp, &metrics) != 0) {
+         api_metrics_end(&metrics, false);
+         ESP_LOGW(TAG, "🩺 Endpoint %s:%s unreachable (%s)", ep.host, ep.port,
+                  api_manager_error_name(s_last_error));
+         return ESP_FAIL;
+     }
+     int status = resp.status_code;
+     // Not kept: it would take a pool slot from the endpoint in use
+     resp.conn_close = true;
+     api_resp_finish(&resp);
+     api_metrics_end(&metrics, status < 500);
+     ESP_LOGI(TAG, "🩺 Endpoint %s:%s answered %d", ep.host, ep.port, status);
+     return (status < 500) ? ESP_OK : ESP_FAIL;
+ }
+
+ bool api_manager_failover_ready(void)
+ {
+     api_endpoint_t next;
+
+     if (s_last_error != API_ERR_DNS && s_last_error != API_ERR_CONNECT &&
+         s_last_error != API_ERR_TLS && s_last_error != API_ERR_HTTP_5XX) {
+         return false;
+     }
+     api_endpoints_select(&next);
+     return next.index != s_ep.index;
+ }
+
+ // 304 Not Modified: the value decoded from the last 200 is still current
+ static bool api_cache_revalidated(api_cache_slot_t slot, void *data, size_t len)
+ {
+     if (!api_cache_get(slot, data, len)) {
+         ESP_LOGE(TAG, "❌ 304 Not Modified but nothing cached");
+         api_error_set(API_ERR_PARSE);
+         return false;
+     }
+     api_cache_touch(slot);
+     ESP_LOGI(TAG, "✅ 304 Not Modified, using cached result");
+     return true;
+ }
+
+ // The first document of the answer (newest in the editor list) tells a
+ // changed list apart from one with the same count
+ static const char *const s_count_keys[] = { "totalElements", "content[0].idFile" };
+ #define API_COUNT_KEY_COUNT 2
+
+ // Outcome of a pending-count response (signer or editor list): a 304
+ // reuses the cached count, a 200 yields totalElements from fields (NULL =
+ // body could not be parsed, error already recorded) and is cached when the
+ // server sent validators (slot API_CACHE_SLOT_COUNT = not cached)
+ static int api_count_result(api_cache_slot_t slot, const char *label, int status,
+                             const char *etag, const char *last_modified,
+                             const json_stream_fields_t *fields)
+ {
+     int32_t cached_count;
+     long value;
+
+     if (status == 304) {
+         if (slot >= API_CACHE_SLOT_COUNT ||
+             !api_cache_revalidated(slot, &cached_count, sizeof(cached_count))) {
+             api_error_set(API_ERR_PARSE);
+             return -1;
+         }
+         ESP_LOGI(TAG, "✅ %s count: %d (not modified)", label, (int)cached_count);
+         return cached_count;
+     }
+
+     if (status != 200) {
+         ESP_LOGE(TAG, "❌ %s API error - Status: %d", label, status);
+         api_error_from_status(status);
+         return -1;
+     }
+
+     if (fields == NULL) {
+         ESP_LOGE(TAG, "❌ Failed to parse %s JSON body", label);
+         return -1;
+     }
+     if (!json_stream_parse_int(json_stream_fields_get(fields, "totalElements"), &value)) {
+         ESP_LOGE(TAG, "❌ %s JSON does not contain a valid 'totalElements' field", label);
+         api_error_set(API_ERR_PARSE);
+         return -1;
+     }
+
+     ESP_LOGI(TAG, "✅ %s count: %ld", label, value);
+     // The document list follows the configured account's counts
+     if (slot == API_CACHE_PENDING_SIGNER || slot == API_CACHE_PENDING_EDITOR) {
+         long newest;
+         if (!json_stream_parse_int(json_stream_fields_get(fields, "content[0].idFile"), &newest)) {
+             newest = -1;
+         }
+         doc_list_observe((slot == API_CACHE_PENDING_SIGNER) ? DOC_LIST_SIGNER : DOC_LIST_EDITOR,
+                          (int)value, newest);
+     }
+     // Only worth keeping if the server lets us revalidate it
+     if (slot < API_CACHE_SLOT_COUNT && (etag[0] != '\0' || last_modified[0] != '\0')) {
+         cached_count = (int32_t)value;
+         api_cache_store(slot, etag, last_modified, &cached_count, sizeof(cached_count));
+     }
+     return (int)value;
+ }
+
+ // Decodes a pending-count response, streaming a 200 body for totalElements.
+ // The response is left for the caller to finish.
+ static int api_count_from_response(api_http_resp_t *resp, api_cache_slot_t slot, const char *label)
+ {
+     json_stream_fields_t fields;
+     const json_stream_fields_t *parsed = NULL;
+
+     if (resp->status_code == 200) {
+         json_stream_fields_init(&fields, s_count_keys, API_COUNT_KEY_COUNT);
+         if (api_resp_extract_fields(resp, &fields) >= 0) {
+             parsed = &fields;
+         }
+     }
+     return api_count_result(slot, label, resp->status_code, resp->etag, resp->last_modified, parsed);
+ }
+
+ int api_manager_check_practices(const net_deadline_t* deadline)
+ {
+     int practices_found;
+     api_http_resp_t resp;
+     char conditional[API_CACHE_ETAG_SIZE + API_CACHE_LAST_MOD_SIZE + 48];
+     api_metrics_req_t metrics;
+
+     api_call_begin(deadline);
+     api_metrics_begin(&metrics, "signer");
+     api_cache_conditional_headers(API_CACHE_PENDING_SIGNER, conditional, sizeof(conditional));
+     if (api_http_get(web_url, conditional, &resp, &metrics) != 0) {
+         api_metrics_end(&metrics, false);
+         return -1;
+     }
+
+     practices_found = api_count_from_response(&resp, API_CACHE_PENDING_SIGNER, "Signer");
+     if (practices_found >= 0) {
+         totalElements = practices_found;
+     }
+
+     api_resp_finish(&resp);
+     api_metrics_end(&metrics, practices_found >= 0);
+     return practices_found;
+ }
+
+// ---------------------------------------------------------------------------
+// Generic GETs (GitHub release check, OTA download)
+// ---------------------------------------------------------------------------
+// Same client as the AskMeSign calls: a pooled connection on the selected
+// transport, chunked and compressed bodies, metrics. Other hosts get
+// HTTP/1.1 only (redirect targets outgrow the HTTP/2 header decoder) and
+// their TLS sessions are not kept.
+
+struct api_http_stream {
+    api_http_resp_t resp;
+    api_metrics_req_t metrics;
+    bool timed;                         // metrics in use (the request had a label)
+    bool failed;                        // A read failed: the body is incomplete
+    const net_deadline_t *deadline;
+    char url[API_HTTP_URL_SIZE];        // Current target, replaced by each redirect
+    char location[API_HTTP_URL_SIZE];   // Location of the last answer
+};
+
+// Splits https://host[:port]/path (port 443 when missing). Returns false
+// for any other scheme or a host that does not fit
+static bool api_http_split_url(const char *url, char *host, size_t host_size,
+                               char *port, size_t port_size, const char **path)
+{
+    if (strncmp(url, "https://", 8) != 0) {
+        return false;
+    }
+    const char *rest = url + 8;
+    size_t host_len = strcspn(rest, ":/");
+    if (host_len == 0 || host_len >= host_size) {
+        return false;
+    }
+    memcpy(host, rest, host_len);
+    host[host_len] = '\0';
+    rest += host_len;
+
+    if (*rest == ':') {
+        size_t port_len = strcspn(rest + 1, "/");
+        if (port_len == 0 || port_len >= port_size) {
+            return false;
+        }
+        memcpy(port, rest + 1, port_len);
+        port[port_len] = '\0';
+        rest += 1 + port_len;
+    } else {
+        strlcpy(port, "443", port_size);
+    }
+    *path = (*rest == '/') ? rest : "/";
+    return true;
+}
+
+// Formats the GET of req for path on host:port. Returns its length or -1
+static int api_http_build_get(const api_http_request_t *req, const char *host, const char *port,
+                              const char *path, char *request, size_t size)
+{
+    const char *accept_encoding = req->identity ? "" : API_ACCEPT_ENCODING;
+    const char *port_sep = (strcmp(port, "443") == 0) ? "" : ":";
+    const char *port_shown = (strcmp(port, "443") == 0) ? "" : port;
+
+    int request_len = snprintf(request, size,
+                               "GET %s HTTP/1.1\r\n"
+                               "Host: %s%s%s\r\n"
+                               "User-Agent: " API_USER_AGENT "\r\n"
+                               "%s"
+                               "Connection: keep-alive\r\n"
+                               "%s"
+                               "\r\n",
+                               path, host, port_sep, port_shown, accept_encoding,
+                               req->headers ? req->headers : "");
+    if (request_len <= 0 || request_len >= (int)size) {
+        ESP_LOGE(TAG, "HTTP request too long for %s", host);
+        return -1;
+    }
+    ESP_LOGI(TAG, "HTTP Request: GET %.64s%s (Host: %s)", path, strlen(path) > 64 ? "..." : "", host);
+    return request_len;
+}
+
+static bool api_http_is_redirect(int status)
+{
+    return status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+}
+
+esp_err_t api_manager_http_open(const api_http_request_t *req, api_http_stream_t **stream_out,
+                                const net_deadline_t *deadline)
+{
+    if (req == NULL || req->url == NULL || stream_out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stream_out = NULL;
+
+    api_http_stream_t *stream = calloc(1, sizeof(*stream));
+    size_t request_size = API_HTTP_URL_SIZE + API_HTTP_REQUEST_SIZE;
+    char *request = malloc(request_size);
+    if (stream == NULL || request == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for an HTTP request");
+        free(stream);
+        free(request);
+        return ESP_ERR_NO_MEM;
+    }
+
+    api_error_reset();
+    s_deadline = deadline;
+    stream->deadline = deadline;
+    if (req->metrics_label != NULL) {
+        api_metrics_begin(&stream->metrics, req->metrics_label);
+        stream->timed = true;
+    }
+    api_metrics_req_t *metrics = stream->timed ? &stream->metrics : NULL;
+    strlcpy(stream->url, req->url, sizeof(stream->url));
+
+    esp_err_t err = ESP_FAIL;
+    for (int redirects = 0; ; redirects++) {
+        char host[WEB_SERVER_SIZE];
+        char port[WEB_PORT_SIZE];
+        const char *path;
+
+        if (!api_http_split_url(stream->url, host, sizeof(host), port, sizeof(port), &path)) {
+            ESP_LOGE(TAG, "❌ Unsupported URL: %.64s", stream->url);
+            err = ESP_ERR_INVALID_ARG;
+            break;
+        }
+        int request_len = api_http_build_get(req, host, port, path, request, request_size);
+        if (request_len < 0) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        stream->location[0] = '\0';
+        if (api_http_exchange(host, port, NULL, request, request_len, &stream->resp,
+                              stream->location, metrics, NULL, NULL) != 0) {
+            err = api_deadline_over() ? ESP_ERR_TIMEOUT : ESP_FAIL;
+            break;
+        }
+
+        int status = stream->resp.status_code;
+        if (!api_http_is_redirect(status) || stream->location[0] == '\0') {
+            err = ESP_OK;
+            break;
+        }
+        if (redirects == API_HTTP_MAX_REDIRECTS) {
+            ESP_LOGE(TAG, "❌ More than %d redirects", API_HTTP_MAX_REDIRECTS);
+            break;
+        }
+        // The redirect's own body is small: drained, the connection stays pooled
+        api_resp_finish(&stream->resp);
+        if (stream->location[0] == '/') {
+            // A relative target stays on the same host
+            int n = snprintf(stream->url, sizeof(stream->url), "https://%s:%s%s", host, port,
+                             stream->location);
+            if (n < 0 || n >= (int)sizeof(stream->url)) {
+                ESP_LOGE(TAG, "❌ Redirect target too long");
+                err = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+        } else {
+            strlcpy(stream->url, stream->location, sizeof(stream->url));
+        }
+        ESP_LOGI(TAG, "↪️ HTTP %d, following redirect to %.64s...", status, stream->url);
+    }
+    free(request);
+
+    if (err != ESP_OK) {
+        api_resp_finish(&stream->resp);
+        if (stream->timed) {
+            api_metrics_end(&stream->metrics, false);
+        }
+        free(stream);
+        return err;
+    }
+    *stream_out = stream;
+    return ESP_OK;
+}
+
+int api_manager_http_status(const api_http_stream_t *stream)
+{
+    return stream->resp.status_code;
+}
+
+int64_t api_manager_http_content_length(const api_http_stream_t *stream)
+{
+    return stream->resp.content_length;
+}
+
+void api_manager_http_validators(const api_http_stream_t *stream, char *etag, size_t etag_size,
+                                 char *last_modified, size_t last_modified_size)
+{
+    if (etag != NULL && etag_size > 0) {
+        strlcpy(etag, stream->resp.etag, etag_size);
+    }
+    if (last_modified != NULL && last_modified_size > 0) {
+        strlcpy(last_modified, stream->resp.last_modified, last_modified_size);
+    }
+}
+
+bool api_manager_http_content_range(const api_http_stream_t *stream, int64_t *start, int64_t *total)
+{
+    if (start != NULL) {
+        *start = stream->resp.range_start;
+    }
+    if (total != NULL) {
+        *total = stream->resp.range_total;
+    }
+    return stream->resp.range_start >= 0;
+}
+
+int api_manager_http_read(api_http_stream_t *stream, void *buf, size_t len)
+{
+    if (stream->failed) {
+        return -1;
+    }
+    s_deadline = stream->deadline;
+    api_metrics_mark(stream->resp.metrics);
+    int n = api_resp_read_body(&stream->resp, buf, len);
+    api_metrics_phase(stream->resp.metrics, API_PHASE_BODY);
+    if (n < 0) {
+        stream->failed = true;
+    }
+    return n;
+}
+
+void api_manager_http_close(api_http_stream_t *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+    s_deadline = stream->deadline;
+    int status = stream->resp.status_code;
+    api_resp_finish(&stream->resp);
+    if (stream->timed) {
+        api_metrics_end(&stream->metrics, !stream->failed && status > 0 && status < 500);
+    }
+    free(stream);
+}
+
+// Decoded GitHub latest release, cached across update checks
+typedef struct {
+    char tag[32];                   // tag_name as published (e.g. "v3.6.2")
+    bool has_firmware;              // firminia3.bin found among the assets
+    ota_version_info_t info;        // Filled from the firmware asset
+} api_release_t;
+
+// Streaming decoder of the GitHub release JSON: tag_name and the assets
+// array, one asset at a time. The document (release notes, uploader
+// records, every asset) can be tens of KB and is never held in memory.
+typedef struct {
+    api_release_t *release;
+    bool has_tag;
+    char asset_name[64];
+    char asset_url[sizeof(((ota_version_info_t *)0)->url)];
+    long asset_size;
+} api_release_parser_t;
+
+static bool api_release_cb(json_stream_event_t evt, int depth, const char *key,
+                           const char *value, void *ctx)
+{
+    api_release_parser_t *p = (api_release_parser_t *)ctx;
+    api_release_t *release = p->release;
+
+    if (depth == 1 && evt == JSON_STREAM_EVT_STRING && strcmp(key, "tag_name") == 0) {
+        strlcpy(release->tag, value, sizeof(release->tag));
+        p->has_tag = true;
+    } else if (depth == 2 && evt == JSON_STREAM_EVT_OBJECT_START) {
+        // A new element of assets (the only array of objects at the top level)
+        p->asset_name[0] = '\0';
+        p->asset_url[0] = '\0';
+        p->asset_size = -1;
+    } else if (depth == 3 && evt == JSON_STREAM_EVT_STRING && strcmp(key, "name") == 0) {
+        strlcpy(p->asset_name, value, sizeof(p->asset_name));
+    } else if (depth == 3 && evt == JSON_STREAM_EVT_STRING && strcmp(key, "browser_download_url") == 0) {
+        if (strlen(value) < JSON_STREAM_VALUE_SIZE - 1) {
+            strlcpy(p->asset_url, value, sizeof(p->asset_url));
+        } else {
+            ESP_LOGW(TAG, "⚠️ Asset URL too long, ignored");
+        }
+    } else if (depth == 3 && evt == JSON_STREAM_EVT_NUMBER && strcmp(key, "size") == 0) {
+        if (!json_stream_parse_int(value, &p->asset_size)) {
+            p->asset_size = -1;
+        }
+    } else if (depth == 2 && evt == JSON_STREAM_EVT_OBJECT_END && !release->has_firmware &&
+               strstr(p->asset_name, "firminia3.bin") != NULL &&
+               p->asset_url[0] != '\0' && p->asset_size >= 0) {
+        ESP_LOGI(TAG, "🔗 Found firmware URL: %s", p->asset_url);
+
+        // Validate firmware size (should be between 1MB and 10MB for ESP32)
+        uint32_t firmware_size = (uint32_t)p->asset_size;
+        if (firmware_size < 1024 * 1024 || firmware_size > 10 * 1024 * 1024) {
+            ESP_LOGW(TAG, "⚠️ Suspicious firmware size: %lu bytes (%.2f MB)",
+                    firmware_size, firmware_size / (1024.0 * 1024.0));
+            // Continue anyway but log warning
+        }
+        strlcpy(release->info.url, p->asset_url, sizeof(release->info.url));
+        release->info.size = firmware_size;
+
+        // For now, leave checksum empty (could be added to GitHub release notes)
+        release->info.checksum[0] = '\0';
+        release->has_firmware = true;
+    }
+    // Nothing else is needed once both are known
+    return !(p->has_tag && release->has_firmware);
+}
+
+// Finishes the release decoded by api_release_cb() (independently of the running version)
+static esp_err_t api_release_finish(api_release_parser_t *p, json_stream_result_t result)
+{
+    api_release_t *release = p->release;
+
+    if (result != JSON_STREAM_COMPLETE && result != JSON_STREAM_STOPPED) {
+        ESP_LOGE(TAG, "❌ Failed to parse GitHub API JSON response");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (!p->has_tag) {
+        ESP_LOGE(TAG, "❌ Invalid GitHub API response format");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    const char* latest_version = release->tag;
+    ESP_LOGI(TAG, "📋 Latest GitHub release: %s", latest_version);
+
+    // Remove 'v' prefix if present
+    const char* clean_latest = (latest_version[0] == 'v') ? latest_version + 1 : latest_version;
+    strlcpy(release->info.version, clean_latest, sizeof(release->info.version));
+
+    if (release->has_firmware) {
+        // Generate signature URL (assuming .sig file exists)
+        snprintf(release->info.signature_url, sizeof(release->info.signature_url),
+                "https://github.com/bisontebiscottato/firminia3/releases/download/%s/firminia3.sig",
+                latest_version);
+    }
+    return ESP_OK;
+}
+
+// Streams the 200 body of the release lookup through the JSON tokenizer
+// (decoded by the client when GitHub compressed it). Reading stops as soon
+// as the tag and the firmware asset are known, so the size of the document
+// does not matter.
+static esp_err_t api_read_release(api_http_stream_t *stream, api_release_t *release,
+                                  api_metrics_req_t *metrics)
+{
+    api_release_parser_t parser = { .release = release };
+    json_stream_result_t result = JSON_STREAM_CONTINUE;
+    json_stream_t js;
+    size_t body_bytes = 0;
+    esp_err_t err = ESP_OK;
+
+    char *chunk = malloc(API_GITHUB_CHUNK_SIZE);
+    if (chunk == NULL) {
+        ESP_LOGE(TAG, "❌ Failed to allocate response buffer");
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(release, 0, sizeof(*release));
+    json_stream_init(&js, api_release_cb, &parser);
+    while (result == JSON_STREAM_CONTINUE) {
+        int n = api_manager_http_read(stream, chunk, API_GITHUB_CHUNK_SIZE);
+        if (n < 0) {
+            ESP_LOGE(TAG, "❌ Failed to read update response");
+            err = api_deadline_over() ? ESP_ERR_TIMEOUT : ESP_ERR_HTTP_INVALID_TRANSPORT;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        body_bytes += n;
+        api_metrics_mark(metrics);
+        result = json_stream_feed(&js, chunk, n);
+        api_metrics_phase(metrics, API_PHASE_PARSE);
+    }
+
+    ESP_LOGI(TAG, "📡 GitHub API response: %u bytes decoded", (unsigned)body_bytes);
+    free(chunk);
+    if (err == ESP_OK) {
+        err = api_release_finish(&parser, result);
+    }
+    return err;
+}
+
+// Fetches the latest release, revalidating the cached one with
+// If-None-Match / If-Modified-Since (a 304 costs no rate-limit quota)
+static esp_err_t api_fetch_release(api_release_t *release, const net_deadline_t *deadline)
+{
+    // Use GitHub API to check for latest release
+    static const char update_url[] =
+        "https://api.github.com/repos/bisontebiscottato/firminia3/releases/latest";
+
+    ESP_LOGI(TAG, "📡 GitHub API URL: %s", update_url);
+
+    // GitHub API headers (no auth needed for public repos), plus the
+    // conditional ones if we already know a release
+    char headers[64 + API_CACHE_ETAG_SIZE + API_CACHE_LAST_MOD_SIZE + 40];
+    char cached_etag[API_CACHE_ETAG_SIZE];
+    char cached_last_modified[API_CACHE_LAST_MOD_SIZE];
+    size_t len = strlcpy(headers, "Accept: application/vnd.github.v3+json\r\n", sizeof(headers));
+    if (api_cache_get_validators(API_CACHE_RELEASE, cached_etag, sizeof(cached_etag),
+                                 cached_last_modified, sizeof(cached_last_modified))) {
+        if (cached_etag[0] != '\0') {
+            len += snprintf(headers + len, sizeof(headers) - len, "If-None-Match: %s\r\n", cached_etag);
+        }
+        if (cached_last_modified[0] != '\0' && len < sizeof(headers)) {
+            snprintf(headers + len, sizeof(headers) - len, "If-Modified-Since: %s\r\n",
+                     cached_last_modified);
+        }
+    }
+
+    api_http_request_t req = {
+        .url = update_url,
+        .headers = headers,
+        .metrics_label = "github",
+    };
+    api_http_stream_t *stream = NULL;
+    esp_err_t err = api_manager_http_open(&req, &stream, deadline);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Failed to open HTTP connection: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    int status_code = api_manager_http_status(stream);
+    ESP_LOGI(TAG, "📡 Update check response: status=%d, content_length=%lld", status_code,
+             api_manager_http_content_length(stream));
+
+    if (status_code == 304) {
+        err = api_cache_revalidated(API_CACHE_RELEASE, release, sizeof(*release))
+              ? ESP_OK : ESP_ERR_INVALID_STATE;
+    } else if (status_code == 200) {
+        err = api_read_release(stream, release, &stream->metrics);
+        if (err == ESP_OK) {
+            char etag[API_CACHE_ETAG_SIZE];
+            char last_modified[API_CACHE_LAST_MOD_SIZE];
+            api_manager_http_validators(stream, etag, sizeof(etag), last_modified, sizeof(last_modified));
+            api_cache_store(API_CACHE_RELEASE, etag, last_modified, release, sizeof(*release));
+        }
+    } else if (status_code == 404) {
+        ESP_LOGI(TAG, "ℹ️ No updates available (404)");
+        err = ESP_ERR_NOT_FOUND;
+    } else {
+        ESP_LOGE(TAG, "❌ Update check failed: HTTP %d", status_code);
+        err = ESP_ERR_HTTP_BASE + status_code;
+    }
+
+    api_manager_http_close(stream);
+    return err;
+}
+
+esp_err_t api_manager_check_firmware_updates(const char* current_version, ota_version_info_t* update_info,
+                                             const net_deadline_t* deadline)
+{
+    if (current_version == NULL || update_info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGI(TAG, "🔍 Checking for firmware updates via GitHub API (current: %s)...", current_version);
+
+    api_release_t release;
+    if (!api_cache_get_fresh(API_CACHE_RELEASE, &release, sizeof(release))) {
+        esp_err_t err = api_fetch_release(&release, deadline);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    // Simple version comparison (remove 'v' prefix if present)
+    const char* clean_latest = release.info.version;
+    const char* clean_current = (current_version[0] == 'v') ? current_version + 1 : current_version;
+
+    if (strcmp(clean_current, clean_latest) >= 0) {
+        ESP_LOGI(TAG, "ℹ️ No newer version available (%s >= %s)", clean_current, clean_latest);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (!release.has_firmware) {
+        ESP_LOGE(TAG, "❌ firminia3.bin not found in release assets");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *update_info = release.info;
+    ESP_LOGI(TAG, "✅ Update available: %s → %s (size: %lu bytes, %.2f MB)",
+             current_version, update_info->version, update_info->size,
+             update_info->size / (1024.0 * 1024.0));
+
+    return ESP_OK;
+}
+
+// Editor mode: Get user ID from /api/v2/account
+esp_err_t api_manager_get_user_id(char* user_id_buffer, size_t buffer_size, const net_deadline_t* deadline)
+{
+    if (!user_id_buffer || buffer_size == 0) {
+        ESP_LOGE(TAG, "❌ Invalid buffer parameters");
+        return ESP_ERR_INVALID_ARG;
+    }
+    api_call_begin(deadline);
+
+    // idUser never changes for a given token: skip the round-trip while cached
+    char cached_id[JSON_STREAM_FIELD_SIZE];
+    if (api_cache_get_fresh(API_CACHE_ACCOUNT, cached_id, sizeof(cached_id))) {
+        strlcpy(user_id_buffer, cached_id, buffer_size);
+        ESP_LOGI(TAG, "✅ User ID from cache: %s", user_id_buffer);
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "🔍 Getting user ID from /api/v2/account...");
+
+    char conditional[API_CACHE_ETAG_SIZE + API_CACHE_LAST_MOD_SIZE + 48];
+    api_cache_conditional_headers(API_CACHE_ACCOUNT, conditional, sizeof(conditional));
+
+    api_metrics_req_t metrics;
+    api_metrics_begin(&metrics, "account");
+
+    api_http_resp_t resp;
+    if (api_http_get("/api/v2/account", conditional, &resp, &metrics) != 0) {
+        ESP_LOGE(TAG, "❌ Failed to open HTTP connection");
+        api_metrics_end(&metrics, false);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    ESP_LOGI(TAG, "📊 Account API Response - Status: %d, Content Length: %lld",
+             resp.status_code, resp.content_length);
+
+    if (resp.status_code == 304) {
+        esp_err_t err = ESP_ERR_INVALID_STATE;
+        if (api_cache_revalidated(API_CACHE_ACCOUNT, cached_id, sizeof(cached_id))) {
+            strlcpy(user_id_buffer, cached_id, buffer_size);
+            err = ESP_OK;
+        }
+        api_resp_finish(&resp);
+        api_metrics_end(&metrics, err == ESP_OK);
+        return err;
+    }
+
+    if (resp.status_code != 200) {
+        ESP_LOGE(TAG, "❌ Account API error - Status: %d", resp.status_code);
+        api_error_from_status(resp.status_code);
+        api_resp_finish(&resp);
+        api_metrics_end(&metrics, false);
+        return ESP_ERR_HTTP_BASE + resp.status_code;
+    }
+
+    json_stream_fields_t fields;
+    static const char *const keys[] = { "idUser" };
+    long id_user;
+    esp_err_t err;
+
+    // Extract idUser straight from the body stream
+    json_stream_fields_init(&fields, keys, 1);
+    int found = api_resp_extract_fields(&resp, &fields);
+    if (found < 0) {
+        ESP_LOGE(TAG, "❌ Failed to parse JSON response");
+        err = ESP_ERR_INVALID_RESPONSE;
+    } else if (json_stream_parse_int(json_stream_fields_get(&fields, "idUser"), &id_user)) {
+        snprintf(user_id_buffer, buffer_size, "%ld", id_user);
+        ESP_LOGI(TAG, "✅ User ID extracted: %s", user_id_buffer);
+        memset(cached_id, 0, sizeof(cached_id));
+        snprintf(cached_id, sizeof(cached_id), "%ld", id_user);
+        api_cache_store(API_CACHE_ACCOUNT, resp.etag, resp.last_modified, cached_id, sizeof(cached_id));
+        err = ESP_OK;
+    } else {
+        ESP_LOGE(TAG, "❌ idUser not found or not a number in response");
+        api_error_set(API_ERR_PARSE);
+        err = ESP_ERR_NOT_FOUND;
+    }
+
+    api_resp_finish(&resp);
+    api_metrics_end(&metrics, err == ESP_OK);
+
+    return err;
+}
+
+// Documents created by the user that are still waiting for signatures,
+// newest first (the count asks for one: page 0, size 1)
+static void api_editor_documents_path(const char *user_id, int page, int page_size, char *path, size_t size)
+{
+    snprintf(path, size, "/api/v2/files/?idUser=%s&page=%d&size=%d&sort=idFile,desc&status=L",
+             user_id, page, page_size);
+}
+
+// Editor mode: Check documents created by user (pending signature)
+int api_manager_check_editor_documents(const char* user_id, const net_deadline_t* deadline)
+{
+    if (!user_id) {
+        ESP_LOGE(TAG, "❌ Invalid user_id parameter");
+        return -1;
+    }
+    api_call_begin(deadline);
+
+    ESP_LOGI(TAG, "🔍 Checking documents for editor (user ID: %s)...", user_id);
+
+    // Build documents path with query parameters
+    char documents_path[256];
+    api_editor_documents_path(user_id, 0, 1, documents_path, sizeof(documents_path));
+
+    char conditional[API_CACHE_ETAG_SIZE + API_CACHE_LAST_MOD_SIZE + 48];
+    api_cache_conditional_headers(API_CACHE_PENDING_EDITOR, conditional, sizeof(conditional));
+
+    api_metrics_req_t metrics;
+    api_metrics_begin(&metrics, "editor");
+
+    api_http_resp_t resp;
+    if (api_http_get(documents_path, conditional, &resp, &metrics) != 0) {
+        ESP_LOGE(TAG, "❌ Failed to open HTTP connection");
+        api_metrics_end(&metrics, false);
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "📊 Documents API Response - Status: %d, Content Length: %lld",
+             resp.status_code, resp.content_length);
+
+    int documents_found = api_count_from_response(&resp, API_CACHE_PENDING_EDITOR, "Editor");
+
+    api_resp_finish(&resp);
+    api_metrics_end(&metrics, documents_found >= 0);
+
+    return documents_found;
+}
+
+// ---------------------------------------------------------------------------
+// Pending-document lists (titles for the display carousel)
+// ---------------------------------------------------------------------------
+// A count reads one document. The lists behind the counts are read
+// DOC_LIST_PAGE_SIZE documents per request, and only once a count poll saw
+// them change (doc_list_observe() in api_count_result()): pages doc_list
+// still holds, shifted by what was added or removed, are not read again.
+
+// Member names tried for a document's title and date, best first
+static const char *const s_doc_title_keys[] = { "title", "fileName", "name" };
+static const char *const s_doc_date_keys[] = { "creationDate", "insertDate", "createdAt" };
+#define API_DOC_KEY_NONE    0xFF
+#define API_DOC_KEYS(keys)  (sizeof(keys) / sizeof((keys)[0]))
+
+typedef struct {
+    doc_list_entry_t entries[DOC_LIST_PAGE_SIZE];
+    size_t n;
+    long total;                 // totalElements (-1 = missing)
+    bool in_content;
+    uint8_t title_rank;         // Key the current title came from (API_DOC_KEY_NONE = none yet)
+    uint8_t date_rank;
+} api_doc_page_t;
+
+static uint8_t api_doc_key_rank(const char *const *keys, size_t count, const char *key)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(keys[i], key) == 0) {
+            return (uint8_t)i;
+        }
+    }
+    return API_DOC_KEY_NONE;
+}
+
+// "2024-05-02T10:11:12Z" or epoch milliseconds (seconds if small) -> "2024-05-02"
+static void api_doc_date(json_stream_event_t evt, const char *value, char *date, size_t size)
+{
+    if (evt == JSON_STREAM_EVT_STRING) {
+        if (strlen(value) >= 10 && value[4] == '-' && value[7] == '-') {
+            snprintf(date, size, "%.10s", value);
+        }
+    } else if (evt == JSON_STREAM_EVT_NUMBER) {
+        char *end;
+        long long v = strtoll(value, &end, 10);
+        if (*end != '\0' || v <= 0) {
+            return;
+        }
+        time_t t = (time_t)((v > 100000000000LL) ? v / 1000 : v);
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(date, size, "%Y-%m-%d", &tm);
+    }
+}
+
+// strlcpy() that never leaves a partial UTF-8 sequence at the end (the cut
+// may fall inside one, here or where json_stream truncated the value)
+static void api_doc_title_copy(char *title, const char *value, size_t size)
+{
+    strlcpy(title, value, size);
+    size_t len = strlen(title);
+    size_t lead = len;
+    while (lead > 0 && len - lead < 4 && ((uint8_t)title[lead - 1] & 0xC0) == 0x80) {
+        lead--;
+    }
+    if (lead == 0) {
+        title[0] = '\0';
+        return;
+    }
+    uint8_t c = (uint8_t)title[lead - 1];
+    size_t need = (c < 0x80) ? 1 : (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+    if (len - (lead - 1) < need) {
+        title[lead - 1] = '\0';
+    }
+}
+
+// Collects totalElements and the documents of "content"
+static bool api_doc_page_cb(json_stream_event_t evt, int depth, const char *key,
+                            const char *value, void *ctx)
+{
+    api_doc_page_t *p = (api_doc_page_t *)ctx;
+
+    if (depth == 1) {
+        if (evt == JSON_STREAM_EVT_ARRAY_START) {
+            p->in_content = (strcmp(key, "content") == 0);
+        } else if (evt == JSON_STREAM_EVT_ARRAY_END) {
+            p->in_content = false;
+        } else if (evt == JSON_STREAM_EVT_NUMBER && strcmp(key, "totalElements") == 0 &&
+                   !json_stream_parse_int(value, &p->total)) {
+            p->total = -1;
+        }
+        return true;
+    }
+    if (!p->in_content || p->n >= DOC_LIST_PAGE_SIZE) {
+        return true;
+    }
+
+    doc_list_entry_t *e = &p->entries[p->n];
+    if (depth == 2 && evt == JSON_STREAM_EVT_OBJECT_START) {
+        memset(e, 0, sizeof(*e));
+        e->id = -1;
+        p->title_rank = API_DOC_KEY_NONE;
+        p->date_rank = API_DOC_KEY_NONE;
+    } else if (depth == 2 && evt == JSON_STREAM_EVT_OBJECT_END) {
+        if (e->id >= 0) {
+            p->n++;
+        }
+    } else if (depth == 3 && value != NULL) {
+        long id;
+        uint8_t title_rank = api_doc_key_rank(s_doc_title_keys, API_DOC_KEYS(s_doc_title_keys), key);
+        uint8_t date_rank = api_doc_key_rank(s_doc_date_keys, API_DOC_KEYS(s_doc_date_keys), key);
+
+        if (strcmp(key, "idFile") == 0) {
+            if (json_stream_parse_int(value, &id) && id >= 0) {
+                e->id = (int32_t)id;
+            }
+        } else if (title_rank < p->title_rank && evt == JSON_STREAM_EVT_STRING && value[0] != '\0') {
+            api_doc_title_copy(e->title, value, sizeof(e->title));
+            p->title_rank = title_rank;
+        } else if (date_rank < p->date_rank) {
+            char date[DOC_LIST_DATE_SIZE] = "";
+            api_doc_date(evt, value, date, sizeof(date));
+            if (date[0] != '\0') {
+                strlcpy(e->date, date, sizeof(e->date));
+                p->date_rank = date_rank;
+            }
+        }
+    }
+    return true;
+}
+
+// Signer list: web_url with its page and size replaced, so the list is the
+// listing the count reads, in the same order
+static bool api_signer_page_target(int page, char *target, size_t size)
+{
+    const char *query = strchr(web_url, '?');
+    size_t len = (query != NULL) ? (size_t)(query - web_url) : strlen(web_url);
+    char sep = '?';
+
+    if (len >= size) {
+        return false;
+    }
+    memcpy(target, web_url, len);
+    target[len] = '\0';
+    for (const char *p = (query != NULL) ? query + 1 : ""; *p != '\0'; ) {
+        size_t param_len = strcspn(p, "&");
+        if (param_len > 0 && strncmp(p, "page=", 5) != 0 && strncmp(p, "size=", 5) != 0) {
+            if (len + 1 + param_len >= size) {
+                return false;
+            }
+            target[len++] = sep;
+            memcpy(target + len, p, param_len);
+            len += param_len;
+            target[len] = '\0';
+            sep = '&';
+        }
+        p += param_len;
+        if (*p == '&') {
+            p++;
+        }
+    }
+    int n = snprintf(target + len, size - len, "%cpage=%d&size=%d", sep, page, DOC_LIST_PAGE_SIZE);
+    return n > 0 && (size_t)n < size - len;
+}
+
+// Reads one page of a list into p. Returns 0 or -1 (error recorded)
+static int api_fetch_document_page(doc_list_kind_t kind, const char *user_id, int page,
+                                   api_doc_page_t *p, api_metrics_req_t *metrics)
+{
+    char target[WEB_URL_SIZE + 32];
+    api_http_resp_t resp;
+
+    if (kind == DOC_LIST_EDITOR) {
+        api_editor_documents_path(user_id, page, DOC_LIST_PAGE_SIZE, target, sizeof(target));
+    } else if (!api_signer_page_target(page, target, sizeof(target))) {
+        ESP_LOGE(TAG, "❌ Signer URL too long for a page request");
+        api_error_set(API_ERR_PARSE);
+        return -1;
+    }
+    if (api_http_get(target, NULL, &resp, metrics) != 0) {
+        return -1;
+    }
+
+    int ret = -1;
+    if (resp.status_code != 200) {
+        ESP_LOGE(TAG, "❌ Document page %d - Status: %d", page, resp.status_code);
+        api_error_from_status(resp.status_code);
+    } else {
+        memset(p, 0, sizeof(*p));
+        p->total = -1;
+        int r = api_resp_stream_json(&resp, api_doc_page_cb, p);
+        if (r == JSON_STREAM_COMPLETE && p->total >= 0) {
+            ret = 0;
+        } else if (r >= 0) {
+            ESP_LOGE(TAG, "❌ Document page %d incomplete or without totalElements", page);
+            api_error_set(API_ERR_PARSE);
+        }
+    }
+    api_resp_finish(&resp);
+    return ret;
+}
+
+esp_err_t api_manager_fetch_documents(doc_list_kind_t kind, const char *user_id,
+                                      const net_deadline_t *deadline)
+{
+    static api_doc_page_t page_buf;     // Network worker only; kept off its stack
+    api_metrics_req_t metrics;
+    bool ok = true;
+    int page;
+
+    if (kind >= DOC_LIST_KIND_COUNT || (kind == DOC_LIST_EDITOR && user_id == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!doc_list_update_begin(kind)) {
+        return ESP_OK;      // Same count and first document as the cached list
+    }
+    api_call_begin(deadline);
+    api_metrics_begin(&metrics, "documents");
+
+    while ((page = doc_list_update_next_page()) >= 0) {
+        if (api_fetch_document_page(kind, user_id, page, &page_buf, &metrics) != 0) {
+            ok = false;
+            break;
+        }
+        doc_list_update_put_page(page, page_buf.entries, page_buf.n, (int)page_buf.total);
+    }
+
+    doc_list_update_end(ok);
+    api_metrics_end(&metrics, ok);
+    if (ok) {
+        return ESP_OK;
+    }
+    return api_deadline_over() ? ESP_ERR_TIMEOUT : ESP_FAIL;
+}
+
+// One pending-count GET of a pipelined batch
+typedef struct {
+    const char *target;
+    const char *token;          // Account the request is made for
+    const char *user;
+    api_cache_slot_t slot;      // API_CACHE_SLOT_COUNT = not cached
+    const char *label;          // For the logs
+} api_count_req_t;
+
+// Keeps the first failure of a batch as the one api_manager_last_error()
+// reports, and clears the current one for the next request
+static void api_error_capture(api_error_class_t *cls, int *status)
+{
+    if (*cls == API_ERR_NONE && s_last_error != API_ERR_NONE) {
+        *cls = s_last_error;
+        *status = s_last_status;
+    }
+    api_error_reset();
+}
+
+// identity: ask for an uncompressed body (the HTTP/2 batch reads its
+// streams side by side and has no room for one decoder each)
+static int api_count_request(const api_count_req_t *req, bool identity, char *request, size_t size)
+{
+    char conditional[API_CACHE_ETAG_SIZE + API_CACHE_LAST_MOD_SIZE + 80];
+
+    conditional[0] = '\0';
+    if (req->slot < API_CACHE_SLOT_COUNT) {
+        api_cache_conditional_headers(req->slot, conditional, sizeof(conditional));
+    }
+    if (identity) {
+        strlcat(conditional, "Accept-Encoding: identity\r\n", sizeof(conditional));
+    }
+    return api_http_build_request(req->target, conditional, req->token, req->user, request, size);
+}
+
+#if API_HTTP2
+// ---------------------------------------------------------------------------
+// HTTP/2 count batch
+// ---------------------------------------------------------------------------
+// On an HTTP/2 connection the counts of a cycle go out as concurrent
+// streams: all HEADERS frames in one write, answers read in whatever order
+// the server interleaves them, each body through its own JSON tokenizer.
+
+// One stream of the batch
+typedef struct {
+    uint32_t id;                // 0 = not opened
+    int status;                 // Final status (0 = headers not seen yet)
+    char etag[API_CACHE_ETAG_SIZE];
+    char last_modified[API_CACHE_LAST_MOD_SIZE];
+    json_stream_t js;
+    json_stream_fields_t fields;
+    uint32_t unacked;           // DATA not yet credited back on the stream
+    bool encoded;               // Compressed although identity was asked for
+    bool done;                  // Count (or failure) decided
+} api_h2_count_t;
+
+typedef struct {
+    api_conn_t *conn;
+    const api_count_req_t *reqs;
+    int n;
+    int *counts;
+    api_h2_count_t *streams;
+    int opened;                 // Requests handled by api_h2_count_open() so far
+    int pending;                // Streams open and not done
+    api_metrics_req_t *metrics;
+    size_t bytes_in;
+    int64_t sent_us;
+    bool reported;              // Endpoint outcome already recorded
+    api_error_class_t *first_error;
+    int *first_status;
+} api_h2_batch_t;
+
+static void api_h2_count_header(const char *name, const char *value, void *ctx)
+{
+    api_h2_count_t *c = (api_h2_count_t *)ctx;
+
+    if (strcmp(name, ":status") == 0) {
+        c->status = atoi(value);
+    } else if (strcmp(name, "etag") == 0) {
+        strlcpy(c->etag, value, sizeof(c->etag));
+    } else if (strcmp(name, "last-modified") == 0) {
+        strlcpy(c->last_modified, value, sizeof(c->last_modified));
+    } else if (strcmp(name, "content-encoding") == 0) {
+        c->encoded = (api_header_encoding(value) != API_ENCODING_IDENTITY);
+    }
+}
+
+// Opens streams for the requests not sent yet, as many as the server
+// allows in flight. A request that cannot be encoded fails on its own.
+static int api_h2_count_open(api_h2_batch_t *b)
+{
+    static char request[API_HTTP_REQUEST_SIZE];             // Kept off the worker stack
+    static uint8_t frames[2 * API_HTTP_REQUEST_SIZE];
+    size_t frames_len = 0;
+    size_t consumed;
+
+    for (; b->opened < b->n && (uint32_t)b->pending < b->conn->h2_max_streams; b->opened++) {
+        const api_count_req_t *req = &b->reqs[b->opened];
+        api_h2_count_t *c = &b->streams[b->opened];
+        int frame_len = -1;
+        int req_len = api_count_request(req, true, request, sizeof(request));
+
+        if (req_len > 0) {
+            frame_len = http2_request_from_http1(request, req_len, &consumed, b->conn->h2_next_stream,
+                                                 frames + frames_len, sizeof(frames) - frames_len);
+            if (frame_len < 0 && frames_len > 0) {
+                // Buffer full: send what is there and encode again
+                if (api_h2_write(b->conn, frames, frames_len) != 0) {
+                    return -1;
+                }
+                api_metrics_add_bytes(b->metrics, 0, frames_len);
+                frames_len = 0;
+                frame_len = http2_request_from_http1(request, req_len, &consumed, b->conn->h2_next_stream,
+                                                     frames, sizeof(frames));
+            }
+        }
+        if (frame_len < 0) {
+            ESP_LOGE(TAG, "❌ %s request cannot be sent as an HTTP/2 stream", req->label);
+            api_error_set(API_ERR_PARSE);
+            api_error_capture(b->first_error, b->first_status);
+            c->done = true;
+            continue;
+        }
+        frames_len += frame_len;
+        c->id = b->conn->h2_next_stream;
+        b->conn->h2_next_stream += 2;
+        json_stream_fields_init(&c->fields, s_count_keys, API_COUNT_KEY_COUNT);
+        json_stream_init(&c->js, json_stream_fields_cb, &c->fields);
+        b->pending++;
+    }
+    if (frames_len > 0) {
+        if (api_h2_write(b->conn, frames, frames_len) != 0) {
+            return -1;
+        }
+        api_metrics_add_bytes(b->metrics, 0, frames_len);
+    }
+    return 0;
+}
+
+// Decides the count of stream i; a stream the server has not ended is cancelled
+static int api_h2_count_done(api_h2_batch_t *b, int i, bool parsed, bool ended)
+{
+    const api_count_req_t *req = &b->reqs[i];
+    api_h2_count_t *c = &b->streams[i];
+    uint8_t rst[HTTP2_RST_STREAM_SIZE];
+
+    b->counts[i] = api_count_result(req->slot, req->label, c->status, c->etag, c->last_modified,
+                                    parsed ? &c->fields : NULL);
+    api_error_capture(b->first_error, b->first_status);
+    c->done = true;
+    b->pending--;
+    if (!ended && api_h2_write(b->conn, rst, http2_rst_stream(rst, c->id, HTTP2_CANCEL)) != 0) {
+        return -1;
+    }
+    // The freed slot lets a request held back by max_concurrent_streams go
+    return api_h2_count_open(b);
+}
 
-    vTaskDelay(pdMS_TO_TICKS(1500));
+static int api_h2_count_headers(api_h2_batch_t *b, int i, const http2_frame_t *f, uint8_t *block)
+{
+    api_h2_count_t *c = &b->streams[i];
+    bool ended = (f->flags & HTTP2_FLAG_END_STREAM) != 0;
+    int len = api_h2_read_header_block(b->conn, f, block, &b->bytes_in);
 
-     // Manual construction of HTTP/1.0 request
-     // In questo esempio, usiamo HTTP/1.0 per forzare la chiusura della connessione.
-     char request[512];
+    if (len < 0) {
+        return -1;
+    }
+    if (c->status != 0) {
+        // Trailers, which end the stream
+        return api_h2_count_done(b, i, true, ended);
+    }
+    if (http2_decode_headers(block, len, api_h2_count_header, c) != 0) {
+        api_h2_disable("HPACK decoding failed");
+        return -1;
+    }
+    if (c->status >= 100 && c->status < 200) {
+        c->status = 0;
+        return 0;
+    }
+    if (!b->reported) {
+        api_metrics_phase(b->metrics, API_PHASE_TTFB);
+        api_endpoints_report(s_ep.index, c->status < 500,
+                             (uint32_t)((esp_timer_get_time() - b->sent_us) / 1000));
+        b->reported = true;
+    }
+    if (c->status == 0) {
+        ESP_LOGE(TAG, "HTTP/2 response without :status");
+        api_error_set(API_ERR_PARSE);
+        c->status = -1;
+        return api_h2_count_done(b, i, false, ended);
+    }
+    // Only a 200 has a body worth reading
+    if (ended || c->status != 200) {
+        return api_h2_count_done(b, i, true, ended);
+    }
+    if (c->encoded) {
+        ESP_LOGE(TAG, "❌ %s: compressed body on an HTTP/2 batch stream", b->reqs[i].label);
+        api_error_set(API_ERR_PARSE);
+        return api_h2_count_done(b, i, false, ended);
+    }
+    return 0;
+}
 
-     #pragma GCC diagnostic push
-     #pragma GCC diagnostic ignored "-Wformat-truncation"
+static int api_h2_count_data(api_h2_batch_t *b, int i, const http2_frame_t *f)
+{
+    api_h2_count_t *c = &b->streams[i];
+    bool ended = (f->flags & HTTP2_FLAG_END_STREAM) != 0;
+    uint32_t payload = f->length;
+    uint8_t pad = 0;
+    char chunk[API_JSON_CHUNK_SIZE];
 
-     snprintf(request, sizeof(request),
-              "GET %s HTTP/1.0\r\n"
-              "Host: %s\r\n"
-              "User-Agent: ESP-32 S3 1.0\r\n"
-              "X-SignToken: %s\r\n"
-              "X-SignUser: %s\r\n"
-              "\r\n",
-              web_url, web_server, api_token, askmesign_user);
-     ESP_LOGI(TAG, "HTTP Request:\n%s", request);
+    if (f->flags & HTTP2_FLAG_PADDED) {
+        if (payload < 1 || api_h2_recv(b->conn, &pad, 1, &b->bytes_in) != 0 || pad > payload - 1) {
+            return -1;
+        }
+        payload -= 1;
+    }
+    payload -= pad;
+    if (api_h2_credit(b->conn, c->id, ended ? NULL : &c->unacked, f->length) != 0) {
+        return -1;
+    }
+    api_metrics_mark(b->metrics);
+    while (payload > 0) {
+        size_t n = (payload < sizeof(chunk)) ? payload : sizeof(chunk);
+        if (api_h2_recv(b->conn, chunk, n, &b->bytes_in) != 0) {
+            return -1;
+        }
+        payload -= n;
+        api_metrics_phase(b->metrics, API_PHASE_BODY);
+        if (c->done) {
+            continue;   // Rest of the frame after the fields were found
+        }
+        json_stream_result_t r = json_stream_feed(&c->js, chunk, n);
+        api_metrics_phase(b->metrics, API_PHASE_PARSE);
+        if (r == JSON_STREAM_ERROR) {
+            api_error_set(API_ERR_PARSE);
+            if (api_h2_count_done(b, i, false, ended) != 0) {
+                return -1;
+            }
+        } else if (r == JSON_STREAM_STOPPED || r == JSON_STREAM_COMPLETE) {
+            ESP_LOGI(TAG, "📄 JSON fields extracted after %u body bytes", (unsigned)c->js.offset);
+            if (api_h2_count_done(b, i, true, ended) != 0) {
+                return -1;
+            }
+        }
+    }
+    if (api_h2_skip(b->conn, pad, &b->bytes_in) != 0) {
+        return -1;
+    }
+    // Body over without all the fields: api_count_result() reports it
+    if (ended && !c->done) {
+        return api_h2_count_done(b, i, true, true);
+    }
+    return 0;
+}
 
-     #pragma GCC diagnostic pop
+// Runs the batch on an HTTP/2 connection. Returns 0 once every stream is
+// done, -1 if the connection failed (streams not done keep count -1)
+static int api_h2_count_run(api_h2_batch_t *b)
+{
+    uint8_t hdr[HTTP2_FRAME_HEADER_SIZE];
+    http2_frame_t f;
+    int ret = -1;
+    uint8_t *block = malloc(API_H2_HEADER_BLOCK_SIZE);
 
-     // Initialization of mbedTLS
-     mbedtls_net_context server_fd;
-     mbedtls_ssl_context ssl;
-     mbedtls_ssl_config conf;
-     mbedtls_ctr_drbg_context ctr_drbg;
-     mbedtls_entropy_context entropy;
-     mbedtls_x509_crt cacert;
-     
-     mbedtls_net_init(&server_fd);
-     mbedtls_ssl_init(&ssl);
-     mbedtls_ssl_config_init(&conf);
-     mbedtls_ctr_drbg_init(&ctr_drbg);
-     mbedtls_entropy_init(&entropy);
-     mbedtls_x509_crt_init(&cacert);
- 
- #ifdef CONFIG_MBEDTLS_SSL_PROTO_TLS1_3
-     psa_status_t status = psa_crypto_init();
-     if (status != PSA_SUCCESS) {
-         ESP_LOGE(TAG, "PSA crypto init failed: %d", (int) status);
-         goto exit;
-     }
- #endif
- 
-     if ((ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, NULL, 0)) != 0) {
-         ESP_LOGE(TAG, "mbedtls_ctr_drbg_seed returned -0x%x", -ret);
-         goto exit;
-     }
- 
-     if ((ret = mbedtls_ssl_config_defaults(&conf,
-                                            MBEDTLS_SSL_IS_CLIENT,
-                                            MBEDTLS_SSL_TRANSPORT_STREAM,
-                                            MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
-         ESP_LOGE(TAG, "mbedtls_ssl_config_defaults returned -0x%x", -ret);
-         goto exit;
-     }
- 
-     mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
-     mbedtls_ssl_conf_ca_chain(&conf, &cacert, NULL);
-     mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);
-     mbedtls_ssl_conf_read_timeout(&conf, 5000);
- 
-     if ((ret = esp_crt_bundle_attach(&conf)) < 0) {
-         ESP_LOGE(TAG, "esp_crt_bundle_attach returned -0x%x", -ret);
-         goto exit;
-     }
- 
-     if ((ret = mbedtls_ssl_setup(&ssl, &conf)) != 0) {
-         ESP_LOGE(TAG, "mbedtls_ssl_setup returned -0x%x", -ret);
-         goto exit;
-     }
- 
-     if ((ret = mbedtls_ssl_set_hostname(&ssl, web_server)) != 0) {
-         ESP_LOGE(TAG, "mbedtls_ssl_set_hostname returned -0x%x", -ret);
-         goto exit;
-     }
- 
-     // Connection to the server
-     ESP_LOGI(TAG, "Connecting to %s:%s...", web_server, web_port);
-     if ((ret = mbedtls_net_connect(&server_fd, web_server, web_port, MBEDTLS_NET_PROTO_TCP)) != 0) {
-         ESP_LOGE(TAG, "mbedtls_net_connect returned -0x%x", -ret);
-         goto exit;
-     }
- 
-     mbedtls_ssl_set_bio(&ssl, &server_fd, mbedtls_net_send, mbedtls_net_recv, NULL);
- 
-     ESP_LOGI(TAG, "Performing the SSL/TLS handshake...");
-     while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
-         if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
-             ESP_LOGE(TAG, "mbedtls_ssl_handshake returned -0x%x", -ret);
-             goto exit;
-         }
-     }
- 
-     if ((ret = mbedtls_ssl_get_verify_result(&ssl)) != 0) {
-         ESP_LOGW(TAG, "Certificate verification failed, flags: 0x%x", ret);
-     } else {
-         ESP_LOGI(TAG, "Certificate verified.");
-     }
- 
-     // Send the request
-     size_t written = 0;
-     size_t request_len = strlen(request);
-     while (written < request_len) {
-         ret = mbedtls_ssl_write(&ssl, (const unsigned char *)request + written, request_len - written);
-         if (ret < 0) {
-             ESP_LOGE(TAG, "mbedtls_ssl_write returned -0x%x", -ret);
-             goto exit;
-         }
-         written += ret;
-     }
-     ESP_LOGI(TAG, "Request sent (%d bytes)", written);
- 
-     // Allocate buffer for the response
-     buffer = malloc(BUFFER_SIZE);
-     if (buffer == NULL) {
-         ESP_LOGE(TAG, "Memory allocation for response failed");
-         goto exit;
-     }
-     memset(buffer, 0, BUFFER_SIZE);
-     
-     // Reads the HTTP response
-     while ((ret = mbedtls_ssl_read(&ssl, (unsigned char *)buffer + offset, BUFFER_SIZE - offset - 1)) > 0) {
-         offset += ret;
-         if (offset >= BUFFER_SIZE - 1) {
-             ESP_LOGE(TAG, "Risposta troppo grande, buffer pieno!");
-             break;
-         }
-     }
-     buffer[offset] = '\0';
- 
-     ESP_LOGI(TAG, "HTTP Response received (%d bytes):\n%s", offset, buffer);
- 
-     // Extracts JSON body (assuming response contains headers and body separated by "\r\n\r\n")
-     const char *json_body = extract_json_body(buffer);
-     if (json_body == NULL) {
-         ESP_LOGE(TAG, "Failed to extract JSON body from HTTP response");
-         practices_found = -1;  // Set error state for JSON extraction failure
-         goto exit;
-     }
-     
-     cJSON *json = cJSON_Parse(json_body);
-     if (json == NULL) {
-         ESP_LOGE(TAG, "Failed to parse JSON body");
-         practices_found = -1;  // Set error state for JSON parsing failure
-         goto exit;
-     }
-     
-     cJSON *numberElem = cJSON_GetObjectItem(json, "totalElements");
-     if (cJSON_IsNumber(numberElem)) {
-         totalElements = numberElem->valueint;
-         practices_found = totalElements;
-         ESP_LOGI(TAG, "Number of Elements: %d", totalElements);
-     } else {
-         ESP_LOGE(TAG, "JSON does not contain a valid 'totalElements' field");
-         practices_found = -1;  // Set error state for invalid JSON
-     }
-     cJSON_Delete(json);
-     
- exit:
-     mbedtls_ssl_close_notify(&ssl);
-     mbedtls_net_free(&server_fd);
-     mbedtls_ssl_free(&ssl);
-     mbedtls_ssl_config_free(&conf);
-     mbedtls_ctr_drbg_free(&ctr_drbg);
-     mbedtls_entropy_free(&entropy);
-    mbedtls_x509_crt_free(&cacert);
-    if (buffer) {
-        free(buffer);
+    if (block == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for the HTTP/2 header block");
+        return -1;
+    }
+    memset(b->streams, 0, b->n * sizeof(b->streams[0]));
+    // Settings sent after the preface (a lower stream limit) apply to this batch
+    if (!api_h2_service_idle(b->conn)) {
+        goto out;
+    }
+    b->sent_us = esp_timer_get_time();
+    api_metrics_mark(b->metrics);
+    if (api_h2_count_open(b) != 0) {
+        goto out;
+    }
+    ESP_LOGI(TAG, "🚀 %d request(s) sent as concurrent HTTP/2 streams", b->pending);
+
+    while (b->pending > 0) {
+        if (api_deadline_over() || api_h2_recv(b->conn, hdr, sizeof(hdr), &b->bytes_in) != 0) {
+            goto out;
+        }
+        http2_frame_header_decode(hdr, &f);
+
+        int i = -1;
+        for (int k = 0; k < b->opened && f.stream_id != 0; k++) {
+            if (b->streams[k].id == f.stream_id && !b->streams[k].done) {
+                i = k;
+                break;
+            }
+        }
+        if (i < 0 || (f.type != HTTP2_FRAME_HEADERS && f.type != HTTP2_FRAME_DATA &&
+                      f.type != HTTP2_FRAME_RST_STREAM)) {
+            if (api_h2_control(b->conn, &f, &b->bytes_in) != 0) {
+                goto out;
+            }
+            if (b->conn->h2_goaway) {
+                ESP_LOGW(TAG, "HTTP/2 GOAWAY with %d stream(s) pending", b->pending);
+                goto out;
+            }
+            continue;
+        }
+
+        if (f.type == HTTP2_FRAME_HEADERS) {
+            ret = api_h2_count_headers(b, i, &f, block);
+        } else if (f.type == HTTP2_FRAME_DATA) {
+            ret = api_h2_count_data(b, i, &f);
+        } else {
+            ESP_LOGW(TAG, "HTTP/2 stream of %s reset by server", b->reqs[i].label);
+            ret = api_h2_skip(b->conn, f.length, &b->bytes_in);
+            if (ret == 0) {
+                api_error_set(API_ERR_CONNECT);
+                b->streams[i].status = -1;
+                ret = api_h2_count_done(b, i, false, true);
+            }
+        }
+        if (ret != 0) {
+            goto out;
+        }
     }
-    return practices_found;
+    ret = 0;
+
+out:
+    free(block);
+    return (ret == 0 && b->pending == 0) ? 0 : -1;
 }
 
-esp_err_t api_manager_check_firmware_updates(const char* current_version, ota_version_info_t* update_info)
+// api_fetch_counts() over HTTP/2. Returns false, with the connection back
+// in the pool and nothing recorded, if the server did not negotiate h2: the
+// caller then goes on with HTTP/1.1 pipelining. A batch that fails on a
+// reused connection before any byte arrived is retried on a fresh one.
+static bool api_h2_fetch_counts(const api_count_req_t *reqs, int n, int *counts,
+                                api_metrics_req_t *metrics,
+                                api_error_class_t *first_error, int *first_status)
 {
-    if (current_version == NULL || update_info == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    static api_h2_count_t streams[API_H2_BATCH_MAX];     // Kept off the worker stack
+
+    if (n > API_H2_BATCH_MAX) {
+        return false;
     }
-    
-    ESP_LOGI(TAG, "🔍 Checking for firmware updates via GitHub API (current: %s)...", current_version);
-    
-    // Use GitHub API to check for latest release
-    char update_url[512];
-    snprintf(update_url, sizeof(update_url), 
-             "https://api.github.com/repos/bisontebiscottato/firminia3/releases/latest");
-    
-    ESP_LOGI(TAG, "📡 GitHub API URL: %s", update_url);
-    
-    // HTTP client configuration for GitHub API
-    esp_http_client_config_t config = {
-        .url = update_url,
-        .method = HTTP_METHOD_GET,
-        .timeout_ms = 15000,
-        .buffer_size = 4096,  // GitHub API responses can be larger
-        .buffer_size_tx = 1024,
-        .crt_bundle_attach = esp_crt_bundle_attach,  // Enable certificate verification
-        .skip_cert_common_name_check = false,
-    };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "❌ Failed to initialize HTTP client for GitHub API");
-        return ESP_ERR_NO_MEM;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        api_h2_batch_t b = {
+            .reqs = reqs, .n = n, .counts = counts, .streams = streams, .metrics = metrics,
+            .first_error = first_error, .first_status = first_status,
+        };
+        bool reused = false;
+
+        api_error_reset();
+        b.conn = api_conn_acquire(&s_ep, &reused, metrics);
+        if (b.conn == NULL) {
+            ESP_LOGE(TAG, "❌ Failed to open HTTP connection");
+            api_error_set(API_ERR_CONNECT);
+            api_error_capture(first_error, first_status);
+            api_metrics_end(metrics, false);
+            return true;
+        }
+        if (!b.conn->h2) {
+            api_conn_release(b.conn, true);
+            return false;
+        }
+
+        int ret = api_h2_count_run(&b);
+        api_metrics_add_bytes(metrics, b.bytes_in, 0);
+        api_conn_release(b.conn, ret == 0 && !b.conn->h2_goaway);
+        if (ret == 0) {
+            bool ok = true;
+            for (int i = 0; i < n; i++) {
+                ok = ok && counts[i] >= 0;
+            }
+            api_metrics_end(metrics, ok);
+            return true;
+        }
+        if (!(reused && b.bytes_in == 0) || api_deadline_over()) {
+            if (!b.reported && !net_deadline_cancelled(s_deadline)) {
+                api_endpoints_report(s_ep.index, false, 0);
+            }
+            api_error_set(API_ERR_CONNECT);
+            api_error_capture(first_error, first_status);
+            api_metrics_end(metrics, false);
+            return true;
+        }
+        ESP_LOGW(TAG, "♻️ Keep-alive connection dropped by server, retrying on a new one");
     }
-    
-    // GitHub API headers (no auth needed for public repos)
-    esp_http_client_set_header(client, "User-Agent", "Firminia/3.6.1");
-    esp_http_client_set_header(client, "Accept", "application/vnd.github.v3+json");
-    
-    // Allocate response buffer (larger for GitHub API)
-    char* buffer = malloc(4096);
-    if (buffer == NULL) {
-        esp_http_client_cleanup(client);
-        ESP_LOGE(TAG, "❌ Failed to allocate response buffer");
-        return ESP_ERR_NO_MEM;
+    return true;
+}
+#endif
+
+// Fetches the counts of reqs[0..n) over the keep-alive connection: up to
+// API_PIPELINE_DEPTH GETs are written back to back (HTTP/1.1 pipelining)
+// and their responses read in order, so a batch costs one round trip and
+// every account shares the same TLS session. A request the pipeline left
+// unanswered (server closed early or dropped it) is sent again on its own.
+// A server that negotiated HTTP/2 gets the batch as concurrent streams.
+// counts[i] is -1 for a failed request; once the deadline is over the
+// requests not yet sent fail without touching the network.
+static void api_fetch_counts(const api_count_req_t *reqs, int n, int *counts, const char *metrics_label)
+{
+    static char request[API_PIPELINE_DEPTH * API_HTTP_REQUEST_SIZE];    // Kept off the worker stack
+    api_error_class_t first_error = API_ERR_NONE;
+    int first_status = 0;
+    api_http_resp_t resp;
+    api_metrics_req_t metrics;
+    bool metrics_open = true;
+
+    for (int i = 0; i < n; i++) {
+        counts[i] = -1;
     }
-    
-    esp_err_t err = esp_http_client_open(client, 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Failed to open HTTP connection: %s", esp_err_to_name(err));
-        free(buffer);
-        esp_http_client_cleanup(client);
-        return err;
+
+    api_metrics_begin(&metrics, metrics_label);
+#if API_HTTP2
+    if (api_h2_fetch_counts(reqs, n, counts, &metrics, &first_error, &first_status)) {
+        s_last_error = first_error;
+        s_last_status = first_status;
+        return;
     }
-    
-    int content_length = esp_http_client_fetch_headers(client);
-    int status_code = esp_http_client_get_status_code(client);
-    
-    ESP_LOGI(TAG, "📡 Update check response: status=%d, content_length=%d", status_code, content_length);
-    
-    if (status_code == 200 && content_length > 0 && content_length < 4096) {
-        int data_read = esp_http_client_read_response(client, buffer, content_length);
-        if (data_read > 0) {
-            buffer[data_read] = '\0';
-            ESP_LOGI(TAG, "📡 GitHub API response received (%d bytes)", data_read);
-            
-            // Parse GitHub API JSON response
-            cJSON *json = cJSON_Parse(buffer);
-            if (json) {
-                cJSON *tag_name = cJSON_GetObjectItem(json, "tag_name");
-                cJSON *assets = cJSON_GetObjectItem(json, "assets");
-                
-                if (cJSON_IsString(tag_name) && cJSON_IsArray(assets)) {
-                    const char* latest_version = cJSON_GetStringValue(tag_name);
-                    ESP_LOGI(TAG, "📋 Latest GitHub release: %s", latest_version);
-                    
-                    // Simple version comparison (remove 'v' prefix if present)
-                    const char* clean_latest = (latest_version[0] == 'v') ? latest_version + 1 : latest_version;
-                    const char* clean_current = (current_version[0] == 'v') ? current_version + 1 : current_version;
-                    
-                    if (strcmp(clean_current, clean_latest) < 0) {
-                        // Find firmware binary in assets
-                        cJSON *asset;
-                        cJSON_ArrayForEach(asset, assets) {
-                            cJSON *name = cJSON_GetObjectItem(asset, "name");
-                            cJSON *download_url = cJSON_GetObjectItem(asset, "browser_download_url");
-                            cJSON *size = cJSON_GetObjectItem(asset, "size");
-                            
-                            if (cJSON_IsString(name) && cJSON_IsString(download_url) && cJSON_IsNumber(size)) {
-                                const char* asset_name = cJSON_GetStringValue(name);
-                                
-                                // Look for firmware binary
-                                if (strstr(asset_name, "firminia3.bin") != NULL) {
-                                    // Fill update info structure
-                                    const char* download_url_str = cJSON_GetStringValue(download_url);
-                                    ESP_LOGI(TAG, "🔗 Found firmware URL: %s", download_url_str);
-                                    
-                                    // Validate firmware size (should be between 1MB and 10MB for ESP32)
-                                    uint32_t firmware_size = (uint32_t)cJSON_GetNumberValue(size);
-                                    if (firmware_size < 1024 * 1024 || firmware_size > 10 * 1024 * 1024) {
-                                        ESP_LOGW(TAG, "⚠️ Suspicious firmware size: %lu bytes (%.2f MB)", 
-                                                firmware_size, firmware_size / (1024.0 * 1024.0));
-                                        // Continue anyway but log warning
-                                    }
-                                    
-                                    strncpy(update_info->version, clean_latest, sizeof(update_info->version) - 1);
-                                    update_info->version[sizeof(update_info->version) - 1] = '\0';
-                                    
-                                    strncpy(update_info->url, download_url_str, sizeof(update_info->url) - 1);
-                                    update_info->url[sizeof(update_info->url) - 1] = '\0';
-                                    
-                                    // Generate signature URL (assuming .sig file exists)
-                                    snprintf(update_info->signature_url, sizeof(update_info->signature_url),
-                                            "https://github.com/bisontebiscottato/firminia3/releases/download/%s/firminia3.sig",
-                                            latest_version);
-                                    
-                                    update_info->size = firmware_size;
-                                    
-                                    // For now, leave checksum empty (could be added to GitHub release notes)
-                                    strcpy(update_info->checksum, "");
-                                    
-                                    ESP_LOGI(TAG, "✅ Update available: %s → %s (size: %lu bytes, %.2f MB)", 
-                                             current_version, update_info->version, update_info->size,
-                                             update_info->size / (1024.0 * 1024.0));
-                                    
-                                    err = ESP_OK;
-                                    break;
-                                }
-                            }
-                        }
-                        
-                        if (err != ESP_OK) {
-                            ESP_LOGE(TAG, "❌ firminia3.bin not found in release assets");
-                            err = ESP_ERR_NOT_FOUND;
-                        }
-                    } else {
-                        ESP_LOGI(TAG, "ℹ️ No newer version available (%s >= %s)", clean_current, clean_latest);
-                        err = ESP_ERR_NOT_FOUND;
-                    }
-                } else {
-                    ESP_LOGE(TAG, "❌ Invalid GitHub API response format");
-                    err = ESP_ERR_INVALID_RESPONSE;
-                }
-                
-                if (json) cJSON_Delete(json);
-            } else {
-                ESP_LOGE(TAG, "❌ Failed to parse GitHub API JSON response");
-                err = ESP_ERR_INVALID_RESPONSE;
+#endif
+
+    for (int first = 0; first < n; first += API_PIPELINE_DEPTH) {
+        int last = (n - first < API_PIPELINE_DEPTH) ? n : first + API_PIPELINE_DEPTH;
+        int built = first;
+        int len = 0;
+
+        if (api_deadline_over()) {
+            api_error_capture(&first_error, &first_status);
+            break;
+        }
+
+        for (; built < last; built++) {
+            int req_len = api_count_request(&reqs[built], false, request + len, sizeof(request) - len);
+            if (req_len < 0) {
+                break;
             }
-        } else {
-            ESP_LOGE(TAG, "❌ Failed to read update response");
-            err = ESP_ERR_HTTP_INVALID_TRANSPORT;
+            len += req_len;
         }
-    } else if (status_code == 404) {
-        ESP_LOGI(TAG, "ℹ️ No updates available (404)");
-        err = ESP_ERR_NOT_FOUND;
-    } else {
-        ESP_LOGE(TAG, "❌ Update check failed: HTTP %d", status_code);
-        err = ESP_ERR_HTTP_BASE + status_code;
+
+        api_error_reset();
+        if (!metrics_open) {
+            api_metrics_begin(&metrics, metrics_label);
+        }
+        metrics_open = false;
+        if (len == 0 || api_http_send(request, len, &resp, &metrics) != 0) {
+            // Connection-level failure: the whole batch is lost
+            ESP_LOGE(TAG, "❌ Failed to open HTTP connection");
+            api_error_capture(&first_error, &first_status);
+            api_metrics_end(&metrics, false);
+            continue;
+        }
+
+        int done = first;
+        bool batch_ok = true;
+        while (true) {
+            counts[done] = api_count_from_response(&resp, reqs[done].slot, reqs[done].label);
+            if (counts[done] < 0) {
+                batch_ok = false;
+                api_error_capture(&first_error, &first_status);
+            }
+            if (++done == built) {
+                api_resp_finish(&resp);
+                break;
+            }
+            if (api_resp_next(&resp) != 0) {
+                // A broken pipeline is not a failure of the requests still to come
+                api_error_reset();
+                break;
+            }
+        }
+        api_metrics_end(&metrics, batch_ok && done == last);
+
+        for (; done < last && !api_deadline_over(); done++) {
+            char single[API_HTTP_REQUEST_SIZE];
+            int req_len = api_count_request(&reqs[done], false, single, sizeof(single));
+
+            ESP_LOGW(TAG, "⚠️ %s response not pipelined, asking again on its own", reqs[done].label);
+            api_metrics_begin(&metrics, reqs[done].label);
+            if (req_len > 0 && api_http_send(single, req_len, &resp, &metrics) == 0) {
+                counts[done] = api_count_from_response(&resp, reqs[done].slot, reqs[done].label);
+                api_resp_finish(&resp);
+            }
+            api_metrics_end(&metrics, counts[done] >= 0);
+            api_error_capture(&first_error, &first_status);
+        }
+        // Deadline that stopped the fallback requests
+        api_error_capture(&first_error, &first_status);
     }
-    
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-    free(buffer);
-    
-    return err;
+
+    s_last_error = first_error;
+    s_last_status = first_status;
 }
 
-// Editor mode: Get user ID from /api/v2/account
-esp_err_t api_manager_get_user_id(char* user_id_buffer, size_t buffer_size)
+// Both mode: signer and editor counts in one round trip
+esp_err_t api_manager_check_both(const char* user_id, int* signer_count, int* editor_count,
+                                 const net_deadline_t* deadline)
 {
-    if (!user_id_buffer || buffer_size == 0) {
-        ESP_LOGE(TAG, "❌ Invalid buffer parameters");
+    if (!user_id || !signer_count || !editor_count) {
+        ESP_LOGE(TAG, "❌ Invalid parameters");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    ESP_LOGI(TAG, "🔍 Getting user ID from /api/v2/account...");
-    
-    // Build account URL
-    char account_url[512];
-    snprintf(account_url, sizeof(account_url), "https://%s/api/v2/account", web_server);
-    
-    ESP_LOGI(TAG, "📡 Account API URL: %s", account_url);
-    
-    // HTTP client configuration
-    esp_http_client_config_t config = {
-        .url = account_url,
-        .method = HTTP_METHOD_GET,
-        .timeout_ms = 30000,
-        .buffer_size = 4096,
-        .buffer_size_tx = 1024,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .skip_cert_common_name_check = false,
+    api_call_begin(deadline);
+
+    char documents_path[256];
+    api_editor_documents_path(user_id, 0, 1, documents_path, sizeof(documents_path));
+
+    const api_count_req_t reqs[2] = {
+        { web_url, api_token, askmesign_user, API_CACHE_PENDING_SIGNER, "Signer" },
+        { documents_path, api_token, askmesign_user, API_CACHE_PENDING_EDITOR, "Editor" },
     };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "❌ Failed to initialize HTTP client");
-        return ESP_FAIL;
-    }
-    
-    // Set headers
-    esp_http_client_set_header(client, "X-SignToken", api_token);
-    esp_http_client_set_header(client, "X-SignUser", askmesign_user);
-    esp_http_client_set_header(client, "User-Agent", "Firminia/3.6.1");
-    esp_http_client_set_header(client, "Accept", "application/json");
-    
-    // Allocate response buffer
-    char* buffer = malloc(4096);
-    if (!buffer) {
-        ESP_LOGE(TAG, "❌ Failed to allocate response buffer");
-        esp_http_client_cleanup(client);
-        return ESP_ERR_NO_MEM;
+    int counts[2];
+
+    api_fetch_counts(reqs, 2, counts, "both");
+    *signer_count = counts[0];
+    *editor_count = counts[1];
+    if (*signer_count >= 0) {
+        totalElements = *signer_count;
     }
-    
-    esp_err_t err = esp_http_client_open(client, 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Failed to open HTTP connection: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        free(buffer);
-        return err;
+
+    return (*signer_count >= 0 && *editor_count >= 0) ? ESP_OK : ESP_FAIL;
+}
+
+// Signer mode with extra accounts: pending practices of every account
+int api_manager_check_accounts(int* counts, int max_counts, const net_deadline_t* deadline)
+{
+    api_count_req_t reqs[1 + EXTRA_ACCOUNTS_MAX];
+    int n = 0;
+    int total = -1;
+
+    if (!counts || max_counts < 1) {
+        ESP_LOGE(TAG, "❌ Invalid parameters");
+        return -1;
     }
-    
-    // Read response
-    int content_length = esp_http_client_fetch_headers(client);
-    int status_code = esp_http_client_get_status_code(client);
-    
-    ESP_LOGI(TAG, "📊 Account API Response - Status: %d, Content Length: %d", status_code, content_length);
-    
-    if (status_code == 200) {
-        int data_read = esp_http_client_read_response(client, buffer, 4095);
-        if (data_read > 0) {
-            buffer[data_read] = '\0';
-            ESP_LOGI(TAG, "📄 Account API Response: %s", buffer);
-            
-            // Parse JSON to extract idUser
-            cJSON *json = cJSON_Parse(buffer);
-            if (json) {
-                cJSON *id_user = cJSON_GetObjectItem(json, "idUser");
-                if (cJSON_IsNumber(id_user)) {
-                    snprintf(user_id_buffer, buffer_size, "%d", id_user->valueint);
-                    ESP_LOGI(TAG, "✅ User ID extracted: %s", user_id_buffer);
-                    cJSON_Delete(json);
-                    err = ESP_OK;
-                } else {
-                    ESP_LOGE(TAG, "❌ idUser not found or not a number in response");
-                    cJSON_Delete(json);
-                    err = ESP_ERR_NOT_FOUND;
-                }
-            } else {
-                ESP_LOGE(TAG, "❌ Failed to parse JSON response");
-                err = ESP_ERR_INVALID_RESPONSE;
-            }
-        } else {
-            ESP_LOGE(TAG, "❌ No data received from account API");
-            err = ESP_ERR_INVALID_RESPONSE;
+    api_call_begin(deadline);
+
+    // The configured account keeps its conditional cache; the extra ones
+    // are small uncached reads on the same connection
+    reqs[n++] = (api_count_req_t){ web_url, api_token, askmesign_user, API_CACHE_PENDING_SIGNER, askmesign_user };
+    for (uint8_t i = 0; i < extra_account_count && n < max_counts; i++) {
+        reqs[n++] = (api_count_req_t){ web_url, extra_accounts[i].token, extra_accounts[i].user,
+                                       API_CACHE_SLOT_COUNT, extra_accounts[i].user };
+    }
+
+    ESP_LOGI(TAG, "🔍 Checking practices for %d account(s)...", n);
+    api_fetch_counts(reqs, n, counts, "accounts");
+
+    if (counts[0] >= 0) {
+        totalElements = counts[0];
+    }
+    for (int i = 0; i < n; i++) {
+        if (counts[i] >= 0) {
+            total = ((total < 0) ? 0 : total) + counts[i];
         }
-    } else {
-        ESP_LOGE(TAG, "❌ Account API error - Status: %d", status_code);
-        err = ESP_ERR_HTTP_BASE + status_code;
     }
-    
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-    free(buffer);
-    
-    return err;
+    return total;
 }
 
-// Editor mode: Check documents created by user (pending signature)
-int api_manager_check_editor_documents(const char* user_id)
+// ---------------------------------------------------------------------------
+// Push transport
+// ---------------------------------------------------------------------------
+// push_url (on web_server) is held open on a pooled connection. A server
+// answering text/event-stream pushes events down one long response; any
+// other answer is treated as a long-poll: the server holds the request
+// until the state differs from If-None-Match, answers, and the request is
+// sent again. Events carry the count (a bare number or JSON with
+// totalElements) or just announce a change.
+
+#define API_PUSH_DATA_SIZE          256
+#define API_PUSH_LONGPOLL_MIN_MS    10000   // An unchanged answer sooner than this means the server does not hold requests
+
+typedef struct {
+    api_push_cb_t cb;
+    void *ctx;
+    char line[API_HTTP_LINE_SIZE];
+    size_t line_len;
+    char event[32];
+    char data[API_PUSH_DATA_SIZE];
+    size_t data_len;
+} api_push_parser_t;
+
+static char s_push_last_id[64];                     // Last-Event-ID, sent again when the stream reopens
+static char s_push_etag[API_CACHE_ETAG_SIZE];       // Long-poll: state the server already told us about
+
+static bool api_push_idle(void *ctx)
 {
-    if (!user_id) {
-        ESP_LOGE(TAG, "❌ Invalid user_id parameter");
-        return -1;
+    api_push_parser_t *p = (api_push_parser_t *)ctx;
+    return p->cb(API_PUSH_IDLE, -1, p->ctx);
+}
+
+// push_url must point at web_server: the stream shares its pool and TLS
+// session, and follows a failover like every other call
+static bool api_push_url_on_server(const char *url)
+{
+    size_t host_len = strlen(web_server);
+
+    if (strncmp(url, "https://", 8) != 0 || strncasecmp(url + 8, web_server, host_len) != 0) {
+        return false;
     }
-    
-    ESP_LOGI(TAG, "🔍 Checking documents for editor (user ID: %s)...", user_id);
-    
-    // Build documents URL with query parameters
-    char documents_url[512];
-    snprintf(documents_url, sizeof(documents_url), 
-             "https://%s/api/v2/files/?idUser=%s&page=0&size=1&sort=idFile,desc&status=L", 
-             web_server, user_id);
-    
-    ESP_LOGI(TAG, "📡 Documents API URL: %s", documents_url);
-    
-    // HTTP client configuration
-    esp_http_client_config_t config = {
-        .url = documents_url,
-        .method = HTTP_METHOD_GET,
-        .timeout_ms = 30000,
-        .buffer_size = 65536,  // Increased to 64KB for very large JSON responses
-        .buffer_size_tx = 1024,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .skip_cert_common_name_check = false,
-    };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "❌ Failed to initialize HTTP client");
-        return -1;
+    char next = url[8 + host_len];
+    return next == '/' || next == ':' || next == '\0';
+}
+
+// Count carried by an event payload: a bare number or a JSON object with
+// totalElements. Returns -1 when the event only announces a change.
+static int api_push_parse_count(const char *data, size_t len)
+{
+    while (len > 0 && (*data == ' ' || *data == '\t')) {
+        data++;
+        len--;
     }
-    
-    // Set headers
-    esp_http_client_set_header(client, "X-SignToken", api_token);
-    esp_http_client_set_header(client, "X-SignUser", askmesign_user);
-    esp_http_client_set_header(client, "User-Agent", "Firminia/3.6.1");
-    esp_http_client_set_header(client, "Accept", "application/json");
-    
-    // Allocate response buffer (64KB for very large JSON responses)
-    char* buffer = malloc(65536);
-    if (!buffer) {
-        ESP_LOGE(TAG, "❌ Failed to allocate response buffer");
-        esp_http_client_cleanup(client);
-        return -1;
+    if (len > 0 && *data >= '0' && *data <= '9') {
+        return (int)strtol(data, NULL, 10);
     }
-    
-    esp_err_t err = esp_http_client_open(client, 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Failed to open HTTP connection: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        free(buffer);
-        return -1;
+    if (len > 0 && *data == '{') {
+        json_stream_t js;
+        json_stream_fields_t fields;
+        static const char *const keys[] = { "totalElements" };
+        long value;
+
+        json_stream_fields_init(&fields, keys, 1);
+        json_stream_init(&js, json_stream_fields_cb, &fields);
+        if (json_stream_feed(&js, data, len) != JSON_STREAM_ERROR &&
+            json_stream_parse_int(json_stream_fields_get(&fields, "totalElements"), &value) &&
+            value >= 0) {
+            return (int)value;
+        }
+    }
+    return -1;
+}
+
+// Blank line: hands the collected event to the owner. Heartbeat events are
+// only there to keep the connection (and the idle timer) alive.
+static bool api_push_dispatch(api_push_parser_t *p)
+{
+    bool keep = true;
+
+    if (p->data_len > 0 && strcmp(p->event, "ping") != 0 && strcmp(p->event, "heartbeat") != 0) {
+        int count = api_push_parse_count(p->data, p->data_len);
+        ESP_LOGI(TAG, "📡 Push event '%s': %s", p->event[0] ? p->event : "message", p->data);
+        keep = p->cb((count >= 0) ? API_PUSH_COUNT : API_PUSH_CHANGED, count, p->ctx);
+    }
+    p->event[0] = '\0';
+    p->data[0] = '\0';
+    p->data_len = 0;
+    return keep;
+}
+
+// One SSE line ("field: value"); false when the owner asked to stop
+static bool api_push_line(api_push_parser_t *p)
+{
+    char *field = p->line;
+    char *value;
+
+    if (field[0] == '\0') {
+        return api_push_dispatch(p);
+    }
+    if (field[0] == ':') {
+        return true;        // Comment, used by servers as heartbeat
     }
-    
-    // Read response
-    int content_length = esp_http_client_fetch_headers(client);
-    int status_code = esp_http_client_get_status_code(client);
-    
-    ESP_LOGI(TAG, "📊 Documents API Response - Status: %d, Content Length: %d", status_code, content_length);
-    
-    int documents_found = -1;
-    
-    if (status_code == 200) {
-        int data_read = esp_http_client_read_response(client, buffer, 65535);
-        if (data_read > 0) {
-            buffer[data_read] = '\0';
-            ESP_LOGI(TAG, "📄 Documents API Response (%d bytes): %s", data_read, buffer);
-            
-            // Parse JSON to extract totalElements
-            cJSON *json = cJSON_Parse(buffer);
-            if (json) {
-                cJSON *total_elements = cJSON_GetObjectItem(json, "totalElements");
-                if (cJSON_IsNumber(total_elements)) {
-                    documents_found = total_elements->valueint;
-                    ESP_LOGI(TAG, "✅ Editor documents found: %d", documents_found);
-                } else {
-                    ESP_LOGE(TAG, "❌ totalElements not found or not a number in response");
-                    documents_found = -1;
+    value = strchr(field, ':');
+    if (value != NULL) {
+        *value++ = '\0';
+        if (*value == ' ') {
+            value++;
+        }
+    } else {
+        value = field + strlen(field);
+    }
+
+    if (strcmp(field, "data") == 0) {
+        if (p->data_len > 0 && p->data_len < sizeof(p->data) - 1) {
+            p->data[p->data_len++] = '\n';
+        }
+        p->data_len += strlcpy(p->data + p->data_len, value, sizeof(p->data) - p->data_len);
+        if (p->data_len >= sizeof(p->data)) {
+            p->data_len = sizeof(p->data) - 1;
+        }
+    } else if (strcmp(field, "event") == 0) {
+        strlcpy(p->event, value, sizeof(p->event));
+    } else if (strcmp(field, "id") == 0) {
+        strlcpy(s_push_last_id, value, sizeof(s_push_last_id));
+    }
+    return true;
+}
+
+// Reads events until the stream ends, fails or the owner stops it
+static esp_err_t api_push_read_events(api_http_resp_t *resp, api_push_parser_t *p)
+{
+    char chunk[API_JSON_CHUNK_SIZE];
+
+    while (true) {
+        int n = api_resp_read_body(resp, chunk, sizeof(chunk));
+        if (n < 0) {
+            return resp->stopped ? ESP_OK : ESP_FAIL;
+        }
+        if (n == 0) {
+            ESP_LOGI(TAG, "📡 Push stream closed by the server");
+            return ESP_OK;
+        }
+        for (int i = 0; i < n; i++) {
+            if (chunk[i] == '\n') {
+                p->line[p->line_len] = '\0';
+                p->line_len = 0;
+                if (!api_push_line(p)) {
+                    resp->stopped = true;
+                    return ESP_OK;
                 }
-                cJSON_Delete(json);
-            } else {
-                ESP_LOGE(TAG, "❌ Failed to parse JSON response");
-                documents_found = -1;
+            } else if (chunk[i] != '\r' && p->line_len < sizeof(p->line) - 1) {
+                p->line[p->line_len++] = chunk[i];
             }
-        } else {
-            ESP_LOGE(TAG, "❌ No data received from documents API");
-            documents_found = -1;
         }
-    } else {
-        ESP_LOGE(TAG, "❌ Documents API error - Status: %d", status_code);
-        documents_found = -1;
-    }
-    
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-    free(buffer);
-    
-    return documents_found;
+    }
+}
+
+esp_err_t api_manager_push_stream(const char* url, api_push_cb_t cb, void* ctx,
+                                  const net_deadline_t* deadline)
+{
+    static api_push_parser_t parser;    // Only the push task streams
+    char headers[160 + sizeof(s_push_last_id) + API_CACHE_ETAG_SIZE];
+    char request[API_HTTP_REQUEST_SIZE];
+    api_http_resp_t resp;
+    api_metrics_req_t metrics;
+    bool opened = false;
+    int last_count = -1;
+
+    if (!url || !cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!api_push_url_on_server(url)) {
+        ESP_LOGE(TAG, "❌ Push URL must be on %s: %s", web_server, url);
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&parser, 0, sizeof(parser));
+    parser.cb = cb;
+    parser.ctx = ctx;
+
+    while (true) {
+        // Uncompressed: a decoder would hold its window for the whole stream
+        int len = snprintf(headers, sizeof(headers),
+                           "Accept: text/event-stream\r\nCache-Control: no-cache\r\n"
+                           "Accept-Encoding: identity\r\n");
+        if (s_push_last_id[0] != '\0') {
+            len += snprintf(headers + len, sizeof(headers) - len, "Last-Event-ID: %s\r\n", s_push_last_id);
+        }
+        if (s_push_etag[0] != '\0') {
+            snprintf(headers + len, sizeof(headers) - len, "If-None-Match: %s\r\n", s_push_etag);
+        }
+        api_call_begin(deadline);
+        int request_len = api_http_build_request(url, headers, api_token, askmesign_user,
+                                                 request, sizeof(request));
+        if (request_len < 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        api_metrics_begin(&metrics, "push");
+        int64_t sent_us = esp_timer_get_time();
+        if (api_http_send_ex(request, request_len, &resp, &metrics, api_push_idle, &parser) != 0) {
+            api_metrics_end(&metrics, false);
+            return resp.stopped ? ESP_OK : ESP_FAIL;
+        }
+
+        if (resp.status_code == 404 || resp.status_code == 405 || resp.status_code == 501) {
+            ESP_LOGW(TAG, "📡 Push endpoint not available (HTTP %d)", resp.status_code);
+            api_error_from_status(resp.status_code);
+            api_resp_finish(&resp);
+            api_metrics_end(&metrics, false);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        if (resp.status_code != 200 && resp.status_code != 304) {
+            ESP_LOGE(TAG, "❌ Push API error - Status: %d", resp.status_code);
+            api_error_from_status(resp.status_code);
+            api_resp_finish(&resp);
+            api_metrics_end(&metrics, false);
+            return ESP_FAIL;
+        }
+        api_metrics_end(&metrics, true);
+
+        if (!opened) {
+            opened = true;
+            ESP_LOGI(TAG, "📡 Push %s open on %s", resp.event_stream ? "stream" : "long-poll", url);
+            if (!cb(API_PUSH_OPEN, -1, ctx)) {
+                resp.conn_close = true;
+                api_resp_finish(&resp);
+                return ESP_OK;
+            }
+        }
+
+        if (resp.event_stream) {
+            esp_err_t err = api_push_read_events(&resp, &parser);
+            // Never drain an endless body: the connection goes with the stream
+            resp.conn_close = true;
+            api_resp_finish(&resp);
+            return err;
+        }
+
+        // Long-poll: one answer per request
+        bool keep = true;
+        int count = -1;
+        if (resp.status_code == 200) {
+            count = api_count_from_response(&resp, API_CACHE_SLOT_COUNT, "Push");
+            strlcpy(s_push_etag, resp.etag, sizeof(s_push_etag));
+            if (count >= 0 && count != last_count) {
+                keep = cb(API_PUSH_COUNT, count, ctx);
+            }
+        }
+        api_resp_finish(&resp);
+
+        if (resp.status_code == 200 && count < 0) {
+            return ESP_FAIL;
+        }
+        uint32_t held_ms = (uint32_t)((esp_timer_get_time() - sent_us) / 1000);
+        if ((count < 0 || count == last_count) && held_ms < API_PUSH_LONGPOLL_MIN_MS) {
+            ESP_LOGW(TAG, "📡 Push endpoint answered in %lu ms without holding the request", held_ms);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        if (count >= 0) {
+            last_count = count;
+        }
+        if (!keep) {
+            return ESP_OK;
+        }
+    }
 }
- 
\ No newline at end of file
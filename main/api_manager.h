@@ -8,25 +8,163 @@
 #define API_MANAGER_H
 
 #include "ota_manager.h"
+#include "net_deadline.h"
+#include "doc_list.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Why the last AskMeSign call failed (drives the retry policy)
+typedef enum {
+    API_ERR_NONE = 0,
+    API_ERR_DNS,            // Name resolution
+    API_ERR_CONNECT,        // TCP connect, send/receive, timeouts
+    API_ERR_TLS,            // TLS setup, handshake or certificate
+    API_ERR_AUTH,           // HTTP 401 / 403
+    API_ERR_HTTP_4XX,       // Other client errors
+    API_ERR_HTTP_5XX,       // Server errors (and 408 / 429, which are transient too)
+    API_ERR_PARSE,          // Malformed response or missing field
+    API_ERR_CANCELLED,      // Aborted through the caller's cancellation token
+    API_ERR_CLASS_COUNT
+} api_error_class_t;
+
+// Every call below is bounded by deadline (DNS, connect, handshake and
+// reads included) and returns within NET_CANCEL_SLICE_MS or so of its
+// token being triggered. deadline may be NULL: no bound beyond the 5 s
+// read timeout, not cancellable.
+
+// Creates the HTTP client's locks (connection pool, TLS state, DNS and
+// response caches). Call once from app_main, before any task can make a request
+esp_err_t api_manager_init(void);
+
 // Returns the number of practices found (or -1 on error)
-int api_manager_check_practices(void);
+int api_manager_check_practices(const net_deadline_t* deadline);
 
 // Editor mode: Get user ID from /api/v2/account
 // Returns ESP_OK on success, error code on failure
-esp_err_t api_manager_get_user_id(char* user_id_buffer, size_t buffer_size);
+esp_err_t api_manager_get_user_id(char* user_id_buffer, size_t buffer_size, const net_deadline_t* deadline);
 
 // Editor mode: Check documents created by user (pending signature)
 // Returns the number of documents found (or -1 on error)
-int api_manager_check_editor_documents(const char* user_id);
+int api_manager_check_editor_documents(const char* user_id, const net_deadline_t* deadline);
+
+// Both mode: signer practices and editor documents, pipelined on one connection
+// Returns ESP_OK when both counts were read; a failed count is set to -1
+esp_err_t api_manager_check_both(const char* user_id, int* signer_count, int* editor_count,
+                                 const net_deadline_t* deadline);
+
+// Signer mode with extra accounts: counts[0] = configured account, then
+// extra_accounts in order (-1 = that account failed). All accounts share the
+// keep-alive connection and are pipelined a few at a time.
+// Returns the sum of the counts read, or -1 if every account failed
+int api_manager_check_accounts(int* counts, int max_counts, const net_deadline_t* deadline);
+
+// Brings the pending-document list of kind (titles and dates, see
+// doc_list.h) up to date with the last count poll, reading only the pages
+// that changed; nothing is requested when the list is current. user_id is
+// needed for DOC_LIST_EDITOR. Returns ESP_OK, ESP_ERR_TIMEOUT when the
+// deadline passed or was cancelled, ESP_FAIL otherwise (the cached list is kept)
+esp_err_t api_manager_fetch_documents(doc_list_kind_t kind, const char *user_id,
+                                      const net_deadline_t *deadline);
+
+// Push transport events (see api_manager_push_stream)
+typedef enum {
+    API_PUSH_OPEN = 0,      // Stream / long-poll established
+    API_PUSH_COUNT,         // An event carried the pending count
+    API_PUSH_CHANGED,       // An event announced a change without a count
+    API_PUSH_IDLE,          // Nothing received for a while (about once a second)
+} api_push_event_t;
+
+// Called from the streaming task; return false to close the stream
+typedef bool (*api_push_cb_t)(api_push_event_t event, int count, void* ctx);
+
+// Holds push_url open (SSE stream or long-poll) and reports events until the
+// stream ends, fails, cb returns false or deadline is cancelled. Blocks:
+// call from its own task. Returns ESP_OK when stopped or closed by the
+// server, ESP_ERR_NOT_SUPPORTED when the endpoint is missing or does not
+// hold requests, ESP_FAIL otherwise
+esp_err_t api_manager_push_stream(const char* url, api_push_cb_t cb, void* ctx,
+                                  const net_deadline_t* deadline);
+
+// Opens (DNS, TCP, TLS) a keep-alive connection to the selected endpoint
+// ahead of the next request and leaves it idle in the pool; a live one is
+// kept as is
+esp_err_t api_manager_preconnect(const net_deadline_t* deadline);
+
+// How long the best idle connection to the selected endpoint stays reusable (0 = none)
+uint32_t api_manager_warm_ms(void);
+
+// Background health check of a fallback endpoint not used for a while
+// (ESP_ERR_NOT_FOUND when none is due); the outcome feeds its health
+esp_err_t api_manager_probe_endpoint(const net_deadline_t* deadline);
+
+// After a failed call on this task: true when the failure was the
+// endpoint's (DNS, connect, TLS, 5xx) and another endpoint is now selected,
+// i.e. running the call again would go elsewhere
+bool api_manager_failover_ready(void);
 
 // Check for firmware updates on AskMeSign server
-// Returns ESP_OK if update available, ESP_ERR_NOT_FOUND if no update
-esp_err_t api_manager_check_firmware_updates(const char* current_version, ota_version_info_t* update_info);
+// Returns ESP_OK if update available, ESP_ERR_NOT_FOUND if no update,
+// ESP_ERR_TIMEOUT when the deadline passed or the check was cancelled
+esp_err_t api_manager_check_firmware_updates(const char* current_version, ota_version_info_t* update_info,
+                                             const net_deadline_t* deadline);
+
+// Generic GET through the AskMeSign client (pool, transport, decoding of
+// compressed bodies, metrics), for other hosts: the GitHub release check
+// and the OTA download. https:// URLs only; up to 3 redirects are followed.
+typedef struct {
+    const char *url;            // https://host[:port]/path
+    const char *headers;        // Extra CRLF-terminated header lines (may be NULL)
+    bool identity;              // Do not offer compressed bodies (e.g. firmware images)
+    const char *metrics_label;  // Name of the request in the latency summary (NULL = not timed)
+} api_http_request_t;
+
+typedef struct api_http_stream api_http_stream_t;
+
+// Sends req and reads the response headers, whatever the status. Returns
+// ESP_OK with *stream to read and close, ESP_ERR_TIMEOUT when deadline
+// passed or was cancelled, ESP_FAIL (or ESP_ERR_NO_MEM, ESP_ERR_INVALID_ARG)
+// otherwise. deadline also bounds every read of the stream.
+esp_err_t api_manager_http_open(const api_http_request_t *req, api_http_stream_t **stream,
+                                const net_deadline_t *deadline);
+
+int api_manager_http_status(const api_http_stream_t *stream);
+
+// Content-Length as sent (-1 = none; the compressed size if the body is)
+int64_t api_manager_http_content_length(const api_http_stream_t *stream);
+
+// ETag and Last-Modified of the response ("" when missing)
+void api_manager_http_validators(const api_http_stream_t *stream, char *etag, size_t etag_size,
+                                 char *last_modified, size_t last_modified_size);
+
+// Content-Range of a 206 answer: first byte sent and whole length (-1 when
+// sent as "*"). False when the answer has none
+bool api_manager_http_content_range(const api_http_stream_t *stream, int64_t *start, int64_t *total);
+
+// Reads up to len decoded body bytes. Returns bytes read, 0 at the end of
+// the body, <0 on error (the stream stays failed)
+int api_manager_http_read(api_http_stream_t *stream, void *buf, size_t len);
+
+// Drains a short unread body to keep the connection, else drops it; frees stream
+void api_manager_http_close(api_http_stream_t *stream);
+
+// Backend of the connections opened from now on (api_transport.h): NULL =
+// TLS, &api_loopback_transport = recorded responses (api_loopback.h).
+// Idle pooled connections are closed.
+struct api_transport_ops;
+void api_manager_set_transport(const struct api_transport_ops *ops);
+
+// Failure class of the last AskMeSign call (API_ERR_NONE after a success);
+// http_status (may be NULL) receives the HTTP status, 0 if none was received
+api_error_class_t api_manager_last_error(int *http_status);
+
+const char *api_manager_error_name(api_error_class_t cls);
+
+// Logs the keep-alive pool counters (new connections vs. requests served on
+// a reused one) and the TLS handshakes (full = certificate exchanged,
+// resumed = abbreviated). Part of api_metrics_log_summary()
+void api_manager_log_summary(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,290 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_metrics.c                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Per-phase latency metrics for API requests  *
+ ************************************************************/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+
+#include "api_metrics.h"
+#include "api_endpoints.h"
+#include "api_manager.h"
+#include "dns_cache.h"
+#include "poll_scheduler.h"
+
+static const char *TAG = "API_Metrics";
+
+#define API_METRICS_LOG_EVERY     20      // Requests between two summary tables
+
+// Bucket upper bounds in microseconds (last bucket is open-ended)
+static const uint32_t s_bucket_us[API_METRICS_BUCKETS] = {
+    250, 500, 1000, 2000, 3000, 5000, 7500, 10000, 15000, 20000,
+    30000, 50000, 75000, 100000, 150000, 200000, 300000, 500000, 750000, 1000000,
+    1500000, 2000000, 3000000, 5000000, 7500000, 10000000, 15000000, 20000000, 30000000, UINT32_MAX
+};
+
+static const char *const s_phase_names[API_PHASE_COUNT] = {
+    [API_PHASE_DNS]     = "dns",
+    [API_PHASE_CONNECT] = "connect",
+    [API_PHASE_TLS]     = "tls",
+    [API_PHASE_TTFB]    = "ttfb",
+    [API_PHASE_BODY]    = "body",
+    [API_PHASE_PARSE]   = "parse",
+    [API_PHASE_TOTAL]   = "total",
+};
+
+// One epoch of samples for a phase
+typedef struct {
+    uint16_t buckets[API_METRICS_BUCKETS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} api_metrics_epoch_t;
+
+// Two epochs per phase: once the current one holds API_METRICS_WINDOW
+// samples it becomes the previous one, so the figures always describe the
+// last 64..128 requests in a fixed amount of RAM
+typedef struct {
+    api_metrics_epoch_t epoch[2];
+    uint8_t current;
+} api_metrics_phase_t;
+
+static api_metrics_phase_t s_phases[API_PHASE_COUNT];
+static api_request_stats_t s_requests;
+static portMUX_TYPE s_metrics_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t api_metrics_free_heap(void)
+{
+    return (uint32_t)heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+static void api_metrics_sample_heap(api_metrics_req_t *req)
+{
+    uint32_t free_now = api_metrics_free_heap();
+    if (free_now < req->heap_low) {
+        req->heap_low = free_now;
+    }
+}
+
+// Caller holds s_metrics_lock
+static void api_metrics_record(api_phase_t phase, uint32_t us)
+{
+    api_metrics_phase_t *p = &s_phases[phase];
+    api_metrics_epoch_t *e = &p->epoch[p->current];
+
+    if (e->count >= API_METRICS_WINDOW) {
+        p->current ^= 1;
+        e = &p->epoch[p->current];
+        memset(e, 0, sizeof(*e));
+    }
+
+    int b = 0;
+    while (b < API_METRICS_BUCKETS - 1 && us > s_bucket_us[b]) {
+        b++;
+    }
+    e->buckets[b]++;
+    if (e->count == 0 || us < e->min_us) {
+        e->min_us = us;
+    }
+    if (us > e->max_us) {
+        e->max_us = us;
+    }
+    e->sum_us += us;
+    e->count++;
+}
+
+void api_metrics_begin(api_metrics_req_t *req, const char *name)
+{
+    memset(req, 0, sizeof(*req));
+    req->name = name;
+    req->start_us = esp_timer_get_time();
+    req->mark_us = req->start_us;
+    req->heap_start = api_metrics_free_heap();
+    req->heap_low = req->heap_start;
+}
+
+void api_metrics_phase(api_metrics_req_t *req, api_phase_t phase)
+{
+    if (req == NULL || phase >= API_PHASE_COUNT) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    api_metrics_add(req, phase, (uint32_t)(now - req->mark_us));
+    req->mark_us = now;
+}
+
+void api_metrics_add(api_metrics_req_t *req, api_phase_t phase, uint32_t duration_us)
+{
+    if (req == NULL || phase >= API_PHASE_COUNT) {
+        return;
+    }
+    req->phase_us[phase] += duration_us;
+    req->phases_seen |= (1u << phase);
+    api_metrics_sample_heap(req);
+}
+
+void api_metrics_mark(api_metrics_req_t *req)
+{
+    if (req != NULL) {
+        req->mark_us = esp_timer_get_time();
+    }
+}
+
+void api_metrics_add_bytes(api_metrics_req_t *req, uint32_t bytes_in, uint32_t bytes_out)
+{
+    if (req != NULL) {
+        req->bytes_in += bytes_in;
+        req->bytes_out += bytes_out;
+    }
+}
+
+void api_metrics_add_saved(api_metrics_req_t *req, uint32_t wire_bytes, uint32_t decoded_bytes)
+{
+    if (req != NULL && decoded_bytes > wire_bytes) {
+        req->bytes_saved += decoded_bytes - wire_bytes;
+    }
+}
+
+void api_metrics_end(api_metrics_req_t *req, bool ok)
+{
+    bool log_summary;
+
+    if (req == NULL) {
+        return;
+    }
+    api_metrics_sample_heap(req);
+    req->phase_us[API_PHASE_TOTAL] = (uint32_t)(esp_timer_get_time() - req->start_us);
+    req->phases_seen |= (1u << API_PHASE_TOTAL);
+    uint32_t heap_peak = req->heap_start - req->heap_low;
+
+    taskENTER_CRITICAL(&s_metrics_lock);
+    for (int i = 0; i < API_PHASE_COUNT; i++) {
+        if (req->phases_seen & (1u << i)) {
+            api_metrics_record((api_phase_t)i, req->phase_us[i]);
+        }
+    }
+    s_requests.requests++;
+    if (!ok) {
+        s_requests.failures++;
+    }
+    s_requests.last_bytes_in = req->bytes_in;
+    s_requests.last_bytes_out = req->bytes_out;
+    s_requests.total_bytes_in += req->bytes_in;
+    s_requests.total_bytes_out += req->bytes_out;
+    s_requests.total_bytes_saved += req->bytes_saved;
+    s_requests.last_heap_peak = heap_peak;
+    if (heap_peak > s_requests.max_heap_peak) {
+        s_requests.max_heap_peak = heap_peak;
+    }
+    log_summary = (s_requests.requests % API_METRICS_LOG_EVERY) == 0;
+    taskEXIT_CRITICAL(&s_metrics_lock);
+
+    ESP_LOGI(TAG, "⏱️ %s %s: dns %lu, connect %lu, tls %lu, ttfb %lu, body %lu, parse %lu, total %lu ms | in %lu B (saved %lu B), out %lu B, heap peak %lu B",
+             req->name ? req->name : "request", ok ? "ok" : "FAILED",
+             req->phase_us[API_PHASE_DNS] / 1000, req->phase_us[API_PHASE_CONNECT] / 1000,
+             req->phase_us[API_PHASE_TLS] / 1000, req->phase_us[API_PHASE_TTFB] / 1000,
+             req->phase_us[API_PHASE_BODY] / 1000, req->phase_us[API_PHASE_PARSE] / 1000,
+             req->phase_us[API_PHASE_TOTAL] / 1000, req->bytes_in, req->bytes_saved, req->bytes_out, heap_peak);
+
+    if (log_summary) {
+        api_metrics_log_summary();
+    }
+}
+
+bool api_metrics_get_phase(api_phase_t phase, api_phase_stats_t *stats)
+{
+    uint32_t buckets[API_METRICS_BUCKETS] = {0};
+    uint64_t sum = 0;
+
+    if (phase >= API_PHASE_COUNT || stats == NULL) {
+        return false;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    taskENTER_CRITICAL(&s_metrics_lock);
+    for (int i = 0; i < 2; i++) {
+        const api_metrics_epoch_t *e = &s_phases[phase].epoch[i];
+        if (e->count == 0) {
+            continue;
+        }
+        if (stats->count == 0 || e->min_us < stats->min_us) {
+            stats->min_us = e->min_us;
+        }
+        if (e->max_us > stats->max_us) {
+            stats->max_us = e->max_us;
+        }
+        stats->count += e->count;
+        sum += e->sum_us;
+        for (int b = 0; b < API_METRICS_BUCKETS; b++) {
+            buckets[b] += e->buckets[b];
+        }
+    }
+    taskEXIT_CRITICAL(&s_metrics_lock);
+
+    if (stats->count == 0) {
+        return false;
+    }
+    stats->avg_us = (uint32_t)(sum / stats->count);
+
+    uint32_t target = (stats->count * 95 + 99) / 100;
+    uint32_t seen = 0;
+    for (int b = 0; b < API_METRICS_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= target) {
+            stats->p95_us = s_bucket_us[b];
+            break;
+        }
+    }
+    if (stats->p95_us > stats->max_us) {
+        stats->p95_us = stats->max_us;
+    }
+    return true;
+}
+
+void api_metrics_get_requests(api_request_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_metrics_lock);
+    *stats = s_requests;
+    taskEXIT_CRITICAL(&s_metrics_lock);
+}
+
+const char *api_metrics_phase_name(api_phase_t phase)
+{
+    return (phase < API_PHASE_COUNT) ? s_phase_names[phase] : "?";
+}
+
+void api_metrics_log_summary(void)
+{
+    api_phase_stats_t st;
+    api_request_stats_t req;
+
+    api_metrics_get_requests(&req);
+    ESP_LOGI(TAG, "📊 API latency (last %d-%d samples per phase, ms):", API_METRICS_WINDOW, API_METRICS_WINDOW * 2);
+    for (int i = 0; i < API_PHASE_COUNT; i++) {
+        if (!api_metrics_get_phase((api_phase_t)i, &st)) {
+            continue;
+        }
+        ESP_LOGI(TAG, "  %-8s n=%-4lu min %lu.%01lu  avg %lu.%01lu  p95 %lu.%01lu  max %lu.%01lu",
+                 s_phase_names[i], st.count,
+                 st.min_us / 1000, (st.min_us % 1000) / 100,
+                 st.avg_us / 1000, (st.avg_us % 1000) / 100,
+                 st.p95_us / 1000, (st.p95_us % 1000) / 100,
+                 st.max_us / 1000, (st.max_us % 1000) / 100);
+    }
+    ESP_LOGI(TAG, "  requests %lu (failed %lu), bytes in %llu (saved %llu) / out %llu, heap peak last %lu B max %lu B",
+             req.requests, req.failures, req.total_bytes_in, req.total_bytes_saved, req.total_bytes_out,
+             req.last_heap_peak, req.max_heap_peak);
+    api_manager_log_summary();
+    dns_cache_log_summary();
+    poll_scheduler_log_summary();
+    api_endpoints_log_summary();
+}
@@ -0,0 +1,102 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_metrics.h                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Per-phase latency metrics for API requests  *
+ ************************************************************/
+
+#ifndef API_METRICS_H
+#define API_METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define API_METRICS_WINDOW        64      // Samples per epoch; stats cover the last 1-2 epochs
+#define API_METRICS_BUCKETS       30
+
+// Phases of an outbound HTTPS request
+typedef enum {
+    API_PHASE_DNS = 0,      // Name resolution
+    API_PHASE_CONNECT,      // TCP connect
+    API_PHASE_TLS,          // TLS handshake
+    API_PHASE_TTFB,         // Request written -> response headers parsed
+    API_PHASE_BODY,         // Body transfer (excluding parse time)
+    API_PHASE_PARSE,        // JSON decoding
+    API_PHASE_TOTAL,        // Whole request
+    API_PHASE_COUNT
+} api_phase_t;
+
+// Rolling statistics of one phase (microseconds)
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p95_us;        // Upper bound of the histogram bucket holding the 95th percentile
+    uint32_t max_us;
+} api_phase_stats_t;
+
+// Per-request counters (application bytes, heap drop seen at phase boundaries)
+typedef struct {
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t last_bytes_in;
+    uint32_t last_bytes_out;
+    uint64_t total_bytes_in;
+    uint64_t total_bytes_out;
+    uint64_t total_bytes_saved;     // Compressed bodies: decoded size minus wire size
+    uint32_t last_heap_peak;
+    uint32_t max_heap_peak;
+} api_request_stats_t;
+
+// Timing context of one request (lives on the caller's stack)
+typedef struct {
+    const char *name;
+    int64_t start_us;
+    int64_t mark_us;
+    uint32_t phase_us[API_PHASE_COUNT];
+    uint32_t phases_seen;   // Bit per phase that actually ran in this request
+    uint32_t bytes_in;
+    uint32_t bytes_out;
+    uint32_t bytes_saved;
+    uint32_t heap_start;
+    uint32_t heap_low;
+} api_metrics_req_t;
+
+// Starts timing a request
+void api_metrics_begin(api_metrics_req_t *req, const char *name);
+
+// Closes the span since the previous mark and records it under phase
+void api_metrics_phase(api_metrics_req_t *req, api_phase_t phase);
+
+// Records an externally measured duration under phase (e.g. accumulated parse time)
+void api_metrics_add(api_metrics_req_t *req, api_phase_t phase, uint32_t duration_us);
+
+// Restarts the span without recording anything
+void api_metrics_mark(api_metrics_req_t *req);
+
+void api_metrics_add_bytes(api_metrics_req_t *req, uint32_t bytes_in, uint32_t bytes_out);
+
+// Records a compressed body: wire bytes received and bytes it decoded to
+void api_metrics_add_saved(api_metrics_req_t *req, uint32_t wire_bytes, uint32_t decoded_bytes);
+
+// Finishes the request, records the total and logs a one-line breakdown
+void api_metrics_end(api_metrics_req_t *req, bool ok);
+
+// Runtime readout (works with any log level)
+bool api_metrics_get_phase(api_phase_t phase, api_phase_stats_t *stats);
+void api_metrics_get_requests(api_request_stats_t *stats);
+const char *api_metrics_phase_name(api_phase_t phase);
+
+// Logs the per-phase table at INFO level
+void api_metrics_log_summary(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // API_METRICS_H
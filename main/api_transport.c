@@ -0,0 +1,714 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_transport.c                                    *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: TLS backend of the HTTP client              *
+ ************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "esp_log.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/error.h"
+#ifdef CONFIG_MBEDTLS_SSL_PROTO_TLS1_3
+    #include "psa/crypto.h"
+#endif
+#include "esp_crt_bundle.h"
+#include "mbedtls/x509_crt.h"
+#include "lwip/sockets.h"
+#include "dns_cache.h"
+#include "device_config.h"
+#include "http2.h"
+
+#include "api_transport.h"
+
+static const char *TAG = "API_Transport";
+
+// Bench testing only (see PUSH_MODE_GUIDE.md): 1 lets the HTTP client
+// talk to a local stand-in server with a self-signed certificate
+#define API_TLS_ALLOW_UNVERIFIED   0
+
+// TLS profile of every connection (TLS_PROFILE_GUIDE.md).
+// BUNDLE: full Mozilla bundle, mbedTLS default suites and curves.
+// PINNED: only the roots in certs/api_roots.pem, ECDHE-ECDSA suites and
+// x25519/secp256r1 first: shorter handshakes, but every host must chain
+// to one of those roots.
+#define API_TLS_PROFILE_BUNDLE     0
+#define API_TLS_PROFILE_PINNED     1
+#define API_TLS_PROFILE            API_TLS_PROFILE_BUNDLE
+
+// Persistent TLS client state, kept across polls so that DRBG seeding,
+// config setup and cert bundle attach happen once, and later handshakes
+// can resume the saved session instead of doing a full handshake.
+typedef struct {
+    bool initialized;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_ssl_config conf;            // AskMeSign endpoints: h2 offered, sessions resumed
+    mbedtls_ssl_config conf_foreign;    // HTTP/1.1 only: other hosts, and AskMeSign once h2 is off
+    mbedtls_ssl_session session;
+#if API_TLS_PROFILE == API_TLS_PROFILE_PINNED
+    mbedtls_x509_crt ca_chain;          // Parsed once from certs/api_roots.pem
+#endif
+    bool session_valid;
+    char session_host[WEB_SERVER_SIZE]; // Endpoint the saved session belongs to
+    uint32_t full_handshakes;
+    uint32_t resumed_handshakes;
+} api_tls_client_t;
+
+// One TLS connection (api_transport_t.state)
+typedef struct {
+    mbedtls_net_context net;
+    mbedtls_ssl_context ssl;
+    bool established;           // Handshake done: close_notify is due on close
+} api_tls_conn_t;
+
+static api_tls_client_t s_tls = {0};
+// s_tls_mutex guards setup, the saved session, the counters and s_h2_off.
+// Handshakes read the configurations without it (they never change once
+// ready) and draw from the DRBG under s_rng_mutex.
+static SemaphoreHandle_t s_tls_mutex = NULL;
+static SemaphoreHandle_t s_rng_mutex = NULL;
+
+static const char *s_alpn_http1[] = { "http/1.1", NULL };
+#if API_HTTP2
+static const char *s_alpn_h2[] = { HTTP2_ALPN, "http/1.1", NULL };
+static bool s_h2_off = false;                   // Set by a protocol error, until reboot
+#endif
+
+#if API_TLS_PROFILE == API_TLS_PROFILE_PINNED
+// certs/api_roots.pem, embedded by main/CMakeLists.txt (NUL-terminated)
+extern const char api_roots_pem_start[] asm("_binary_api_roots_pem_start");
+extern const char api_roots_pem_end[] asm("_binary_api_roots_pem_end");
+
+// ECDSA first, ECDHE only. AES-GCM and SHA-256/384 run on the AES and SHA
+// engines; the CBC suites are there for older servers.
+static const int s_tls_ciphersuites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    0
+};
+
+// Key exchange groups in order of preference (secp384r1 for servers without the other two)
+static const uint16_t s_tls_groups[] = {
+    MBEDTLS_SSL_IANA_TLS_GROUP_X25519,
+    MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1,
+    MBEDTLS_SSL_IANA_TLS_GROUP_SECP384R1,
+    MBEDTLS_SSL_IANA_TLS_GROUP_NONE
+};
+
+// Signature algorithms offered for the server's key exchange
+static const uint16_t s_tls_sig_algs[] = {
+    MBEDTLS_TLS1_3_SIG_ECDSA_SECP256R1_SHA256,
+    MBEDTLS_TLS1_3_SIG_ECDSA_SECP384R1_SHA384,
+    MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA256,
+    MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA384,
+    MBEDTLS_TLS1_3_SIG_RSA_PKCS1_SHA512,
+    MBEDTLS_TLS1_3_SIG_NONE
+};
+
+static int api_tls_profile_load(void)
+{
+    int ret = mbedtls_x509_crt_parse(&s_tls.ca_chain, (const unsigned char *)api_roots_pem_start,
+                                     api_roots_pem_end - api_roots_pem_start);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Pinned roots unusable: mbedtls_x509_crt_parse returned -0x%x", -ret);
+        return ret;
+    }
+    if (ret > 0) {
+        ESP_LOGW(TAG, "⚠️ %d pinned root(s) could not be parsed", ret);
+    }
+    ESP_LOGI(TAG, "🔐 Pinned TLS profile (ECDSA first)");
+    return 0;
+}
+
+static int api_tls_profile_apply(mbedtls_ssl_config *conf)
+{
+    mbedtls_ssl_conf_ca_chain(conf, &s_tls.ca_chain, NULL);
+    mbedtls_ssl_conf_ciphersuites(conf, s_tls_ciphersuites);
+    mbedtls_ssl_conf_groups(conf, s_tls_groups);
+    mbedtls_ssl_conf_sig_algs(conf, s_tls_sig_algs);
+    return 0;
+}
+
+static void api_tls_profile_release(void)
+{
+    mbedtls_x509_crt_free(&s_tls.ca_chain);
+}
+#else
+static int api_tls_profile_load(void)
+{
+    return 0;
+}
+
+static int api_tls_profile_apply(mbedtls_ssl_config *conf)
+{
+    int ret = esp_crt_bundle_attach(conf);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "esp_crt_bundle_attach returned -0x%x", -ret);
+        return ret;
+    }
+    return 0;
+}
+
+static void api_tls_profile_release(void)
+{
+    // One bundle serves both configurations
+    esp_crt_bundle_detach(&s_tls.conf);
+    esp_crt_bundle_detach(&s_tls.conf_foreign);
+}
+#endif
+
+esp_err_t api_transport_init(void)
+{
+    if (s_tls_mutex != NULL) {
+        return ESP_OK;
+    }
+    s_tls_mutex = xSemaphoreCreateMutex();
+    s_rng_mutex = xSemaphoreCreateMutex();
+    if (s_tls_mutex == NULL || s_rng_mutex == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for the TLS client lock");
+        if (s_tls_mutex != NULL) {
+            vSemaphoreDelete(s_tls_mutex);
+            s_tls_mutex = NULL;
+        }
+        if (s_rng_mutex != NULL) {
+            vSemaphoreDelete(s_rng_mutex);
+            s_rng_mutex = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// RNG of both configurations. The net_worker and push_client handshakes
+// run at the same time, and mbedTLS is built without MBEDTLS_THREADING_C:
+// the shared DRBG must not be updated by two tasks at once
+static int api_tls_random(void *ctx, unsigned char *out, size_t len)
+{
+    xSemaphoreTake(s_rng_mutex, portMAX_DELAY);
+    int ret = mbedtls_ctr_drbg_random(ctx, out, len);
+    xSemaphoreGive(s_rng_mutex);
+    return ret;
+}
+
+// Undoes a failed api_tls_client_prepare(); a ready client is kept until
+// reboot, since open connections point at its configurations. Caller holds
+// s_tls_mutex.
+static void api_tls_client_free(void)
+{
+    if (!s_tls.initialized) {
+        return;
+    }
+    api_tls_profile_release();
+    mbedtls_ssl_session_free(&s_tls.session);
+    mbedtls_ssl_config_free(&s_tls.conf);
+    mbedtls_ssl_config_free(&s_tls.conf_foreign);
+    mbedtls_ctr_drbg_free(&s_tls.ctr_drbg);
+    mbedtls_entropy_free(&s_tls.entropy);
+    s_tls.initialized = false;
+    s_tls.session_valid = false;
+}
+
+// Defaults shared by both configurations
+static int api_tls_conf_setup(mbedtls_ssl_config *conf, const char **alpn)
+{
+    int ret;
+
+    if ((ret = mbedtls_ssl_config_defaults(conf,
+                                           MBEDTLS_SSL_IS_CLIENT,
+                                           MBEDTLS_SSL_TRANSPORT_STREAM,
+                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_config_defaults returned -0x%x", -ret);
+        return ret;
+    }
+
+#if API_TLS_ALLOW_UNVERIFIED
+    ESP_LOGW(TAG, "⚠️ Server certificate NOT enforced (bench test build)");
+    mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+#else
+    mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+#endif
+    mbedtls_ssl_conf_rng(conf, api_tls_random, &s_tls.ctr_drbg);
+    mbedtls_ssl_conf_read_timeout(conf, API_TRANSPORT_READ_TIMEOUT_MS);
+    mbedtls_ssl_conf_alpn_protocols(conf, alpn);
+#ifdef CONFIG_MBEDTLS_CLIENT_SSL_SESSION_TICKETS
+    mbedtls_ssl_conf_session_tickets(conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    return api_tls_profile_apply(conf);
+}
+
+// Lazily creates the DRBG/config objects, once
+static int api_tls_client_prepare(void)
+{
+    int ret;
+
+    if (s_tls_mutex == NULL) {
+        ESP_LOGE(TAG, "❌ api_transport_init() was not called");
+        return -1;
+    }
+    xSemaphoreTake(s_tls_mutex, portMAX_DELAY);
+    if (s_tls.initialized) {
+        xSemaphoreGive(s_tls_mutex);
+        return 0;
+    }
+
+#ifdef CONFIG_MBEDTLS_SSL_PROTO_TLS1_3
+    psa_status_t status = psa_crypto_init();
+    if (status != PSA_SUCCESS) {
+        ESP_LOGE(TAG, "PSA crypto init failed: %d", (int) status);
+        xSemaphoreGive(s_tls_mutex);
+        return -1;
+    }
+#endif
+
+    mbedtls_entropy_init(&s_tls.entropy);
+    mbedtls_ctr_drbg_init(&s_tls.ctr_drbg);
+    mbedtls_ssl_config_init(&s_tls.conf);
+    mbedtls_ssl_config_init(&s_tls.conf_foreign);
+    mbedtls_ssl_session_init(&s_tls.session);
+#if API_TLS_PROFILE == API_TLS_PROFILE_PINNED
+    mbedtls_x509_crt_init(&s_tls.ca_chain);
+#endif
+    s_tls.session_valid = false;
+    s_tls.initialized = true;
+
+    if ((ret = mbedtls_ctr_drbg_seed(&s_tls.ctr_drbg, mbedtls_entropy_func, &s_tls.entropy, NULL, 0)) != 0) {
+        ESP_LOGE(TAG, "mbedtls_ctr_drbg_seed returned -0x%x", -ret);
+        goto fail;
+    }
+    if ((ret = api_tls_profile_load()) != 0) {
+        goto fail;
+    }
+#if API_HTTP2
+    ret = api_tls_conf_setup(&s_tls.conf, s_alpn_h2);
+#else
+    ret = api_tls_conf_setup(&s_tls.conf, s_alpn_http1);
+#endif
+    if (ret != 0 || (ret = api_tls_conf_setup(&s_tls.conf_foreign, s_alpn_http1)) != 0) {
+        goto fail;
+    }
+
+    ESP_LOGI(TAG, "🔐 TLS client config ready");
+    xSemaphoreGive(s_tls_mutex);
+    return 0;
+
+fail:
+    api_tls_client_free();
+    xSemaphoreGive(s_tls_mutex);
+    return ret != 0 ? ret : -1;
+}
+
+bool api_transport_tls_disable_h2(void)
+{
+    bool was_on = false;
+
+#if API_HTTP2
+    // s_tls.conf is never touched again (a handshake may be reading it):
+    // new AskMeSign connections just move to the HTTP/1.1 configuration
+    if (s_tls_mutex != NULL) {
+        xSemaphoreTake(s_tls_mutex, portMAX_DELAY);
+        was_on = !s_h2_off;
+        s_h2_off = true;
+        xSemaphoreGive(s_tls_mutex);
+    }
+#endif
+    return was_on;
+}
+
+void api_transport_tls_get_stats(uint32_t *full_handshakes, uint32_t *resumed_handshakes)
+{
+    uint32_t full = 0;
+    uint32_t resumed = 0;
+
+    if (s_tls_mutex != NULL) {
+        xSemaphoreTake(s_tls_mutex, portMAX_DELAY);
+        full = s_tls.full_handshakes;
+        resumed = s_tls.resumed_handshakes;
+        xSemaphoreGive(s_tls_mutex);
+    }
+    if (full_handshakes) {
+        *full_handshakes = full;
+    }
+    if (resumed_handshakes) {
+        *resumed_handshakes = resumed;
+    }
+}
+
+// Failure class of a wait that gave up because the call ran out of time
+static api_error_class_t api_tls_deadline_error(const api_transport_t *t)
+{
+    return net_deadline_cancelled(t->deadline) ? API_ERR_CANCELLED : API_ERR_CONNECT;
+}
+
+// Drives the handshake step by step so we can tell whether the server sent
+// its certificate (full handshake) or jumped straight to ChangeCipherSpec
+// (abbreviated handshake on a resumed session). Sessions are only kept for
+// AskMeSign endpoints.
+static int api_tls_handshake(api_transport_t *t, mbedtls_ssl_context *ssl, const char *host)
+{
+    int ret = 0;
+    bool saw_certificate = false;
+    bool offered = false;
+
+    // The saved session is shared by the worker and the push stream, and
+    // only offered back to the endpoint that issued it
+    xSemaphoreTake(s_tls_mutex, portMAX_DELAY);
+    if (!t->foreign && s_tls.session_valid && strcmp(s_tls.session_host, host) == 0) {
+        if ((ret = mbedtls_ssl_set_session(ssl, &s_tls.session)) != 0) {
+            ESP_LOGW(TAG, "mbedtls_ssl_set_session returned -0x%x, doing full handshake", -ret);
+        } else {
+            offered = true;
+        }
+    }
+    xSemaphoreGive(s_tls_mutex);
+
+    while (!mbedtls_ssl_is_handshake_over(ssl)) {
+        if (ssl->MBEDTLS_PRIVATE(state) == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+            saw_certificate = true;
+        }
+        ret = mbedtls_ssl_handshake_step(ssl);
+        if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            // A rejected ticket/ID must not be offered again
+            if (offered) {
+                xSemaphoreTake(s_tls_mutex, portMAX_DELAY);
+                s_tls.session_valid = false;
+                xSemaphoreGive(s_tls_mutex);
+            }
+            return ret;
+        }
+    }
+
+    bool full = saw_certificate || !offered;
+    xSemaphoreTake(s_tls_mutex, portMAX_DELAY);
+    if (full) {
+        s_tls.full_handshakes++;
+    } else {
+        s_tls.resumed_handshakes++;
+    }
+    uint32_t full_count = s_tls.full_handshakes;
+    uint32_t resumed_count = s_tls.resumed_handshakes;
+    // Save the (possibly renewed) session for the next poll
+    if (!t->foreign) {
+        mbedtls_ssl_session_free(&s_tls.session);
+        mbedtls_ssl_session_init(&s_tls.session);
+        s_tls.session_valid = (mbedtls_ssl_get_session(ssl, &s_tls.session) == 0);
+        strlcpy(s_tls.session_host, host, sizeof(s_tls.session_host));
+    }
+    xSemaphoreGive(s_tls_mutex);
+
+    ESP_LOGI(TAG, "🤝 TLS handshake %s, %s (full: %lu, resumed: %lu)",
+             full ? "FULL" : "RESUMED", mbedtls_ssl_get_ciphersuite(ssl), full_count, resumed_count);
+    return 0;
+}
+
+// Waits for a non-blocking connect() to complete, in NET_CANCEL_SLICE_MS
+// slices so the deadline and the cancellation token are honoured
+static int api_net_wait_connected(const api_transport_t *t, int fd)
+{
+    uint32_t waited_ms = 0;
+
+    while (true) {
+        if (net_deadline_over(t->deadline)) {
+            return -1;
+        }
+        if (waited_ms >= API_TRANSPORT_CONNECT_TIMEOUT_MS) {
+            return -1;
+        }
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(fd, &wfds);
+        struct timeval tv = { .tv_sec = 0, .tv_usec = NET_CANCEL_SLICE_MS * 1000 };
+        int ready = select(fd + 1, NULL, &wfds, NULL, &tv);
+        if (ready < 0) {
+            return -1;
+        }
+        if (ready > 0) {
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len) != 0 || so_error != 0) {
+                return -1;
+            }
+            return 0;
+        }
+        waited_ms += NET_CANCEL_SLICE_MS;
+    }
+}
+
+// Same as mbedtls_net_connect(), with name resolution and TCP connect
+// timed as separate phases. The socket is left non-blocking: every later
+// wait goes through api_bio_wait()
+static api_error_class_t api_net_connect(const api_transport_t *t, mbedtls_net_context *net,
+                                         const char *host, const char *port,
+                                         api_metrics_req_t *metrics)
+{
+    struct sockaddr_in addr;
+
+    if (net_deadline_over(t->deadline)) {
+        return api_tls_deadline_error(t);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)atoi(port));
+
+    // Served from RAM while the record TTL holds (stale if the resolver is down)
+    esp_err_t err = dns_cache_resolve(host, &addr.sin_addr, t->deadline);
+    api_metrics_phase(metrics, API_PHASE_DNS);
+    if (net_deadline_cancelled(t->deadline)) {
+        return API_ERR_CANCELLED;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "DNS lookup for %s failed (%s)", host, esp_err_to_name(err));
+        return API_ERR_DNS;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return API_ERR_CONNECT;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int ret = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    if (ret != 0 && errno == EINPROGRESS) {
+        ret = api_net_wait_connected(t, fd);
+    }
+    api_metrics_phase(metrics, API_PHASE_CONNECT);
+    if (ret != 0) {
+        close(fd);
+        ESP_LOGE(TAG, "TCP connect to %s:%s failed", host, port);
+        return net_deadline_over(t->deadline) ? api_tls_deadline_error(t) : API_ERR_CONNECT;
+    }
+    net->fd = fd;
+    return API_ERR_NONE;
+}
+
+// Waits until the socket is ready for rw, in NET_CANCEL_SLICE_MS slices so
+// a stuck read or write gives up soon after the deadline passes or the
+// token is triggered. timeout_ms (0 = none) bounds the single wait.
+static int api_bio_wait(api_transport_t *t, uint32_t rw, uint32_t timeout_ms)
+{
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+    uint32_t waited_ms = 0;
+
+    while (true) {
+        if (net_deadline_over(t->deadline)) {
+            return MBEDTLS_ERR_SSL_TIMEOUT;
+        }
+        int ready = mbedtls_net_poll(&c->net, rw, NET_CANCEL_SLICE_MS);
+        if (ready < 0) {
+            return ready;
+        }
+        if (ready > 0) {
+            return 0;
+        }
+        waited_ms += NET_CANCEL_SLICE_MS;
+        if (timeout_ms != 0 && waited_ms >= timeout_ms) {
+            return MBEDTLS_ERR_SSL_TIMEOUT;
+        }
+    }
+}
+
+static int api_bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    api_transport_t *t = (api_transport_t *)ctx;
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+
+    while (true) {
+        int ret = mbedtls_net_send(&c->net, buf, len);
+        if (ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return ret;
+        }
+        if ((ret = api_bio_wait(t, MBEDTLS_NET_POLL_WRITE, API_TRANSPORT_READ_TIMEOUT_MS)) != 0) {
+            return ret;
+        }
+    }
+}
+
+// timeout is the config's read timeout (API_TRANSPORT_READ_TIMEOUT_MS)
+static int api_bio_recv_timeout(void *ctx, unsigned char *buf, size_t len, uint32_t timeout)
+{
+    api_transport_t *t = (api_transport_t *)ctx;
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+
+    while (true) {
+        int ret = mbedtls_net_recv(&c->net, buf, len);
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ) {
+            return ret;
+        }
+        if ((ret = api_bio_wait(t, MBEDTLS_NET_POLL_READ, timeout)) != 0) {
+            return ret;
+        }
+    }
+}
+
+static void api_tls_close(api_transport_t *t)
+{
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+
+    if (c == NULL) {
+        return;
+    }
+    if (c->established) {
+        mbedtls_ssl_close_notify(&c->ssl);
+    }
+    mbedtls_net_free(&c->net);
+    mbedtls_ssl_free(&c->ssl);
+    free(c);
+    t->state = NULL;
+}
+
+static api_error_class_t api_tls_open(api_transport_t *t, const char *host, const char *port,
+                                      api_metrics_req_t *metrics)
+{
+    api_error_class_t cls = API_ERR_TLS;
+    int ret;
+    api_tls_conn_t *c = calloc(1, sizeof(*c));
+
+    if (c == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for a TLS connection");
+        return API_ERR_CONNECT;
+    }
+    t->state = c;
+    mbedtls_net_init(&c->net);
+    mbedtls_ssl_init(&c->ssl);
+
+    if ((ret = api_tls_client_prepare()) != 0) {
+        goto fail;
+    }
+
+    mbedtls_ssl_config *conf = &s_tls.conf_foreign;
+#if API_HTTP2
+    xSemaphoreTake(s_tls_mutex, portMAX_DELAY);
+    if (!t->foreign && !s_h2_off) {
+        conf = &s_tls.conf;
+    }
+    xSemaphoreGive(s_tls_mutex);
+#else
+    if (!t->foreign) {
+        conf = &s_tls.conf;
+    }
+#endif
+    if ((ret = mbedtls_ssl_setup(&c->ssl, conf)) != 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_setup returned -0x%x", -ret);
+        goto fail;
+    }
+
+    if ((ret = mbedtls_ssl_set_hostname(&c->ssl, host)) != 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_set_hostname returned -0x%x", -ret);
+        goto fail;
+    }
+
+    if ((cls = api_net_connect(t, &c->net, host, port, metrics)) != API_ERR_NONE) {
+        goto fail;
+    }
+    cls = API_ERR_TLS;
+
+    mbedtls_ssl_set_bio(&c->ssl, t, api_bio_send, NULL, api_bio_recv_timeout);
+
+    ESP_LOGI(TAG, "Performing the SSL/TLS handshake...");
+    ret = api_tls_handshake(t, &c->ssl, host);
+    api_metrics_phase(metrics, API_PHASE_TLS);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_handshake returned -0x%x", -ret);
+        // A stalled or reset socket is a network problem, not a TLS one
+        if (net_deadline_over(t->deadline)) {
+            cls = api_tls_deadline_error(t);
+        } else if (ret == MBEDTLS_ERR_SSL_TIMEOUT || ret == MBEDTLS_ERR_NET_RECV_FAILED ||
+                   ret == MBEDTLS_ERR_NET_SEND_FAILED || ret == MBEDTLS_ERR_NET_CONN_RESET) {
+            cls = API_ERR_CONNECT;
+        }
+        goto fail;
+    }
+    c->established = true;
+
+    uint32_t flags = mbedtls_ssl_get_verify_result(&c->ssl);
+    if (flags != 0) {
+        ESP_LOGW(TAG, "Certificate verification failed, flags: 0x%lx", flags);
+    } else {
+        ESP_LOGI(TAG, "Certificate verified.");
+    }
+    return API_ERR_NONE;
+
+fail:
+    api_tls_close(t);
+    return cls;
+}
+
+static int api_tls_send(api_transport_t *t, const uint8_t *buf, size_t len)
+{
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+    size_t written = 0;
+
+    while (written < len) {
+        int ret = mbedtls_ssl_write(&c->ssl, buf + written, len - written);
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (ret < 0) {
+            ESP_LOGE(TAG, "mbedtls_ssl_write returned -0x%x", -ret);
+            return ret;
+        }
+        written += ret;
+    }
+    return 0;
+}
+
+static int api_tls_recv(api_transport_t *t, uint8_t *buf, size_t len)
+{
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+    int ret;
+
+    do {
+        ret = mbedtls_ssl_read(&c->ssl, buf, len);
+    } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+    if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        return 0;
+    }
+    if (ret < 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_read returned -0x%x", -ret);
+    }
+    return ret;
+}
+
+// Decrypted bytes already buffered count as readable: the socket may be
+// silent while a record holds more
+static int api_tls_poll(api_transport_t *t, uint32_t timeout_ms)
+{
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+
+    if (mbedtls_ssl_get_bytes_avail(&c->ssl) > 0) {
+        return 1;
+    }
+    return mbedtls_net_poll(&c->net, MBEDTLS_NET_POLL_READ, timeout_ms);
+}
+
+static const char *api_tls_alpn(api_transport_t *t)
+{
+    api_tls_conn_t *c = (api_tls_conn_t *)t->state;
+
+    return mbedtls_ssl_get_alpn_protocol(&c->ssl);
+}
+
+const api_transport_ops_t api_transport_tls = {
+    .name = "tls",
+    .open = api_tls_open,
+    .send = api_tls_send,
+    .recv = api_tls_recv,
+    .poll = api_tls_poll,
+    .alpn = api_tls_alpn,
+    .close = api_tls_close,
+};
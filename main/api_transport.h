@@ -0,0 +1,81 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: api_transport.h                                    *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Byte-stream backends under the HTTP client  *
+ ************************************************************/
+
+#ifndef API_TRANSPORT_H
+#define API_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "api_manager.h"
+#include "api_metrics.h"
+#include "net_deadline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The HTTP client in api_manager.c (pool, HTTP/1.1 and HTTP/2, body
+// decoding, metrics) reads and writes its connections through one of
+// these backends: TLS to a real server (api_transport_tls) or recorded
+// responses served from memory (api_loopback_transport, api_loopback.h).
+// Backends return byte counts, 0 when the peer closed the stream (recv)
+// or a negative mbedTLS-style error code, logged as -0x%x.
+
+// Offers HTTP/2 through ALPN to AskMeSign endpoints (h2 first, http/1.1 as
+// the fallback the server picks if it has no HTTP/2). 0 = HTTP/1.1 only
+#define API_HTTP2                       1
+
+#define API_TRANSPORT_READ_TIMEOUT_MS   5000    // One stalled read or write, whatever the deadline
+#define API_TRANSPORT_CONNECT_TIMEOUT_MS 10000  // TCP connect, even with a later (or no) deadline
+
+typedef struct api_transport api_transport_t;
+
+typedef struct api_transport_ops {
+    const char *name;
+    // Connects (DNS, TCP and TLS, or nothing for the loopback) and times
+    // the phases into metrics (may be NULL). Returns API_ERR_NONE or the
+    // failure class.
+    api_error_class_t (*open)(api_transport_t *t, const char *host, const char *port,
+                              api_metrics_req_t *metrics);
+    // Writes all of buf (0) or fails (<0)
+    int (*send)(api_transport_t *t, const uint8_t *buf, size_t len);
+    // Reads at least one byte, waiting up to the read timeout
+    int (*recv)(api_transport_t *t, uint8_t *buf, size_t len);
+    // >0 when recv would not block, 0 once timeout_ms passed, <0 on error
+    int (*poll)(api_transport_t *t, uint32_t timeout_ms);
+    // Protocol agreed through ALPN (NULL = none, i.e. HTTP/1.1)
+    const char *(*alpn)(api_transport_t *t);
+    // Closes the stream and frees the backend state (nothing to do after a failed open)
+    void (*close)(api_transport_t *t);
+} api_transport_ops_t;
+
+// One connection; set up by the HTTP client, owned by a pool slot
+struct api_transport {
+    const api_transport_ops_t *ops;
+    const net_deadline_t *deadline;     // Of the call using the connection (NULL = unbounded)
+    bool foreign;                       // Not an AskMeSign endpoint: HTTP/1.1 only, no session kept
+    void *state;                        // Backend's
+};
+
+extern const api_transport_ops_t api_transport_tls;
+
+// Creates the TLS backend's lock (called by api_manager_init())
+esp_err_t api_transport_init(void);
+
+// Stops offering h2 through ALPN on new AskMeSign connections (until
+// reboot). True the first time, false when it was already off
+bool api_transport_tls_disable_h2(void);
+
+// Full handshakes (certificate exchanged) and resumed ones so far
+void api_transport_tls_get_stats(uint32_t *full_handshakes, uint32_t *resumed_handshakes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // API_TRANSPORT_H
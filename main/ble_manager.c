@@ -172,6 +172,30 @@ static uint8_t config_char_uuid[16] = {
      return (interval >= 10000 && interval <= 9000000);
  }
 
+// Spread: digits only, 0 (disabled) to 3600000 ms
+static bool validate_spread(const char *spread_str) {
+    if (!spread_str || strlen(spread_str) == 0)
+        return false;
+    for (size_t i = 0; i < strlen(spread_str); i++) {
+        if (!isdigit((unsigned char)spread_str[i])) {
+            return false;
+        }
+    }
+    return atol(spread_str) <= 3600000;
+}
+
+// Pre-connect lead time: digits only, 0 (disabled) to 600000 ms
+static bool validate_preconnect(const char *preconnect_str) {
+    if (!preconnect_str || strlen(preconnect_str) == 0)
+        return false;
+    for (size_t i = 0; i < strlen(preconnect_str); i++) {
+        if (!isdigit((unsigned char)preconnect_str[i])) {
+            return false;
+        }
+    }
+    return atol(preconnect_str) <= 600000;
+}
+
 static bool validate_language(const char *language_str) {
     if (!language_str || strlen(language_str) == 0)
         return false;
@@ -184,7 +208,7 @@ static bool validate_language(const char *language_str) {
     return (lang >= 0 && lang < LANGUAGE_COUNT);
 }
 
-// Working mode: must be "0" (Signer) or "1" (Editor)
+// Working mode: must be "0" (Signer), "1" (Editor) or "2" (Both)
 static bool validate_working_mode(const char *working_mode_str) {
     if (!working_mode_str || strlen(working_mode_str) == 0)
         return false;
@@ -194,7 +218,73 @@ static bool validate_working_mode(const char *working_mode_str) {
         }
     }
     int mode = atoi(working_mode_str);
-    return (mode == 0 || mode == 1);  // 0 = Signer, 1 = Editor
+    return (mode >= 0 && mode <= 2);  // 0 = Signer, 1 = Editor, 2 = Both
+}
+
+// Push URL: empty (polling only) or an https:// URL that fits the buffer
+static bool validate_push_url(const char *url) {
+    if (!url)
+        return false;
+    return strlen(url) == 0 || (validate_url(url) && strlen(url) < WEB_URL_SIZE);
+}
+
+// LAN sharing: "0" (off) or "1" (on)
+static bool validate_lan_share(const char *lan_share_str) {
+    return lan_share_str && (strcmp(lan_share_str, "0") == 0 || strcmp(lan_share_str, "1") == 0);
+}
+
+// Extra accounts: array of up to EXTRA_ACCOUNTS_MAX {"token", "user"} objects.
+// Parsed into out/out_count; the globals are only touched by the caller.
+static bool parse_accounts(const cJSON *accounts_item, device_account_t *out, uint8_t *out_count) {
+    const cJSON *entry;
+
+    *out_count = 0;
+    if (!cJSON_IsArray(accounts_item) || cJSON_GetArraySize(accounts_item) > EXTRA_ACCOUNTS_MAX)
+        return false;
+    cJSON_ArrayForEach(entry, accounts_item) {
+        const cJSON *token = cJSON_GetObjectItemCaseSensitive(entry, "token");
+        const cJSON *user = cJSON_GetObjectItemCaseSensitive(entry, "user");
+        if (!cJSON_IsString(token) || !validate_token(token->valuestring) ||
+            strlen(token->valuestring) == 0 || strlen(token->valuestring) >= API_TOKEN_SIZE ||
+            !cJSON_IsString(user) || strlen(user->valuestring) == 0 ||
+            strlen(user->valuestring) >= ASKMESIGN_USER_SIZE) {
+            return false;
+        }
+        strcpy(out[*out_count].token, token->valuestring);
+        strcpy(out[*out_count].user, user->valuestring);
+        (*out_count)++;
+    }
+    return true;
+}
+
+// Fallback endpoints: array of up to EXTRA_ENDPOINTS_MAX "host" or
+// "host:port" strings (port 443 when omitted). Parsed into out/out_count.
+static bool parse_endpoints(const cJSON *endpoints_item, device_endpoint_t *out, uint8_t *out_count) {
+    const cJSON *entry;
+
+    *out_count = 0;
+    if (!cJSON_IsArray(endpoints_item) || cJSON_GetArraySize(endpoints_item) > EXTRA_ENDPOINTS_MAX)
+        return false;
+    cJSON_ArrayForEach(entry, endpoints_item) {
+        if (!cJSON_IsString(entry))
+            return false;
+        device_endpoint_t *ep = &out[*out_count];
+        const char *colon = strchr(entry->valuestring, ':');
+        size_t host_len = colon ? (size_t)(colon - entry->valuestring) : strlen(entry->valuestring);
+        if (host_len == 0 || host_len >= WEB_SERVER_SIZE)
+            return false;
+        memcpy(ep->host, entry->valuestring, host_len);
+        ep->host[host_len] = '\0';
+        strcpy(ep->port, DEFAULT_WEB_PORT);
+        if (colon && (strlen(colon + 1) >= WEB_PORT_SIZE || !validate_port(colon + 1)))
+            return false;
+        if (colon)
+            strcpy(ep->port, colon + 1);
+        if (!validate_server(ep->host))
+            return false;
+        (*out_count)++;
+    }
+    return true;
 }
 
 /**
@@ -249,8 +339,16 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
         cJSON *updated_token = cJSON_GetObjectItemCaseSensitive(json, "_updated_token");
         cJSON *updated_user = cJSON_GetObjectItemCaseSensitive(json, "_updated_user");
         cJSON *updated_interval = cJSON_GetObjectItemCaseSensitive(json, "_updated_interval");
+        cJSON *updated_interval_min = cJSON_GetObjectItemCaseSensitive(json, "_updated_interval_min");
+        cJSON *updated_interval_max = cJSON_GetObjectItemCaseSensitive(json, "_updated_interval_max");
+        cJSON *updated_spread = cJSON_GetObjectItemCaseSensitive(json, "_updated_spread");
+        cJSON *updated_preconnect = cJSON_GetObjectItemCaseSensitive(json, "_updated_preconnect");
         cJSON *updated_language = cJSON_GetObjectItemCaseSensitive(json, "_updated_language");
         cJSON *updated_working_mode = cJSON_GetObjectItemCaseSensitive(json, "_updated_working_mode");
+        cJSON *updated_accounts = cJSON_GetObjectItemCaseSensitive(json, "_updated_accounts");
+        cJSON *updated_endpoints = cJSON_GetObjectItemCaseSensitive(json, "_updated_endpoints");
+        cJSON *updated_push_url = cJSON_GetObjectItemCaseSensitive(json, "_updated_push_url");
+        cJSON *updated_lan_share = cJSON_GetObjectItemCaseSensitive(json, "_updated_lan_share");
 
         // Extract configuration fields
         cJSON *ssid_item = cJSON_GetObjectItemCaseSensitive(json, "ssid");
@@ -261,8 +359,16 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
         cJSON *token_item = cJSON_GetObjectItemCaseSensitive(json, "token");
         cJSON *user_item = cJSON_GetObjectItemCaseSensitive(json, "user");
         cJSON *interval_item = cJSON_GetObjectItemCaseSensitive(json, "interval");
+        cJSON *interval_min_item = cJSON_GetObjectItemCaseSensitive(json, "interval_min");
+        cJSON *interval_max_item = cJSON_GetObjectItemCaseSensitive(json, "interval_max");
+        cJSON *spread_item = cJSON_GetObjectItemCaseSensitive(json, "spread");
+        cJSON *preconnect_item = cJSON_GetObjectItemCaseSensitive(json, "preconnect");
         cJSON *language_item = cJSON_GetObjectItemCaseSensitive(json, "language");
         cJSON *working_mode_item = cJSON_GetObjectItemCaseSensitive(json, "working_mode");
+        cJSON *accounts_item = cJSON_GetObjectItemCaseSensitive(json, "accounts");
+        cJSON *endpoints_item = cJSON_GetObjectItemCaseSensitive(json, "endpoints");
+        cJSON *push_url_item = cJSON_GetObjectItemCaseSensitive(json, "push_url");
+        cJSON *lan_share_item = cJSON_GetObjectItemCaseSensitive(json, "lan_share");
 
         bool valid = true;
         bool any_field_updated = false;
@@ -356,6 +462,50 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
             }
         }
 
+        if (cJSON_IsTrue(updated_interval_min)) {
+            if (!cJSON_IsString(interval_min_item) || !validate_interval(interval_min_item->valuestring)) {
+                ESP_LOGE(TAG, "❌ Campo 'interval_min' marcato per aggiornamento ma non valido");
+                valid = false;
+            } else {
+                strcpy(api_interval_min_ms, interval_min_item->valuestring);
+                ESP_LOGI(TAG, "✅ Intervallo API minimo aggiornato: %s ms", api_interval_min_ms);
+                any_field_updated = true;
+            }
+        }
+
+        if (cJSON_IsTrue(updated_interval_max)) {
+            if (!cJSON_IsString(interval_max_item) || !validate_interval(interval_max_item->valuestring)) {
+                ESP_LOGE(TAG, "❌ Campo 'interval_max' marcato per aggiornamento ma non valido");
+                valid = false;
+            } else {
+                strcpy(api_interval_max_ms, interval_max_item->valuestring);
+                ESP_LOGI(TAG, "✅ Intervallo API massimo aggiornato: %s ms", api_interval_max_ms);
+                any_field_updated = true;
+            }
+        }
+
+        if (cJSON_IsTrue(updated_spread)) {
+            if (!cJSON_IsString(spread_item) || !validate_spread(spread_item->valuestring)) {
+                ESP_LOGE(TAG, "❌ Campo 'spread' marcato per aggiornamento ma non valido");
+                valid = false;
+            } else {
+                strcpy(poll_spread_ms, spread_item->valuestring);
+                ESP_LOGI(TAG, "✅ Finestra di distribuzione aggiornata: %s ms", poll_spread_ms);
+                any_field_updated = true;
+            }
+        }
+
+        if (cJSON_IsTrue(updated_preconnect)) {
+            if (!cJSON_IsString(preconnect_item) || !validate_preconnect(preconnect_item->valuestring)) {
+                ESP_LOGE(TAG, "❌ Campo 'preconnect' marcato per aggiornamento ma non valido");
+                valid = false;
+            } else {
+                strcpy(preconnect_ms, preconnect_item->valuestring);
+                ESP_LOGI(TAG, "✅ Anticipo di connessione aggiornato: %s ms", preconnect_ms);
+                any_field_updated = true;
+            }
+        }
+
         if (cJSON_IsTrue(updated_language)) {
             if (!cJSON_IsString(language_item) || !validate_language(language_item->valuestring)) {
                 ESP_LOGE(TAG, "❌ Campo 'language' marcato per aggiornamento ma non valido");
@@ -373,8 +523,58 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
                 valid = false;
             } else {
                 strcpy(working_mode, working_mode_item->valuestring);
-                ESP_LOGI(TAG, "✅ Modalità di lavoro aggiornata: %s (%s)", working_mode, 
-                         (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) ? "Editor" : "Signer");
+                ESP_LOGI(TAG, "✅ Modalità di lavoro aggiornata: %s (%s)", working_mode,
+                         device_config_working_mode_name());
+                any_field_updated = true;
+            }
+        }
+
+        if (cJSON_IsTrue(updated_accounts)) {
+            device_account_t parsed[EXTRA_ACCOUNTS_MAX];
+            uint8_t parsed_count;
+            if (!parse_accounts(accounts_item, parsed, &parsed_count)) {
+                ESP_LOGE(TAG, "❌ Campo 'accounts' marcato per aggiornamento ma non valido (max %d)", EXTRA_ACCOUNTS_MAX);
+                valid = false;
+            } else {
+                memcpy(extra_accounts, parsed, sizeof(parsed));
+                extra_account_count = parsed_count;
+                ESP_LOGI(TAG, "✅ Account aggiuntivi aggiornati: %u", extra_account_count);
+                any_field_updated = true;
+            }
+        }
+
+        if (cJSON_IsTrue(updated_endpoints)) {
+            device_endpoint_t parsed[EXTRA_ENDPOINTS_MAX];
+            uint8_t parsed_count;
+            if (!parse_endpoints(endpoints_item, parsed, &parsed_count)) {
+                ESP_LOGE(TAG, "❌ Campo 'endpoints' marcato per aggiornamento ma non valido (max %d)", EXTRA_ENDPOINTS_MAX);
+                valid = false;
+            } else {
+                memcpy(extra_endpoints, parsed, sizeof(parsed));
+                extra_endpoint_count = parsed_count;
+                ESP_LOGI(TAG, "✅ Endpoint alternativi aggiornati: %u", extra_endpoint_count);
+                any_field_updated = true;
+            }
+        }
+
+        if (cJSON_IsTrue(updated_push_url)) {
+            if (!cJSON_IsString(push_url_item) || !validate_push_url(push_url_item->valuestring)) {
+                ESP_LOGE(TAG, "❌ Campo 'push_url' marcato per aggiornamento ma non valido");
+                valid = false;
+            } else {
+                strcpy(push_url, push_url_item->valuestring);
+                ESP_LOGI(TAG, "✅ URL push aggiornato: %s", (strlen(push_url) > 0) ? push_url : "(solo polling)");
+                any_field_updated = true;
+            }
+        }
+
+        if (cJSON_IsTrue(updated_lan_share)) {
+            if (!cJSON_IsString(lan_share_item) || !validate_lan_share(lan_share_item->valuestring)) {
+                ESP_LOGE(TAG, "❌ Campo 'lan_share' marcato per aggiornamento ma non valido");
+                valid = false;
+            } else {
+                strcpy(lan_share, lan_share_item->valuestring);
+                ESP_LOGI(TAG, "✅ Condivisione LAN aggiornata: %s", lan_share);
                 any_field_updated = true;
             }
         }
@@ -420,15 +620,39 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
             if (cJSON_IsTrue(updated_interval)) {
                 nvs_set_str(handle, "api_interval_ms", api_interval_ms);
             }
+            if (cJSON_IsTrue(updated_interval_min)) {
+                nvs_set_str(handle, "api_int_min_ms", api_interval_min_ms);
+            }
+            if (cJSON_IsTrue(updated_interval_max)) {
+                nvs_set_str(handle, "api_int_max_ms", api_interval_max_ms);
+            }
+            if (cJSON_IsTrue(updated_spread)) {
+                nvs_set_str(handle, "poll_spread_ms", poll_spread_ms);
+            }
+            if (cJSON_IsTrue(updated_preconnect)) {
+                nvs_set_str(handle, "preconnect_ms", preconnect_ms);
+            }
             if (cJSON_IsTrue(updated_language)) {
                 nvs_set_str(handle, "language", language);
             }
             if (cJSON_IsTrue(updated_working_mode)) {
                 nvs_set_str(handle, "working_mode", working_mode);
             }
+            if (cJSON_IsTrue(updated_push_url)) {
+                nvs_set_str(handle, "push_url", push_url);
+            }
+            if (cJSON_IsTrue(updated_lan_share)) {
+                nvs_set_str(handle, "lan_share", lan_share);
+            }
             
             nvs_commit(handle);
             nvs_close(handle);
+            if (cJSON_IsTrue(updated_accounts)) {
+                save_accounts_to_nvs();
+            }
+            if (cJSON_IsTrue(updated_endpoints)) {
+                save_endpoints_to_nvs();
+            }
             ESP_LOGI(TAG, "✅ Configurazione parziale aggiornata e salvata in NVS!");
         } else {
             ESP_LOGE(TAG, "❌ Errore apertura NVS per salvataggio parziale: %s", esp_err_to_name(err));
@@ -446,8 +670,16 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
         cJSON *token_item = cJSON_GetObjectItemCaseSensitive(json, "token");
         cJSON *user_item = cJSON_GetObjectItemCaseSensitive(json, "user");
         cJSON *interval_item = cJSON_GetObjectItemCaseSensitive(json, "interval");
+        cJSON *interval_min_item = cJSON_GetObjectItemCaseSensitive(json, "interval_min");
+        cJSON *interval_max_item = cJSON_GetObjectItemCaseSensitive(json, "interval_max");
+        cJSON *spread_item = cJSON_GetObjectItemCaseSensitive(json, "spread");
+        cJSON *preconnect_item = cJSON_GetObjectItemCaseSensitive(json, "preconnect");
         cJSON *language_item = cJSON_GetObjectItemCaseSensitive(json, "language");
         cJSON *working_mode_item = cJSON_GetObjectItemCaseSensitive(json, "working_mode");
+        cJSON *accounts_item = cJSON_GetObjectItemCaseSensitive(json, "accounts");
+        cJSON *endpoints_item = cJSON_GetObjectItemCaseSensitive(json, "endpoints");
+        cJSON *push_url_item = cJSON_GetObjectItemCaseSensitive(json, "push_url");
+        cJSON *lan_share_item = cJSON_GetObjectItemCaseSensitive(json, "lan_share");
 
         bool valid = true;
 
@@ -483,12 +715,59 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
             ESP_LOGE(TAG, "❌ Campo 'interval' mancante");
             valid = false;
         }
+        // Optional: older apps do not send the adaptive polling bounds
+        if (interval_min_item != NULL &&
+            (!cJSON_IsString(interval_min_item) || !validate_interval(interval_min_item->valuestring))) {
+            ESP_LOGE(TAG, "❌ Campo 'interval_min' non valido");
+            valid = false;
+        }
+        if (interval_max_item != NULL &&
+            (!cJSON_IsString(interval_max_item) || !validate_interval(interval_max_item->valuestring))) {
+            ESP_LOGE(TAG, "❌ Campo 'interval_max' non valido");
+            valid = false;
+        }
+        if (spread_item != NULL &&
+            (!cJSON_IsString(spread_item) || !validate_spread(spread_item->valuestring))) {
+            ESP_LOGE(TAG, "❌ Campo 'spread' non valido");
+            valid = false;
+        }
+        if (preconnect_item != NULL &&
+            (!cJSON_IsString(preconnect_item) || !validate_preconnect(preconnect_item->valuestring))) {
+            ESP_LOGE(TAG, "❌ Campo 'preconnect' non valido");
+            valid = false;
+        }
         if (!cJSON_IsString(language_item) || !validate_language(language_item->valuestring)) {
             ESP_LOGE(TAG, "❌ Campo 'language' mancante o non valido (0=EN, 1=IT, 2=FR, 3=ES)");
             valid = false;
         }
         if (!cJSON_IsString(working_mode_item) || !validate_working_mode(working_mode_item->valuestring)) {
-            ESP_LOGE(TAG, "❌ Campo 'working_mode' mancante o non valido (0=Signer, 1=Editor)");
+            ESP_LOGE(TAG, "❌ Campo 'working_mode' mancante o non valido (0=Signer, 1=Editor, 2=Both)");
+            valid = false;
+        }
+        // Optional: no extra accounts when absent
+        device_account_t parsed_accounts[EXTRA_ACCOUNTS_MAX];
+        uint8_t parsed_account_count = 0;
+        if (accounts_item != NULL && !parse_accounts(accounts_item, parsed_accounts, &parsed_account_count)) {
+            ESP_LOGE(TAG, "❌ Campo 'accounts' non valido (max %d oggetti {token, user})", EXTRA_ACCOUNTS_MAX);
+            valid = false;
+        }
+        // Optional: web_server only when absent
+        device_endpoint_t parsed_endpoints[EXTRA_ENDPOINTS_MAX];
+        uint8_t parsed_endpoint_count = 0;
+        if (endpoints_item != NULL && !parse_endpoints(endpoints_item, parsed_endpoints, &parsed_endpoint_count)) {
+            ESP_LOGE(TAG, "❌ Campo 'endpoints' non valido (max %d stringhe \"host[:porta]\")", EXTRA_ENDPOINTS_MAX);
+            valid = false;
+        }
+        // Optional: polling only when absent
+        if (push_url_item != NULL &&
+            (!cJSON_IsString(push_url_item) || !validate_push_url(push_url_item->valuestring))) {
+            ESP_LOGE(TAG, "❌ Campo 'push_url' non valido (vuoto o https://...)");
+            valid = false;
+        }
+        // Optional: off when absent
+        if (lan_share_item != NULL &&
+            (!cJSON_IsString(lan_share_item) || !validate_lan_share(lan_share_item->valuestring))) {
+            ESP_LOGE(TAG, "❌ Campo 'lan_share' non valido (0 o 1)");
             valid = false;
         }
         
@@ -507,15 +786,25 @@ static void ble_process_received_data(uint8_t *data, uint16_t length)
         strcpy(api_token, token_item->valuestring);
         strcpy(askmesign_user, user_item->valuestring);
         strcpy(api_interval_ms, interval_item->valuestring);
+        strcpy(api_interval_min_ms, interval_min_item ? interval_min_item->valuestring : DEFAULT_API_INTERVAL_MIN);
+        strcpy(api_interval_max_ms, interval_max_item ? interval_max_item->valuestring : DEFAULT_API_INTERVAL_MAX);
+        strcpy(poll_spread_ms, spread_item ? spread_item->valuestring : DEFAULT_POLL_SPREAD_MS);
+        strcpy(preconnect_ms, preconnect_item ? preconnect_item->valuestring : DEFAULT_PRECONNECT_MS);
         strcpy(language, language_item->valuestring);
         strcpy(working_mode, working_mode_item->valuestring);
+        memcpy(extra_accounts, parsed_accounts, sizeof(parsed_accounts));
+        extra_account_count = parsed_account_count;
+        memcpy(extra_endpoints, parsed_endpoints, sizeof(parsed_endpoints));
+        extra_endpoint_count = parsed_endpoint_count;
+        strcpy(push_url, push_url_item ? push_url_item->valuestring : DEFAULT_PUSH_URL);
+        strcpy(lan_share, lan_share_item ? lan_share_item->valuestring : DEFAULT_LAN_SHARE);
         // Save the updated configuration to NVS (traditional mode only)
         save_config_to_nvs();
         ESP_LOGI(TAG, "✅ Configurazione completa aggiornata e salvata in NVS!");
     }
 
-    ESP_LOGI(TAG, "📝 Working Mode configured: %s (%s)", working_mode, 
-             (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) ? "Editor" : "Signer");
+    ESP_LOGI(TAG, "📝 Working Mode configured: %s (%s)", working_mode,
+             device_config_working_mode_name());
  
      // Update language setting
      language_t new_lang = (language_t)atoi(language);
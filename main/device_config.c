@@ -25,8 +25,133 @@ char web_url[WEB_URL_SIZE];
 char api_token[API_TOKEN_SIZE];
 char askmesign_user[ASKMESIGN_USER_SIZE];
 char api_interval_ms[API_INTERVAL_MS_SIZE];
+char api_interval_min_ms[API_INTERVAL_MS_SIZE];
+char api_interval_max_ms[API_INTERVAL_MS_SIZE];
+char poll_spread_ms[API_INTERVAL_MS_SIZE];
+char preconnect_ms[API_INTERVAL_MS_SIZE];
 char language[LANGUAGE_SIZE];
 char working_mode[WORKING_MODE_SIZE];
+char push_url[WEB_URL_SIZE];
+char lan_share[LAN_SHARE_SIZE];
+device_account_t extra_accounts[EXTRA_ACCOUNTS_MAX];
+uint8_t extra_account_count = 0;
+device_endpoint_t extra_endpoints[EXTRA_ENDPOINTS_MAX];
+uint8_t extra_endpoint_count = 0;
+
+// Packed NVS layout of the extra accounts: a count byte followed by
+// "token\0user\0" for each account, so unused slots and the unused tail
+// of each field take no flash
+#define ACCOUNTS_BLOB_SIZE   (1 + EXTRA_ACCOUNTS_MAX * (API_TOKEN_SIZE + ASKMESIGN_USER_SIZE))
+
+static size_t accounts_pack(uint8_t *blob)
+{
+    size_t len = 1;
+
+    blob[0] = extra_account_count;
+    for (uint8_t i = 0; i < extra_account_count; i++) {
+        size_t n = strlen(extra_accounts[i].token) + 1;
+        memcpy(blob + len, extra_accounts[i].token, n);
+        len += n;
+        n = strlen(extra_accounts[i].user) + 1;
+        memcpy(blob + len, extra_accounts[i].user, n);
+        len += n;
+    }
+    return len;
+}
+
+// Copies the next NUL-terminated string of the blob; false if it is missing or too long
+static bool accounts_unpack_str(const uint8_t *blob, size_t len, size_t *pos, char *dst, size_t size)
+{
+    const uint8_t *end = memchr(blob + *pos, '\0', len - *pos);
+    if (end == NULL || (size_t)(end - (blob + *pos)) >= size) {
+        return false;
+    }
+    memcpy(dst, blob + *pos, end - (blob + *pos) + 1);
+    *pos = (end - blob) + 1;
+    return true;
+}
+
+static void accounts_unpack(const uint8_t *blob, size_t len)
+{
+    size_t pos = 1;
+    uint8_t count = (len > 0) ? blob[0] : 0;
+
+    extra_account_count = 0;
+    if (count > EXTRA_ACCOUNTS_MAX) {
+        count = EXTRA_ACCOUNTS_MAX;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        device_account_t *acc = &extra_accounts[i];
+        if (!accounts_unpack_str(blob, len, &pos, acc->token, sizeof(acc->token)) ||
+            !accounts_unpack_str(blob, len, &pos, acc->user, sizeof(acc->user))) {
+            ESP_LOGW(TAG, "Truncated accounts record, keeping %u account(s)", extra_account_count);
+            return;
+        }
+        extra_account_count++;
+    }
+}
+
+static void accounts_store(nvs_handle_t handle)
+{
+    static uint8_t blob[ACCOUNTS_BLOB_SIZE];    // Off the BLE host task stack
+
+    if (extra_account_count == 0) {
+        nvs_erase_key(handle, NVS_EXTRA_ACCOUNTS);
+        return;
+    }
+    nvs_set_blob(handle, NVS_EXTRA_ACCOUNTS, blob, accounts_pack(blob));
+}
+
+// Same packed layout for the fallback endpoints: count byte, then
+// "host\0port\0" for each endpoint
+#define ENDPOINTS_BLOB_SIZE  (1 + EXTRA_ENDPOINTS_MAX * (WEB_SERVER_SIZE + WEB_PORT_SIZE))
+
+static size_t endpoints_pack(uint8_t *blob)
+{
+    size_t len = 1;
+
+    blob[0] = extra_endpoint_count;
+    for (uint8_t i = 0; i < extra_endpoint_count; i++) {
+        size_t n = strlen(extra_endpoints[i].host) + 1;
+        memcpy(blob + len, extra_endpoints[i].host, n);
+        len += n;
+        n = strlen(extra_endpoints[i].port) + 1;
+        memcpy(blob + len, extra_endpoints[i].port, n);
+        len += n;
+    }
+    return len;
+}
+
+static void endpoints_unpack(const uint8_t *blob, size_t len)
+{
+    size_t pos = 1;
+    uint8_t count = (len > 0) ? blob[0] : 0;
+
+    extra_endpoint_count = 0;
+    if (count > EXTRA_ENDPOINTS_MAX) {
+        count = EXTRA_ENDPOINTS_MAX;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        device_endpoint_t *ep = &extra_endpoints[i];
+        if (!accounts_unpack_str(blob, len, &pos, ep->host, sizeof(ep->host)) ||
+            !accounts_unpack_str(blob, len, &pos, ep->port, sizeof(ep->port))) {
+            ESP_LOGW(TAG, "Truncated endpoints record, keeping %u endpoint(s)", extra_endpoint_count);
+            return;
+        }
+        extra_endpoint_count++;
+    }
+}
+
+static void endpoints_store(nvs_handle_t handle)
+{
+    uint8_t blob[ENDPOINTS_BLOB_SIZE];
+
+    if (extra_endpoint_count == 0) {
+        nvs_erase_key(handle, NVS_EXTRA_ENDPOINTS);
+        return;
+    }
+    nvs_set_blob(handle, NVS_EXTRA_ENDPOINTS, blob, endpoints_pack(blob));
+}
 
 void load_config_from_nvs(void) {
     nvs_handle_t handle;
@@ -43,8 +168,16 @@ void load_config_from_nvs(void) {
         strcpy(api_token, DEFAULT_API_TOKEN);
         strcpy(askmesign_user, DEFAULT_ASKMESIGN_USER);
         strcpy(api_interval_ms, DEFAULT_API_INTERVAL_MS);
+        strcpy(api_interval_min_ms, DEFAULT_API_INTERVAL_MIN);
+        strcpy(api_interval_max_ms, DEFAULT_API_INTERVAL_MAX);
+        strcpy(poll_spread_ms, DEFAULT_POLL_SPREAD_MS);
+        strcpy(preconnect_ms, DEFAULT_PRECONNECT_MS);
         strcpy(language, DEFAULT_LANGUAGE);
         strcpy(working_mode, DEFAULT_WORKING_MODE);
+        strcpy(push_url, DEFAULT_PUSH_URL);
+        strcpy(lan_share, DEFAULT_LAN_SHARE);
+        extra_account_count = 0;
+        extra_endpoint_count = 0;
         
         // Save default configuration to NVS for future use
         save_config_to_nvs();
@@ -104,6 +237,28 @@ void load_config_from_nvs(void) {
         strcpy(api_interval_ms, DEFAULT_API_INTERVAL_MS);
     }
 
+    // Load API Interval floor / ceiling (adaptive polling)
+    len = sizeof(api_interval_min_ms);
+    if (nvs_get_str(handle, NVS_API_INTERVAL_MIN, api_interval_min_ms, &len) != ESP_OK || strlen(api_interval_min_ms) == 0) {
+        strcpy(api_interval_min_ms, DEFAULT_API_INTERVAL_MIN);
+    }
+    len = sizeof(api_interval_max_ms);
+    if (nvs_get_str(handle, NVS_API_INTERVAL_MAX, api_interval_max_ms, &len) != ESP_OK || strlen(api_interval_max_ms) == 0) {
+        strcpy(api_interval_max_ms, DEFAULT_API_INTERVAL_MAX);
+    }
+
+    // Load poll spread window
+    len = sizeof(poll_spread_ms);
+    if (nvs_get_str(handle, NVS_POLL_SPREAD_MS, poll_spread_ms, &len) != ESP_OK || strlen(poll_spread_ms) == 0) {
+        strcpy(poll_spread_ms, DEFAULT_POLL_SPREAD_MS);
+    }
+
+    // Load pre-connect lead time
+    len = sizeof(preconnect_ms);
+    if (nvs_get_str(handle, NVS_PRECONNECT_MS, preconnect_ms, &len) != ESP_OK || strlen(preconnect_ms) == 0) {
+        strcpy(preconnect_ms, DEFAULT_PRECONNECT_MS);
+    }
+
     // Load Language
     len = sizeof(language);
     if (nvs_get_str(handle, NVS_LANGUAGE, language, &len) != ESP_OK || strlen(language) == 0) {
@@ -115,6 +270,36 @@ void load_config_from_nvs(void) {
     if (nvs_get_str(handle, NVS_WORKING_MODE, working_mode, &len) != ESP_OK || strlen(working_mode) == 0) {
         strcpy(working_mode, DEFAULT_WORKING_MODE);
     }
+
+    // Load push URL (empty is a valid value: polling only)
+    len = sizeof(push_url);
+    if (nvs_get_str(handle, NVS_PUSH_URL, push_url, &len) != ESP_OK) {
+        strcpy(push_url, DEFAULT_PUSH_URL);
+    }
+
+    // Load LAN result sharing
+    len = sizeof(lan_share);
+    if (nvs_get_str(handle, NVS_LAN_SHARE, lan_share, &len) != ESP_OK || strlen(lan_share) == 0) {
+        strcpy(lan_share, DEFAULT_LAN_SHARE);
+    }
+
+    // Load extra accounts
+    uint8_t accounts_blob[ACCOUNTS_BLOB_SIZE];
+    len = sizeof(accounts_blob);
+    if (nvs_get_blob(handle, NVS_EXTRA_ACCOUNTS, accounts_blob, &len) == ESP_OK) {
+        accounts_unpack(accounts_blob, len);
+    } else {
+        extra_account_count = 0;
+    }
+
+    // Load fallback endpoints
+    uint8_t endpoints_blob[ENDPOINTS_BLOB_SIZE];
+    len = sizeof(endpoints_blob);
+    if (nvs_get_blob(handle, NVS_EXTRA_ENDPOINTS, endpoints_blob, &len) == ESP_OK) {
+        endpoints_unpack(endpoints_blob, len);
+    } else {
+        extra_endpoint_count = 0;
+    }
     
     nvs_close(handle);
     
@@ -126,10 +311,19 @@ void load_config_from_nvs(void) {
     ESP_LOGI(TAG, "Web URL: %s", web_url);
     ESP_LOGI(TAG, "API Token: %s", (strlen(api_token) > 0) ? "******" : "Empty!");
     ESP_LOGI(TAG, "AskMeSign User: %s", askmesign_user);
-    ESP_LOGI(TAG, "API Interval check: %s", api_interval_ms);
+    ESP_LOGI(TAG, "API Interval check: %s (min %s, max %s)", api_interval_ms, api_interval_min_ms, api_interval_max_ms);
+    ESP_LOGI(TAG, "Poll spread window: %s ms", poll_spread_ms);
+    ESP_LOGI(TAG, "Pre-connect lead time: %s ms", preconnect_ms);
     ESP_LOGI(TAG, "Language: %s", language);
-    ESP_LOGI(TAG, "Working Mode: %s (%s)", working_mode, 
-             (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) ? "Editor" : "Signer");
+    ESP_LOGI(TAG, "Working Mode: %s (%s)", working_mode, device_config_working_mode_name());
+    ESP_LOGI(TAG, "Push URL: %s", (strlen(push_url) > 0) ? push_url : "None (polling)");
+    ESP_LOGI(TAG, "LAN sharing: %s", (strcmp(lan_share, "1") == 0) ? "On" : "Off");
+    for (uint8_t i = 0; i < extra_account_count; i++) {
+        ESP_LOGI(TAG, "Extra account %u: %s", i + 1, extra_accounts[i].user);
+    }
+    for (uint8_t i = 0; i < extra_endpoint_count; i++) {
+        ESP_LOGI(TAG, "Fallback endpoint %u: %s:%s", i + 1, extra_endpoints[i].host, extra_endpoints[i].port);
+    }
 
 }
 
@@ -149,8 +343,16 @@ void save_config_to_nvs(void) {
     nvs_set_str(handle, NVS_API_TOKEN, api_token);
     nvs_set_str(handle, NVS_ASKMESIGN_USER, askmesign_user);
     nvs_set_str(handle, NVS_API_INTERVAL_MS, api_interval_ms);
+    nvs_set_str(handle, NVS_API_INTERVAL_MIN, api_interval_min_ms);
+    nvs_set_str(handle, NVS_API_INTERVAL_MAX, api_interval_max_ms);
+    nvs_set_str(handle, NVS_POLL_SPREAD_MS, poll_spread_ms);
+    nvs_set_str(handle, NVS_PRECONNECT_MS, preconnect_ms);
     nvs_set_str(handle, NVS_LANGUAGE, language);
     nvs_set_str(handle, NVS_WORKING_MODE, working_mode);
+    nvs_set_str(handle, NVS_PUSH_URL, push_url);
+    nvs_set_str(handle, NVS_LAN_SHARE, lan_share);
+    accounts_store(handle);
+    endpoints_store(handle);
 
     nvs_commit(handle);
     nvs_close(handle);
@@ -182,11 +384,80 @@ void reset_config_to_default(void) {
     strcpy(api_token, DEFAULT_API_TOKEN);
     strcpy(askmesign_user, DEFAULT_ASKMESIGN_USER);
     strcpy(api_interval_ms, DEFAULT_API_INTERVAL_MS);
+    strcpy(api_interval_min_ms, DEFAULT_API_INTERVAL_MIN);
+    strcpy(api_interval_max_ms, DEFAULT_API_INTERVAL_MAX);
+    strcpy(poll_spread_ms, DEFAULT_POLL_SPREAD_MS);
+    strcpy(preconnect_ms, DEFAULT_PRECONNECT_MS);
     strcpy(language, DEFAULT_LANGUAGE);
     strcpy(working_mode, DEFAULT_WORKING_MODE);
+    strcpy(push_url, DEFAULT_PUSH_URL);
+    strcpy(lan_share, DEFAULT_LAN_SHARE);
+    extra_account_count = 0;
+    extra_endpoint_count = 0;
     
     // Save the default configuration to NVS
     save_config_to_nvs();
     
     ESP_LOGW(TAG, "✅ Configuration reset to default and saved to NVS!");
-}
\ No newline at end of file
+}
+
+void save_accounts_to_nvs(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error opening NVS for writing: %s", esp_err_to_name(err));
+        return;
+    }
+    accounts_store(handle);
+    nvs_commit(handle);
+    nvs_close(handle);
+    ESP_LOGI(TAG, "%u extra account(s) saved to NVS", extra_account_count);
+}
+
+void save_endpoints_to_nvs(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error opening NVS for writing: %s", esp_err_to_name(err));
+        return;
+    }
+    endpoints_store(handle);
+    nvs_commit(handle);
+    nvs_close(handle);
+    ESP_LOGI(TAG, "%u fallback endpoint(s) saved to NVS", extra_endpoint_count);
+}
+
+const char *device_config_working_mode_name(void)
+{
+    if (strcmp(working_mode, WORKING_MODE_BOTH) == 0) {
+        return "Both";
+    }
+    return (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) ? "Editor" : "Signer";
+}
+
+// FNV-1a over a NUL-separated list of strings
+static uint32_t fnv1a(uint32_t hash, const char *s)
+{
+    do {
+        hash ^= (uint8_t)*s;
+        hash *= 16777619u;
+    } while (*s++ != '\0');
+    return hash;
+}
+
+uint32_t device_config_fingerprint(void)
+{
+    uint32_t hash = 2166136261u;
+    hash = fnv1a(hash, web_server);
+    hash = fnv1a(hash, web_port);
+    hash = fnv1a(hash, web_url);
+    hash = fnv1a(hash, api_token);
+    hash = fnv1a(hash, askmesign_user);
+    for (uint8_t i = 0; i < extra_account_count; i++) {
+        hash = fnv1a(hash, extra_accounts[i].token);
+        hash = fnv1a(hash, extra_accounts[i].user);
+    }
+    return hash;
+}
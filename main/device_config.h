@@ -8,6 +8,7 @@
 #define DEVICE_CONFIG_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // NVS keys definitions
 #define NVS_NAMESPACE         "config"
@@ -19,8 +20,16 @@
 #define NVS_API_TOKEN         "api_token"
 #define NVS_ASKMESIGN_USER    "askmesign_user"
 #define NVS_API_INTERVAL_MS   "api_interval_ms"
+#define NVS_API_INTERVAL_MIN  "api_int_min_ms"
+#define NVS_API_INTERVAL_MAX  "api_int_max_ms"
+#define NVS_POLL_SPREAD_MS    "poll_spread_ms"
 #define NVS_LANGUAGE          "language"
 #define NVS_WORKING_MODE      "working_mode"
+#define NVS_EXTRA_ACCOUNTS    "accounts"
+#define NVS_PUSH_URL          "push_url"
+#define NVS_PRECONNECT_MS     "preconnect_ms"
+#define NVS_EXTRA_ENDPOINTS   "endpoints"
+#define NVS_LAN_SHARE         "lan_share"
 
 // Buffer sizes for string parameters
 #define WIFI_SSID_SIZE        33
@@ -33,6 +42,9 @@
 #define API_INTERVAL_MS_SIZE  12
 #define LANGUAGE_SIZE          2
 #define WORKING_MODE_SIZE      2
+#define LAN_SHARE_SIZE         2
+#define EXTRA_ACCOUNTS_MAX     4     // Accounts polled besides api_token / askmesign_user
+#define EXTRA_ENDPOINTS_MAX    3     // Fallback API front ends after web_server:web_port
 
 // Global configuration variables
 extern char wifi_ssid[WIFI_SSID_SIZE];
@@ -43,8 +55,34 @@ extern char web_url[WEB_URL_SIZE];
 extern char api_token[API_TOKEN_SIZE];
 extern char askmesign_user[ASKMESIGN_USER_SIZE];
 extern char api_interval_ms[API_INTERVAL_MS_SIZE];
+extern char api_interval_min_ms[API_INTERVAL_MS_SIZE];
+extern char api_interval_max_ms[API_INTERVAL_MS_SIZE];
+extern char poll_spread_ms[API_INTERVAL_MS_SIZE];
+extern char preconnect_ms[API_INTERVAL_MS_SIZE];
 extern char language[LANGUAGE_SIZE];
 extern char working_mode[WORKING_MODE_SIZE];
+extern char push_url[WEB_URL_SIZE];
+extern char lan_share[LAN_SHARE_SIZE];
+
+// Additional AskMeSign accounts (signer mode), e.g. an assistant following
+// several signing queues. Stored in NVS as one packed blob.
+typedef struct {
+    char token[API_TOKEN_SIZE];
+    char user[ASKMESIGN_USER_SIZE];
+} device_account_t;
+
+extern device_account_t extra_accounts[EXTRA_ACCOUNTS_MAX];
+extern uint8_t extra_account_count;
+
+// Alternate AskMeSign front ends serving the same API, in order of
+// preference after web_server:web_port. Stored in NVS as one packed blob.
+typedef struct {
+    char host[WEB_SERVER_SIZE];
+    char port[WEB_PORT_SIZE];
+} device_endpoint_t;
+
+extern device_endpoint_t extra_endpoints[EXTRA_ENDPOINTS_MAX];
+extern uint8_t extra_endpoint_count;
 
 // Default values - Non-functional placeholders that require BLE configuration
 #define DEFAULT_WIFI_SSID        ""
@@ -54,13 +92,20 @@ extern char working_mode[WORKING_MODE_SIZE];
 #define DEFAULT_WEB_URL          "https://sign.askme.it/api/v2/files/pending?page=0&size=1"
 #define DEFAULT_API_TOKEN        ""
 #define DEFAULT_ASKMESIGN_USER   ""
-#define DEFAULT_API_INTERVAL_MS  "30000"
+#define DEFAULT_API_INTERVAL_MS  "30000"   // Average spacing of API calls (budget)
+#define DEFAULT_API_INTERVAL_MIN "15000"   // Fastest polling while counts are changing
+#define DEFAULT_API_INTERVAL_MAX "300000"  // Slowest polling while counts are flat
+#define DEFAULT_POLL_SPREAD_MS   "30000"   // Window the fleet's first polls after a (re)connect are spread over
+#define DEFAULT_PRECONNECT_MS    "5000"    // Connection opened this long before a poll (0 = at poll time)
 #define DEFAULT_LANGUAGE         "0"
-#define DEFAULT_WORKING_MODE     "0"  // 0 = Signer mode (default), 1 = Editor mode
+#define DEFAULT_WORKING_MODE     "0"  // 0 = Signer mode (default), 1 = Editor mode, 2 = Both
+#define DEFAULT_PUSH_URL         ""   // Empty = polling only (see PUSH_MODE_GUIDE.md)
+#define DEFAULT_LAN_SHARE        "0"  // 1 = share counts with devices of this account on the LAN (see LAN_SHARE_GUIDE.md)
 
 // Working mode constants
 #define WORKING_MODE_SIGNER      "0"
 #define WORKING_MODE_EDITOR      "1"
+#define WORKING_MODE_BOTH        "2"  // Signer and editor counts side by side
 
 // Function declarations
 void load_config_from_nvs(void);
@@ -68,4 +113,16 @@ void save_config_to_nvs(void);
 bool is_config_default(void);
 void reset_config_to_default(void);
 
+// Persists extra_accounts alone (partial BLE updates)
+void save_accounts_to_nvs(void);
+
+// Persists extra_endpoints alone (partial BLE updates)
+void save_endpoints_to_nvs(void);
+
+// "Signer", "Editor" or "Both" for the current working_mode (logging)
+const char *device_config_working_mode_name(void);
+
+// Hash of server + credentials, used to drop state that belongs to another account
+uint32_t device_config_fingerprint(void);
+
 #endif // DEVICE_CONFIG_H
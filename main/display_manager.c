@@ -29,6 +29,7 @@
 #include "esp_wifi.h"
 #include "translations.h"
 #include "qr_image.h"
+#include "doc_list.h"
 
  static const char *TAG = "display";
  
@@ -83,6 +84,19 @@ static bool ota_suspend_lvgl = false;
 // Global pointer to the LVGL label for displaying MAC address
 static lv_obj_t *mac_label = NULL;
 
+// Caption shown under a count restored from before a reboot
+static lv_obj_t *stale_label = NULL;
+static bool stale_count = false;
+static uint32_t stale_age_s = 0;
+#define STALE_TEXT_COLOR    lv_color_hex(0x808080)  // Grigio
+
+// Pending-document carousel shown above the count (titles from doc_list)
+static lv_obj_t *doc_label = NULL;
+static lv_timer_t *doc_timer = NULL;
+static uint32_t doc_index = 0;
+#define DOC_CAROUSEL_INTERVAL_MS 4000
+#define DOC_TEXT_COLOR      lv_color_hex(0xC0C0C0)  // Grigio chiaro
+
 // Global pointer to the QR code image object
 static lv_obj_t *qr_image = NULL;
 
@@ -99,6 +113,12 @@ static bool ble_show_text = true;  // true = show text, false = show QR code
  
  // Flag to indicate if state_label should be repositioned (editor mode with SHOW_PRACTICES)
  static bool reposition_state_label_after_anim = false;
+
+ // Both mode: editor count shown next to the signer one (see display_manager_update_dual)
+ static int both_editor_count = 0;
+
+ // Several accounts: per-account counts shown under the total in SHOW_PRACTICES
+ static char accounts_breakdown[128] = {0};
  
  // Global pointer for the animated arc
  static lv_obj_t *state_arc = NULL;
@@ -181,7 +201,7 @@ static void fade_out_anim_ready_cb(lv_anim_t *a)
    if (reposition_state_label_after_anim) {
        // In editor mode, position text below the big number
        lv_obj_align(lbl, LV_ALIGN_CENTER, 0, 40);  // Position below the big number
-       lv_obj_set_style_text_font(lbl, &lv_font_montserrat_28, 0);  // Medium font for better readability
+       lv_obj_set_style_text_font(lbl, pending_font, 0);  // Medium font (small for the both-mode legend)
        fade_in_anim_start(lbl);
        reposition_state_label_after_anim = false;  // Reset flag
    } else {
@@ -446,6 +466,84 @@ static void ble_alternate_timer_cb(lv_timer_t *timer)
     ESP_LOGI(TAG, "🔄 BLE timer callback completed");
 }
 
+//------------------------------------------------------------------------------
+// doc_carousel_timer_cb - Mostra il prossimo documento in attesa
+//------------------------------------------------------------------------------
+// Reads the cached lists only: no network call per frame. Both mode shows
+// the signer titles, then the editor ones.
+static void doc_carousel_timer_cb(lv_timer_t *timer)
+{
+    doc_list_kind_t kinds[DOC_LIST_KIND_COUNT];
+    size_t counts[DOC_LIST_KIND_COUNT];
+    size_t n_kinds = 0;
+    size_t total = 0;
+    doc_list_entry_t entry;
+
+    if (strcmp(working_mode, WORKING_MODE_EDITOR) != 0 &&
+        (strcmp(working_mode, WORKING_MODE_BOTH) == 0 || accounts_breakdown[0] == '\0')) {
+        kinds[n_kinds++] = DOC_LIST_SIGNER;
+    }
+    if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0 || strcmp(working_mode, WORKING_MODE_BOTH) == 0) {
+        kinds[n_kinds++] = DOC_LIST_EDITOR;
+    }
+    for (size_t k = 0; k < n_kinds; k++) {
+        counts[k] = doc_list_count(kinds[k], NULL);
+        total += counts[k];
+    }
+    if (total == 0) {
+        lv_obj_add_flag(doc_label, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+
+    size_t index = doc_index++ % total;
+    size_t k = 0;
+    while (index >= counts[k]) {
+        index -= counts[k++];
+    }
+    if (!doc_list_get(kinds[k], index, &entry)) {
+        return;     // List replaced meanwhile: the next tick catches up
+    }
+    if (entry.title[0] == '\0') {
+        snprintf(entry.title, sizeof(entry.title), "#%ld", (long)entry.id);
+    }
+    if (entry.date[0] != '\0') {
+        lv_label_set_text_fmt(doc_label, "%s - %s", entry.title, entry.date);
+    } else {
+        lv_label_set_text(doc_label, entry.title);
+    }
+    lv_obj_clear_flag(doc_label, LV_OBJ_FLAG_HIDDEN);
+}
+
+// Starts (show) or stops the carousel; caller holds lvgl_api_lock
+static void doc_carousel_show(bool show)
+{
+    if (!show) {
+        if (doc_timer != NULL) {
+            lv_timer_del(doc_timer);
+            doc_timer = NULL;
+        }
+        if (doc_label != NULL) {
+            lv_obj_add_flag(doc_label, LV_OBJ_FLAG_HIDDEN);
+        }
+        return;
+    }
+    if (doc_label == NULL) {
+        doc_label = lv_label_create(lv_scr_act());
+        lv_obj_set_style_text_font(doc_label, &lv_font_montserrat_14, 0);
+        lv_obj_set_style_text_color(doc_label, DOC_TEXT_COLOR, 0);
+        lv_obj_set_style_text_align(doc_label, LV_TEXT_ALIGN_CENTER, 0);
+        lv_obj_set_width(doc_label, 160);   // Chord of the round panel at that height
+        lv_label_set_long_mode(doc_label, LV_LABEL_LONG_SCROLL_CIRCULAR);
+        lv_obj_align(doc_label, LV_ALIGN_TOP_MID, 0, 36);
+        lv_obj_add_flag(doc_label, LV_OBJ_FLAG_HIDDEN);
+    }
+    if (doc_timer == NULL) {
+        doc_index = 0;
+        doc_timer = lv_timer_create(doc_carousel_timer_cb, DOC_CAROUSEL_INTERVAL_MS, NULL);
+        doc_carousel_timer_cb(doc_timer);
+    }
+}
+
 //------------------------------------------------------------------------------
 // display_manager_disable_ble_timer - Disabilita il timer BLE durante OTA
 //------------------------------------------------------------------------------
@@ -663,7 +761,9 @@ void display_manager_disable_ble_timer(void)
 
              // Choose appropriate message based on working mode
              char temp_text[512];
-             if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
+             if (strcmp(working_mode, WORKING_MODE_BOTH) == 0) {
+                 snprintf(temp_text, sizeof(temp_text), get_translated_string(STR_CHECKING_BOTH, current_lang), short_user);
+             } else if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
                  snprintf(temp_text, sizeof(temp_text), get_translated_string(STR_CHECKING_EDITOR_DOCUMENTS, current_lang), short_user);
              } else {
                  snprintf(temp_text, sizeof(temp_text), get_translated_string(STR_CHECKING_SIGNER_PRACTICES, current_lang), short_user);
@@ -676,7 +776,13 @@ void display_manager_disable_ble_timer(void)
 
          case DISPLAY_STATE_SHOW_PRACTICES:
              // Choose appropriate message based on working mode
-             if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
+             if (strcmp(working_mode, WORKING_MODE_BOTH) == 0) {
+                 // Both mode: the big label carries both numbers, this is just the legend
+                 strcpy(new_text, get_translated_string(STR_BOTH_LEGEND, current_lang));
+             } else if (accounts_breakdown[0] != '\0' && strcmp(working_mode, WORKING_MODE_EDITOR) != 0) {
+                 // Several accounts: the big number is the total, this is the breakdown
+                 strlcpy(new_text, accounts_breakdown, sizeof(new_text));
+             } else if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
                  // For editor mode, show descriptive text without number (big number will be shown separately)
                  if (practices_count == 1) {
                      strcpy(new_text, get_translated_string(STR_EDITOR_DOCUMENT_WAITING, current_lang));
@@ -693,7 +799,10 @@ void display_manager_disable_ble_timer(void)
              break;
          case DISPLAY_STATE_NO_PRACTICES:
              // Choose appropriate message based on working mode
-             if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
+             if (strcmp(working_mode, WORKING_MODE_BOTH) == 0) {
+                 snprintf(new_text, sizeof(new_text), "%s\n%s", 
+                         LV_SYMBOL_OK, get_translated_string(STR_NO_BOTH_PENDING, current_lang));
+             } else if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
                  snprintf(new_text, sizeof(new_text), "%s\n%s", 
                          LV_SYMBOL_OK, get_translated_string(STR_NO_EDITOR_DOCUMENTS, current_lang));
              } else {
@@ -756,6 +865,9 @@ void display_manager_disable_ble_timer(void)
     else {
         if (state == DISPLAY_STATE_CHECKING_API)
             pending_font = &lv_font_montserrat_18;
+        else if (state == DISPLAY_STATE_SHOW_PRACTICES &&
+                 (strcmp(working_mode, WORKING_MODE_BOTH) == 0 || accounts_breakdown[0] != '\0'))
+            pending_font = &lv_font_montserrat_18;
         else
             pending_font = &lv_font_montserrat_28;
     
@@ -764,11 +876,16 @@ void display_manager_disable_ble_timer(void)
 
      // If we are in SHOW_PRACTICES, show number_label
      if (state == DISPLAY_STATE_SHOW_PRACTICES) {
-         lv_label_set_text_fmt(number_label, "%d", practices_count);
+         bool both = (strcmp(working_mode, WORKING_MODE_BOTH) == 0);
+         if (both) {
+             lv_label_set_text_fmt(number_label, "%d | %d", practices_count, both_editor_count);
+         } else {
+             lv_label_set_text_fmt(number_label, "%d", practices_count);
+         }
          lv_obj_clear_flag(number_label, LV_OBJ_FLAG_HIDDEN);
          
-         // In editor mode, set flag to reposition the text label after animation
-         if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
+         // In editor, both and multi-account mode, set flag to reposition the text label after animation
+         if (both || accounts_breakdown[0] != '\0' || strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
              reposition_state_label_after_anim = true;
          } else {
              reposition_state_label_after_anim = false;
@@ -780,6 +897,38 @@ void display_manager_disable_ble_timer(void)
          reposition_state_label_after_anim = false;
      }
 
+    // Restored count: dimmed, with its caption, until the first live result
+    bool stale_shown = stale_count &&
+                       (state == DISPLAY_STATE_SHOW_PRACTICES || state == DISPLAY_STATE_NO_PRACTICES);
+    lv_obj_set_style_text_color(number_label, stale_shown ? STALE_TEXT_COLOR : lv_color_white(), 0);
+    lv_obj_set_style_text_color(state_label, stale_shown ? STALE_TEXT_COLOR : lv_color_white(), 0);
+    if (stale_shown) {
+        static char stale_text[48];
+        if (stale_age_s == UINT32_MAX) {
+            snprintf(stale_text, sizeof(stale_text), "%s %s", LV_SYMBOL_REFRESH,
+                     get_translated_string(STR_LAST_KNOWN, current_lang));
+        } else {
+            char caption[40];
+            snprintf(caption, sizeof(caption), get_translated_string(STR_LAST_KNOWN_AGE, current_lang),
+                     (unsigned long)(stale_age_s / 60));
+            snprintf(stale_text, sizeof(stale_text), "%s %s", LV_SYMBOL_REFRESH, caption);
+        }
+        if (stale_label == NULL) {
+            stale_label = lv_label_create(lv_scr_act());
+            lv_obj_set_style_text_font(stale_label, &lv_font_montserrat_14, 0);
+            lv_obj_set_style_text_color(stale_label, STALE_TEXT_COLOR, 0);
+            lv_obj_set_style_text_align(stale_label, LV_TEXT_ALIGN_CENTER, 0);
+            lv_obj_align(stale_label, LV_ALIGN_BOTTOM_MID, 0, -30);
+        }
+        lv_label_set_text(stale_label, stale_text);
+        lv_obj_clear_flag(stale_label, LV_OBJ_FLAG_HIDDEN);
+    } else if (stale_label != NULL) {
+        lv_obj_add_flag(stale_label, LV_OBJ_FLAG_HIDDEN);
+    }
+
+    // Titles of the pending documents, once the count is a live one
+    doc_carousel_show(state == DISPLAY_STATE_SHOW_PRACTICES && !stale_shown);
+
     // Hide MAC label in all states except WIFI_CONNECTING
     if (mac_label != NULL) {
         if (state == DISPLAY_STATE_WIFI_CONNECTING) {
@@ -880,6 +1029,36 @@ void display_manager_disable_ble_timer(void)
      _lock_release(&lvgl_api_lock);
 }
 
+//------------------------------------------------------------------------------
+// display_manager_update_dual
+//------------------------------------------------------------------------------
+void display_manager_update_dual(display_state_t state, int signer_count, int editor_count)
+{
+    both_editor_count = editor_count;
+    display_manager_update(state, signer_count);
+}
+
+//------------------------------------------------------------------------------
+// display_manager_set_breakdown
+//------------------------------------------------------------------------------
+void display_manager_set_breakdown(const char *text)
+{
+    _lock_acquire(&lvgl_api_lock);
+    strlcpy(accounts_breakdown, text ? text : "", sizeof(accounts_breakdown));
+    _lock_release(&lvgl_api_lock);
+}
+
+//------------------------------------------------------------------------------
+// display_manager_set_stale
+//------------------------------------------------------------------------------
+void display_manager_set_stale(bool stale, uint32_t age_s)
+{
+    _lock_acquire(&lvgl_api_lock);
+    stale_count = stale;
+    stale_age_s = age_s;
+    _lock_release(&lvgl_api_lock);
+}
+
 void display_manager_show_ota_progress(int percentage, const char* status_text)
 {
     // Only update display once at the beginning of OTA to avoid SPI conflicts
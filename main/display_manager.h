@@ -29,6 +29,13 @@ typedef enum {
 
 void display_manager_init(void);
 void display_manager_update(display_state_t state, int practices_count);
+// Both working mode: SHOW_PRACTICES shows "signer | editor" counts
+void display_manager_update_dual(display_state_t state, int signer_count, int editor_count);
+// Signer mode with several accounts: per-account text shown under the total (NULL = none)
+void display_manager_set_breakdown(const char *text);
+// Count restored from before a reboot: SHOW/NO_PRACTICES are dimmed with a
+// "last known" caption until cleared (age_s = UINT32_MAX: age unknown)
+void display_manager_set_stale(bool stale, uint32_t age_s);
 void display_manager_show_ota_progress(int percentage, const char* status_text);
 void display_manager_disable_ble_timer(void);
 
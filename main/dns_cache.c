@@ -0,0 +1,480 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: dns_cache.c                                        *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: TTL-aware DNS cache for the API hosts       *
+ ************************************************************/
+
+#include <string.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include "dns_cache.h"
+#include "device_config.h"
+
+static const char *TAG = "DNS_Cache";
+
+#define DNS_PORT            53
+#define DNS_PACKET_SIZE     512
+#define DNS_TYPE_A          1
+#define DNS_TYPE_CNAME      5
+#define DNS_CLASS_IN        1
+
+typedef struct {
+    char host[DNS_CACHE_HOST_SIZE];
+    struct in_addr addr;
+    int64_t expires_us;         // Record TTL elapsed
+    int64_t stale_until_us;     // Last moment the entry may be served stale
+    int64_t last_used_us;
+} dns_cache_entry_t;
+
+static dns_cache_entry_t s_entries[DNS_CACHE_SIZE];
+static SemaphoreHandle_t s_dns_mutex = NULL;
+static uint32_t s_hits = 0;
+static uint32_t s_misses = 0;
+static uint32_t s_stale_served = 0;
+static uint32_t s_flushes = 0;
+// Network the entries were resolved on (net_worker only, see dns_cache_prewarm())
+static uint32_t s_net_resolver = 0;
+static uint32_t s_net_subnet = 0;
+
+esp_err_t dns_cache_init(void)
+{
+    if (s_dns_mutex != NULL) {
+        return ESP_OK;
+    }
+    s_dns_mutex = xSemaphoreCreateMutex();
+    if (s_dns_mutex == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for the DNS cache lock");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// False before dns_cache_init(): every lookup then goes to the resolver
+static bool dns_cache_lock(void)
+{
+    if (s_dns_mutex == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_dns_mutex, portMAX_DELAY);
+    return true;
+}
+
+static void dns_cache_unlock(void)
+{
+    xSemaphoreGive(s_dns_mutex);
+}
+
+// Caller holds the lock
+static dns_cache_entry_t *dns_cache_find(const char *host)
+{
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (s_entries[i].host[0] != '\0' && strcasecmp(s_entries[i].host, host) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void dns_cache_store(const char *host, struct in_addr addr, uint32_t ttl_s)
+{
+    if (ttl_s < DNS_CACHE_MIN_TTL_S) {
+        ttl_s = DNS_CACHE_MIN_TTL_S;
+    } else if (ttl_s > DNS_CACHE_MAX_TTL_S) {
+        ttl_s = DNS_CACHE_MAX_TTL_S;
+    }
+    int64_t now = esp_timer_get_time();
+
+    if (!dns_cache_lock()) {
+        return;
+    }
+    dns_cache_entry_t *entry = dns_cache_find(host);
+    if (entry == NULL) {
+        // Reuse the least recently used slot
+        entry = &s_entries[0];
+        for (int i = 1; i < DNS_CACHE_SIZE; i++) {
+            if (s_entries[i].last_used_us < entry->last_used_us) {
+                entry = &s_entries[i];
+            }
+        }
+        strlcpy(entry->host, host, sizeof(entry->host));
+    }
+    entry->addr = addr;
+    entry->expires_us = now + (int64_t)ttl_s * 1000000;
+    entry->stale_until_us = entry->expires_us + (int64_t)DNS_CACHE_STALE_S * 1000000;
+    entry->last_used_us = now;
+    dns_cache_unlock();
+
+    ESP_LOGI(TAG, "🌐 %s -> %s (ttl %lu s)", host, inet_ntoa(addr), (unsigned long)ttl_s);
+}
+
+// Address of the resolver handed out by DHCP
+static bool dns_cache_server(struct sockaddr_in *server)
+{
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_dns_info_t dns;
+
+    if (netif == NULL || esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns) != ESP_OK ||
+        dns.ip.type != ESP_IPADDR_TYPE_V4 || dns.ip.u_addr.ip4.addr == 0) {
+        return false;
+    }
+    memset(server, 0, sizeof(*server));
+    server->sin_family = AF_INET;
+    server->sin_port = htons(DNS_PORT);
+    server->sin_addr.s_addr = dns.ip.u_addr.ip4.addr;
+    return true;
+}
+
+// The reply comes from the resolver the query was sent to
+static bool dns_reply_from(const struct sockaddr_in *from, socklen_t from_len,
+                           const struct sockaddr_in *server)
+{
+    return from_len >= sizeof(*from) && from->sin_family == AF_INET &&
+           from->sin_addr.s_addr == server->sin_addr.s_addr && from->sin_port == server->sin_port;
+}
+
+// Checks that the reply's only question is ours: host, type A, class IN.
+// Returns the offset after it or -1
+static int dns_match_question(const uint8_t *pkt, int len, const char *host)
+{
+    const char *label = host;
+    int pos = 12;
+
+    if (((pkt[4] << 8) | pkt[5]) != 1) {
+        return -1;
+    }
+    while (true) {
+        if (pos >= len) {
+            return -1;
+        }
+        uint8_t n = pkt[pos++];
+        if (n == 0) {
+            break;
+        }
+        const char *dot = strchr(label, '.');
+        size_t host_n = dot ? (size_t)(dot - label) : strlen(label);
+        if (n > 63 || pos + n > len || n != host_n || strncasecmp((const char *)&pkt[pos], label, n) != 0) {
+            return -1;      // Compression pointers included: nothing precedes the question
+        }
+        pos += n;
+        label += n + (dot ? 1 : 0);
+    }
+    if (*label != '\0' || pos + 4 > len ||
+        ((pkt[pos] << 8) | pkt[pos + 1]) != DNS_TYPE_A || ((pkt[pos + 2] << 8) | pkt[pos + 3]) != DNS_CLASS_IN) {
+        return -1;
+    }
+    return pos + 4;
+}
+
+// Skips a (possibly compressed) name. Returns the offset after it or -1
+static int dns_skip_name(const uint8_t *pkt, int len, int pos)
+{
+    while (pos < len) {
+        uint8_t label = pkt[pos];
+        if (label == 0) {
+            return pos + 1;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            return (pos + 2 <= len) ? pos + 2 : -1;
+        }
+        pos += label + 1;
+    }
+    return -1;
+}
+
+// Sends one A query straight to the resolver and parses the answer, so
+// that the record TTL (which getaddrinfo() does not expose) is known.
+// Returns 0 on success, -1 on timeout/error/NXDOMAIN/cancellation.
+static int dns_query_a(const char *host, struct in_addr *addr, uint32_t *ttl_s,
+                       const net_deadline_t *deadline)
+{
+    uint8_t pkt[DNS_PACKET_SIZE];
+    struct sockaddr_in server;
+    int len = 0;
+
+    if (!dns_cache_server(&server)) {
+        return -1;
+    }
+
+    uint16_t id = (uint16_t)esp_random();
+    memset(pkt, 0, 12);
+    pkt[0] = id >> 8;
+    pkt[1] = id & 0xFF;
+    pkt[2] = 0x01;          // RD
+    pkt[5] = 1;             // QDCOUNT
+    len = 12;
+
+    // QNAME
+    const char *label = host;
+    while (*label != '\0') {
+        const char *dot = strchr(label, '.');
+        size_t n = dot ? (size_t)(dot - label) : strlen(label);
+        if (n == 0 || n > 63 || len + n + 6 > sizeof(pkt)) {
+            return -1;
+        }
+        pkt[len++] = (uint8_t)n;
+        memcpy(&pkt[len], label, n);
+        len += n;
+        label += n + (dot ? 1 : 0);
+    }
+    pkt[len++] = 0;
+    pkt[len++] = 0;
+    pkt[len++] = DNS_TYPE_A;
+    pkt[len++] = 0;
+    pkt[len++] = DNS_CLASS_IN;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return -1;
+    }
+    // Short receive slices: the caller's deadline and token are checked in between
+    struct timeval tv = { .tv_sec = 0, .tv_usec = NET_CANCEL_SLICE_MS * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int ret = -1;
+    if (sendto(sock, pkt, len, 0, (struct sockaddr *)&server, sizeof(server)) != len) {
+        goto out;
+    }
+
+    // Only the resolver's answer to this very question counts: stray
+    // datagrams (late answers to an earlier query, forged ones) are dropped
+    int64_t give_up = esp_timer_get_time() +
+                      (int64_t)net_deadline_left_ms(deadline, DNS_CACHE_QUERY_TIMEOUT_MS) * 1000;
+    struct sockaddr_in from;
+    socklen_t from_len;
+    int pos = -1;
+    int n;
+    do {
+        from_len = sizeof(from);
+        n = recvfrom(sock, pkt, sizeof(pkt), 0, (struct sockaddr *)&from, &from_len);
+        if (n >= 12 && dns_reply_from(&from, from_len, &server) &&
+            pkt[0] == (id >> 8) && pkt[1] == (id & 0xFF) && (pkt[2] & 0x80) &&
+            (pos = dns_match_question(pkt, n, host)) > 0) {
+            break;
+        }
+        n = -1;
+    } while (esp_timer_get_time() < give_up && !net_deadline_over(deadline));
+
+    if (n < 12 || (pkt[3] & 0x0F) != 0) {
+        goto out;   // Timeout or RCODE != NOERROR
+    }
+
+    int ancount = (pkt[6] << 8) | pkt[7];
+
+    // The shortest TTL along a CNAME chain bounds the answer's lifetime
+    uint32_t min_ttl = UINT32_MAX;
+    for (int i = 0; i < ancount && pos > 0; i++) {
+        pos = dns_skip_name(pkt, n, pos);
+        if (pos < 0 || pos + 10 > n) {
+            break;
+        }
+        uint16_t type = (pkt[pos] << 8) | pkt[pos + 1];
+        uint16_t cls = (pkt[pos + 2] << 8) | pkt[pos + 3];
+        uint32_t ttl = ((uint32_t)pkt[pos + 4] << 24) | ((uint32_t)pkt[pos + 5] << 16) |
+                       ((uint32_t)pkt[pos + 6] << 8) | pkt[pos + 7];
+        uint16_t rdlen = (pkt[pos + 8] << 8) | pkt[pos + 9];
+        pos += 10;
+        if (pos + rdlen > n) {
+            break;
+        }
+        if (cls == DNS_CLASS_IN && (type == DNS_TYPE_A || type == DNS_TYPE_CNAME) && ttl < min_ttl) {
+            min_ttl = ttl;
+        }
+        if (type == DNS_TYPE_A && cls == DNS_CLASS_IN && rdlen == 4) {
+            memcpy(&addr->s_addr, &pkt[pos], 4);
+            *ttl_s = min_ttl;
+            ret = 0;
+            break;
+        }
+        pos += rdlen;
+    }
+
+out:
+    close(sock);
+    return ret;
+}
+
+// Resolution through lwIP (used when the direct query is not possible)
+static int dns_getaddrinfo_a(const char *host, struct in_addr *addr)
+{
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host, NULL, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    *addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+    return 0;
+}
+
+// force = refresh even if the entry is still fresh
+static esp_err_t dns_cache_lookup(const char *host, struct in_addr *addr, bool force,
+                                  const net_deadline_t *deadline)
+{
+    struct in_addr resolved;
+    uint32_t ttl_s = 0;
+
+    if (host == NULL || host[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Literal addresses never hit the network
+    if (inet_pton(AF_INET, host, addr) == 1) {
+        return ESP_OK;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool have_stale = false;
+    struct in_addr stale;
+
+    if (dns_cache_lock()) {
+        dns_cache_entry_t *entry = dns_cache_find(host);
+        if (entry != NULL) {
+            entry->last_used_us = now;
+            if (!force && now < entry->expires_us) {
+                *addr = entry->addr;
+                s_hits++;
+                dns_cache_unlock();
+                return ESP_OK;
+            }
+            if (now < entry->stale_until_us) {
+                stale = entry->addr;
+                have_stale = true;
+            }
+        }
+        s_misses++;
+        dns_cache_unlock();
+    }
+
+    if (net_deadline_over(deadline)) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t start = esp_timer_get_time();
+    if (dns_query_a(host, &resolved, &ttl_s, deadline) == 0) {
+        ESP_LOGI(TAG, "🔎 Resolved %s in %lld ms", host, (esp_timer_get_time() - start) / 1000);
+        dns_cache_store(host, resolved, ttl_s);
+        *addr = resolved;
+        return ESP_OK;
+    }
+
+    // The resolver did not answer in time: a stale address is far more
+    // likely to work than waiting again
+    if (have_stale) {
+        ESP_LOGW(TAG, "⚠️ DNS query for %s failed, serving stale address %s", host, inet_ntoa(stale));
+        if (dns_cache_lock()) {
+            s_stale_served++;
+            dns_cache_unlock();
+        }
+        *addr = stale;
+        return ESP_OK;
+    }
+
+    // Nothing cached: let lwIP try (it has its own retries and servers),
+    // unless the caller could not wait for them
+    if (net_deadline_left_ms(deadline, DNS_CACHE_FALLBACK_MIN_MS) < DNS_CACHE_FALLBACK_MIN_MS) {
+        ESP_LOGW(TAG, "⚠️ No time left to resolve %s through lwIP", host);
+        return ESP_ERR_TIMEOUT;
+    }
+    if (dns_getaddrinfo_a(host, &resolved) == 0) {
+        dns_cache_store(host, resolved, DNS_CACHE_FALLBACK_TTL_S);
+        *addr = resolved;
+        return ESP_OK;
+    }
+
+    ESP_LOGE(TAG, "❌ Cannot resolve %s", host);
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t dns_cache_resolve(const char *host, struct in_addr *addr, const net_deadline_t *deadline)
+{
+    return dns_cache_lookup(host, addr, false, deadline);
+}
+
+// Resolver and subnet of the station. Either one changing means another
+// network, where the cached answers (stale ones above all) may not hold
+static void dns_cache_check_network(void)
+{
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip;
+    struct sockaddr_in server;
+
+    if (netif == NULL || !dns_cache_server(&server) || esp_netif_get_ip_info(netif, &ip) != ESP_OK) {
+        return;
+    }
+    uint32_t subnet = ip.ip.addr & ip.netmask.addr;
+    if (server.sin_addr.s_addr == s_net_resolver && subnet == s_net_subnet) {
+        return;
+    }
+    if (s_net_resolver != 0) {
+        ESP_LOGI(TAG, "🔄 Network or resolver changed, flushing the DNS cache");
+        dns_cache_flush();
+    }
+    s_net_resolver = server.sin_addr.s_addr;
+    s_net_subnet = subnet;
+}
+
+void dns_cache_prewarm(const net_deadline_t *deadline)
+{
+    static const char *const github_hosts[] = DNS_CACHE_GITHUB_HOSTS;
+    struct in_addr addr;
+    int64_t start = esp_timer_get_time();
+
+    dns_cache_check_network();
+    ESP_LOGI(TAG, "🔥 Pre-warming DNS cache");
+
+    // The network may have changed: refresh even entries that look fresh
+    dns_cache_lookup(web_server, &addr, true, deadline);
+    for (uint8_t i = 0; i < extra_endpoint_count && !net_deadline_over(deadline); i++) {
+        dns_cache_lookup(extra_endpoints[i].host, &addr, true, deadline);
+    }
+
+    // The release check and the OTA download go through the same transport
+    for (size_t i = 0; i < sizeof(github_hosts) / sizeof(github_hosts[0]) && !net_deadline_over(deadline); i++) {
+        dns_cache_lookup(github_hosts[i], &addr, true, deadline);
+    }
+
+    ESP_LOGI(TAG, "🔥 DNS pre-warm done in %lld ms", (esp_timer_get_time() - start) / 1000);
+}
+
+void dns_cache_flush(void)
+{
+    if (!dns_cache_lock()) {
+        return;
+    }
+    memset(s_entries, 0, sizeof(s_entries));
+    s_flushes++;
+    dns_cache_unlock();
+}
+
+void dns_cache_log_summary(void)
+{
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t stale = 0;
+    uint32_t flushes = 0;
+
+    if (!dns_cache_lock()) {
+        return;
+    }
+    hits = s_hits;
+    misses = s_misses;
+    stale = s_stale_served;
+    flushes = s_flushes;
+    dns_cache_unlock();
+
+    ESP_LOGI(TAG, "  dns cache hits %lu misses %lu stale served %lu flushes %lu",
+             hits, misses, stale, flushes);
+}
@@ -0,0 +1,79 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: dns_cache.h                                        *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: TTL-aware DNS cache for the API hosts       *
+ ************************************************************/
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lwip/sockets.h"
+#include "net_deadline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_CACHE_SIZE              8
+#define DNS_CACHE_HOST_SIZE         64
+#define DNS_CACHE_MIN_TTL_S         30      // Floor for very short record TTLs
+#define DNS_CACHE_MAX_TTL_S         3600    // Ceiling for very long record TTLs
+#define DNS_CACHE_FALLBACK_TTL_S    60      // TTL of answers obtained through getaddrinfo()
+#define DNS_CACHE_STALE_S           86400   // How long an expired entry may still be served
+#define DNS_CACHE_QUERY_TIMEOUT_MS  1500    // Per attempt, before falling back / serving stale
+#define DNS_CACHE_FALLBACK_MIN_MS   5000    // Time left needed to risk lwIP's getaddrinfo() (not cancellable)
+
+// Hosts resolved ahead of time after IP_EVENT_STA_GOT_IP (web_server and the fallback endpoints are added at runtime)
+#define DNS_CACHE_GITHUB_HOSTS      { "api.github.com", "github.com", "objects.githubusercontent.com", \
+                                      "release-assets.githubusercontent.com" }
+
+// Creates the cache lock (called by api_manager_init(); until then nothing is cached)
+esp_err_t dns_cache_init(void);
+
+/**
+ * @brief Resolves host to an IPv4 address
+ *
+ * Fresh entries are served from RAM. Expired ones are refreshed with a
+ * direct query to the DHCP-provided resolver (so the record TTL is known);
+ * if the resolver does not answer, the expired entry is served (stale) for
+ * up to DNS_CACHE_STALE_S.
+ *
+ * The query waits in NET_CANCEL_SLICE_MS slices and stops as soon as the
+ * deadline passes or its token is triggered. The getaddrinfo() fallback
+ * cannot be interrupted, so it is only tried with DNS_CACHE_FALLBACK_MIN_MS
+ * or more left.
+ *
+ * @param host     Host name or dotted IPv4 literal
+ * @param addr     Output address (network byte order)
+ * @param deadline Bound of the lookup (NULL = none)
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the name cannot be resolved,
+ *         ESP_ERR_TIMEOUT if the deadline passed or the lookup was cancelled
+ */
+esp_err_t dns_cache_resolve(const char *host, struct in_addr *addr, const net_deadline_t *deadline);
+
+/**
+ * @brief Resolves web_server, the fallback endpoints and the GitHub hosts (blocking)
+ *
+ * Run from the network worker right after the station gets an address.
+ * On another network (resolver or subnet changed) the cache is flushed
+ * first.
+ *
+ * @param deadline Stops the remaining lookups once over (NULL = none)
+ */
+void dns_cache_prewarm(const net_deadline_t *deadline);
+
+// Drops every entry (e.g. after a network change)
+void dns_cache_flush(void);
+
+// Logs hits, misses, stale answers and flushes (part of api_metrics_log_summary())
+void dns_cache_log_summary(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DNS_CACHE_H
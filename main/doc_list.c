@@ -0,0 +1,293 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: doc_list.c                                         *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Cached pending-document titles (PSRAM)      *
+ ************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "doc_list.h"
+
+static const char *TAG = "Doc_List";
+
+// Requests one update may make: every page once, plus a couple for a list
+// that moves while it is read
+#define DOC_LIST_MAX_PAGES      (DOC_LIST_CAPACITY / DOC_LIST_PAGE_SIZE + 2)
+
+typedef struct {
+    doc_list_entry_t *entries;  // DOC_LIST_CAPACITY slots, newest first
+    size_t count;
+    int total;                  // totalElements when fetched (-1 = never fetched)
+    int seen_total;             // Last count poll (-1 = none yet)
+    long seen_newest;           // idFile of its first document (-1 = unknown)
+} doc_list_t;
+
+// Update in progress (network worker only)
+typedef struct {
+    bool active;
+    doc_list_kind_t kind;
+    size_t filled;              // Leading entries of s_staging already known
+    size_t target;              // Entries the new list will hold
+    int total;
+    int pages;                  // Requests made so far
+    size_t reused;              // Entries taken from the old list
+} doc_list_update_t;
+
+static doc_list_t s_lists[DOC_LIST_KIND_COUNT];
+static doc_list_entry_t *s_staging = NULL;
+static doc_list_update_t s_update;
+static SemaphoreHandle_t s_mutex = NULL;
+
+static void doc_list_lock(void)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+}
+
+static void doc_list_unlock(void)
+{
+    xSemaphoreGive(s_mutex);
+}
+
+// Entry arrays live in PSRAM when the board has it: they are read a few
+// times a minute by the display, never in a hot path
+static doc_list_entry_t *doc_list_alloc(void)
+{
+    size_t size = DOC_LIST_CAPACITY * sizeof(doc_list_entry_t);
+    doc_list_entry_t *entries = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM);
+
+    if (entries == NULL) {
+        entries = calloc(1, size);
+    }
+    return entries;
+}
+
+esp_err_t doc_list_init(void)
+{
+    if (s_mutex != NULL) {
+        return ESP_OK;
+    }
+    for (int k = 0; k < DOC_LIST_KIND_COUNT; k++) {
+        s_lists[k].entries = doc_list_alloc();
+        s_lists[k].total = -1;
+        s_lists[k].seen_total = -1;
+        s_lists[k].seen_newest = -1;
+    }
+    s_staging = doc_list_alloc();
+    s_mutex = xSemaphoreCreateMutex();
+    if (s_staging == NULL || s_mutex == NULL ||
+        s_lists[DOC_LIST_SIGNER].entries == NULL || s_lists[DOC_LIST_EDITOR].entries == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for the document lists");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "📄 Document lists ready (%d x %u bytes)", DOC_LIST_KIND_COUNT + 1,
+             (unsigned)(DOC_LIST_CAPACITY * sizeof(doc_list_entry_t)));
+    return ESP_OK;
+}
+
+// Caller holds the lock
+static bool doc_list_is_outdated(const doc_list_t *list)
+{
+    if (list->total < 0) {
+        return true;
+    }
+    if (list->seen_total >= 0 && list->seen_total != list->total) {
+        return true;
+    }
+    if (list->seen_newest >= 0 && (list->count == 0 || list->entries[0].id != list->seen_newest)) {
+        return true;
+    }
+    return false;
+}
+
+void doc_list_observe(doc_list_kind_t kind, int total, long newest_id)
+{
+    if (s_mutex == NULL || kind >= DOC_LIST_KIND_COUNT) {
+        return;
+    }
+    doc_list_lock();
+    s_lists[kind].seen_total = total;
+    s_lists[kind].seen_newest = newest_id;
+    doc_list_unlock();
+}
+
+bool doc_list_outdated(doc_list_kind_t kind)
+{
+    bool outdated;
+
+    if (s_mutex == NULL || kind >= DOC_LIST_KIND_COUNT || s_lists[kind].entries == NULL) {
+        return false;
+    }
+    doc_list_lock();
+    outdated = doc_list_is_outdated(&s_lists[kind]);
+    doc_list_unlock();
+    return outdated;
+}
+
+size_t doc_list_count(doc_list_kind_t kind, int *total)
+{
+    size_t count = 0;
+
+    if (total) {
+        *total = 0;
+    }
+    if (s_mutex == NULL || kind >= DOC_LIST_KIND_COUNT) {
+        return 0;
+    }
+    doc_list_lock();
+    count = s_lists[kind].count;
+    if (total) {
+        *total = (s_lists[kind].total > 0) ? s_lists[kind].total : 0;
+    }
+    doc_list_unlock();
+    return count;
+}
+
+bool doc_list_get(doc_list_kind_t kind, size_t index, doc_list_entry_t *entry)
+{
+    bool found = false;
+
+    if (s_mutex == NULL || kind >= DOC_LIST_KIND_COUNT || entry == NULL) {
+        return false;
+    }
+    doc_list_lock();
+    if (index < s_lists[kind].count) {
+        *entry = s_lists[kind].entries[index];
+        found = true;
+    }
+    doc_list_unlock();
+    return found;
+}
+
+bool doc_list_update_begin(doc_list_kind_t kind)
+{
+    if (!doc_list_outdated(kind) || s_staging == NULL) {
+        return false;
+    }
+    doc_list_lock();
+    int total = s_lists[kind].seen_total;
+    doc_list_unlock();
+
+    memset(&s_update, 0, sizeof(s_update));
+    s_update.active = true;
+    s_update.kind = kind;
+    s_update.total = total;
+    // Unknown total: read until a short page
+    s_update.target = (total >= 0 && total < DOC_LIST_CAPACITY) ? (size_t)total : DOC_LIST_CAPACITY;
+    return true;
+}
+
+int doc_list_update_next_page(void)
+{
+    if (!s_update.active || s_update.filled >= s_update.target) {
+        return -1;
+    }
+    if (s_update.pages >= DOC_LIST_MAX_PAGES) {
+        ESP_LOGW(TAG, "⚠️ List kept changing while read, stopping at %u documents",
+                 (unsigned)s_update.filled);
+        s_update.target = s_update.filled;
+        return -1;
+    }
+    return (int)(s_update.filled / DOC_LIST_PAGE_SIZE);
+}
+
+// The page just read sits in the old list at an offset (documents added
+// above it: negative, removed above it: positive). When the documents after
+// it are as many as before, the rest of the old list is still good, moved
+// by that offset. Returns the entries copied into s_staging.
+static size_t doc_list_reuse_tail(const doc_list_entry_t *entries, size_t n, size_t start)
+{
+    const doc_list_t *old = &s_lists[s_update.kind];
+    long j = -1;
+
+    // Only the network worker writes the lists: no lock needed to read them here
+    for (size_t i = 0; i < old->count; i++) {
+        if (old->entries[i].id == entries[n - 1].id) {
+            j = (long)i;
+            break;
+        }
+    }
+    if (j < 0) {
+        return 0;
+    }
+    long shift = j - (long)(start + n - 1);
+    for (size_t i = 0; i < n; i++) {
+        long at = (long)(start + i) + shift;
+        if (at < 0) {
+            continue;       // Added above everything cached
+        }
+        if (at >= (long)old->count || old->entries[at].id != entries[i].id) {
+            return 0;
+        }
+    }
+    if (old->total - shift != s_update.total) {
+        return 0;           // Something changed further down too
+    }
+
+    size_t copied = 0;
+    while (s_update.filled < s_update.target && (long)s_update.filled + shift < (long)old->count) {
+        s_staging[s_update.filled] = old->entries[s_update.filled + shift];
+        s_update.filled++;
+        copied++;
+    }
+    return copied;
+}
+
+void doc_list_update_put_page(int page, const doc_list_entry_t *entries, size_t n, int total)
+{
+    if (!s_update.active || page < 0) {
+        return;
+    }
+    size_t start = (size_t)page * DOC_LIST_PAGE_SIZE;
+
+    s_update.pages++;
+    s_update.total = total;
+    s_update.target = (total >= 0 && total < DOC_LIST_CAPACITY) ? (size_t)total : DOC_LIST_CAPACITY;
+    for (size_t i = 0; i < n && start + i < DOC_LIST_CAPACITY; i++) {
+        s_staging[start + i] = entries[i];
+    }
+    size_t end = start + n;
+    if (end > DOC_LIST_CAPACITY) {
+        end = DOC_LIST_CAPACITY;
+    }
+    if (end > s_update.filled) {
+        s_update.filled = end;
+    }
+    // A short page is the end of the list, whatever the count said
+    if (n < DOC_LIST_PAGE_SIZE && end < s_update.target) {
+        s_update.target = end;
+    }
+    if (n > 0 && s_update.filled < s_update.target) {
+        s_update.reused += doc_list_reuse_tail(entries, n, start);
+    }
+}
+
+void doc_list_update_end(bool ok)
+{
+    if (!s_update.active) {
+        return;
+    }
+    s_update.active = false;
+    if (!ok) {
+        ESP_LOGW(TAG, "⚠️ Document list update failed, keeping the cached one");
+        return;
+    }
+    if (s_update.filled > s_update.target) {
+        s_update.filled = s_update.target;
+    }
+
+    doc_list_t *list = &s_lists[s_update.kind];
+    doc_list_lock();
+    memcpy(list->entries, s_staging, s_update.filled * sizeof(doc_list_entry_t));
+    list->count = s_update.filled;
+    list->total = (s_update.total >= 0) ? s_update.total : (int)s_update.filled;
+    doc_list_unlock();
+    ESP_LOGI(TAG, "📄 %s list: %u of %d document(s), %d page request(s), %u reused",
+             (s_update.kind == DOC_LIST_SIGNER) ? "Signer" : "Editor", (unsigned)list->count,
+             list->total, s_update.pages, (unsigned)s_update.reused);
+}
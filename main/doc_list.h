@@ -0,0 +1,81 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: doc_list.h                                         *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Cached pending-document titles (PSRAM)      *
+ ************************************************************/
+
+#ifndef DOC_LIST_H
+#define DOC_LIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DOC_LIST_CAPACITY       32      // Newest documents kept per list
+#define DOC_LIST_PAGE_SIZE      8       // Documents per request (size= of the page URL)
+#define DOC_LIST_TITLE_SIZE     56      // Longer titles are truncated
+#define DOC_LIST_DATE_SIZE      11      // "YYYY-MM-DD"
+
+// One list per pending count
+typedef enum {
+    DOC_LIST_SIGNER = 0,        // web_url: practices to sign
+    DOC_LIST_EDITOR,            // /api/v2/files: documents created, waiting for signatures
+    DOC_LIST_KIND_COUNT
+} doc_list_kind_t;
+
+typedef struct {
+    int32_t id;                         // idFile
+    char title[DOC_LIST_TITLE_SIZE];
+    char date[DOC_LIST_DATE_SIZE];      // "" when the server sent none
+} doc_list_entry_t;
+
+/**
+ * @brief Allocates the lists (PSRAM when there is some, internal RAM otherwise)
+ *
+ * Until this is called the lists stay empty and never ask for a fetch.
+ */
+esp_err_t doc_list_init(void);
+
+/**
+ * @brief Records what a count poll saw of a list
+ *
+ * total is totalElements, newest_id the idFile of the first document of
+ * the answer (-1 = not sent, e.g. a 304 or no document). The list is
+ * outdated when they differ from what it holds.
+ */
+void doc_list_observe(doc_list_kind_t kind, int total, long newest_id);
+
+// True when the list differs from the last count poll (or was never fetched)
+bool doc_list_outdated(doc_list_kind_t kind);
+
+// Documents in the list (at most DOC_LIST_CAPACITY) and totalElements behind it
+size_t doc_list_count(doc_list_kind_t kind, int *total);
+
+// Copies the document at index (0 = newest); false past the end
+bool doc_list_get(doc_list_kind_t kind, size_t index, doc_list_entry_t *entry);
+
+/**
+ * @brief Page-by-page update of an outdated list (network worker only)
+ *
+ * begin() returns false when the list is current. Then next_page() gives
+ * the page to fetch (-1 = done), put_page() hands over what it held and
+ * end() publishes the new list, or keeps the old one when ok is false.
+ * Pages whose documents are already cached, shifted up or down by the
+ * ones added or removed above them, are not requested again.
+ */
+bool doc_list_update_begin(doc_list_kind_t kind);
+int doc_list_update_next_page(void);
+void doc_list_update_put_page(int page, const doc_list_entry_t *entries, size_t n, int total);
+void doc_list_update_end(bool ok);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DOC_LIST_H
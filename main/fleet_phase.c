@@ -0,0 +1,74 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: fleet_phase.c                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Per-device phase offsets (load spreading)   *
+ ************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+
+#include "fleet_phase.h"
+#include "device_config.h"
+
+static const char *TAG = "FleetPhase";
+
+static uint8_t s_mac[6];
+static bool s_mac_read = false;
+
+// 32-bit hash of MAC + salt (FNV-1a followed by a final avalanche, since
+// units of one batch differ only in the last MAC bytes)
+static uint32_t fleet_hash(fleet_salt_t salt)
+{
+    if (!s_mac_read) {
+        if (esp_read_mac(s_mac, ESP_MAC_WIFI_STA) != ESP_OK) {
+            ESP_LOGW(TAG, "⚠️ Cannot read MAC, using phase 0");
+        }
+        s_mac_read = true;
+    }
+
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        hash ^= s_mac[i];
+        hash *= 16777619u;
+    }
+    hash ^= (uint32_t)salt;
+    hash *= 16777619u;
+
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+uint32_t fleet_phase_ms(fleet_salt_t salt, uint32_t window_ms)
+{
+    if (window_ms == 0) {
+        return 0;
+    }
+    // Scale instead of modulo: even spread for any window size
+    return (uint32_t)(((uint64_t)fleet_hash(salt) * window_ms) >> 32);
+}
+
+uint32_t fleet_spread_ms(void)
+{
+    char *endptr;
+    unsigned long spread = strtoul(poll_spread_ms, &endptr, 10);
+
+    if (endptr == poll_spread_ms || *endptr != '\0') {
+        spread = strtoul(DEFAULT_POLL_SPREAD_MS, NULL, 10);
+    }
+    return (uint32_t)spread;
+}
+
+uint32_t fleet_skew_interval(uint32_t interval_ms)
+{
+    // [-SKEW, +SKEW] percent in steps of 0.1%
+    int32_t permille = (int32_t)fleet_phase_ms(FLEET_SALT_INTERVAL, FLEET_INTERVAL_SKEW_PCT * 20 + 1)
+                       - FLEET_INTERVAL_SKEW_PCT * 10;
+    return (uint32_t)((int64_t)interval_ms * (1000 + permille) / 1000);
+}
@@ -0,0 +1,44 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: fleet_phase.h                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Per-device phase offsets (load spreading)   *
+ ************************************************************/
+
+#ifndef FLEET_PHASE_H
+#define FLEET_PHASE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLEET_INTERVAL_SKEW_PCT    5       // Per-device stretch of poll intervals (+/-)
+
+// Independent offsets for the different schedules
+typedef enum {
+    FLEET_SALT_FIRST_POLL = 1,      // First poll after boot / Wi-Fi (re)connect
+    FLEET_SALT_OTA,                 // Periodic GitHub release check
+    FLEET_SALT_INTERVAL,            // Poll interval skew
+} fleet_salt_t;
+
+/**
+ * @brief Deterministic per-device offset in [0, window_ms)
+ *
+ * Derived from the Wi-Fi MAC, so a unit always lands on the same slot of
+ * the window while the fleet is spread evenly over it.
+ */
+uint32_t fleet_phase_ms(fleet_salt_t salt, uint32_t window_ms);
+
+// Configured spread window for the first poll after a (re)connect (poll_spread_ms)
+uint32_t fleet_spread_ms(void);
+
+// interval_ms stretched by this device's skew (within +/- FLEET_INTERVAL_SKEW_PCT)
+uint32_t fleet_skew_interval(uint32_t interval_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLEET_PHASE_H
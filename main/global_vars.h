@@ -11,6 +11,8 @@
 extern "C" {
 #endif
 
+#define CURRENT_FIRMWARE_VERSION "3.6.1"
+
 // Global variables declarations
 extern bool ota_in_progress;
 
@@ -0,0 +1,577 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: http2.c                                            *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: HTTP/2 framing and HPACK for the API client *
+ ************************************************************/
+
+#include <string.h>
+#include <strings.h>
+
+#include "http2.h"
+
+#define HTTP2_PREFACE               "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define HTTP2_SETTINGS_HEADER_TABLE_SIZE    0x1
+#define HTTP2_SETTINGS_ENABLE_PUSH          0x2
+
+#define HPACK_STATIC_COUNT          61
+#define HPACK_IDX_AUTHORITY         1
+#define HPACK_IDX_METHOD_GET        2
+#define HPACK_IDX_PATH              4
+#define HPACK_IDX_SCHEME_HTTPS      7
+#define HPACK_HUFFMAN_MAX_BITS      30
+
+// RFC 7541 Appendix A
+static const char *const s_static_table[HPACK_STATIC_COUNT + 1][2] = {
+    { "", "" },
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" },
+};
+
+// RFC 7541 Appendix B as a canonical code: number of codes of each bit
+// length, then the symbols in code order (EOS, the last 30-bit code, is
+// not listed: decoding it is an error)
+static const uint8_t s_huff_count[HPACK_HUFFMAN_MAX_BITS + 1] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+static const uint8_t s_huff_symbols[256] = {
+     48,  49,  50,  97,  99, 101, 105, 111, 115, 116,  32,  37,  45,  46,  47,  51,
+     52,  53,  54,  55,  56,  57,  61,  65,  95,  98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117,  58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+     77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  89, 106, 107, 113, 118,
+    119, 120, 121, 122,  38,  42,  44,  59,  88,  90,  33,  34,  40,  41,  63,  39,
+     43, 124,  35,  62,   0,  36,  64,  91,  93, 126,  94, 125,  60,  96, 123,  92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233,   1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239,   9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+      2,   3,   4,   5,   6,   7,   8,  11,  12,  14,  15,  16,  17,  18,  19,  20,
+     21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220, 249,  10,  13,  22,
+};
+
+// Connection-specific headers HTTP/2 forbids
+static const char *const s_dropped_headers[] = {
+    "host", "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade", "te",
+};
+
+// ---------------------------------------------------------------------------
+// Frames
+// ---------------------------------------------------------------------------
+
+static void http2_put32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static void http2_frame_header_encode(uint8_t *out, uint32_t length, uint8_t type, uint8_t flags,
+                                      uint32_t stream_id)
+{
+    out[0] = (uint8_t)(length >> 16);
+    out[1] = (uint8_t)(length >> 8);
+    out[2] = (uint8_t)length;
+    out[3] = type;
+    out[4] = flags;
+    http2_put32(out + 5, stream_id & HTTP2_MAX_STREAM_ID);
+}
+
+void http2_frame_header_decode(const uint8_t *in, http2_frame_t *frame)
+{
+    frame->length = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+    frame->type = in[3];
+    frame->flags = in[4];
+    frame->stream_id = (((uint32_t)in[5] << 24) | ((uint32_t)in[6] << 16) |
+                        ((uint32_t)in[7] << 8) | in[8]) & HTTP2_MAX_STREAM_ID;
+}
+
+size_t http2_client_preface(uint8_t *out, size_t size)
+{
+    size_t magic_len = sizeof(HTTP2_PREFACE) - 1;
+    size_t len = magic_len + HTTP2_FRAME_HEADER_SIZE + 12;
+
+    if (size < len) {
+        return 0;
+    }
+    memcpy(out, HTTP2_PREFACE, magic_len);
+    uint8_t *p = out + magic_len;
+    http2_frame_header_encode(p, 12, HTTP2_FRAME_SETTINGS, 0, 0);
+    p += HTTP2_FRAME_HEADER_SIZE;
+    p[0] = 0;
+    p[1] = HTTP2_SETTINGS_HEADER_TABLE_SIZE;
+    http2_put32(p + 2, 0);
+    p[6] = 0;
+    p[7] = HTTP2_SETTINGS_ENABLE_PUSH;
+    http2_put32(p + 8, 0);
+    return len;
+}
+
+size_t http2_settings_ack(uint8_t *out)
+{
+    http2_frame_header_encode(out, 0, HTTP2_FRAME_SETTINGS, HTTP2_FLAG_ACK, 0);
+    return HTTP2_SETTINGS_ACK_SIZE;
+}
+
+size_t http2_window_update(uint8_t *out, uint32_t stream_id, uint32_t increment)
+{
+    http2_frame_header_encode(out, 4, HTTP2_FRAME_WINDOW_UPDATE, 0, stream_id);
+    http2_put32(out + HTTP2_FRAME_HEADER_SIZE, increment & HTTP2_MAX_STREAM_ID);
+    return HTTP2_WINDOW_UPDATE_SIZE;
+}
+
+size_t http2_rst_stream(uint8_t *out, uint32_t stream_id, http2_error_t error)
+{
+    http2_frame_header_encode(out, 4, HTTP2_FRAME_RST_STREAM, 0, stream_id);
+    http2_put32(out + HTTP2_FRAME_HEADER_SIZE, error);
+    return HTTP2_RST_STREAM_SIZE;
+}
+
+size_t http2_ping_ack(uint8_t *out, const uint8_t *opaque)
+{
+    http2_frame_header_encode(out, 8, HTTP2_FRAME_PING, HTTP2_FLAG_ACK, 0);
+    memcpy(out + HTTP2_FRAME_HEADER_SIZE, opaque, 8);
+    return HTTP2_PING_SIZE;
+}
+
+size_t http2_goaway(uint8_t *out, uint32_t last_stream_id, http2_error_t error)
+{
+    http2_frame_header_encode(out, 8, HTTP2_FRAME_GOAWAY, 0, 0);
+    http2_put32(out + HTTP2_FRAME_HEADER_SIZE, last_stream_id & HTTP2_MAX_STREAM_ID);
+    http2_put32(out + HTTP2_FRAME_HEADER_SIZE + 4, error);
+    return HTTP2_GOAWAY_SIZE;
+}
+
+// ---------------------------------------------------------------------------
+// HPACK encoding (literals only)
+// ---------------------------------------------------------------------------
+
+// Integer with an N-bit prefix (RFC 7541 5.1). Returns bytes written or 0
+static size_t hpack_put_int(uint8_t *out, size_t size, uint8_t first, int prefix_bits, uint32_t value)
+{
+    uint32_t max = (1u << prefix_bits) - 1;
+    size_t n = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    if (value < max) {
+        out[n++] = first | (uint8_t)value;
+        return n;
+    }
+    out[n++] = first | (uint8_t)max;
+    value -= max;
+    while (value >= 0x80) {
+        if (n >= size) {
+            return 0;
+        }
+        out[n++] = (uint8_t)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    if (n >= size) {
+        return 0;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Raw (not Huffman-coded) string literal. Returns bytes written or 0
+static size_t hpack_put_string(uint8_t *out, size_t size, const char *str, size_t len)
+{
+    size_t n = hpack_put_int(out, size, 0x00, 7, (uint32_t)len);
+    if (n == 0 || size - n < len) {
+        return 0;
+    }
+    memcpy(out + n, str, len);
+    return n + len;
+}
+
+// Static table entry carrying this name, 0 if none
+static uint32_t hpack_static_name(const char *name)
+{
+    for (uint32_t i = 1; i <= HPACK_STATIC_COUNT; i++) {
+        if (strcmp(s_static_table[i][0], name) == 0) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// Literal header field without indexing (RFC 7541 6.2.2). Returns bytes written or 0
+static size_t hpack_put_field(uint8_t *out, size_t size, const char *name, const char *value, size_t value_len)
+{
+    uint32_t index = hpack_static_name(name);
+    size_t n = hpack_put_int(out, size, 0x00, 4, index);
+    size_t m;
+
+    if (n == 0) {
+        return 0;
+    }
+    if (index == 0) {
+        if ((m = hpack_put_string(out + n, size - n, name, strlen(name))) == 0) {
+            return 0;
+        }
+        n += m;
+    }
+    if ((m = hpack_put_string(out + n, size - n, value, value_len)) == 0) {
+        return 0;
+    }
+    return n + m;
+}
+
+// Finds the end of the line starting at p (before CRLF or LF); NULL if unterminated
+static const char *http2_line_end(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+    if (nl == NULL) {
+        return NULL;
+    }
+    return (nl > p && nl[-1] == '\r') ? nl - 1 : nl;
+}
+
+static const char *http2_skip_eol(const char *eol)
+{
+    return (*eol == '\r') ? eol + 2 : eol + 1;
+}
+
+static bool http2_dropped_header(const char *name)
+{
+    for (size_t i = 0; i < sizeof(s_dropped_headers) / sizeof(s_dropped_headers[0]); i++) {
+        if (strcmp(name, s_dropped_headers[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Splits "Name: value" into a lowercase name and a trimmed value
+static bool http2_split_header(const char *line, const char *eol, char *name, size_t name_size,
+                               const char **value, size_t *value_len)
+{
+    const char *colon = memchr(line, ':', eol - line);
+    size_t name_len;
+
+    if (colon == NULL || colon == line || (size_t)(colon - line) >= name_size) {
+        return false;
+    }
+    name_len = colon - line;
+    for (size_t i = 0; i < name_len; i++) {
+        char c = line[i];
+        name[i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+    }
+    name[name_len] = '\0';
+
+    const char *v = colon + 1;
+    while (v < eol && (*v == ' ' || *v == '\t')) {
+        v++;
+    }
+    const char *v_end = eol;
+    while (v_end > v && (v_end[-1] == ' ' || v_end[-1] == '\t')) {
+        v_end--;
+    }
+    *value = v;
+    *value_len = v_end - v;
+    return true;
+}
+
+int http2_request_from_http1(const char *request, size_t len, size_t *consumed,
+                             uint32_t stream_id, uint8_t *out, size_t size)
+{
+    const char *end = request + len;
+    const char *p = request;
+    const char *eol;
+    const char *target;
+    const char *target_end;
+    const char *authority = "";
+    size_t authority_len = 0;
+    char name[HTTP2_NAME_SIZE];
+    const char *value;
+    size_t value_len;
+    size_t n = HTTP2_FRAME_HEADER_SIZE;
+    size_t m;
+
+    if (size <= HTTP2_FRAME_HEADER_SIZE || (eol = http2_line_end(p, end)) == NULL ||
+        strncmp(p, "GET ", 4) != 0) {
+        return -1;
+    }
+    target = p + 4;
+    target_end = memchr(target, ' ', eol - target);
+    if (target_end == NULL) {
+        return -1;
+    }
+    // Absolute form (web_url): the path only, the authority comes from Host
+    size_t scheme_len = (strncmp(target, "https://", 8) == 0) ? 8 :
+                        (strncmp(target, "http://", 7) == 0) ? 7 : 0;
+    if (scheme_len > 0) {
+        const char *path = memchr(target + scheme_len, '/', target_end - (target + scheme_len));
+        if (path != NULL) {
+            target = path;
+        } else {
+            target = "/";
+            target_end = target + 1;
+        }
+    }
+
+    // Host first: pseudo-header fields precede all the others
+    const char *headers = http2_skip_eol(eol);
+    for (p = headers; (eol = http2_line_end(p, end)) != NULL && eol != p; p = http2_skip_eol(eol)) {
+        if (http2_split_header(p, eol, name, sizeof(name), &value, &value_len) &&
+            strcmp(name, "host") == 0) {
+            authority = value;
+            authority_len = value_len;
+        }
+    }
+    if (eol == NULL) {
+        return -1;      // No empty line: truncated request
+    }
+    *consumed = http2_skip_eol(eol) - request;
+
+    if ((m = hpack_put_int(out + n, size - n, 0x80, 7, HPACK_IDX_METHOD_GET)) == 0) {
+        return -1;
+    }
+    n += m;
+    if ((m = hpack_put_int(out + n, size - n, 0x80, 7, HPACK_IDX_SCHEME_HTTPS)) == 0) {
+        return -1;
+    }
+    n += m;
+    if ((m = hpack_put_field(out + n, size - n, s_static_table[HPACK_IDX_AUTHORITY][0],
+                             authority, authority_len)) == 0) {
+        return -1;
+    }
+    n += m;
+    if ((m = hpack_put_field(out + n, size - n, s_static_table[HPACK_IDX_PATH][0],
+                             target, target_end - target)) == 0) {
+        return -1;
+    }
+    n += m;
+
+    for (p = headers; (eol = http2_line_end(p, end)) != NULL && eol != p; p = http2_skip_eol(eol)) {
+        if (!http2_split_header(p, eol, name, sizeof(name), &value, &value_len) ||
+            http2_dropped_header(name)) {
+            continue;
+        }
+        if ((m = hpack_put_field(out + n, size - n, name, value, value_len)) == 0) {
+            return -1;
+        }
+        n += m;
+    }
+
+    http2_frame_header_encode(out, (uint32_t)(n - HTTP2_FRAME_HEADER_SIZE), HTTP2_FRAME_HEADERS,
+                              HTTP2_FLAG_END_STREAM | HTTP2_FLAG_END_HEADERS, stream_id);
+    return (int)n;
+}
+
+// ---------------------------------------------------------------------------
+// HPACK decoding
+// ---------------------------------------------------------------------------
+
+static int hpack_get_int(const uint8_t *in, size_t len, size_t *pos, int prefix_bits, uint32_t *value)
+{
+    uint32_t max = (1u << prefix_bits) - 1;
+    uint32_t v;
+    int shift = 0;
+
+    if (*pos >= len) {
+        return -1;
+    }
+    v = in[(*pos)++] & max;
+    if (v < max) {
+        *value = v;
+        return 0;
+    }
+    while (true) {
+        if (*pos >= len || shift > 21) {
+            return -1;
+        }
+        uint8_t b = in[(*pos)++];
+        v += (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+        if ((b & 0x80) == 0) {
+            break;
+        }
+    }
+    *value = v;
+    return 0;
+}
+
+// Huffman-coded string into out (truncated to size - 1)
+static int hpack_huffman_decode(const uint8_t *in, size_t len, char *out, size_t size)
+{
+    uint32_t code = 0;
+    uint32_t first = 0;
+    uint32_t index = 0;
+    int bits = 0;
+    bool ones = true;           // Bits of the pending code are all 1 (valid padding so far)
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        for (int b = 7; b >= 0; b--) {
+            uint32_t bit = (in[i] >> b) & 1;
+            uint32_t count;
+
+            code |= bit;
+            bits++;
+            count = s_huff_count[bits];
+            if (code - first < count) {
+                index += code - first;
+                if (index >= sizeof(s_huff_symbols)) {
+                    return -1;  // EOS inside a string
+                }
+                if (n < size - 1) {
+                    out[n++] = (char)s_huff_symbols[index];
+                }
+                code = first = index = 0;
+                bits = 0;
+                ones = true;
+                continue;
+            }
+            ones = ones && bit;
+            if (bits >= HPACK_HUFFMAN_MAX_BITS) {
+                return -1;
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+    }
+    out[n] = '\0';
+    // Padding: the most significant bits of EOS, at most 7 of them
+    return (bits <= 7 && ones) ? 0 : -1;
+}
+
+static int hpack_get_string(const uint8_t *in, size_t len, size_t *pos, char *out, size_t size)
+{
+    uint32_t str_len;
+    bool huffman;
+
+    if (*pos >= len) {
+        return -1;
+    }
+    huffman = (in[*pos] & 0x80) != 0;
+    if (hpack_get_int(in, len, pos, 7, &str_len) != 0 || str_len > len - *pos) {
+        return -1;
+    }
+    if (huffman) {
+        if (hpack_huffman_decode(in + *pos, str_len, out, size) != 0) {
+            return -1;
+        }
+    } else {
+        size_t copy = (str_len < size - 1) ? str_len : size - 1;
+        memcpy(out, in + *pos, copy);
+        out[copy] = '\0';
+    }
+    *pos += str_len;
+    return 0;
+}
+
+int http2_decode_headers(const uint8_t *block, size_t len, http2_header_cb_t cb, void *ctx)
+{
+    char name[HTTP2_NAME_SIZE];
+    char value[HTTP2_VALUE_SIZE];
+    size_t pos = 0;
+
+    while (pos < len) {
+        uint8_t b = block[pos];
+        uint32_t index;
+        int prefix_bits;
+
+        if (b & 0x80) {
+            // Indexed field: only the static table exists
+            if (hpack_get_int(block, len, &pos, 7, &index) != 0 ||
+                index == 0 || index > HPACK_STATIC_COUNT) {
+                return -1;
+            }
+            cb(s_static_table[index][0], s_static_table[index][1], ctx);
+            continue;
+        }
+        if ((b & 0xe0) == 0x20) {
+            // Dynamic table size update: never above the 0 we announced
+            if (hpack_get_int(block, len, &pos, 5, &index) != 0 || index != 0) {
+                return -1;
+            }
+            continue;
+        }
+        // Literal with incremental indexing (kept nowhere: the table holds
+        // 0 bytes), without indexing or never indexed
+        prefix_bits = ((b & 0xc0) == 0x40) ? 6 : 4;
+        if (hpack_get_int(block, len, &pos, prefix_bits, &index) != 0 || index > HPACK_STATIC_COUNT) {
+            return -1;
+        }
+        if (index == 0) {
+            if (hpack_get_string(block, len, &pos, name, sizeof(name)) != 0) {
+                return -1;
+            }
+        } else {
+            strlcpy(name, s_static_table[index][0], sizeof(name));
+        }
+        if (hpack_get_string(block, len, &pos, value, sizeof(value)) != 0) {
+            return -1;
+        }
+        cb(name, value, ctx);
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: http2.h                                            *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: HTTP/2 framing and HPACK for the API client *
+ ************************************************************/
+
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pure encoding/decoding: the caller owns the connection and does the I/O.
+// The client announces an HPACK dynamic table of size 0, so the server
+// never references earlier header blocks and decoding keeps no state.
+
+#define HTTP2_ALPN                  "h2"
+#define HTTP2_FRAME_HEADER_SIZE     9
+#define HTTP2_DEFAULT_WINDOW        65535   // Initial flow-control window (connection and streams)
+#define HTTP2_DEFAULT_MAX_STREAMS   100     // Assumed until the server says otherwise
+#define HTTP2_MAX_STREAM_ID         0x7fffffffu
+#define HTTP2_NAME_SIZE             48      // Longer header names are truncated
+#define HTTP2_VALUE_SIZE            192     // Longer header values are truncated
+
+// Bytes needed by the fixed-size control frames below
+#define HTTP2_SETTINGS_ACK_SIZE     HTTP2_FRAME_HEADER_SIZE
+#define HTTP2_WINDOW_UPDATE_SIZE    (HTTP2_FRAME_HEADER_SIZE + 4)
+#define HTTP2_RST_STREAM_SIZE       (HTTP2_FRAME_HEADER_SIZE + 4)
+#define HTTP2_PING_SIZE             (HTTP2_FRAME_HEADER_SIZE + 8)
+#define HTTP2_GOAWAY_SIZE           (HTTP2_FRAME_HEADER_SIZE + 8)
+
+typedef enum {
+    HTTP2_FRAME_DATA = 0x0,
+    HTTP2_FRAME_HEADERS = 0x1,
+    HTTP2_FRAME_PRIORITY = 0x2,
+    HTTP2_FRAME_RST_STREAM = 0x3,
+    HTTP2_FRAME_SETTINGS = 0x4,
+    HTTP2_FRAME_PUSH_PROMISE = 0x5,
+    HTTP2_FRAME_PING = 0x6,
+    HTTP2_FRAME_GOAWAY = 0x7,
+    HTTP2_FRAME_WINDOW_UPDATE = 0x8,
+    HTTP2_FRAME_CONTINUATION = 0x9
+} http2_frame_type_t;
+
+#define HTTP2_FLAG_END_STREAM       0x01
+#define HTTP2_FLAG_ACK              0x01    // SETTINGS, PING
+#define HTTP2_FLAG_END_HEADERS      0x04
+#define HTTP2_FLAG_PADDED           0x08
+#define HTTP2_FLAG_PRIORITY         0x20
+
+#define HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS   0x3
+
+typedef enum {
+    HTTP2_NO_ERROR = 0x0,
+    HTTP2_PROTOCOL_ERROR = 0x1,
+    HTTP2_INTERNAL_ERROR = 0x2,
+    HTTP2_FLOW_CONTROL_ERROR = 0x3,
+    HTTP2_REFUSED_STREAM = 0x7,
+    HTTP2_CANCEL = 0x8,
+    HTTP2_COMPRESSION_ERROR = 0x9
+} http2_error_t;
+
+typedef struct {
+    uint32_t length;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream_id;
+} http2_frame_t;
+
+void http2_frame_header_decode(const uint8_t *in, http2_frame_t *frame);
+
+/**
+ * @brief Client connection preface: magic string and initial SETTINGS
+ *
+ * Server push off, HPACK dynamic table 0, max_frame_size default.
+ *
+ * @return Bytes written, 0 if size is too small
+ */
+size_t http2_client_preface(uint8_t *out, size_t size);
+
+size_t http2_settings_ack(uint8_t *out);
+size_t http2_window_update(uint8_t *out, uint32_t stream_id, uint32_t increment);
+size_t http2_rst_stream(uint8_t *out, uint32_t stream_id, http2_error_t error);
+size_t http2_ping_ack(uint8_t *out, const uint8_t *opaque);
+size_t http2_goaway(uint8_t *out, uint32_t last_stream_id, http2_error_t error);
+
+/**
+ * @brief Turns one HTTP/1.1 GET (request line, headers, empty line) into a
+ *        HEADERS frame with END_STREAM
+ *
+ * Host becomes :authority, an absolute target its path, header names are
+ * lowercased and connection-specific headers dropped. Nothing is
+ * Huffman-coded or indexed.
+ *
+ * @param request  HTTP/1.1 request text
+ * @param len      Its length; *consumed receives the bytes it took (the
+ *                 text may hold more pipelined requests)
+ * @return Frame length, or -1 if the request is malformed or out is too small
+ */
+int http2_request_from_http1(const char *request, size_t len, size_t *consumed,
+                             uint32_t stream_id, uint8_t *out, size_t size);
+
+// Receives every decoded field; name is lowercase, both are NUL-terminated
+typedef void (*http2_header_cb_t)(const char *name, const char *value, void *ctx);
+
+/**
+ * @brief Decodes one complete header block (HEADERS + CONTINUATION payloads)
+ *
+ * @return 0, or -1 on a compression error (connection error for HTTP/2)
+ */
+int http2_decode_headers(const uint8_t *block, size_t len, http2_header_cb_t cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP2_H
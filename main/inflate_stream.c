@@ -0,0 +1,294 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: inflate_stream.c                                   *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Streaming gzip/deflate decoder (ROM tinfl)  *
+ ************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "miniz.h"
+
+#include "inflate_stream.h"
+
+static const char *TAG = "Inflate";
+
+// gzip header flags (RFC 1952)
+#define GZIP_FHCRC      0x02
+#define GZIP_FEXTRA     0x04
+#define GZIP_FNAME      0x08
+#define GZIP_FCOMMENT   0x10
+#define GZIP_RESERVED   0xe0
+
+typedef enum {
+    ST_GZIP_HEADER = 0,     // 10 fixed bytes
+    ST_GZIP_EXTRA_LEN,      // FEXTRA: 2-byte length
+    ST_GZIP_EXTRA,          // FEXTRA: payload, skipped
+    ST_GZIP_NAME,           // FNAME: up to NUL
+    ST_GZIP_COMMENT,        // FCOMMENT: up to NUL
+    ST_GZIP_HCRC,           // FHCRC: 2 bytes, not checked
+    ST_DEFLATE_DETECT,      // First 2 bytes: zlib header or raw deflate
+    ST_BODY,
+    ST_GZIP_TRAILER,        // CRC32 and ISIZE
+    ST_END,
+    ST_ERROR
+} inflate_state_t;
+
+struct inflate_stream {
+    tinfl_decompressor tinfl;
+    uint8_t window[TINFL_LZ_DICT_SIZE];    // tinfl's circular output: decoded data lives here
+    uint8_t format;
+    uint8_t state;
+    uint8_t gzip_flags;
+    uint32_t tinfl_flags;
+    uint8_t hdr[10];            // Header/trailer bytes collected so far
+    uint8_t hdr_len;
+    uint16_t extra_left;
+    size_t window_pos;          // Where tinfl writes next
+    size_t pending_pos;         // Decoded bytes not handed out yet: window[pending_pos..]
+    size_t pending;
+    uint32_t crc;
+    uint32_t decoded;           // Bytes out of tinfl (gzip ISIZE check)
+    uint32_t total_in;
+    uint32_t total_out;
+};
+
+inflate_stream_t *inflate_stream_create(inflate_stream_format_t format)
+{
+    inflate_stream_t *s = malloc(sizeof(*s));
+
+    if (s == NULL) {
+        ESP_LOGE(TAG, "❌ No memory for the decoder (%u bytes)", (unsigned)sizeof(*s));
+        return NULL;
+    }
+    // The window needs no clearing: tinfl only reads back what it wrote
+    memset(&s->format, 0, sizeof(*s) - offsetof(inflate_stream_t, format));
+    s->format = format;
+    s->state = (format == INFLATE_STREAM_GZIP) ? ST_GZIP_HEADER : ST_DEFLATE_DETECT;
+    return s;
+}
+
+void inflate_stream_free(inflate_stream_t *s)
+{
+    free(s);
+}
+
+uint32_t inflate_stream_total_in(const inflate_stream_t *s)
+{
+    return s->total_in;
+}
+
+uint32_t inflate_stream_total_out(const inflate_stream_t *s)
+{
+    return s->total_out;
+}
+
+static uint32_t inflate_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void inflate_body_start(inflate_stream_t *s)
+{
+    tinfl_init(&s->tinfl);
+    s->state = ST_BODY;
+}
+
+// Next optional gzip header field after state, or the body
+static void inflate_gzip_next_field(inflate_stream_t *s, inflate_state_t state)
+{
+    s->hdr_len = 0;
+    if (state < ST_GZIP_EXTRA_LEN && (s->gzip_flags & GZIP_FEXTRA)) {
+        s->state = ST_GZIP_EXTRA_LEN;
+    } else if (state < ST_GZIP_NAME && (s->gzip_flags & GZIP_FNAME)) {
+        s->state = ST_GZIP_NAME;
+    } else if (state < ST_GZIP_COMMENT && (s->gzip_flags & GZIP_FCOMMENT)) {
+        s->state = ST_GZIP_COMMENT;
+    } else if (state < ST_GZIP_HCRC && (s->gzip_flags & GZIP_FHCRC)) {
+        s->state = ST_GZIP_HCRC;
+    } else {
+        inflate_body_start(s);
+    }
+}
+
+// One byte of framing (gzip header or trailer, deflate detection).
+// Returns false on a malformed stream.
+static bool inflate_frame_byte(inflate_stream_t *s, uint8_t c)
+{
+    switch (s->state) {
+    case ST_GZIP_HEADER:
+        s->hdr[s->hdr_len++] = c;
+        if (s->hdr_len < 10) {
+            return true;
+        }
+        if (s->hdr[0] != 0x1f || s->hdr[1] != 0x8b || s->hdr[2] != 8 || (s->hdr[3] & GZIP_RESERVED)) {
+            ESP_LOGE(TAG, "Not a gzip stream");
+            return false;
+        }
+        s->gzip_flags = s->hdr[3];
+        inflate_gzip_next_field(s, ST_GZIP_HEADER);
+        return true;
+
+    case ST_GZIP_EXTRA_LEN:
+        s->hdr[s->hdr_len++] = c;
+        if (s->hdr_len == 2) {
+            s->extra_left = s->hdr[0] | (s->hdr[1] << 8);
+            s->hdr_len = 0;
+            s->state = ST_GZIP_EXTRA;
+            if (s->extra_left == 0) {
+                inflate_gzip_next_field(s, ST_GZIP_EXTRA);
+            }
+        }
+        return true;
+
+    case ST_GZIP_EXTRA:
+        if (--s->extra_left == 0) {
+            inflate_gzip_next_field(s, ST_GZIP_EXTRA);
+        }
+        return true;
+
+    case ST_GZIP_NAME:
+    case ST_GZIP_COMMENT:
+        if (c == 0) {
+            inflate_gzip_next_field(s, (inflate_state_t)s->state);
+        }
+        return true;
+
+    case ST_GZIP_HCRC:
+        if (++s->hdr_len == 2) {
+            inflate_gzip_next_field(s, ST_GZIP_HCRC);
+        }
+        return true;
+
+    case ST_DEFLATE_DETECT:
+        s->hdr[s->hdr_len++] = c;
+        if (s->hdr_len == 2) {
+            // CM 8, window <= 32 KB and the FCHECK multiple of 31: zlib.
+            // Anything else is taken as raw deflate. The two bytes stay
+            // in hdr and are fed to tinfl first.
+            uint8_t cmf = s->hdr[0];
+            if ((cmf & 0x0f) == 8 && (cmf >> 4) <= 7 && ((cmf << 8) | s->hdr[1]) % 31 == 0) {
+                s->tinfl_flags = TINFL_FLAG_PARSE_ZLIB_HEADER;
+            }
+            inflate_body_start(s);
+        }
+        return true;
+
+    case ST_GZIP_TRAILER:
+        s->hdr[s->hdr_len++] = c;
+        if (s->hdr_len < 8) {
+            return true;
+        }
+        if (inflate_le32(s->hdr) != s->crc || inflate_le32(s->hdr + 4) != s->decoded) {
+            ESP_LOGE(TAG, "gzip trailer mismatch (crc %08lx/%08lx, size %lu/%lu)",
+                     (unsigned long)inflate_le32(s->hdr), (unsigned long)s->crc,
+                     (unsigned long)inflate_le32(s->hdr + 4), (unsigned long)s->decoded);
+            return false;
+        }
+        s->state = ST_END;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Runs tinfl once on the buffered detection bytes or on the caller's
+// input. Returns false on corrupt data, *stalled when it needs more input.
+static bool inflate_body(inflate_stream_t *s, const uint8_t *in, size_t in_size, size_t *in_pos,
+                         bool *stalled)
+{
+    bool from_hdr = (s->hdr_len > 0);
+    const uint8_t *src = from_hdr ? s->hdr : in + *in_pos;
+    size_t src_len = from_hdr ? s->hdr_len : in_size - *in_pos;
+    size_t produced = sizeof(s->window) - s->window_pos;
+
+    tinfl_status status = tinfl_decompress(&s->tinfl, src, &src_len, s->window,
+                                           s->window + s->window_pos, &produced,
+                                           s->tinfl_flags | TINFL_FLAG_HAS_MORE_INPUT);
+    if (from_hdr) {
+        memmove(s->hdr, s->hdr + src_len, s->hdr_len - src_len);
+        s->hdr_len -= src_len;
+    } else {
+        *in_pos += src_len;
+    }
+    if (produced > 0) {
+        if (s->format == INFLATE_STREAM_GZIP) {
+            s->crc = esp_rom_crc32_le(s->crc, s->window + s->window_pos, produced);
+        }
+        s->pending_pos = s->window_pos;
+        s->pending = produced;
+        s->decoded += produced;
+        s->window_pos = (s->window_pos + produced) & (sizeof(s->window) - 1);
+    }
+
+    if (status < TINFL_STATUS_DONE) {
+        ESP_LOGE(TAG, "Corrupt %s data (tinfl %d)",
+                 (s->format == INFLATE_STREAM_GZIP) ? "gzip" : "deflate", (int)status);
+        return false;
+    }
+    if (status == TINFL_STATUS_DONE) {
+        s->hdr_len = 0;
+        s->state = (s->format == INFLATE_STREAM_GZIP) ? ST_GZIP_TRAILER : ST_END;
+    }
+    *stalled = (status == TINFL_STATUS_NEEDS_MORE_INPUT && produced == 0 && !from_hdr);
+    return true;
+}
+
+inflate_stream_result_t inflate_stream_run(inflate_stream_t *s, const uint8_t *in, size_t *in_len,
+                                           uint8_t *out, size_t *out_len)
+{
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    inflate_stream_result_t ret = INFLATE_STREAM_MORE;
+
+    while (true) {
+        // What tinfl decoded last time goes out before it decodes more
+        if (s->pending > 0) {
+            size_t n = *out_len - out_pos;
+            if (n > s->pending) {
+                n = s->pending;
+            }
+            memcpy(out + out_pos, s->window + s->pending_pos, n);
+            out_pos += n;
+            s->pending_pos += n;
+            s->pending -= n;
+            if (s->pending > 0) {
+                break;      // Output full
+            }
+        }
+        if (s->state == ST_END) {
+            ret = INFLATE_STREAM_DONE;
+            break;
+        }
+        if (s->state == ST_ERROR) {
+            ret = INFLATE_STREAM_ERROR;
+            break;
+        }
+        if (s->state == ST_BODY) {
+            bool stalled = false;
+            if (!inflate_body(s, in, *in_len, &in_pos, &stalled)) {
+                s->state = ST_ERROR;
+            } else if (stalled) {
+                break;      // Input used up
+            }
+            continue;
+        }
+        if (in_pos >= *in_len) {
+            break;
+        }
+        if (!inflate_frame_byte(s, in[in_pos++])) {
+            s->state = ST_ERROR;
+        }
+    }
+
+    s->total_in += in_pos;
+    s->total_out += out_pos;
+    *in_len = in_pos;
+    *out_len = out_pos;
+    return ret;
+}
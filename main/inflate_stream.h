@@ -0,0 +1,60 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: inflate_stream.h                                   *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Streaming gzip/deflate decoder (ROM tinfl)  *
+ ************************************************************/
+
+#ifndef INFLATE_STREAM_H
+#define INFLATE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decodes a Content-Encoding body slice by slice with the inflater in ROM.
+// Memory is one heap block of about 43 KB (the 32 KB deflate window plus
+// the decoder tables), whatever the size of the document.
+
+typedef enum {
+    INFLATE_STREAM_GZIP = 0,    // RFC 1952 framing, CRC32 and size checked
+    INFLATE_STREAM_DEFLATE      // zlib (RFC 1950) or, as some servers send it, raw deflate
+} inflate_stream_format_t;
+
+typedef enum {
+    INFLATE_STREAM_MORE = 0,    // Needs more input or more output space
+    INFLATE_STREAM_DONE,        // End of the compressed stream (trailer checked)
+    INFLATE_STREAM_ERROR        // Corrupt data or checksum mismatch
+} inflate_stream_result_t;
+
+typedef struct inflate_stream inflate_stream_t;
+
+// NULL when out of memory
+inflate_stream_t *inflate_stream_create(inflate_stream_format_t format);
+void inflate_stream_free(inflate_stream_t *s);
+
+/**
+ * @brief Decodes as much as the buffers allow
+ *
+ * @param in      Compressed input
+ * @param in_len  In: bytes available, out: bytes consumed
+ * @param out     Decoded output
+ * @param out_len In: space available, out: bytes written
+ * @return INFLATE_STREAM_MORE until the end of the stream. Bytes after the
+ *         end (e.g. a second gzip member) are left unconsumed.
+ */
+inflate_stream_result_t inflate_stream_run(inflate_stream_t *s, const uint8_t *in, size_t *in_len,
+                                           uint8_t *out, size_t *out_len);
+
+// Compressed bytes consumed and decoded bytes returned so far
+uint32_t inflate_stream_total_in(const inflate_stream_t *s);
+uint32_t inflate_stream_total_out(const inflate_stream_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INFLATE_STREAM_H
@@ -0,0 +1,488 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: json_stream.c                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Incremental (SAX-style) JSON tokenizer      *
+ ************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "esp_log.h"
+
+#include "json_stream.h"
+
+static const char *TAG = "JSON_Stream";
+
+// Tokenizer states
+enum {
+    JS_VALUE = 0,       // Expecting a value
+    JS_ARRAY_FIRST,     // After '[': value or ']'
+    JS_OBJECT_FIRST,    // After '{': key or '}'
+    JS_OBJECT_KEY,      // After ',' inside an object: key
+    JS_COLON,           // After a key
+    JS_AFTER_VALUE,     // ',' or closing bracket
+    JS_STRING,
+    JS_STRING_ESC,
+    JS_STRING_UNICODE,
+    JS_NUMBER,
+    JS_LITERAL,
+    JS_DONE
+};
+
+static bool is_ws(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool parent_is_array(const json_stream_t *js)
+{
+    return js->depth > 0 && ((js->array_mask >> (js->depth - 1)) & 1u);
+}
+
+static const char *current_key(const json_stream_t *js)
+{
+    return (js->depth > 0 && !parent_is_array(js)) ? js->key : "";
+}
+
+static void append_key(json_stream_t *js, char c)
+{
+    if (js->key_len < JSON_STREAM_KEY_SIZE - 1) {
+        js->key[js->key_len++] = c;
+        js->key[js->key_len] = '\0';
+    }
+}
+
+static void append_value(json_stream_t *js, char c)
+{
+    if (js->value_len < JSON_STREAM_VALUE_SIZE - 1) {
+        js->value[js->value_len++] = c;
+        js->value[js->value_len] = '\0';
+    } else {
+        js->value_truncated = true;
+    }
+}
+
+static void append_char(json_stream_t *js, char c)
+{
+    if (js->in_key) {
+        append_key(js, c);
+    } else {
+        append_value(js, c);
+    }
+}
+
+#define JS_REPLACEMENT_CHAR     0xFFFD
+
+static bool is_high_surrogate(uint16_t cu)
+{
+    return cu >= 0xD800 && cu <= 0xDBFF;
+}
+
+static bool is_low_surrogate(uint16_t cu)
+{
+    return cu >= 0xDC00 && cu <= 0xDFFF;
+}
+
+// Appends a code point as UTF-8
+static void append_utf8(json_stream_t *js, uint32_t cp)
+{
+    if (cp < 0x80) {
+        append_char(js, (char)cp);
+    } else if (cp < 0x800) {
+        append_char(js, (char)(0xC0 | (cp >> 6)));
+        append_char(js, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        append_char(js, (char)(0xE0 | (cp >> 12)));
+        append_char(js, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        append_char(js, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        append_char(js, (char)(0xF0 | (cp >> 18)));
+        append_char(js, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        append_char(js, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        append_char(js, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+// A high surrogate not followed by a \u low one stands alone: U+FFFD
+static void flush_surrogate(json_stream_t *js)
+{
+    if (js->esc_high != 0) {
+        append_utf8(js, JS_REPLACEMENT_CHAR);
+        js->esc_high = 0;
+    }
+}
+
+// Appends a \uXXXX code unit. A surrogate pair (\uD83D\uDE00) becomes one
+// 4-byte sequence; a lone surrogate becomes U+FFFD
+static void append_codepoint(json_stream_t *js, uint16_t cu)
+{
+    if (js->esc_high != 0 && is_low_surrogate(cu)) {
+        append_utf8(js, 0x10000 + (((uint32_t)(js->esc_high - 0xD800) << 10) | (cu - 0xDC00)));
+        js->esc_high = 0;
+        return;
+    }
+    flush_surrogate(js);
+    if (is_high_surrogate(cu)) {
+        js->esc_high = cu;
+    } else if (is_low_surrogate(cu)) {
+        append_utf8(js, JS_REPLACEMENT_CHAR);
+    } else {
+        append_utf8(js, cu);
+    }
+}
+
+static void reset_value(json_stream_t *js)
+{
+    js->value_len = 0;
+    js->value[0] = '\0';
+    js->value_truncated = false;
+}
+
+// Emits a scalar and moves to the next state. Returns false if the callback stopped us
+static bool emit_scalar(json_stream_t *js, json_stream_event_t evt)
+{
+    bool keep_going = js->cb ? js->cb(evt, js->depth, current_key(js), js->value, js->ctx) : true;
+    js->state = (js->depth == 0) ? JS_DONE : JS_AFTER_VALUE;
+    return keep_going;
+}
+
+// Returns: 1 ok, 0 stopped by callback, -1 error
+static int open_container(json_stream_t *js, bool is_array)
+{
+    if (js->depth >= JSON_STREAM_MAX_DEPTH) {
+        ESP_LOGE(TAG, "Nesting deeper than %d levels", JSON_STREAM_MAX_DEPTH);
+        return -1;
+    }
+    bool keep_going = true;
+    if (js->cb) {
+        keep_going = js->cb(is_array ? JSON_STREAM_EVT_ARRAY_START : JSON_STREAM_EVT_OBJECT_START,
+                            js->depth, current_key(js), NULL, js->ctx);
+    }
+    js->depth++;
+    if (is_array) {
+        js->array_mask |= (1u << (js->depth - 1));
+        js->state = JS_ARRAY_FIRST;
+    } else {
+        js->array_mask &= ~(1u << (js->depth - 1));
+        js->state = JS_OBJECT_FIRST;
+    }
+    return keep_going ? 1 : 0;
+}
+
+static int close_container(json_stream_t *js, bool is_array)
+{
+    if (js->depth == 0 || parent_is_array(js) != is_array) {
+        return -1;
+    }
+    js->depth--;
+    bool keep_going = true;
+    if (js->cb) {
+        keep_going = js->cb(is_array ? JSON_STREAM_EVT_ARRAY_END : JSON_STREAM_EVT_OBJECT_END,
+                            js->depth, "", NULL, js->ctx);
+    }
+    js->state = (js->depth == 0) ? JS_DONE : JS_AFTER_VALUE;
+    return keep_going ? 1 : 0;
+}
+
+// Starts a value at character c. Returns 1 ok, 0 stopped, -1 error
+static int begin_value(json_stream_t *js, char c)
+{
+    if (c == '{') {
+        return open_container(js, false);
+    }
+    if (c == '[') {
+        return open_container(js, true);
+    }
+    reset_value(js);
+    if (c == '"') {
+        js->in_key = false;
+        js->state = JS_STRING;
+        return 1;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        append_value(js, c);
+        js->state = JS_NUMBER;
+        return 1;
+    }
+    if (c == 't' || c == 'f' || c == 'n') {
+        append_value(js, c);
+        js->state = JS_LITERAL;
+        return 1;
+    }
+    return -1;
+}
+
+void json_stream_init(json_stream_t *js, json_stream_cb_t cb, void *ctx)
+{
+    memset(js, 0, sizeof(*js));
+    js->cb = cb;
+    js->ctx = ctx;
+    js->state = JS_VALUE;
+}
+
+json_stream_result_t json_stream_feed(json_stream_t *js, const char *data, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len) {
+        char c = data[i];
+        int ret = 1;
+
+        switch (js->state) {
+            case JS_DONE:
+                if (!is_ws(c)) {
+                    ESP_LOGW(TAG, "Trailing data after JSON document at offset %u", (unsigned)js->offset);
+                }
+                return JSON_STREAM_COMPLETE;
+
+            case JS_VALUE:
+            case JS_ARRAY_FIRST:
+                if (is_ws(c)) {
+                    break;
+                }
+                if (c == ']' && js->state == JS_ARRAY_FIRST) {
+                    ret = close_container(js, true);
+                } else {
+                    ret = begin_value(js, c);
+                }
+                break;
+
+            case JS_OBJECT_FIRST:
+            case JS_OBJECT_KEY:
+                if (is_ws(c)) {
+                    break;
+                }
+                if (c == '}' && js->state == JS_OBJECT_FIRST) {
+                    ret = close_container(js, false);
+                } else if (c == '"') {
+                    js->in_key = true;
+                    js->key_len = 0;
+                    js->key[0] = '\0';
+                    js->state = JS_STRING;
+                } else {
+                    ret = -1;
+                }
+                break;
+
+            case JS_COLON:
+                if (is_ws(c)) {
+                    break;
+                }
+                if (c == ':') {
+                    js->state = JS_VALUE;
+                } else {
+                    ret = -1;
+                }
+                break;
+
+            case JS_AFTER_VALUE:
+                if (is_ws(c)) {
+                    break;
+                }
+                if (c == ',') {
+                    js->state = parent_is_array(js) ? JS_VALUE : JS_OBJECT_KEY;
+                } else if (c == '}') {
+                    ret = close_container(js, false);
+                } else if (c == ']') {
+                    ret = close_container(js, true);
+                } else {
+                    ret = -1;
+                }
+                break;
+
+            case JS_STRING:
+                if (c == '\\') {
+                    js->state = JS_STRING_ESC;
+                    break;
+                }
+                flush_surrogate(js);
+                if (c == '"') {
+                    if (js->in_key) {
+                        js->in_key = false;
+                        js->state = JS_COLON;
+                    } else {
+                        ret = emit_scalar(js, JSON_STREAM_EVT_STRING) ? 1 : 0;
+                    }
+                } else {
+                    append_char(js, c);
+                }
+                break;
+
+            case JS_STRING_ESC:
+                js->state = JS_STRING;
+                if (c != 'u') {
+                    flush_surrogate(js);
+                }
+                switch (c) {
+                    case 'b': append_char(js, '\b'); break;
+                    case 'f': append_char(js, '\f'); break;
+                    case 'n': append_char(js, '\n'); break;
+                    case 'r': append_char(js, '\r'); break;
+                    case 't': append_char(js, '\t'); break;
+                    case 'u':
+                        js->esc_digits = 0;
+                        js->esc_code = 0;
+                        js->state = JS_STRING_UNICODE;
+                        break;
+                    default:  append_char(js, c); break;   // \" \\ \/
+                }
+                break;
+
+            case JS_STRING_UNICODE: {
+                int nibble;
+                if (c >= '0' && c <= '9') {
+                    nibble = c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    nibble = c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    nibble = c - 'A' + 10;
+                } else {
+                    ret = -1;
+                    break;
+                }
+                js->esc_code = (uint16_t)((js->esc_code << 4) | nibble);
+                if (++js->esc_digits == 4) {
+                    append_codepoint(js, js->esc_code);
+                    js->state = JS_STRING;
+                }
+                break;
+            }
+
+            case JS_NUMBER:
+                if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                    append_value(js, c);
+                    break;
+                }
+                // Terminator belongs to the next token: emit and re-examine it
+                if (!emit_scalar(js, JSON_STREAM_EVT_NUMBER)) {
+                    js->offset += i;
+                    return JSON_STREAM_STOPPED;
+                }
+                continue;
+
+            case JS_LITERAL:
+                if (c >= 'a' && c <= 'z') {
+                    append_value(js, c);
+                    break;
+                }
+                if (strcmp(js->value, "true") == 0 || strcmp(js->value, "false") == 0) {
+                    ret = emit_scalar(js, JSON_STREAM_EVT_BOOL) ? 1 : 0;
+                } else if (strcmp(js->value, "null") == 0) {
+                    ret = emit_scalar(js, JSON_STREAM_EVT_NULL) ? 1 : 0;
+                } else {
+                    ret = -1;
+                    break;
+                }
+                if (ret == 0) {
+                    js->offset += i;
+                    return JSON_STREAM_STOPPED;
+                }
+                continue;
+
+            default:
+                ret = -1;
+                break;
+        }
+
+        if (ret < 0) {
+            ESP_LOGE(TAG, "Malformed JSON at offset %u (char 0x%02x)", (unsigned)(js->offset + i), (unsigned char)c);
+            js->offset += i;
+            return JSON_STREAM_ERROR;
+        }
+        i++;
+        if (ret == 0) {
+            js->offset += i;
+            return JSON_STREAM_STOPPED;
+        }
+    }
+
+    js->offset += len;
+    return (js->state == JS_DONE) ? JSON_STREAM_COMPLETE : JSON_STREAM_CONTINUE;
+}
+
+void json_stream_fields_init(json_stream_fields_t *fields, const char *const *keys, size_t count)
+{
+    memset(fields, 0, sizeof(*fields));
+    if (count > JSON_STREAM_MAX_FIELDS) {
+        count = JSON_STREAM_MAX_FIELDS;
+    }
+    for (size_t i = 0; i < count; i++) {
+        fields->keys[i] = keys[i];
+    }
+    fields->count = count;
+}
+
+bool json_stream_fields_cb(json_stream_event_t evt, int depth, const char *key,
+                           const char *value, void *ctx)
+{
+    json_stream_fields_t *fields = (json_stream_fields_t *)ctx;
+
+    if (depth == 1 && evt == JSON_STREAM_EVT_ARRAY_START) {
+        strlcpy(fields->array, key, sizeof(fields->array));
+        fields->array_first = true;
+        return true;
+    }
+    if (depth == 1 && evt == JSON_STREAM_EVT_ARRAY_END) {
+        fields->array[0] = '\0';
+        return true;
+    }
+    if (depth == 2 && evt == JSON_STREAM_EVT_OBJECT_END) {
+        fields->array_first = false;
+        return true;
+    }
+    if (value == NULL) {
+        return true;
+    }
+    if (depth == 3 && fields->array[0] != '\0' && fields->array_first) {
+        size_t array_len = strlen(fields->array);
+        for (size_t i = 0; i < fields->count; i++) {
+            const char *k = fields->keys[i];
+            if (!fields->found[i] && strncmp(k, fields->array, array_len) == 0 &&
+                strncmp(k + array_len, "[0].", 4) == 0 && strcmp(k + array_len + 4, key) == 0) {
+                strlcpy(fields->values[i], value, JSON_STREAM_FIELD_SIZE);
+                fields->found[i] = true;
+                fields->found_count++;
+                break;
+            }
+        }
+        return fields->found_count < fields->count;
+    }
+    if (depth != 1) {
+        return true;
+    }
+    for (size_t i = 0; i < fields->count; i++) {
+        if (!fields->found[i] && strcmp(key, fields->keys[i]) == 0) {
+            strlcpy(fields->values[i], value, JSON_STREAM_FIELD_SIZE);
+            fields->found[i] = true;
+            fields->found_count++;
+            break;
+        }
+    }
+    return fields->found_count < fields->count;
+}
+
+const char *json_stream_fields_get(const json_stream_fields_t *fields, const char *key)
+{
+    for (size_t i = 0; i < fields->count; i++) {
+        if (fields->found[i] && strcmp(fields->keys[i], key) == 0) {
+            return fields->values[i];
+        }
+    }
+    return NULL;
+}
+
+bool json_stream_parse_int(const char *text, long *out)
+{
+    char *end = NULL;
+    if (text == NULL || *text == '\0') {
+        return false;
+    }
+    errno = 0;
+    long v = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0') {
+        return false;
+    }
+    *out = v;
+    return true;
+}
@@ -0,0 +1,114 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: json_stream.h                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Incremental (SAX-style) JSON tokenizer      *
+ ************************************************************/
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tokenizer limits (the whole state is a few hundred bytes, no heap)
+#define JSON_STREAM_MAX_DEPTH     32      // Nesting levels tracked (bitmask)
+#define JSON_STREAM_KEY_SIZE      48      // Longer keys are truncated
+#define JSON_STREAM_VALUE_SIZE    192     // Longer string values are truncated
+#define JSON_STREAM_MAX_FIELDS    4
+#define JSON_STREAM_FIELD_SIZE    32
+
+typedef enum {
+    JSON_STREAM_EVT_OBJECT_START = 0,
+    JSON_STREAM_EVT_OBJECT_END,
+    JSON_STREAM_EVT_ARRAY_START,
+    JSON_STREAM_EVT_ARRAY_END,
+    JSON_STREAM_EVT_STRING,
+    JSON_STREAM_EVT_NUMBER,
+    JSON_STREAM_EVT_BOOL,
+    JSON_STREAM_EVT_NULL
+} json_stream_event_t;
+
+typedef enum {
+    JSON_STREAM_CONTINUE = 0,   // Need more input
+    JSON_STREAM_STOPPED,        // Callback asked to stop (caller has what it needs)
+    JSON_STREAM_COMPLETE,       // Top-level value fully parsed
+    JSON_STREAM_ERROR           // Malformed input
+} json_stream_result_t;
+
+/**
+ * @brief Token callback
+ *
+ * @param evt   Event type
+ * @param depth Number of containers enclosing the token (root value = 0,
+ *              members of the root object = 1, ...). Start/end events of
+ *              the same container report the same depth.
+ * @param key   Member name when the parent is an object, "" inside arrays
+ *              and for end events
+ * @param value Scalar text (strings unescaped, numbers/literals raw), NULL
+ *              for container events
+ * @param ctx   User context
+ * @return true to keep parsing, false to stop early
+ */
+typedef bool (*json_stream_cb_t)(json_stream_event_t evt, int depth, const char *key,
+                                 const char *value, void *ctx);
+
+typedef struct {
+    json_stream_cb_t cb;
+    void *ctx;
+    uint8_t state;
+    uint8_t depth;
+    uint32_t array_mask;        // Bit n set = container at depth n+1 is an array
+    bool in_key;
+    bool value_truncated;
+    uint8_t key_len;
+    uint16_t value_len;
+    uint8_t esc_digits;
+    uint16_t esc_code;
+    uint16_t esc_high;          // High surrogate waiting for its low half (0 = none)
+    size_t offset;              // Bytes consumed so far (for error reporting)
+    char key[JSON_STREAM_KEY_SIZE];
+    char value[JSON_STREAM_VALUE_SIZE];
+} json_stream_t;
+
+void json_stream_init(json_stream_t *js, json_stream_cb_t cb, void *ctx);
+
+/**
+ * @brief Feed the next slice of the document
+ *
+ * @return JSON_STREAM_CONTINUE while more input is expected
+ */
+json_stream_result_t json_stream_feed(json_stream_t *js, const char *data, size_t len);
+
+// Top-level scalar field extraction (e.g. "totalElements", "idUser"):
+// parsing stops as soon as every requested key has been seen. A key of the
+// form "array[0].name" picks a member of the first object of a top-level
+// array (e.g. "content[0].idFile").
+typedef struct {
+    const char *keys[JSON_STREAM_MAX_FIELDS];
+    char values[JSON_STREAM_MAX_FIELDS][JSON_STREAM_FIELD_SIZE];
+    bool found[JSON_STREAM_MAX_FIELDS];
+    size_t count;
+    size_t found_count;
+    char array[JSON_STREAM_KEY_SIZE];   // Top-level array being read ("" = none)
+    bool array_first;                   // Still in its first element
+} json_stream_fields_t;
+
+void json_stream_fields_init(json_stream_fields_t *fields, const char *const *keys, size_t count);
+bool json_stream_fields_cb(json_stream_event_t evt, int depth, const char *key,
+                           const char *value, void *ctx);
+const char *json_stream_fields_get(const json_stream_fields_t *fields, const char *key);
+
+// Parses a JSON integer token; false if text is not a plain integer
+bool json_stream_parse_int(const char *text, long *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_STREAM_H
@@ -0,0 +1,578 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: lan_share.c                                        *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Count sharing between devices on the LAN    *
+ ************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+
+#include "lan_share.h"
+#include "wifi_manager.h"
+#include "device_config.h"
+#include "global_vars.h"
+
+static const char *TAG = "LanShare";
+
+// Datagram layout (big endian), every message:
+//   0  "FMLS"         4  version       5  type       6  flags      7  0
+//   8  group id      12  node (MAC)   18  boot id   22  sequence
+// RESULT only:
+//  26  age of the count (ms)          30  practices 34  editor practices
+//  38  accounts      39  per-account practices (1 + EXTRA_ACCOUNTS_MAX)
+// then the first LAN_TAG_SIZE bytes of HMAC-SHA256(api_token, all of the above).
+// Counts travel in clear (they are on every desk display anyway), but only
+// a device holding the account's token can produce one that is accepted.
+#define LAN_MAGIC              "FMLS"
+#define LAN_VERSION            1
+#define LAN_MSG_HELLO          1
+#define LAN_MSG_RESULT         2
+#define LAN_FLAG_LEADER        0x01    // Sender polls for the group
+#define LAN_FLAG_FAILING       0x02    // Sender's last poll failed
+#define LAN_HEADER_SIZE        26
+#define LAN_RESULT_SIZE        (13 + 4 * (1 + EXTRA_ACCOUNTS_MAX))
+#define LAN_TAG_SIZE           16
+#define LAN_PACKET_MAX         (LAN_HEADER_SIZE + LAN_RESULT_SIZE + LAN_TAG_SIZE)
+#define LAN_IDLE_CHECK_MS      1000    // Wait while Wi-Fi is down or an OTA is running
+#define LAN_RECV_SLICE_MS      500
+#define LAN_NVS_BOOT_KEY       "boot"
+
+typedef struct {
+    uint8_t node[6];
+    uint32_t boot;              // Grows at every reboot of the peer
+    uint32_t seq;               // Last message accepted from this boot
+    uint32_t heard_ms;
+    uint8_t flags;
+} lan_peer_t;
+
+typedef struct {
+    TaskHandle_t task;
+    SemaphoreHandle_t mutex;
+    int sock;                   // -1 while out of the group
+    uint8_t node[6];
+    uint32_t boot;
+    uint32_t seq;
+    uint32_t group;
+    uint32_t joined_ms;
+    bool leader;
+    bool failing;               // Own last poll failed: not a candidate
+    bool announce;              // Lead taken or given up: say so now
+    bool has_result;            // Own last good count, sent to peers that join
+    net_job_result_t result;
+    uint32_t result_ms;
+    bool has_shared;            // Last count received from a leader
+    uint8_t shared_from[6];
+    uint32_t shared_ms;         // When that leader polled it
+    bool has_latest;
+    uint32_t latest_ms;         // When the count on screen was polled (own or shared)
+    lan_peer_t peers[LAN_SHARE_MAX_PEERS];
+    uint8_t peer_count;
+    lan_peer_t gone[LAN_SHARE_MAX_PEERS];  // Boot and sequence of peers that went quiet
+    uint8_t gone_next;          // Slot the next one overwrites
+} lan_share_state_t;
+
+static lan_share_state_t s_lan = { .sock = -1 };
+
+static void lan_lock(void)
+{
+    xSemaphoreTake(s_lan.mutex, portMAX_DELAY);
+}
+
+static void lan_unlock(void)
+{
+    xSemaphoreGive(s_lan.mutex);
+}
+
+static uint32_t lan_now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static bool lan_can_run(void)
+{
+    return wifi_manager_is_connected() && !ota_in_progress;
+}
+
+// Devices only share when every count they show would be the same: same
+// server, credentials and extra accounts (fingerprint) and working mode
+static uint32_t lan_group_id(void)
+{
+    uint32_t hash = device_config_fingerprint();
+
+    for (const char *p = working_mode; *p != '\0'; p++) {
+        hash ^= (uint8_t)*p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool lan_tag(const uint8_t *msg, size_t len, uint8_t *tag)
+{
+    uint8_t full[32];
+    const mbedtls_md_info_t *md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+
+    if (md == NULL || mbedtls_md_hmac(md, (const uint8_t *)api_token, strlen(api_token),
+                                      msg, len, full) != 0) {
+        return false;
+    }
+    memcpy(tag, full, LAN_TAG_SIZE);
+    return true;
+}
+
+// Constant time: a forger learns nothing from how fast a tag is refused
+static bool lan_tag_ok(const uint8_t *msg, size_t len, const uint8_t *tag)
+{
+    uint8_t expected[LAN_TAG_SIZE];
+    uint8_t diff = 0;
+
+    if (!lan_tag(msg, len, expected)) {
+        return false;
+    }
+    for (int i = 0; i < LAN_TAG_SIZE; i++) {
+        diff |= expected[i] ^ tag[i];
+    }
+    return diff == 0;
+}
+
+static size_t lan_put32(uint8_t *pkt, size_t pos, uint32_t value)
+{
+    pkt[pos] = value >> 24;
+    pkt[pos + 1] = (value >> 16) & 0xFF;
+    pkt[pos + 2] = (value >> 8) & 0xFF;
+    pkt[pos + 3] = value & 0xFF;
+    return pos + 4;
+}
+
+static uint32_t lan_get32(const uint8_t *pkt, size_t pos)
+{
+    return ((uint32_t)pkt[pos] << 24) | ((uint32_t)pkt[pos + 1] << 16) |
+           ((uint32_t)pkt[pos + 2] << 8) | pkt[pos + 3];
+}
+
+// Last three MAC bytes, enough to tell the devices of one office apart
+static const char *lan_node_name(const uint8_t *node, char *buf, size_t size)
+{
+    snprintf(buf, size, "%02x:%02x:%02x", node[3], node[4], node[5]);
+    return buf;
+}
+
+// Caller holds the lock
+static void lan_send(uint8_t type)
+{
+    uint8_t pkt[LAN_PACKET_MAX];
+    size_t len = 0;
+
+    if (s_lan.sock < 0 || (type == LAN_MSG_RESULT && !s_lan.has_result)) {
+        return;
+    }
+    memcpy(pkt, LAN_MAGIC, 4);
+    len = 4;
+    pkt[len++] = LAN_VERSION;
+    pkt[len++] = type;
+    pkt[len++] = (s_lan.leader ? LAN_FLAG_LEADER : 0) | (s_lan.failing ? LAN_FLAG_FAILING : 0);
+    pkt[len++] = 0;
+    len = lan_put32(pkt, len, s_lan.group);
+    memcpy(&pkt[len], s_lan.node, 6);
+    len += 6;
+    len = lan_put32(pkt, len, s_lan.boot);
+    len = lan_put32(pkt, len, ++s_lan.seq);
+    if (type == LAN_MSG_RESULT) {
+        len = lan_put32(pkt, len, lan_now_ms() - s_lan.result_ms);
+        len = lan_put32(pkt, len, (uint32_t)s_lan.result.practices);
+        len = lan_put32(pkt, len, (uint32_t)s_lan.result.editor_practices);
+        pkt[len++] = s_lan.result.accounts;
+        for (int i = 0; i < 1 + EXTRA_ACCOUNTS_MAX; i++) {
+            len = lan_put32(pkt, len, (uint32_t)s_lan.result.account_practices[i]);
+        }
+    }
+    if (!lan_tag(pkt, len, &pkt[len])) {
+        return;
+    }
+    len += LAN_TAG_SIZE;
+
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(LAN_SHARE_PORT),
+    };
+    dest.sin_addr.s_addr = inet_addr(LAN_SHARE_GROUP_ADDR);
+    if (sendto(s_lan.sock, pkt, len, 0, (struct sockaddr *)&dest, sizeof(dest)) != (int)len) {
+        ESP_LOGW(TAG, "⚠️ Send failed (errno %d)", errno);
+    }
+}
+
+// Lowest-MAC peer that claims the lead and is healthy (caller holds the lock)
+static const lan_peer_t *lan_claimant(void)
+{
+    const lan_peer_t *best = NULL;
+
+    for (uint8_t i = 0; i < s_lan.peer_count; i++) {
+        const lan_peer_t *peer = &s_lan.peers[i];
+        if ((peer->flags & LAN_FLAG_LEADER) && !(peer->flags & LAN_FLAG_FAILING) &&
+            (best == NULL || memcmp(peer->node, best->node, 6) < 0)) {
+            best = peer;
+        }
+    }
+    return best;
+}
+
+// Drops silent peers and settles who leads. A claimed lead is kept while
+// the leader is heard and healthy, so a device joining later does not take
+// over; two claims (a split that healed) go to the lowest MAC. Without a
+// claim, the lowest healthy MAC takes the lead once it has listened for
+// LAN_SHARE_SETTLE_MS. Caller holds the lock.
+static void lan_elect(uint32_t now)
+{
+    char name[9];
+
+    for (uint8_t i = 0; i < s_lan.peer_count;) {
+        if (now - s_lan.peers[i].heard_ms > LAN_SHARE_PEER_TIMEOUT_MS) {
+            ESP_LOGI(TAG, "👋 Peer %s gone quiet", lan_node_name(s_lan.peers[i].node, name, sizeof(name)));
+            // Its datagrams stay replayable: remember how far it got
+            s_lan.gone[s_lan.gone_next] = s_lan.peers[i];
+            s_lan.gone_next = (s_lan.gone_next + 1) % LAN_SHARE_MAX_PEERS;
+            s_lan.peers[i] = s_lan.peers[--s_lan.peer_count];
+        } else {
+            i++;
+        }
+    }
+
+    const lan_peer_t *claimant = lan_claimant();
+    bool lead;
+    if (s_lan.failing || s_lan.sock < 0) {
+        lead = false;
+    } else if (claimant != NULL) {
+        lead = s_lan.leader && memcmp(s_lan.node, claimant->node, 6) < 0;
+    } else if (s_lan.leader) {
+        lead = true;
+    } else {
+        lead = (now - s_lan.joined_ms >= LAN_SHARE_SETTLE_MS);
+        for (uint8_t i = 0; i < s_lan.peer_count && lead; i++) {
+            if (!(s_lan.peers[i].flags & LAN_FLAG_FAILING) && memcmp(s_lan.peers[i].node, s_lan.node, 6) < 0) {
+                lead = false;
+            }
+        }
+    }
+
+    if (lead != s_lan.leader) {
+        s_lan.leader = lead;
+        s_lan.announce = true;
+        if (lead) {
+            ESP_LOGI(TAG, "👑 Polling for %u peer(s)", s_lan.peer_count);
+        } else if (claimant != NULL) {
+            ESP_LOGI(TAG, "🤝 Peer %s polls for the group", lan_node_name(claimant->node, name, sizeof(name)));
+        } else {
+            ESP_LOGI(TAG, "🤝 Lead given up");
+        }
+    }
+}
+
+static void lan_leave(void)
+{
+    lan_lock();
+    if (s_lan.sock >= 0) {
+        close(s_lan.sock);
+        s_lan.sock = -1;
+    }
+    s_lan.leader = false;
+    // Their boot and sequence numbers still stop replays after a rejoin
+    for (uint8_t i = 0; i < s_lan.peer_count; i++) {
+        s_lan.gone[s_lan.gone_next] = s_lan.peers[i];
+        s_lan.gone_next = (s_lan.gone_next + 1) % LAN_SHARE_MAX_PEERS;
+    }
+    s_lan.peer_count = 0;
+    s_lan.has_shared = false;
+    lan_unlock();
+}
+
+static bool lan_join(void)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "❌ Cannot create socket (errno %d)", errno);
+        return false;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(LAN_SHARE_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct ip_mreq mreq = {
+        .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+    mreq.imr_multiaddr.s_addr = inet_addr(LAN_SHARE_GROUP_ADDR);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+        ESP_LOGE(TAG, "❌ Cannot join %s:%d (errno %d)", LAN_SHARE_GROUP_ADDR, LAN_SHARE_PORT, errno);
+        close(sock);
+        return false;
+    }
+    // Never past the first router; own datagrams are looped back and ignored
+    uint8_t ttl = 1;
+    uint8_t loop = 1;
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    struct timeval tv = {
+        .tv_sec = 0,
+        .tv_usec = LAN_RECV_SLICE_MS * 1000,
+    };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    lan_lock();
+    s_lan.sock = sock;
+    s_lan.joined_ms = lan_now_ms();
+    s_lan.failing = false;
+    s_lan.announce = true;
+    lan_unlock();
+    ESP_LOGI(TAG, "🏠 Joined %s:%d (group %08lx)", LAN_SHARE_GROUP_ADDR, LAN_SHARE_PORT,
+             (unsigned long)s_lan.group);
+    return true;
+}
+
+// Checks a datagram and updates the sender's entry. A count from the peer
+// this device follows is handed to main_flow_task.
+static void lan_handle_packet(const uint8_t *pkt, int len)
+{
+    char name[9];
+
+    if (len < LAN_HEADER_SIZE + LAN_TAG_SIZE || memcmp(pkt, LAN_MAGIC, 4) != 0 ||
+        pkt[4] != LAN_VERSION || lan_get32(pkt, 8) != s_lan.group || memcmp(&pkt[12], s_lan.node, 6) == 0) {
+        return;     // Other firmware, other account, or our own echo
+    }
+    uint8_t type = pkt[5];
+    if ((type == LAN_MSG_HELLO && len != LAN_HEADER_SIZE + LAN_TAG_SIZE) ||
+        (type == LAN_MSG_RESULT && len != LAN_HEADER_SIZE + LAN_RESULT_SIZE + LAN_TAG_SIZE) ||
+        (type != LAN_MSG_HELLO && type != LAN_MSG_RESULT)) {
+        return;
+    }
+    if (!lan_tag_ok(pkt, len - LAN_TAG_SIZE, &pkt[len - LAN_TAG_SIZE])) {
+        ESP_LOGW(TAG, "⚠️ Datagram with a bad tag from %s ignored", lan_node_name(&pkt[12], name, sizeof(name)));
+        return;
+    }
+
+    uint32_t now = lan_now_ms();
+    uint32_t boot = lan_get32(pkt, 18);
+    uint32_t seq = lan_get32(pkt, 22);
+    net_job_result_t event;
+    bool deliver = false;
+
+    lan_lock();
+    lan_peer_t *peer = NULL;
+    for (uint8_t i = 0; i < s_lan.peer_count; i++) {
+        if (memcmp(s_lan.peers[i].node, &pkt[12], 6) == 0) {
+            peer = &s_lan.peers[i];
+            break;
+        }
+    }
+    if (peer == NULL) {
+        if (s_lan.peer_count >= LAN_SHARE_MAX_PEERS) {
+            lan_unlock();
+            return;
+        }
+        peer = &s_lan.peers[s_lan.peer_count++];
+        memset(peer, 0, sizeof(*peer));
+        memcpy(peer->node, &pkt[12], 6);
+        for (int i = 0; i < LAN_SHARE_MAX_PEERS; i++) {
+            if (memcmp(s_lan.gone[i].node, peer->node, 6) == 0) {
+                peer->boot = s_lan.gone[i].boot;
+                peer->seq = s_lan.gone[i].seq;
+                memset(&s_lan.gone[i], 0, sizeof(s_lan.gone[i]));
+                break;
+            }
+        }
+        ESP_LOGI(TAG, "👋 Peer %s joined", lan_node_name(peer->node, name, sizeof(name)));
+        // A newcomer need not wait for the next poll to be covered
+        if (s_lan.leader) {
+            s_lan.announce = true;
+        }
+    }
+    // Boot ids only grow, so a datagram captured before the peer's last
+    // reboot is as stale as a repeated sequence number
+    if (boot < peer->boot || (boot == peer->boot && seq <= peer->seq)) {
+        lan_unlock();
+        return;     // Duplicate or replayed
+    }
+    peer->boot = boot;
+    peer->seq = seq;
+    peer->heard_ms = now;
+    peer->flags = pkt[6];
+    lan_elect(now);
+
+    if (type == LAN_MSG_RESULT && !s_lan.leader && lan_claimant() == peer) {
+        uint32_t polled_ms = now - lan_get32(pkt, 26);
+        s_lan.has_shared = true;
+        memcpy(s_lan.shared_from, peer->node, 6);
+        s_lan.shared_ms = polled_ms;
+        // A new leader starts with the count it last polled itself: it
+        // covers us, but must not replace a newer one on screen
+        deliver = !s_lan.has_latest || (int32_t)(polled_ms - s_lan.latest_ms) >= 0;
+        s_lan.has_latest = true;
+        if (deliver) {
+            s_lan.latest_ms = polled_ms;
+        }
+    }
+    if (deliver) {
+        memset(&event, 0, sizeof(event));
+        event.type = NET_JOB_LAN_RESULT;
+        event.triggers = 1;
+        event.err = ESP_OK;
+        event.practices = (int32_t)lan_get32(pkt, 30);
+        event.editor_practices = (int32_t)lan_get32(pkt, 34);
+        event.accounts = (pkt[38] <= EXTRA_ACCOUNTS_MAX + 1) ? pkt[38] : 0;
+        for (int i = 0; i < 1 + EXTRA_ACCOUNTS_MAX; i++) {
+            event.account_practices[i] = (int32_t)lan_get32(pkt, 39 + 4 * i);
+        }
+    }
+    lan_unlock();
+
+    if (deliver) {
+        ESP_LOGI(TAG, "🏠 Count %d from %s", event.practices, lan_node_name(&pkt[12], name, sizeof(name)));
+        net_worker_deliver(&event);
+    }
+}
+
+static void lan_share_task(void *pvParameters)
+{
+    uint8_t pkt[LAN_PACKET_MAX + 1];
+    uint32_t last_hello = 0;
+
+    ESP_LOGI(TAG, "🏠 LAN sharing started");
+
+    while (1) {
+        if (!lan_can_run()) {
+            if (s_lan.sock >= 0) {
+                lan_leave();
+            }
+            vTaskDelay(pdMS_TO_TICKS(LAN_IDLE_CHECK_MS));
+            continue;
+        }
+        if (s_lan.sock < 0 && !lan_join()) {
+            vTaskDelay(pdMS_TO_TICKS(LAN_SHARE_HELLO_MS));
+            continue;
+        }
+
+        uint32_t now = lan_now_ms();
+        lan_lock();
+        lan_elect(now);
+        if (s_lan.announce || now - last_hello >= LAN_SHARE_HELLO_MS) {
+            lan_send(LAN_MSG_HELLO);
+            // Peers that just joined, or a lead just taken: the last count goes out too
+            if (s_lan.announce && s_lan.leader) {
+                lan_send(LAN_MSG_RESULT);
+            }
+            s_lan.announce = false;
+            last_hello = now;
+        }
+        lan_unlock();
+
+        int n = recvfrom(s_lan.sock, pkt, sizeof(pkt), 0, NULL, NULL);
+        if (n > 0) {
+            lan_handle_packet(pkt, n);
+        } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            ESP_LOGW(TAG, "⚠️ Receive failed (errno %d), rejoining", errno);
+            lan_leave();
+            vTaskDelay(pdMS_TO_TICKS(LAN_IDLE_CHECK_MS));
+        }
+    }
+}
+
+// Boot id of this run: one more than the last, kept in NVS so that peers
+// can tell this boot's datagrams from those of any earlier one
+static bool lan_next_boot_id(uint32_t *boot)
+{
+    nvs_handle_t handle;
+    uint32_t last = 0;
+
+    if (nvs_open(LAN_SHARE_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_get_u32(handle, LAN_NVS_BOOT_KEY, &last);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+        *boot = last + 1;
+        err = nvs_set_u32(handle, LAN_NVS_BOOT_KEY, *boot);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err == ESP_OK;
+}
+
+esp_err_t lan_share_start(void)
+{
+    if (s_lan.task != NULL || strcmp(lan_share, "1") != 0) {
+        return ESP_OK;
+    }
+    if (esp_read_mac(s_lan.node, ESP_MAC_WIFI_STA) != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Cannot read MAC, LAN sharing off");
+        return ESP_FAIL;
+    }
+    // Without a growing boot id peers would take this run for a replay
+    if (!lan_next_boot_id(&s_lan.boot)) {
+        ESP_LOGE(TAG, "❌ Cannot store the boot id, LAN sharing off");
+        return ESP_FAIL;
+    }
+    s_lan.group = lan_group_id();
+    s_lan.mutex = xSemaphoreCreateMutex();
+    if (s_lan.mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(lan_share_task, "lan_share", LAN_SHARE_STACK_SIZE, NULL,
+                    LAN_SHARE_PRIORITY, &s_lan.task) != pdPASS) {
+        ESP_LOGE(TAG, "❌ Failed to create LAN sharing task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void lan_share_publish(const net_job_result_t *result)
+{
+    if (s_lan.mutex == NULL || result == NULL) {
+        return;
+    }
+    lan_lock();
+    s_lan.failing = (result->practices < 0);
+    if (!s_lan.failing) {
+        s_lan.result = *result;
+        s_lan.result_ms = lan_now_ms();
+        s_lan.has_result = true;
+        s_lan.latest_ms = s_lan.result_ms;
+        s_lan.has_latest = true;
+    }
+    // A failed poll gives the lead up now, not at the next announce
+    lan_elect(lan_now_ms());
+    if (s_lan.leader) {
+        lan_send(LAN_MSG_RESULT);
+    }
+    lan_unlock();
+}
+
+bool lan_share_covered(uint32_t max_age_ms)
+{
+    bool covered = false;
+
+    if (s_lan.mutex == NULL) {
+        return false;
+    }
+    lan_lock();
+    const lan_peer_t *leader = s_lan.leader ? NULL : lan_claimant();
+    if (leader != NULL && s_lan.has_shared && memcmp(leader->node, s_lan.shared_from, 6) == 0) {
+        covered = (lan_now_ms() - s_lan.shared_ms <= max_age_ms + LAN_SHARE_RESULT_GRACE_MS);
+    }
+    lan_unlock();
+    return covered;
+}
+
+bool lan_share_is_leader(void)
+{
+    return s_lan.leader;
+}
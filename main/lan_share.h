@@ -0,0 +1,66 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: lan_share.h                                        *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Count sharing between devices on the LAN    *
+ ************************************************************/
+
+#ifndef LAN_SHARE_H
+#define LAN_SHARE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "net_worker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LAN_SHARE_STACK_SIZE       4096
+#define LAN_SHARE_PRIORITY         3       // Below the network worker
+#define LAN_SHARE_GROUP_ADDR       "239.255.77.77"
+#define LAN_SHARE_PORT             47701
+#define LAN_SHARE_HELLO_MS         5000    // Announce period
+#define LAN_SHARE_PEER_TIMEOUT_MS  16000   // A peer silent this long is gone (three announces missed)
+#define LAN_SHARE_SETTLE_MS        11000   // Listen this long before claiming the lead after (re)connecting
+#define LAN_SHARE_RESULT_GRACE_MS  30000   // Shared counts stay good this long past the poll ceiling
+#define LAN_SHARE_MAX_PEERS        8
+#define LAN_SHARE_NVS_NAMESPACE    "lan_share"  // Boot id counter
+
+/**
+ * @brief Starts the LAN sharing task
+ *
+ * Devices with the same server, credentials and working mode form a
+ * group: the one that leads polls and multicasts its counts, the others
+ * show them as NET_JOB_LAN_RESULT events (see net_worker.h). Does nothing
+ * unless lan_share is "1".
+ *
+ * @return esp_err_t ESP_OK on success (or when sharing is off)
+ */
+esp_err_t lan_share_start(void);
+
+/**
+ * @brief Hands a poll result to the group
+ *
+ * Sent to the peers when this device leads; a failed poll (practices < 0)
+ * gives the lead up so that a healthy peer takes over.
+ */
+void lan_share_publish(const net_job_result_t *result);
+
+/**
+ * @brief True while a healthy leader's counts make this device's polls redundant
+ *
+ * @param max_age_ms Oldest shared count still good (the poll ceiling:
+ *                   the leader polls at least this often)
+ */
+bool lan_share_covered(uint32_t max_age_ms);
+
+// True while this device polls for the group
+bool lan_share_is_leader(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LAN_SHARE_H
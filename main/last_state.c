@@ -0,0 +1,168 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: last_state.c                                       *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Last known count, kept across reboots       *
+ ************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rtc_time.h"
+#include "esp_rom_crc.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "last_state.h"
+#include "device_config.h"
+
+static const char *TAG = "LastState";
+
+#define LAST_STATE_NVS_KEY        "state"
+#define LAST_STATE_MAGIC          0x4C535431UL    // "LST1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t fingerprint;       // Configuration the count belongs to
+    uint64_t saved_rtc_us;      // RTC time of the save (RTC copy only)
+    int32_t practices;
+    int32_t editor_practices;
+    char working_mode;
+    uint8_t reserved[3];
+    uint32_t crc;               // Over all the fields above
+} last_state_record_t;
+
+// Survives software resets; garbage after a power cut (caught by the CRC)
+static RTC_NOINIT_ATTR last_state_record_t s_rtc_record;
+
+static last_state_record_t s_nvs_record;        // What flash holds
+static bool s_nvs_loaded = false;
+static int64_t s_nvs_written_us = 0;            // Last flash write (0 = none this boot)
+
+static uint32_t last_state_crc(const last_state_record_t *record)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(last_state_record_t, crc));
+}
+
+static bool last_state_valid(const last_state_record_t *record)
+{
+    return record->magic == LAST_STATE_MAGIC && record->crc == last_state_crc(record) &&
+           record->fingerprint == device_config_fingerprint() &&
+           record->working_mode == working_mode[0];
+}
+
+static void last_state_fill(last_state_record_t *record, int practices, int editor_practices)
+{
+    memset(record, 0, sizeof(*record));
+    record->magic = LAST_STATE_MAGIC;
+    record->fingerprint = device_config_fingerprint();
+    record->practices = practices;
+    record->editor_practices = editor_practices;
+    record->working_mode = working_mode[0];
+}
+
+static void last_state_nvs_load(void)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(s_nvs_record);
+
+    if (s_nvs_loaded) {
+        return;
+    }
+    s_nvs_loaded = true;
+    memset(&s_nvs_record, 0, sizeof(s_nvs_record));
+
+    if (nvs_open(LAST_STATE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(handle, LAST_STATE_NVS_KEY, &s_nvs_record, &len) != ESP_OK ||
+        len != sizeof(s_nvs_record)) {
+        memset(&s_nvs_record, 0, sizeof(s_nvs_record));
+    }
+    nvs_close(handle);
+}
+
+static void last_state_nvs_write(const last_state_record_t *record)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LAST_STATE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Cannot open NVS for last state: %s", esp_err_to_name(err));
+        return;
+    }
+    err = nvs_set_blob(handle, LAST_STATE_NVS_KEY, record, sizeof(*record));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Failed to persist last state: %s", esp_err_to_name(err));
+        return;
+    }
+    s_nvs_record = *record;
+    s_nvs_written_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "💾 Last state saved to flash: %ld / %ld", record->practices, record->editor_practices);
+}
+
+bool last_state_load(last_state_t *out)
+{
+    if (out == NULL) {
+        return false;
+    }
+    last_state_nvs_load();
+
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool rtc_kept = (reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT && reason != ESP_RST_UNKNOWN);
+
+    if (rtc_kept && last_state_valid(&s_rtc_record)) {
+        uint64_t now_us = esp_rtc_get_time_us();
+        out->practices = s_rtc_record.practices;
+        out->editor_practices = s_rtc_record.editor_practices;
+        out->age_s = (now_us >= s_rtc_record.saved_rtc_us) ?
+                     (uint32_t)((now_us - s_rtc_record.saved_rtc_us) / 1000000ULL) : LAST_STATE_AGE_UNKNOWN;
+        ESP_LOGI(TAG, "⚡ Last state from RTC memory: %d / %d (%lu s old)",
+                 out->practices, out->editor_practices, out->age_s);
+        return true;
+    }
+    if (last_state_valid(&s_nvs_record)) {
+        out->practices = s_nvs_record.practices;
+        out->editor_practices = s_nvs_record.editor_practices;
+        out->age_s = LAST_STATE_AGE_UNKNOWN;
+        ESP_LOGI(TAG, "💾 Last state from flash: %d / %d", out->practices, out->editor_practices);
+        return true;
+    }
+    ESP_LOGI(TAG, "No last state for this configuration");
+    return false;
+}
+
+void last_state_save(int practices, int editor_practices)
+{
+    last_state_record_t record;
+
+    if (practices < 0) {
+        return;
+    }
+    last_state_nvs_load();
+
+    last_state_fill(&record, practices, editor_practices);
+    record.saved_rtc_us = esp_rtc_get_time_us();
+    record.crc = last_state_crc(&record);
+    s_rtc_record = record;
+
+    // Flash copy: no timestamp, so an unchanged count compares equal
+    last_state_fill(&record, practices, editor_practices);
+    record.crc = last_state_crc(&record);
+    if (memcmp(&record, &s_nvs_record, sizeof(record)) == 0) {
+        return;
+    }
+    if (s_nvs_written_us != 0 &&
+        esp_timer_get_time() - s_nvs_written_us < (int64_t)LAST_STATE_NVS_MIN_MS * 1000) {
+        ESP_LOGD(TAG, "Flash write of last state deferred");
+        return;
+    }
+    last_state_nvs_write(&record);
+}
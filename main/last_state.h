@@ -0,0 +1,58 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: last_state.h                                       *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Last known count, kept across reboots       *
+ ************************************************************/
+
+#ifndef LAST_STATE_H
+#define LAST_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LAST_STATE_NVS_NAMESPACE      "last_state"
+#define LAST_STATE_NVS_MIN_MS         600000UL    // At most one flash write per 10 minutes
+#define LAST_STATE_AGE_UNKNOWN        UINT32_MAX
+
+// Count shown before the reboot
+typedef struct {
+    int practices;              // Signer practices / editor documents (both mode: signer)
+    int editor_practices;       // Both mode: editor documents, otherwise -1
+    uint32_t age_s;             // Age at boot, LAST_STATE_AGE_UNKNOWN after a power cut
+} last_state_t;
+
+/**
+ * @brief Loads the count saved before the last reboot
+ *
+ * RTC memory survives esp_restart(), panics and OTA reboots and is tried
+ * first; after a power cut the (less recent) NVS copy is used. The state
+ * is only returned if it belongs to the current server, credentials and
+ * working mode.
+ *
+ * @param out Loaded state
+ * @return true if a usable state was found
+ */
+bool last_state_load(last_state_t *out);
+
+/**
+ * @brief Records a successful refresh
+ *
+ * RTC memory is updated every time. Flash is only written when the count
+ * differs from the stored copy, and at most once per LAST_STATE_NVS_MIN_MS;
+ * a change held back is written by a later call.
+ *
+ * @param practices        Count (both mode: signer)
+ * @param editor_practices Both mode: editor documents, otherwise -1
+ */
+void last_state_save(int practices, int editor_practices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LAST_STATE_H
@@ -11,6 +11,7 @@
  ************************************************************/
 
  #include <stdio.h>
+ #include <stdlib.h>
  #include <string.h>
  #include "esp_log.h"
  #include "nvs_flash.h"
@@ -22,6 +23,14 @@
 #include "ble_manager.h"
 #include "wifi_manager.h"
 #include "api_manager.h"
+#include "net_worker.h"
+#include "poll_scheduler.h"
+#include "retry_policy.h"
+#include "fleet_phase.h"
+#include "push_client.h"
+#include "lan_share.h"
+#include "last_state.h"
+#include "doc_list.h"
 #include "display_manager.h"
 #include "ota_manager.h"
 #include "translations.h"
@@ -35,11 +44,17 @@
 #define WARMUP_DURATION_MS             5000    // Duration of the warmup phase
 #define POLL_INTERVAL_MS               200     // Polling interval of the button during warmup
 #define BLE_WAIT_DURATION_MS           120000   // Maximum waiting time for BLE configuration
-#define DEFAULT_API_CHECK_INTERVAL_MS  60000UL // Waiting time between one API check and the next
 #define BUTTON_POLL_INTERVAL_MS        200     // Polling interval of the button in the waiting loop
 #define OTA_BUTTON_HOLD_TIME_MS        5000    // Time to hold button for OTA update
 #define RESET_BUTTON_HOLD_TIME_MS      10000   // Time to hold button for configuration reset
 #define OTA_CHECK_INTERVAL_MS          21600000UL // OTA check every 6 hours
+#define OTA_RESUME_RETRY_MS            600000UL   // Interrupted download: next attempt after 10 minutes
+#define OTA_RESUME_BOOT_DELAY_MS       60000UL    // ...or this long after boot (plus the device's phase)
+#define CHECKING_MIN_DISPLAY_MS        600     // Minimum on-screen time of the Checking animation
+#define PRECONNECT_RENEW_MS            5000    // Renew a warm connection this close to going stale
+#define ENDPOINT_PROBE_CHECK_MS        30000   // How often fallback endpoints are offered a health probe
+#define ENDPOINT_PROBE_CLEARANCE_MS    15000   // No probe this close to the next poll
+#define PRESS_RESTART_AFTER_MS         2000    // A press restarts a refresh on the wire for longer than this
 #define BOOT_WATCHDOG_TIMEOUT_MS       30000   // 30 seconds timeout for boot completion
 #define BOOT_HEALTH_CHECK_INTERVAL_MS  5000    // Check every 5 seconds during boot
 
@@ -52,15 +67,25 @@
  bool force_immediate_check = false;   // se true, salta il periodo di attesa
 
 // OTA variables
-static uint32_t last_ota_check = 0;
+static uint32_t next_ota_check = 0;     // Set at boot to this device's slot of the interval
 bool ota_in_progress = false;
 static bool force_display_refresh = false;
-#define CURRENT_FIRMWARE_VERSION "3.6.1"
 
-// API protection variables
-static bool api_call_in_progress = false;
-static uint32_t last_api_call_time = 0;
-#define MIN_API_CALL_INTERVAL_MS 3000  // Minimum 3 seconds between API calls
+// Last count shown (used to restore the display after OTA messages);
+// the editor one is only used in both mode
+static int s_last_practices = 0;
+static int s_last_editor_practices = -1;
+
+// Refresh timing: the Checking animation runs while the request is on the
+// wire; a result that arrives early is held until it has been visible for
+// CHECKING_MIN_DISPLAY_MS
+static uint32_t s_checking_since = 0;       // When CHECKING_API was shown (ms)
+static uint32_t s_press_time = 0;           // Short press that asked for the refresh (0 = none)
+static bool s_result_deferred = false;
+static int s_deferred_practices = 0;
+static int s_deferred_editor_practices = -1;
+static uint32_t s_last_update_ms = 0;       // Last refresh started or count pushed (ms)
+static bool s_showing_last_known = false;   // Count restored from before the reboot is on screen
 
 // Boot watchdog variables
 static uint32_t boot_start_time = 0;
@@ -675,12 +700,19 @@ static void ota_progress_callback(int percentage, ota_status_t status, ota_error
         esp_restart();
     } else if (status == OTA_STATUS_ERROR) {
         ESP_LOGE(TAG, "❌ OTA update failed with error: %d", error);
+        // A download that stopped half way goes on soon, not at the next
+        // periodic check
+        if (ota_resume_pending(CURRENT_FIRMWARE_VERSION)) {
+            next_ota_check = xTaskGetTickCount() * portTICK_PERIOD_MS + OTA_RESUME_RETRY_MS;
+        }
         // Resume normal operation after 5 seconds
         vTaskDelay(pdMS_TO_TICKS(5000));
+        force_display_refresh = true;
     }
 }
 
-// Check for OTA updates
+// Check for OTA updates: the lookup runs on the network worker and the
+// outcome is handled by handle_ota_result() when it completes
 static void check_ota_updates(void)
 {
     if (ota_in_progress) {
@@ -689,12 +721,22 @@ static void check_ota_updates(void)
     }
     
     ESP_LOGI(TAG, "🔍 Checking for firmware updates...");
+    net_worker_post(NET_JOB_CHECK_OTA);
     
-    ota_version_info_t update_info;
-    esp_err_t err = api_manager_check_firmware_updates(CURRENT_FIRMWARE_VERSION, &update_info);
+    next_ota_check = xTaskGetTickCount() * portTICK_PERIOD_MS + OTA_CHECK_INTERVAL_MS;
+}
+
+static void handle_ota_result(const net_job_result_t* result)
+{
+    esp_err_t err = result->err;
+    
+    if (ota_in_progress) {
+        ESP_LOGI(TAG, "⏳ OTA already in progress, ignoring check result");
+        return;
+    }
     
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "🚀 Update available: %s → %s", CURRENT_FIRMWARE_VERSION, update_info.version);
+        ESP_LOGI(TAG, "🚀 Update available: %s → %s", CURRENT_FIRMWARE_VERSION, result->update_info.version);
         
         // Set OTA in progress flag
         ota_in_progress = true;
@@ -706,7 +748,7 @@ static void check_ota_updates(void)
         display_manager_update(DISPLAY_STATE_OTA_UPDATE, 0);
         
         // Start OTA update
-        err = ota_start_update(&update_info);
+        err = ota_start_update(&result->update_info);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "❌ Failed to start OTA update: %s", esp_err_to_name(err));
             ota_in_progress = false;
@@ -731,8 +773,360 @@ static void check_ota_updates(void)
         // Force display refresh to return to normal state
         force_display_refresh = true;
     }
+}
+
+// Per-account breakdown shown under the total when extra accounts are
+// configured: "name count" pairs, two per line, names cut at '@'
+static void update_accounts_breakdown(const net_job_result_t *result)
+{
+    char text[128];
+    size_t len = 0;
+
+    if (result->accounts == 0 || result->practices < 0) {
+        display_manager_set_breakdown(NULL);
+        return;
+    }
+    text[0] = '\0';
+    for (uint8_t i = 0; i < result->accounts && len < sizeof(text); i++) {
+        const char *user = (i == 0) ? askmesign_user : extra_accounts[i - 1].user;
+        int name_len = (int)strcspn(user, "@");
+        char count[8];
+
+        if (name_len > 8) {
+            name_len = 8;
+        }
+        if (result->account_practices[i] >= 0) {
+            snprintf(count, sizeof(count), "%d", result->account_practices[i]);
+        } else {
+            strcpy(count, "?");
+        }
+        len += snprintf(text + len, sizeof(text) - len, "%s%.*s %s",
+                        (i == 0) ? "" : ((i % 2) ? "   " : "\n"), name_len, user, count);
+    }
+    display_manager_set_breakdown(text);
+}
+
+// Shows the pending count(s): in both mode editor_practices holds the
+// editor documents and the signer practices are in practices
+static void show_practices(int practices, int editor_practices)
+{
+    if (editor_practices >= 0) {
+        display_manager_update_dual(DISPLAY_STATE_SHOW_PRACTICES, practices, editor_practices);
+    } else {
+        display_manager_update(DISPLAY_STATE_SHOW_PRACTICES, practices);
+    }
+}
+
+// Shows the count saved before the reboot (dimmed) while the device warms
+// up and connects; the first live result replaces it
+static bool show_last_known_state(void)
+{
+    last_state_t cached;
+
+    if (!last_state_load(&cached)) {
+        return false;
+    }
+    display_manager_set_stale(true, cached.age_s);
+    if (cached.practices + ((cached.editor_practices > 0) ? cached.editor_practices : 0) > 0) {
+        show_practices(cached.practices, cached.editor_practices);
+    } else {
+        display_manager_update(DISPLAY_STATE_NO_PRACTICES, 0);
+    }
+    s_last_practices = cached.practices;
+    s_last_editor_practices = cached.editor_practices;
+    s_showing_last_known = true;
+    return true;
+}
+
+// Another screen (no Wi-Fi, BLE) replaces the restored count
+static void drop_last_known_state(void)
+{
+    if (s_showing_last_known) {
+        s_showing_last_known = false;
+        display_manager_set_stale(false, 0);
+    }
+}
+
+// Handle results (same logic for all modes; editor_practices is -1 outside both mode)
+static void apply_practices_result(int practices, int editor_practices)
+{
+    int total = practices + ((editor_practices > 0) ? editor_practices : 0);
+
+    drop_last_known_state();
+    last_state_save(practices, editor_practices);
+    if (practices < 0) {
+        ESP_LOGE(TAG, "API call failed (network issue, server error, or certificate issue).");
+        s_current_state = STATE_API_ERROR;
+        display_manager_update(DISPLAY_STATE_API_ERROR, 0);
+    }
+    else if (total > 0) {
+        s_current_state = STATE_SHOW_PRACTICES;
+        ESP_LOGI(TAG, "Switching state to SHOW_PRACTICES");
+        show_practices(practices, editor_practices);
+    }
+    else {
+        s_current_state = STATE_NO_PRACTICES;
+        display_manager_update(DISPLAY_STATE_NO_PRACTICES, 0);
+    }
+    s_last_practices = practices;
+    s_last_editor_practices = editor_practices;
+    
+    if (s_press_time != 0) {
+        uint32_t latency = (xTaskGetTickCount() * portTICK_PERIOD_MS) - s_press_time;
+        ESP_LOGI(TAG, "⏱️ Press-to-number latency: %lu ms%s", latency,
+                 latency < 1000 ? "" : " (above 1 s target)");
+        s_press_time = 0;
+    }
+}
+
+// Shows a refresh result, unless the Checking animation has not been on
+// screen long enough yet: then it is applied by handle_net_results()
+static void on_refresh_result(int practices, int editor_practices)
+{
+    uint32_t shown = (xTaskGetTickCount() * portTICK_PERIOD_MS) - s_checking_since;
+    
+    if (s_current_state == STATE_CHECKING_API && !s_showing_last_known &&
+        shown < CHECKING_MIN_DISPLAY_MS) {
+        s_deferred_practices = practices;
+        s_deferred_editor_practices = editor_practices;
+        s_result_deferred = true;
+        return;
+    }
+    apply_practices_result(practices, editor_practices);
+}
+
+// Starts a refresh on the network worker. If one is already queued or
+// running, the trigger is merged into it and the display is left alone.
+static void request_practices_refresh(void)
+{
+    if (net_worker_is_busy(NET_JOB_REFRESH_COUNT)) {
+        ESP_LOGI(TAG, "🔗 Refresh already in flight - trigger coalesced");
+        net_worker_post(NET_JOB_REFRESH_COUNT);
+        return;
+    }
     
-    last_ota_check = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    // Titles can wait: the worker queues them again after this count
+    net_worker_cancel(NET_JOB_FETCH_DOCUMENTS, false);
+
+    // Start the request first: the animation runs while it is on the wire
+    if (net_worker_post(NET_JOB_REFRESH_COUNT)) {
+        poll_scheduler_on_call();
+        retry_policy_on_call();
+    }
+    s_last_update_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    
+    s_current_state = STATE_CHECKING_API;
+    s_checking_since = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    s_result_deferred = false;
+    // The restored count stays up until the answer replaces it
+    if (!s_showing_last_known) {
+        display_manager_update(DISPLAY_STATE_CHECKING_API, 0);
+    }
+}
+
+// Time left before the next poll (0 = due): a failure or reconnect
+// schedules the poll itself, otherwise the adaptive interval applies. While
+// the push stream is live, polling only runs at the ceiling as a safety net.
+// While a LAN peer polls for the group this device does not poll at all:
+// the wait only ends once that peer goes quiet or its counts get old.
+static uint32_t poll_wait_remaining_ms(uint32_t elapsed)
+{
+    uint32_t wait;
+
+    if (lan_share_covered(poll_scheduler_ceiling_ms())) {
+        return poll_scheduler_ceiling_ms();
+    }
+    if (retry_policy_pending()) {
+        return retry_policy_delay_ms();
+    }
+    if (push_client_is_live()) {
+        elapsed = (xTaskGetTickCount() * portTICK_PERIOD_MS) - s_last_update_ms;
+        wait = poll_scheduler_ceiling_ms();
+    } else {
+        wait = poll_scheduler_interval_ms();
+    }
+    return (elapsed < wait) ? wait - elapsed : 0;
+}
+
+static bool poll_wait_over(uint32_t elapsed)
+{
+    return poll_wait_remaining_ms(elapsed) == 0;
+}
+
+// Within preconnect_ms of the next poll, has the network worker open the
+// API connection so the poll itself is a single round trip; the connection
+// is re-opened while it would go stale before the poll (lead times above
+// the server's keep-alive limit keep it warm for button presses too)
+static void preconnect_if_due(uint32_t elapsed)
+{
+    static uint32_t last_attempt_ms = 0;
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t lead = (uint32_t)strtoul(preconnect_ms, NULL, 10);
+    uint32_t remaining = poll_wait_remaining_ms(elapsed);
+
+    if (lead == 0 || remaining == 0 || remaining > lead ||
+        net_worker_is_busy(NET_JOB_PRECONNECT) || net_worker_is_busy(NET_JOB_REFRESH_COUNT)) {
+        return;
+    }
+    uint32_t warm = api_manager_warm_ms();
+    if (warm >= remaining || warm > PRECONNECT_RENEW_MS) {
+        return;     // Lasts until the poll, or still good for a while
+    }
+    // A failed attempt (no route, DNS down) is not repeated every loop
+    if (last_attempt_ms != 0 && now - last_attempt_ms < PRECONNECT_RENEW_MS) {
+        return;
+    }
+    last_attempt_ms = now;
+    ESP_LOGI(TAG, "🔥 Poll in %lu ms - pre-connecting", remaining);
+    net_worker_post(NET_JOB_PRECONNECT);
+}
+
+// With fallback endpoints configured, lets the network worker health-check
+// the ones not in use while it is idle and well away from the next poll
+// (the worker decides which endpoint, if any, is due)
+static void probe_endpoints_if_due(uint32_t elapsed)
+{
+    static uint32_t last_check_ms = 0;
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    if (extra_endpoint_count == 0 || now - last_check_ms < ENDPOINT_PROBE_CHECK_MS) {
+        return;
+    }
+    if (poll_wait_remaining_ms(elapsed) < ENDPOINT_PROBE_CLEARANCE_MS ||
+        net_worker_is_busy(NET_JOB_REFRESH_COUNT) || net_worker_is_busy(NET_JOB_PRECONNECT) ||
+        net_worker_is_busy(NET_JOB_CHECK_OTA)) {
+        return;
+    }
+    last_check_ms = now;
+    net_worker_post(NET_JOB_PROBE_ENDPOINT);
+}
+
+// Push event from push_client. A pushed count is shown directly when it is
+// the whole answer (signer mode, single account); otherwise the event only
+// says something changed and a refresh fetches the counts.
+static void handle_push_event(const net_job_result_t* result)
+{
+    bool single_count = (strcmp(working_mode, WORKING_MODE_SIGNER) == 0 && extra_account_count == 0);
+
+    if (result->err == ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "📡 Push stream lost - back to adaptive polling");
+        return;
+    }
+    if (result->practices >= 0 && single_count) {
+        ESP_LOGI(TAG, "📡 Pushed count: %d", result->practices);
+        s_last_update_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        poll_scheduler_on_result(result->practices);
+        retry_policy_on_success();
+        lan_share_publish(result);
+        update_accounts_breakdown(result);
+        on_refresh_result(result->practices, -1);
+        return;
+    }
+    ESP_LOGI(TAG, "📡 Push change notification - refreshing");
+    request_practices_refresh();
+}
+
+// Count polled by the LAN peer that leads this device's group: shown like
+// a refresh of our own, unless it is too old to stand in for one
+static void handle_lan_result(const net_job_result_t* result)
+{
+    if (!lan_share_covered(poll_scheduler_ceiling_ms())) {
+        return;
+    }
+    s_last_update_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    poll_scheduler_on_result((result->practices >= 0 && result->editor_practices > 0) ?
+                             result->practices + result->editor_practices : result->practices);
+    retry_policy_on_success();
+    update_accounts_breakdown(result);
+    on_refresh_result(result->practices, result->editor_practices);
+}
+
+// Wi-Fi dropped: nothing on the wire can complete, so the running job and
+// the push stream give up now instead of waiting out their deadlines
+static void abort_network_ops(void)
+{
+    if (net_worker_cancel(NET_JOB_TYPE_COUNT, false)) {
+        ESP_LOGW(TAG, "⛔ Network job cancelled (Wi-Fi lost)");
+    }
+    push_client_cancel();
+}
+
+// Applies the completion events posted by the network worker, waiting up
+// to wait_ms for one to arrive (so results show up as soon as they land)
+static void handle_net_results(uint32_t wait_ms)
+{
+    static net_job_result_t result;
+    
+    // Don't sleep past the moment a deferred result becomes due
+    if (s_result_deferred) {
+        uint32_t shown = (xTaskGetTickCount() * portTICK_PERIOD_MS) - s_checking_since;
+        uint32_t remaining = (shown < CHECKING_MIN_DISPLAY_MS) ? CHECKING_MIN_DISPLAY_MS - shown : 0;
+        if (remaining < wait_ms) {
+            wait_ms = remaining;
+        }
+    }
+    
+    TickType_t wait = pdMS_TO_TICKS(wait_ms);
+    while (net_worker_get_result(&result, wait)) {
+        wait = 0;
+        switch (result.type) {
+            case NET_JOB_REFRESH_COUNT:
+                ESP_LOGI(TAG, "📊 Refresh completed in %lu ms: %d", result.duration_ms, result.practices);
+                // Both mode: the scheduler follows the combined count
+                poll_scheduler_on_result((result.practices >= 0 && result.editor_practices > 0) ?
+                                         result.practices + result.editor_practices : result.practices);
+                if (result.practices >= 0) {
+                    retry_policy_on_success();
+                } else {
+                    retry_policy_on_failure(result.err_class, result.http_status);
+                }
+                update_accounts_breakdown(&result);
+                on_refresh_result(result.practices, result.editor_practices);
+                // Leading the LAN group: the peers show this count too
+                lan_share_publish(&result);
+                break;
+            case NET_JOB_CHECK_OTA:
+                handle_ota_result(&result);
+                break;
+            case NET_JOB_PUSH_EVENT:
+                handle_push_event(&result);
+                break;
+            case NET_JOB_LAN_RESULT:
+                handle_lan_result(&result);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    if (s_result_deferred &&
+        (xTaskGetTickCount() * portTICK_PERIOD_MS) - s_checking_since >= CHECKING_MIN_DISPLAY_MS) {
+        s_result_deferred = false;
+        apply_practices_result(s_deferred_practices, s_deferred_editor_practices);
+    }
+    
+    // Check if we need to force display refresh after OTA check feedback
+    if (force_display_refresh) {
+        force_display_refresh = false;
+        // Re-display current state to override temporary OTA messages
+        switch (s_current_state) {
+            case STATE_SHOW_PRACTICES:
+                show_practices(s_last_practices, s_last_editor_practices);
+                break;
+            case STATE_NO_PRACTICES:
+                display_manager_update(DISPLAY_STATE_NO_PRACTICES, 0);
+                break;
+            case STATE_API_ERROR:
+                display_manager_update(DISPLAY_STATE_API_ERROR, 0);
+                break;
+            case STATE_CHECKING_API:
+                display_manager_update(DISPLAY_STATE_CHECKING_API, 0);
+                break;
+            default:
+                // For other states, just continue normal flow
+                break;
+        }
+    }
 }
  
  static void main_flow_task(void* pvParameters)
@@ -776,9 +1170,15 @@ static void check_ota_updates(void)
      
      ESP_LOGI(TAG, "✅ Firmware security checks completed");
 
-     // WARMING UP phase
+     // Load configuration from NVS
+     ESP_LOGI(TAG, "Loading configuration from NVS...");
+     load_config_from_nvs();
+
+     // WARMING UP phase: the last known count, if any, is shown right away
      s_current_state = STATE_WARMING_UP;
-     display_manager_update(DISPLAY_STATE_WARMING_UP, 0);
+     if (!show_last_known_state()) {
+         display_manager_update(DISPLAY_STATE_WARMING_UP, 0);
+     }
 
      // Run rollback tests if enabled (after warming up)
      #if ENABLE_ROLLBACK_TESTS
@@ -787,6 +1187,7 @@ static void check_ota_updates(void)
  
           if (check_button_pressed_during_warmup()) {
           ESP_LOGI(TAG, "Button press detected during warmup. Entering BLE configuration mode.");
+          drop_last_known_state();
           s_current_state = STATE_BLE_ADVERTISING;
           display_manager_update(DISPLAY_STATE_BLE_ADVERTISING, 0);
 
@@ -839,9 +1240,6 @@ static void check_ota_updates(void)
           vTaskDelay(pdMS_TO_TICKS(WARMUP_DURATION_MS));
      }
 
-     // Load configuration from NVS
-     ESP_LOGI(TAG, "Loading configuration from NVS...");
-     load_config_from_nvs();
      bool config_valid = is_config_valid();
      ESP_LOGI(TAG, "Configuration valid: %s", config_valid ? "YES" : "NO");
 
@@ -898,15 +1296,30 @@ static void check_ota_updates(void)
  
      if (config_valid) {
           s_current_state = STATE_WIFI_CONNECTING;
-          display_manager_update(DISPLAY_STATE_WIFI_CONNECTING, 0);
+          if (!s_showing_last_known) {
+              display_manager_update(DISPLAY_STATE_WIFI_CONNECTING, 0);
+          }
           bool wifi_ok = wifi_manager_connect(wifi_ssid, wifi_password);
             if (wifi_ok) {
-                force_immediate_check = true;   // primo check immediato
+                // First check on this device's slot of the spread window (or
+                // later, if the last boot left a backoff running)
+                retry_policy_on_connect();
             } else {
                 s_current_state = STATE_NO_WIFI;
+                drop_last_known_state();
                 display_manager_update(DISPLAY_STATE_NO_WIFI_SLEEPING, 0);
                 ESP_LOGW(TAG, "Wi-Fi connection failed. Retrying in loop...");
           }
+          // Optional: the stream waits for Wi-Fi on its own
+          esp_err_t push_err = push_client_start();
+          if (push_err != ESP_OK) {
+              ESP_LOGE(TAG, "❌ Failed to start push client: %s", esp_err_to_name(push_err));
+          }
+          // Optional: polls are shared with the account's other devices on the LAN
+          esp_err_t lan_err = lan_share_start();
+          if (lan_err != ESP_OK) {
+              ESP_LOGE(TAG, "❌ Failed to start LAN sharing: %s", esp_err_to_name(lan_err));
+          }
      }
  
      // Initialize the variable for rising edge detection
@@ -914,12 +1327,25 @@ static void check_ota_updates(void)
      
      // Boot is now complete - stop the watchdog
      stop_boot_watchdog();
+     
+     // First OTA check on this device's slot of the interval, so the fleet
+     // does not query GitHub together after a power cut
+     next_ota_check = xTaskGetTickCount() * portTICK_PERIOD_MS +
+                      fleet_phase_ms(FLEET_SALT_OTA, OTA_CHECK_INTERVAL_MS);
+     // A download the reboot interrupted goes on as soon as Wi-Fi is up
+     if (ota_resume_pending(CURRENT_FIRMWARE_VERSION)) {
+         next_ota_check = xTaskGetTickCount() * portTICK_PERIOD_MS + OTA_RESUME_BOOT_DELAY_MS +
+                          fleet_phase_ms(FLEET_SALT_OTA, OTA_RESUME_BOOT_DELAY_MS);
+     }
  
     while (1) {
         
         /* -- 0. Check boot watchdog (if still active) --- */
         check_boot_watchdog();
         
+        /* -- 0. Apply results from the network worker --- */
+        handle_net_results(0);
+        
         /* -- 0. Check for button actions in ALL states (OTA: 5s, Reset: 10s) --- */
         if (s_current_state != STATE_WARMING_UP) {
             // Check for direct button press or flag from API wait loop
@@ -993,7 +1419,7 @@ static void check_ota_updates(void)
         /* -- 0.5. Check for OTA updates (periodically, when WiFi connected) --- */
         if (!ota_in_progress && wifi_manager_is_connected()) {
             uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-            if (current_time - last_ota_check > OTA_CHECK_INTERVAL_MS) {
+            if ((int32_t)(current_time - next_ota_check) >= 0) {
                 ESP_LOGI(TAG, "⏰ Periodic OTA check triggered");
                 check_ota_updates();
             }
@@ -1002,6 +1428,8 @@ static void check_ota_updates(void)
         /* -- 1. Gestione Wi-Fi ---------------------------------------------- */
         if (!wifi_manager_is_connected()) {
             ESP_LOGW(TAG, "Wi-Fi connection lost. Attempting reconnection…");
+            abort_network_ops();
+            drop_last_known_state();
             display_manager_update(DISPLAY_STATE_WIFI_CONNECTING, 0);
 
             if (!wifi_manager_connect(wifi_ssid, wifi_password)) {
@@ -1011,24 +1439,30 @@ static void check_ota_updates(void)
                 continue;                      // riprova dall’inizio del while
             } else {
                 ESP_LOGI(TAG, "Wi-Fi reconnected successfully.");
-                force_immediate_check = true;  // ← qui!
+                // Not immediately: the whole fleet reconnects at once after an outage
+                retry_policy_on_connect();
             }
         }
 
         /* -- 2. Attesa o check immediato ------------------------------------ */
+        bool wifi_lost = false;
         if (!force_immediate_check) {          // attesa “tradizionale”
             uint32_t elapsed = 0;
-            char *endptr;
-            uint32_t interval = strtoul(api_interval_ms, &endptr, 10);
 
-            if (endptr == api_interval_ms || *endptr != '\0') {
-                interval = DEFAULT_API_CHECK_INTERVAL_MS; // se conversione fallita, uso il default
-            }
-            while (elapsed < interval) {
+            // Re-read every round: the result of the last call moves the
+            // interval (api_interval_ms is the budget, not a fixed period)
+            while (!poll_wait_over(elapsed)) {
+                // Handled at the top of the loop, without waiting for the poll
+                if (!wifi_manager_is_connected()) {
+                    wifi_lost = true;
+                    break;
+                }
+
                 // Check for short button press for immediate API check
                 if ((s_current_state == STATE_SHOW_PRACTICES ||
                     s_current_state == STATE_NO_PRACTICES ||
-                    s_current_state == STATE_API_ERROR)) {
+                    s_current_state == STATE_API_ERROR ||
+                    s_current_state == STATE_CHECKING_API)) {
                     
                     int current = gpio_get_level(BUTTON_GPIO);
                     if (last_button_state == 0 && current == 1) {
@@ -1045,22 +1479,24 @@ static void check_ota_updates(void)
                         }
                         
                         if (hold_time < 1000 && gpio_get_level(BUTTON_GPIO) == 0) {
-                            ESP_LOGI(TAG, "🔘 Short press detected (%lu ms) - checking API call protection", hold_time);
+                            ESP_LOGI(TAG, "🔘 Short press detected (%lu ms)", hold_time);
+                            last_button_state = 0;
+                            if (s_press_time == 0) {
+                                s_press_time = press_start;
+                            }
                             
-                            // Check if API call is already in progress or too soon after last call
-                            uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                            if (api_call_in_progress) {
-                                ESP_LOGW(TAG, "⚠️ API call already in progress - ignoring button press");
-                                last_button_state = 0;
-                                continue; // Continue waiting, don't exit loop
-                            } else if ((current_time - last_api_call_time) < MIN_API_CALL_INTERVAL_MS) {
-                                ESP_LOGW(TAG, "⚠️ Too soon after last API call (%lu ms ago) - ignoring button press", 
-                                        current_time - last_api_call_time);
-                                last_button_state = 0;
-                                continue; // Continue waiting, don't exit loop
+                            // A refresh already in flight answers this press too,
+                            // unless it looks stuck: then it starts over right away
+                            if (net_worker_is_busy(NET_JOB_REFRESH_COUNT)) {
+                                if (net_worker_running_ms(NET_JOB_REFRESH_COUNT) >= PRESS_RESTART_AFTER_MS &&
+                                    net_worker_cancel(NET_JOB_REFRESH_COUNT, true)) {
+                                    ESP_LOGI(TAG, "⛔ Refresh slow to answer - restarted for this press");
+                                } else {
+                                    ESP_LOGI(TAG, "🔗 Refresh already in flight - press coalesced");
+                                }
+                                net_worker_post(NET_JOB_REFRESH_COUNT);
                             } else {
-                                ESP_LOGI(TAG, "✅ API call allowed - triggering immediate check");
-                                last_button_state = 0;
+                                ESP_LOGI(TAG, "✅ Triggering immediate check");
                                 break; // Exit wait loop for immediate API check
                             }
                         } else {
@@ -1075,11 +1511,19 @@ static void check_ota_updates(void)
                     }
                 }
                 
-                vTaskDelay(pdMS_TO_TICKS(BUTTON_POLL_INTERVAL_MS));
-                elapsed += BUTTON_POLL_INTERVAL_MS;
+                preconnect_if_due(elapsed);
+                probe_endpoints_if_due(elapsed);
+
+                // Sleep on the result queue: results arrive while we keep servicing the button
+                uint32_t poll_start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+                handle_net_results(BUTTON_POLL_INTERVAL_MS);
+                elapsed += (xTaskGetTickCount() * portTICK_PERIOD_MS) - poll_start;
             }
         }
         /* Se force_immediate_check era true, saltiamo completamente il loop */
+        if (wifi_lost) {
+            continue;
+        }
 
         force_immediate_check = false;         // consumato il "bonus" immediato
 
@@ -1090,88 +1534,9 @@ static void check_ota_updates(void)
             continue; // Go back to main loop start to handle the long press
         }
         
-        // Set API call protection flags
-        api_call_in_progress = true;
-        last_api_call_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        ESP_LOGI(TAG, "🔒 API call protection activated");
-        
-        s_current_state = STATE_CHECKING_API;
-        display_manager_update(DISPLAY_STATE_CHECKING_API, 0);
-        
-        // Show "Checking..." message for at least 2 seconds for better UX
-        ESP_LOGI(TAG, "⏳ Showing checking message for 2 seconds...");
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        ESP_LOGI(TAG, "✅ 2 seconds delay completed, starting API call");
-        
-        int practices = -1;
-        
-        // Check working mode and call appropriate API
-        if (strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
-            ESP_LOGI(TAG, "📝 Editor mode: Checking documents created by user...");
-            
-            // First get user ID
-            char user_id[32];
-            esp_err_t err = api_manager_get_user_id(user_id, sizeof(user_id));
-            
-            if (err == ESP_OK) {
-                ESP_LOGI(TAG, "✅ User ID obtained: %s", user_id);
-                // Then check documents created by this user
-                practices = api_manager_check_editor_documents(user_id);
-                ESP_LOGI(TAG, "📊 Editor documents = %d", practices);
-            } else {
-                ESP_LOGE(TAG, "❌ Failed to get user ID for editor mode");
-                practices = -1;
-            }
-        } else {
-            ESP_LOGI(TAG, "✍️ Signer mode: Checking practices to sign...");
-            practices = api_manager_check_practices();
-            ESP_LOGI(TAG, "📊 Signer practices = %d", practices);
-        }
-
-        // Handle results (same logic for both modes)
-        if (practices < 0) {
-            ESP_LOGE(TAG, "API call failed (network issue, server error, or certificate issue).");
-            s_current_state = STATE_API_ERROR;
-            display_manager_update(DISPLAY_STATE_API_ERROR, 0);
-            // Clear API call protection flag even on error
-            api_call_in_progress = false;
-            ESP_LOGI(TAG, "🔓 API call protection deactivated (error case)");
-        }
-        else if (practices > 0) {
-            s_current_state = STATE_SHOW_PRACTICES;
-            ESP_LOGI(TAG, "Switching state to SHOW_PRACTICES");
-            display_manager_update(DISPLAY_STATE_SHOW_PRACTICES, practices);
-            // Clear API call protection flag
-            api_call_in_progress = false;
-            ESP_LOGI(TAG, "🔓 API call protection deactivated");
-        }
-        else {
-            s_current_state = STATE_NO_PRACTICES;
-            display_manager_update(DISPLAY_STATE_NO_PRACTICES, 0);
-            // Clear API call protection flag
-            api_call_in_progress = false;
-            ESP_LOGI(TAG, "🔓 API call protection deactivated");
-        }
-
-          // Check if we need to force display refresh after OTA check feedback
-          if (force_display_refresh) {
-              force_display_refresh = false;
-              // Re-display current state to override temporary OTA messages
-              switch (s_current_state) {
-                  case STATE_SHOW_PRACTICES:
-                      display_manager_update(DISPLAY_STATE_SHOW_PRACTICES, practices);
-                      break;
-                  case STATE_NO_PRACTICES:
-                      display_manager_update(DISPLAY_STATE_NO_PRACTICES, 0);
-                      break;
-                  case STATE_API_ERROR:
-                      display_manager_update(DISPLAY_STATE_API_ERROR, 0);
-                      break;
-                  default:
-                      // For other states, just continue normal flow
-                      break;
-              }
-          }
+        // The API call runs on the network worker; its result is applied by
+        // handle_net_results() while this loop keeps servicing the button
+        request_practices_refresh();
 
           // Brief delay to allow time for other tasks (e.g. LVGL) and feed the watchdog
           vTaskDelay(pdMS_TO_TICKS(100));
@@ -1200,10 +1565,26 @@ static void check_ota_updates(void)
      };
      gpio_config(&btn_config);
  
+    // HTTP client locks, before anything that may start a request
+    if (api_manager_init() != ESP_OK) {
+        ESP_LOGE(TAG, "❌ HTTP client unavailable");
+    }
+
     ble_manager_init();
     wifi_manager_init();
     display_manager_init();
     
+    // Document titles for the carousel (PSRAM), filled by the network worker
+    if (doc_list_init() != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Document list unavailable, counts only");
+    }
+
+    // Network worker: API calls run off main_flow_task
+    esp_err_t net_err = net_worker_init();
+    if (net_err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Failed to start network worker: %s", esp_err_to_name(net_err));
+    }
+    
     // Initialize OTA manager
     esp_err_t ota_err = ota_manager_init(ota_progress_callback);
     if (ota_err == ESP_OK) {
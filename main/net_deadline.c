@@ -0,0 +1,60 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: net_deadline.c                                     *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Deadlines and cancellation for network ops  *
+ ************************************************************/
+
+#include <stddef.h>
+#include "esp_timer.h"
+
+#include "net_deadline.h"
+
+net_deadline_t net_deadline_in(uint32_t timeout_ms, const net_cancel_token_t *token)
+{
+    net_deadline_t deadline = {
+        .at_us = (timeout_ms > 0) ? esp_timer_get_time() + (int64_t)timeout_ms * 1000 : 0,
+        .token = token,
+        .generation = (token != NULL) ? token->generation : 0,
+    };
+    return deadline;
+}
+
+void net_cancel_trigger(net_cancel_token_t *token)
+{
+    // Aligned 32-bit stores are atomic on the ESP32 cores
+    token->generation++;
+}
+
+bool net_deadline_cancelled(const net_deadline_t *deadline)
+{
+    return deadline != NULL && deadline->token != NULL &&
+           deadline->token->generation != deadline->generation;
+}
+
+bool net_deadline_over(const net_deadline_t *deadline)
+{
+    if (deadline == NULL) {
+        return false;
+    }
+    return net_deadline_cancelled(deadline) ||
+           (deadline->at_us != 0 && esp_timer_get_time() >= deadline->at_us);
+}
+
+uint32_t net_deadline_left_ms(const net_deadline_t *deadline, uint32_t cap_ms)
+{
+    if (deadline == NULL) {
+        return cap_ms;
+    }
+    if (net_deadline_cancelled(deadline)) {
+        return 0;
+    }
+    if (deadline->at_us == 0) {
+        return cap_ms;
+    }
+    int64_t left_ms = (deadline->at_us - esp_timer_get_time()) / 1000;
+    if (left_ms <= 0) {
+        return 0;
+    }
+    return (left_ms < cap_ms) ? (uint32_t)left_ms : cap_ms;
+}
@@ -0,0 +1,59 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: net_deadline.h                                     *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Deadlines and cancellation for network ops  *
+ ************************************************************/
+
+#ifndef NET_DEADLINE_H
+#define NET_DEADLINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_CANCEL_SLICE_MS        20      // Blocking waits check deadline and token this often
+
+// Owned by whoever may need to abort operations (network worker, push client)
+typedef struct {
+    volatile uint32_t generation;   // Bumped by net_cancel_trigger()
+} net_cancel_token_t;
+
+// Absolute bound of one operation, from DNS to the last body byte
+typedef struct {
+    int64_t at_us;                      // esp_timer time to give up at (0 = no deadline)
+    const net_cancel_token_t *token;    // NULL = cannot be cancelled
+    uint32_t generation;                // token->generation when the operation started
+} net_deadline_t;
+
+/**
+ * @brief Starts a deadline timeout_ms from now
+ *
+ * Only a net_cancel_trigger() issued after this call cancels the operation,
+ * so a trigger that raced an earlier job does not hit the next one.
+ *
+ * @param timeout_ms Budget of the operation (0 = no deadline)
+ * @param token      Cancellation token (may be NULL)
+ */
+net_deadline_t net_deadline_in(uint32_t timeout_ms, const net_cancel_token_t *token);
+
+// Cancels every operation started on token before this call (any task)
+void net_cancel_trigger(net_cancel_token_t *token);
+
+// True once the token was triggered after the operation started
+bool net_deadline_cancelled(const net_deadline_t *deadline);
+
+// True once the deadline passed or the operation was cancelled (NULL = never)
+bool net_deadline_over(const net_deadline_t *deadline);
+
+// Time left, capped at cap_ms (also the answer when there is no deadline); 0 once over
+uint32_t net_deadline_left_ms(const net_deadline_t *deadline, uint32_t cap_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NET_DEADLINE_H
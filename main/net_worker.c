@@ -0,0 +1,378 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: net_worker.c                                       *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Network worker task (API calls off the UI)  *
+ ************************************************************/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "net_worker.h"
+#include "api_manager.h"
+#include "dns_cache.h"
+#include "doc_list.h"
+#include "device_config.h"
+#include "global_vars.h"
+
+static const char *TAG = "NetWorker";
+
+typedef struct {
+    QueueHandle_t job_queue;        // net_job_type_t, one slot per type
+    QueueHandle_t result_queue;     // net_job_result_t
+    TaskHandle_t task;
+    portMUX_TYPE lock;
+    bool queued[NET_JOB_TYPE_COUNT];
+    bool running[NET_JOB_TYPE_COUNT];
+    bool rerun[NET_JOB_TYPE_COUNT];         // Cancelled job is queued again
+    uint32_t triggers[NET_JOB_TYPE_COUNT];
+    int64_t started_us;                     // Start of the running job
+    net_cancel_token_t cancel;              // Aborts the running job (net_worker_cancel)
+} net_worker_state_t;
+
+static net_worker_state_t s_worker = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const uint32_t s_job_deadline_ms[NET_JOB_TYPE_COUNT] = {
+    [NET_JOB_REFRESH_COUNT] = NET_REFRESH_DEADLINE_MS,
+    [NET_JOB_CHECK_OTA]     = NET_OTA_CHECK_DEADLINE_MS,
+    [NET_JOB_DNS_PREWARM]   = 0,    // Bounded by the resolver's own timeouts
+    [NET_JOB_PRECONNECT]    = NET_PRECONNECT_DEADLINE_MS,
+    [NET_JOB_PROBE_ENDPOINT] = NET_PROBE_DEADLINE_MS,
+    [NET_JOB_FETCH_DOCUMENTS] = NET_DOCUMENTS_DEADLINE_MS,
+};
+
+// Returns the count for the working mode (both mode: signer practices,
+// with the editor documents in *editor_practices; extra accounts: the sum,
+// with the breakdown in result->account_practices), -1 on error
+static int net_worker_refresh_count(net_job_result_t *result, const net_deadline_t *deadline)
+{
+    int *editor_practices = &result->editor_practices;
+    int practices = -1;
+    bool both = (strcmp(working_mode, WORKING_MODE_BOTH) == 0);
+
+    *editor_practices = -1;
+
+    // Check working mode and call appropriate API
+    if (both || strcmp(working_mode, WORKING_MODE_EDITOR) == 0) {
+        if (both) {
+            ESP_LOGI(TAG, "✍️ Both mode: Checking practices and documents...");
+        } else {
+            ESP_LOGI(TAG, "📝 Editor mode: Checking documents created by user...");
+        }
+
+        // First get user ID
+        char user_id[32];
+        esp_err_t err = api_manager_get_user_id(user_id, sizeof(user_id), deadline);
+
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Failed to get user ID for %s mode", both ? "both" : "editor");
+        } else if (both) {
+            int signer = -1;
+            int editor = -1;
+            // One pipelined exchange; a failure of either count fails the refresh
+            if (api_manager_check_both(user_id, &signer, &editor, deadline) == ESP_OK) {
+                practices = signer;
+                *editor_practices = editor;
+            }
+            ESP_LOGI(TAG, "📊 Signer practices = %d, editor documents = %d", signer, editor);
+        } else {
+            ESP_LOGI(TAG, "✅ User ID obtained: %s", user_id);
+            // Then check documents created by this user
+            practices = api_manager_check_editor_documents(user_id, deadline);
+            ESP_LOGI(TAG, "📊 Editor documents = %d", practices);
+        }
+    } else if (extra_account_count > 0) {
+        ESP_LOGI(TAG, "✍️ Signer mode: Checking practices to sign for %u account(s)...",
+                 extra_account_count + 1);
+        practices = api_manager_check_accounts(result->account_practices, 1 + extra_account_count,
+                                                deadline);
+        result->accounts = 1 + extra_account_count;
+        ESP_LOGI(TAG, "📊 Signer practices (all accounts) = %d", practices);
+    } else {
+        ESP_LOGI(TAG, "✍️ Signer mode: Checking practices to sign...");
+        practices = api_manager_check_practices(deadline);
+        ESP_LOGI(TAG, "📊 Signer practices = %d", practices);
+    }
+    return practices;
+}
+
+// Lists shown by the display for the working mode (none with extra
+// accounts: the titles would not say whose they are)
+static void net_worker_document_kinds(bool *signer, bool *editor)
+{
+    bool both = (strcmp(working_mode, WORKING_MODE_BOTH) == 0);
+
+    *editor = both || strcmp(working_mode, WORKING_MODE_EDITOR) == 0;
+    *signer = both || (!*editor && extra_account_count == 0);
+}
+
+// Queues the title fetch when a count just seen differs from its list. A
+// job of its own, so the count is shown without waiting for the titles.
+static void net_worker_queue_documents(void)
+{
+    bool signer, editor;
+
+    net_worker_document_kinds(&signer, &editor);
+    if ((signer && doc_list_outdated(DOC_LIST_SIGNER)) || (editor && doc_list_outdated(DOC_LIST_EDITOR))) {
+        net_worker_post(NET_JOB_FETCH_DOCUMENTS);
+    }
+}
+
+static esp_err_t net_worker_fetch_documents(const net_deadline_t *deadline)
+{
+    bool signer, editor;
+    esp_err_t err = ESP_OK;
+
+    net_worker_document_kinds(&signer, &editor);
+    if (signer) {
+        err = api_manager_fetch_documents(DOC_LIST_SIGNER, NULL, deadline);
+    }
+    if (editor && err == ESP_OK && doc_list_outdated(DOC_LIST_EDITOR)) {
+        // Cached by the refresh that queued this job
+        char user_id[32];
+        err = api_manager_get_user_id(user_id, sizeof(user_id), deadline);
+        if (err == ESP_OK) {
+            err = api_manager_fetch_documents(DOC_LIST_EDITOR, user_id, deadline);
+        }
+    }
+    return err;
+}
+
+// Never block on a slow consumer: drop the oldest event instead
+static void net_worker_publish(const net_job_result_t *result)
+{
+    if (xQueueSend(s_worker.result_queue, result, 0) != pdTRUE) {
+        net_job_result_t stale;
+        xQueueReceive(s_worker.result_queue, &stale, 0);
+        ESP_LOGW(TAG, "⚠️ Result queue full, dropped event for job %d", stale.type);
+        xQueueSend(s_worker.result_queue, result, 0);
+    }
+}
+
+static void net_worker_task(void *pvParameters)
+{
+    net_job_type_t type;
+    static net_job_result_t result;     // Kept off the stack (TLS needs it)
+
+    ESP_LOGI(TAG, "🌐 Network worker started");
+
+    while (1) {
+        if (xQueueReceive(s_worker.job_queue, &type, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // From here on new posts of this type join the running job. The
+        // deadline snapshots the token in the same section, so any cancel
+        // that sees running[type] also hits this job
+        int64_t start_us = esp_timer_get_time();
+        taskENTER_CRITICAL(&s_worker.lock);
+        s_worker.queued[type] = false;
+        s_worker.running[type] = true;
+        s_worker.started_us = start_us;
+        net_deadline_t deadline = net_deadline_in(s_job_deadline_ms[type], &s_worker.cancel);
+        taskEXIT_CRITICAL(&s_worker.lock);
+
+        memset(&result, 0, sizeof(result));
+        result.type = type;
+
+        switch (type) {
+            case NET_JOB_REFRESH_COUNT:
+                result.practices = net_worker_refresh_count(&result, &deadline);
+                // The endpoint failed and another one took over: one more go, same deadline
+                if (result.practices < 0 && !net_deadline_over(&deadline) && api_manager_failover_ready()) {
+                    ESP_LOGW(TAG, "🔀 Refresh failed on its endpoint, running it on the next one");
+                    result.practices = net_worker_refresh_count(&result, &deadline);
+                }
+                result.err = (result.practices < 0) ? ESP_FAIL : ESP_OK;
+                if (result.practices < 0) {
+                    result.err_class = api_manager_last_error(&result.http_status);
+                } else {
+                    net_worker_queue_documents();
+                }
+                break;
+            case NET_JOB_CHECK_OTA:
+                result.practices = -1;
+                result.editor_practices = -1;
+                result.err = api_manager_check_firmware_updates(CURRENT_FIRMWARE_VERSION, &result.update_info,
+                                                                &deadline);
+                break;
+            case NET_JOB_DNS_PREWARM:
+                dns_cache_prewarm(&deadline);
+                result.err = ESP_OK;
+                break;
+            case NET_JOB_PRECONNECT:
+                result.err = api_manager_preconnect(&deadline);
+                break;
+            case NET_JOB_PROBE_ENDPOINT:
+                result.err = api_manager_probe_endpoint(&deadline);
+                break;
+            case NET_JOB_FETCH_DOCUMENTS:
+                result.err = net_worker_fetch_documents(&deadline);
+                break;
+            default:
+                result.err = ESP_ERR_INVALID_ARG;
+                break;
+        }
+        result.duration_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+        bool cancelled = net_deadline_cancelled(&deadline);
+        bool rerun = false;
+        taskENTER_CRITICAL(&s_worker.lock);
+        s_worker.running[type] = false;
+        if (cancelled) {
+            // The triggers stay with the job that answers them
+            rerun = s_worker.rerun[type] && !s_worker.queued[type];
+            s_worker.queued[type] = s_worker.queued[type] || rerun;
+        } else {
+            result.triggers = s_worker.triggers[type];
+            s_worker.triggers[type] = 0;
+        }
+        s_worker.rerun[type] = false;
+        taskEXIT_CRITICAL(&s_worker.lock);
+
+        if (cancelled) {
+            ESP_LOGW(TAG, "⛔ Job %d cancelled after %lu ms%s",
+                     type, result.duration_ms, rerun ? ", running it again" : "");
+            if (rerun) {
+                xQueueSend(s_worker.job_queue, &type, 0);
+            }
+            continue;
+        }
+
+        ESP_LOGI(TAG, "✅ Job %d done in %lu ms (%lu trigger(s) served)",
+                 type, result.duration_ms, result.triggers);
+
+        // Housekeeping jobs have nobody waiting for them
+        if (type == NET_JOB_DNS_PREWARM || type == NET_JOB_PRECONNECT ||
+            type == NET_JOB_PROBE_ENDPOINT || type == NET_JOB_FETCH_DOCUMENTS) {
+            continue;
+        }
+
+        net_worker_publish(&result);
+    }
+}
+
+esp_err_t net_worker_init(void)
+{
+    if (s_worker.task != NULL) {
+        return ESP_OK;
+    }
+
+    s_worker.job_queue = xQueueCreate(NET_JOB_TYPE_COUNT, sizeof(net_job_type_t));
+    s_worker.result_queue = xQueueCreate(NET_WORKER_RESULT_DEPTH, sizeof(net_job_result_t));
+    if (s_worker.job_queue == NULL || s_worker.result_queue == NULL) {
+        ESP_LOGE(TAG, "❌ Failed to create worker queues");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(net_worker_task, "net_worker", NET_WORKER_STACK_SIZE, NULL,
+                    NET_WORKER_PRIORITY, &s_worker.task) != pdPASS) {
+        ESP_LOGE(TAG, "❌ Failed to create network worker task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool net_worker_post(net_job_type_t type)
+{
+    bool enqueue = false;
+
+    if (type >= NET_JOB_TYPE_COUNT || type == NET_JOB_PUSH_EVENT || type == NET_JOB_LAN_RESULT ||
+        s_worker.job_queue == NULL) {
+        return false;
+    }
+
+    taskENTER_CRITICAL(&s_worker.lock);
+    s_worker.triggers[type]++;
+    if (!s_worker.queued[type] && !s_worker.running[type]) {
+        s_worker.queued[type] = true;
+        enqueue = true;
+    }
+    taskEXIT_CRITICAL(&s_worker.lock);
+
+    if (!enqueue) {
+        ESP_LOGI(TAG, "🔗 Job %d already pending, request coalesced", type);
+        return false;
+    }
+
+    // One queue slot per job type, so this cannot fail while the flags hold
+    if (xQueueSend(s_worker.job_queue, &type, 0) != pdTRUE) {
+        taskENTER_CRITICAL(&s_worker.lock);
+        s_worker.queued[type] = false;
+        s_worker.triggers[type] = 0;
+        taskEXIT_CRITICAL(&s_worker.lock);
+        ESP_LOGE(TAG, "❌ Job queue full, request %d dropped", type);
+        return false;
+    }
+    return true;
+}
+
+void net_worker_deliver(const net_job_result_t *result)
+{
+    if (s_worker.result_queue == NULL || result == NULL) {
+        return;
+    }
+    net_worker_publish(result);
+}
+
+bool net_worker_get_result(net_job_result_t *result, TickType_t wait)
+{
+    if (s_worker.result_queue == NULL || result == NULL) {
+        // Callers use this as their poll delay: keep that behaviour
+        vTaskDelay(wait);
+        return false;
+    }
+    return xQueueReceive(s_worker.result_queue, result, wait) == pdTRUE;
+}
+
+bool net_worker_is_busy(net_job_type_t type)
+{
+    bool busy;
+
+    if (type >= NET_JOB_TYPE_COUNT) {
+        return false;
+    }
+    taskENTER_CRITICAL(&s_worker.lock);
+    busy = s_worker.queued[type] || s_worker.running[type];
+    taskEXIT_CRITICAL(&s_worker.lock);
+    return busy;
+}
+
+uint32_t net_worker_running_ms(net_job_type_t type)
+{
+    int64_t started_us = 0;
+
+    if (type >= NET_JOB_TYPE_COUNT) {
+        return 0;
+    }
+    taskENTER_CRITICAL(&s_worker.lock);
+    if (s_worker.running[type]) {
+        started_us = s_worker.started_us;
+    }
+    taskEXIT_CRITICAL(&s_worker.lock);
+    return (started_us != 0) ? (uint32_t)((esp_timer_get_time() - started_us) / 1000) : 0;
+}
+
+bool net_worker_cancel(net_job_type_t type, bool rerun)
+{
+    bool hit = false;
+
+    taskENTER_CRITICAL(&s_worker.lock);
+    for (int t = 0; t < NET_JOB_TYPE_COUNT; t++) {
+        if (s_worker.running[t] && (type == NET_JOB_TYPE_COUNT || type == (net_job_type_t)t)) {
+            s_worker.rerun[t] = rerun;
+            hit = true;
+        }
+    }
+    if (hit) {
+        net_cancel_trigger(&s_worker.cancel);
+    }
+    taskEXIT_CRITICAL(&s_worker.lock);
+    return hit;
+}
@@ -0,0 +1,126 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: net_worker.h                                       *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Network worker task (API calls off the UI)  *
+ ************************************************************/
+
+#ifndef NET_WORKER_H
+#define NET_WORKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "ota_manager.h"    // Per ota_version_info_t
+#include "api_manager.h"    // Per api_error_class_t
+#include "device_config.h"  // Per EXTRA_ACCOUNTS_MAX
+#include "net_deadline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_WORKER_STACK_SIZE      8192    // TLS handshakes need the room
+#define NET_WORKER_PRIORITY        4       // Below main_flow_task
+#define NET_WORKER_RESULT_DEPTH    4
+
+// Deadline of each job, DNS to last byte (0 = none)
+#define NET_REFRESH_DEADLINE_MS    20000   // Account lookup + pipelined counts
+#define NET_OTA_CHECK_DEADLINE_MS  20000
+#define NET_PRECONNECT_DEADLINE_MS 10000
+#define NET_PROBE_DEADLINE_MS      10000
+#define NET_DOCUMENTS_DEADLINE_MS  20000   // Every changed page of both lists
+
+// Jobs main_flow_task can hand to the worker
+typedef enum {
+    NET_JOB_REFRESH_COUNT = 0,  // Pending practices/documents for the working mode
+    NET_JOB_CHECK_OTA,          // GitHub latest-release lookup
+    NET_JOB_DNS_PREWARM,        // Resolve the API hosts after (re)connecting; no completion event
+    NET_JOB_PRECONNECT,         // Open the API connection ahead of the next poll; no completion event
+    NET_JOB_PROBE_ENDPOINT,     // Health check of a fallback API endpoint; no completion event
+    NET_JOB_FETCH_DOCUMENTS,    // Pending-document titles after a count changed (queued by the worker); no completion event
+    NET_JOB_PUSH_EVENT,         // Not a job: events from push_client (see net_worker_deliver)
+    NET_JOB_LAN_RESULT,         // Not a job: counts polled by the LAN leader (lan_share)
+    NET_JOB_TYPE_COUNT
+} net_job_type_t;
+
+// Completion event delivered back to main_flow_task
+typedef struct {
+    net_job_type_t type;
+    uint32_t triggers;              // Posts coalesced into this run (>= 1)
+    uint32_t duration_ms;           // Time spent in the API calls
+    int practices;                  // REFRESH_COUNT, LAN_RESULT: count (both mode: signer), -1 on error
+    int editor_practices;           // REFRESH_COUNT, LAN_RESULT, both mode: editor documents, otherwise -1
+    uint8_t accounts;               // REFRESH_COUNT, LAN_RESULT, extra accounts: entries in account_practices (0 = single account)
+    int account_practices[1 + EXTRA_ACCOUNTS_MAX];  // Per-account counts, -1 = that account failed
+    api_error_class_t err_class;    // REFRESH_COUNT: why it failed
+    int http_status;                // REFRESH_COUNT: HTTP status of the failure (0 = none)
+    esp_err_t err;                  // CHECK_OTA: ESP_OK = update available, ESP_ERR_NOT_FOUND = none
+                                    // PUSH_EVENT: ESP_OK = change (practices = count, -1 = unknown),
+                                    //             ESP_ERR_INVALID_STATE = push stream lost
+    ota_version_info_t update_info; // CHECK_OTA: valid when err == ESP_OK
+} net_job_result_t;
+
+/**
+ * @brief Creates the worker task and its queues
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t net_worker_init(void);
+
+/**
+ * @brief Requests a job
+ *
+ * A job of the same type that is already queued or running absorbs the
+ * request (timer, button, Wi-Fi reconnect and OTA triggers coalesce into one
+ * network call) and a single completion event is delivered for it.
+ *
+ * @param type Job type
+ * @return true if a new job was queued, false if it was merged or rejected
+ */
+bool net_worker_post(net_job_type_t type);
+
+/**
+ * @brief Waits for the next completion event
+ *
+ * @param result Output event
+ * @param wait   Ticks to wait (0 = poll)
+ * @return true if an event was received
+ */
+bool net_worker_get_result(net_job_result_t *result, TickType_t wait);
+
+/**
+ * @brief Delivers an event produced outside the worker
+ *
+ * Lets other network tasks (push_client, lan_share) reach main_flow_task through the
+ * same completion queue; like the worker's own events it never blocks.
+ *
+ * @param result Event to deliver (copied)
+ */
+void net_worker_deliver(const net_job_result_t *result);
+
+// True while a job of this type is queued or running
+bool net_worker_is_busy(net_job_type_t type);
+
+// How long the running job of this type has been at it (0 = not running)
+uint32_t net_worker_running_ms(net_job_type_t type);
+
+/**
+ * @brief Aborts the running job of this type
+ *
+ * Triggers the worker's cancellation token: the blocked API call returns
+ * within a few tens of milliseconds. A cancelled job delivers no event;
+ * with rerun it is queued again right away and its triggers carry over.
+ *
+ * @param type  Job type, NET_JOB_TYPE_COUNT = whatever is running
+ * @param rerun Run the job again instead of dropping it
+ * @return true if a running job was cancelled
+ */
+bool net_worker_cancel(net_job_type_t type, bool rerun);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NET_WORKER_H
@@ -7,12 +7,14 @@
 
 #include "ota_manager.h"
 #include "esp_log.h"
-#include "esp_http_client.h"
-#include "esp_https_ota.h"
 #include "esp_ota_ops.h"
 #include "esp_app_format.h"
 #include "esp_image_format.h"
-#include "esp_crt_bundle.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include "api_manager.h"
+#include "api_cache.h"
+#include "net_deadline.h"
 #include "mbedtls/sha256.h"
 #include "mbedtls/rsa.h"
 #include "mbedtls/pk.h"
@@ -23,6 +25,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "OTA_MANAGER";
@@ -32,7 +36,9 @@ typedef struct {
     ota_status_t status;
     ota_error_t last_error;
     ota_progress_callback_t progress_callback;
-    esp_https_ota_handle_t ota_handle;
+    esp_ota_handle_t ota_handle;
+    bool ota_begun;                     // ota_handle open: end or abort it
+    net_cancel_token_t cancel;          // Stops the download (ota_cancel_update)
     const esp_partition_t* update_partition;
     const esp_partition_t* running_partition;
     SemaphoreHandle_t mutex;
@@ -44,10 +50,12 @@ static ota_manager_state_t g_ota_state = {0};
 
 // Forward declarations
 static void ota_task(void* pvParameter);
-static esp_err_t ota_download_firmware(const ota_version_info_t* update_info);
+static esp_err_t ota_download_firmware(const ota_version_info_t* update_info,
+                                       const net_deadline_t* deadline);
 static void ota_set_status(ota_status_t status);
 static void ota_set_error(ota_error_t error);
 static void ota_notify_progress(int percentage);
+static void ota_resume_clear(void);
 
 esp_err_t ota_manager_init(ota_progress_callback_t progress_cb)
 {
@@ -131,7 +139,8 @@ esp_err_t ota_start_update(const ota_version_info_t* update_info)
         return ESP_ERR_TIMEOUT;
     }
     
-    if (g_ota_state.status != OTA_STATUS_IDLE) {
+    // A cancelled task may still be closing its download
+    if (g_ota_state.status != OTA_STATUS_IDLE || g_ota_state.ota_task_handle != NULL) {
         xSemaphoreGive(g_ota_state.mutex);
         ESP_LOGE(TAG, "❌ OTA update already in progress");
         return ESP_ERR_INVALID_STATE;
@@ -168,6 +177,7 @@ static void ota_task(void* pvParameter)
 {
     ota_version_info_t* update_info = (ota_version_info_t*)pvParameter;
     esp_err_t err = ESP_OK;
+    net_deadline_t deadline = net_deadline_in(OTA_DOWNLOAD_TIMEOUT_MS, &g_ota_state.cancel);
     
     ESP_LOGI(TAG, "📥 OTA Task started");
     
@@ -190,7 +200,15 @@ static void ota_task(void* pvParameter)
     ota_set_status(OTA_STATUS_DOWNLOADING);
     ota_notify_progress(0);
     
-    err = ota_download_firmware(update_info);
+    err = ota_download_firmware(update_info, &deadline);
+    if (err != ESP_OK && net_deadline_cancelled(&deadline)) {
+        // ota_cancel_update() already reset the state
+        ESP_LOGI(TAG, "🚫 Firmware download stopped");
+        g_ota_state.ota_task_handle = NULL;
+        free(update_info);
+        vTaskDelete(NULL);
+        return;
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "❌ Firmware download failed: %s", esp_err_to_name(err));
         ota_set_error(OTA_ERROR_DOWNLOAD_FAILED);
@@ -207,7 +225,14 @@ static void ota_task(void* pvParameter)
     ota_set_status(OTA_STATUS_INSTALLING);
     ota_notify_progress(90);
     
-    err = esp_https_ota_finish(g_ota_state.ota_handle);
+    // esp_ota_end() checks the image (and its hash) before it can boot.
+    // Good or not, the image in the partition is not resumed any more
+    err = esp_ota_end(g_ota_state.ota_handle);
+    g_ota_state.ota_begun = false;
+    ota_resume_clear();
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(g_ota_state.update_partition);
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "❌ OTA finish failed: %s", esp_err_to_name(err));
         ota_set_error(OTA_ERROR_WRITE_FAILED);
@@ -229,7 +254,15 @@ static void ota_task(void* pvParameter)
     
 cleanup:
     ota_set_status(OTA_STATUS_ERROR);
+    // The task is done with the state: a resume scheduled by the callback
+    // may start the next one
+    xSemaphoreTake(g_ota_state.mutex, portMAX_DELAY);
+    int percentage = g_ota_state.progress_percentage;
     g_ota_state.ota_task_handle = NULL;
+    xSemaphoreGive(g_ota_state.mutex);
+    // The callback puts the device back to polling (and schedules the
+    // resume of an interrupted download)
+    ota_notify_progress(percentage);
     
     // Free the allocated update_info memory
     if (update_info) {
@@ -239,115 +272,482 @@ cleanup:
     vTaskDelete(NULL);
 }
 
-static esp_err_t ota_download_firmware(const ota_version_info_t* update_info)
+// Reads the next part of the firmware into buf. Returns bytes read (0 at
+// the end of the image) or <0
+static int ota_read(api_http_stream_t* stream, uint8_t* buf, size_t len)
 {
-    ESP_LOGI(TAG, "📥 Downloading firmware from: %s", update_info->url);
-    
-    // Validate firmware size to prevent division by zero and other issues
-    if (update_info->size == 0 || update_info->size > 10 * 1024 * 1024) { // Max 10MB
-        ESP_LOGE(TAG, "❌ Invalid firmware size: %lu bytes", update_info->size);
-        return ESP_ERR_INVALID_SIZE;
+    int n = api_manager_http_read(stream, buf, len);
+    if (n < 0) {
+        ESP_LOGE(TAG, "❌ Firmware download interrupted");
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Resumable download
+// ---------------------------------------------------------------------------
+// NVS keeps which release is being downloaded, into which partition and
+// how much of it is already there. A dropped connection is retried on the
+// spot from the last byte written; after a reboot the download goes on
+// from the last checkpoint. esp_ota_end() checks the hash of the whole
+// image, so a resumed image that does not fit together is never booted.
+
+#define OTA_RESUME_NVS_KEY      "progress"
+#define OTA_RESUME_MAGIC        0x4F545231UL    // "OTR1"
+
+typedef struct {
+    uint32_t magic;
+    char version[32];               // Release being downloaded
+    uint32_t url_crc;               // Its asset URL (the download host it redirects to
+                                    // signs every link: that one never repeats)
+    uint32_t size;                  // Image size the release announced
+    uint32_t partition_address;     // Update partition receiving it
+    uint32_t written;               // Image bytes in flash, a multiple of OTA_RESUME_CHECKPOINT_BYTES
+    char validator[API_CACHE_ETAG_SIZE];    // ETag (or Last-Modified) of the image, sent as If-Range
+    uint32_t crc;                   // Over all the fields above
+} ota_resume_record_t;
+
+// One download, across its retries
+typedef struct {
+    const ota_version_info_t* info;
+    ota_resume_record_t record;     // Progress as saved to NVS
+    uint32_t written;               // Image bytes written to the partition so far
+    uint8_t* buf;                   // OTA_BUFFER_SIZE
+    uint32_t chunks;
+    int last_progress;
+    uint32_t last_update_time;
+} ota_download_t;
+
+static uint32_t ota_resume_crc(const ota_resume_record_t* record)
+{
+    return esp_rom_crc32_le(0, (const uint8_t*)record, offsetof(ota_resume_record_t, crc));
+}
+
+static uint32_t ota_resume_url_crc(const char* url)
+{
+    return esp_rom_crc32_le(0, (const uint8_t*)url, strlen(url));
+}
+
+static bool ota_resume_load(ota_resume_record_t* record)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(*record);
+    bool valid = false;
+
+    if (nvs_open(OTA_RESUME_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    if (nvs_get_blob(handle, OTA_RESUME_NVS_KEY, record, &len) == ESP_OK && len == sizeof(*record)) {
+        valid = (record->magic == OTA_RESUME_MAGIC && record->crc == ota_resume_crc(record));
+    }
+    nvs_close(handle);
+    return valid;
+}
+
+static void ota_resume_save(ota_resume_record_t* record)
+{
+    nvs_handle_t handle;
+
+    record->magic = OTA_RESUME_MAGIC;
+    record->crc = ota_resume_crc(record);
+    esp_err_t err = nvs_open(OTA_RESUME_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, OTA_RESUME_NVS_KEY, record, sizeof(*record));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Failed to save download progress: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "💾 Download progress saved: %lu bytes", record->written);
+}
+
+static void ota_resume_clear(void)
+{
+    nvs_handle_t handle;
+
+    if (nvs_open(OTA_RESUME_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_erase_key(handle, OTA_RESUME_NVS_KEY) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+// The saved progress is of this release, in this partition, and the start
+// of the image (checked when it arrived) is still there
+static bool ota_resume_usable(const ota_resume_record_t* record, const ota_version_info_t* info)
+{
+    esp_app_desc_t app_desc;
+
+    if (strcmp(record->version, info->version) != 0 || record->url_crc != ota_resume_url_crc(info->url) ||
+        record->size != info->size || record->partition_address != g_ota_state.update_partition->address) {
+        return false;
+    }
+    if (record->written == 0 || record->written >= record->size ||
+        record->written % OTA_RESUME_CHECKPOINT_BYTES != 0) {
+        return false;
+    }
+    if (esp_ota_get_partition_description(g_ota_state.update_partition, &app_desc) != ESP_OK) {
+        return false;
+    }
+    ESP_LOGI(TAG, "📋 Partly downloaded firmware: %s (%s %s)", app_desc.version, app_desc.date, app_desc.time);
+    return true;
+}
+
+// Starts the record of a download from byte 0
+static void ota_resume_start(ota_download_t* dl)
+{
+    memset(&dl->record, 0, sizeof(dl->record));
+    strlcpy(dl->record.version, dl->info->version, sizeof(dl->record.version));
+    dl->record.url_crc = ota_resume_url_crc(dl->info->url);
+    dl->record.size = dl->info->size;
+    dl->record.partition_address = g_ota_state.update_partition->address;
+    dl->written = 0;
+}
+
+// Drops what was downloaded: the next request asks for the whole image
+static void ota_download_restart(ota_download_t* dl)
+{
+    if (g_ota_state.ota_begun) {
+        esp_ota_abort(g_ota_state.ota_handle);
+        g_ota_state.ota_begun = false;
+    }
+    if (dl->record.written > 0) {
+        ota_resume_clear();
+    }
+    ota_resume_start(dl);
+}
+
+// Saves the progress each time another OTA_RESUME_CHECKPOINT_BYTES are in flash
+static void ota_download_checkpoint(ota_download_t* dl)
+{
+    uint32_t checkpoint = dl->written - dl->written % OTA_RESUME_CHECKPOINT_BYTES;
+
+    if (checkpoint > dl->record.written && checkpoint < dl->info->size) {
+        dl->record.written = checkpoint;
+        ota_resume_save(&dl->record);
+    }
+}
+
+static void ota_download_progress(ota_download_t* dl)
+{
+    // Update progress with safe division
+    int progress = (int)(((uint64_t)dl->written * 70) / dl->info->size); // 0-70% for download
+    if (progress > 70) progress = 70;
+    
+    // Debug log every 10 chunks to monitor download
+    if (++dl->chunks % 10 == 0) {
+        ESP_LOGI(TAG, "📊 Download progress: %lu bytes / %lu bytes (%d%%)", 
+                 dl->written, dl->info->size, progress);
     }
     
-    ESP_LOGI(TAG, "📏 Firmware size: %lu bytes (%.2f MB)", update_info->size, 
-             update_info->size / (1024.0 * 1024.0));
-    
-    esp_http_client_config_t config = {
-        .url = update_info->url,
-        .timeout_ms = OTA_RECV_TIMEOUT_MS,
-        .keep_alive_enable = true,
-        .crt_bundle_attach = esp_crt_bundle_attach,  // Enable certificate verification
-        .skip_cert_common_name_check = false,
-        .buffer_size = 8192,        // Increased buffer for large firmware files
-        .buffer_size_tx = 2048,     // Increased TX buffer
-    };
+    // Update progress only occasionally to reduce SPI conflicts
+    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
     
-    esp_https_ota_config_t ota_config = {
-        .http_config = &config,
-    };
+    // Update every 5% or every 2 seconds (LVGL is suspended, so safe now)
+    if (progress != dl->last_progress && 
+        (progress - dl->last_progress >= 5 || current_time - dl->last_update_time > 2000)) {
+        ota_notify_progress(progress);
+        dl->last_progress = progress;
+        dl->last_update_time = current_time;
+    }
+}
+
+// What If-Range is given on a resume: a strong ETag, else Last-Modified
+static void ota_download_validator(const api_http_stream_t* stream, char* validator, size_t size)
+{
+    char etag[API_CACHE_ETAG_SIZE];
+    char last_modified[API_CACHE_LAST_MOD_SIZE];
+
+    api_manager_http_validators(stream, etag, sizeof(etag), last_modified, sizeof(last_modified));
+    strlcpy(validator, (etag[0] == '"') ? etag : last_modified, size);
+}
+
+// Checks the answer to a request: the whole image (200) or, when part of
+// it is already written, the rest (206). ESP_ERR_NOT_FINISHED when the
+// image has to be asked for again from byte 0
+static esp_err_t ota_download_check_answer(ota_download_t* dl, const api_http_stream_t* stream)
+{
+    int status = api_manager_http_status(stream);
+    char validator[API_CACHE_ETAG_SIZE];
+
+    ota_download_validator(stream, validator, sizeof(validator));
+    if (status == 206 && dl->written > 0) {
+        int64_t start = -1;
+        int64_t total = -1;
+        api_manager_http_content_range(stream, &start, &total);
+        if (start != dl->written || (total >= 0 && total != dl->info->size)) {
+            ESP_LOGW(TAG, "⚠️ Server sent from byte %lld of %lld instead of %lu: starting over",
+                     start, total, dl->written);
+            ota_download_restart(dl);
+            return ESP_ERR_NOT_FINISHED;
+        }
+        // A server that ignores If-Range: the image must not have changed meanwhile
+        if (dl->record.validator[0] != '\0' && validator[0] != '\0' &&
+            strcmp(validator, dl->record.validator) != 0) {
+            ESP_LOGW(TAG, "⚠️ Firmware image changed on the server: starting over");
+            ota_download_restart(dl);
+            return ESP_ERR_NOT_FINISHED;
+        }
+        ESP_LOGI(TAG, "⏯️ Resuming download at %lu of %lu bytes", dl->written, dl->info->size);
+        return ESP_OK;
+    }
+    if (status == 200) {
+        if (dl->written > 0) {
+            // No Range support, or If-Range found another image
+            ESP_LOGW(TAG, "⚠️ Server sent the whole image: starting over");
+            ota_download_restart(dl);
+        }
+        strlcpy(dl->record.validator, validator, sizeof(dl->record.validator));
+        return ESP_OK;
+    }
+    if (status == 416 && dl->written > 0) {
+        ESP_LOGW(TAG, "⚠️ Server refused the range: starting over");
+        ota_download_restart(dl);
+        return ESP_ERR_NOT_FINISHED;
+    }
+    ESP_LOGE(TAG, "❌ Firmware request failed: HTTP %d", status);
+    return (status >= 500) ? ESP_FAIL : ESP_ERR_INVALID_RESPONSE;
+}
+
+// The image starts with its header, the first segment header and the
+// app description: check them before touching the update partition. On
+// success buf holds the first *buffered bytes of the image
+static esp_err_t ota_download_check_header(ota_download_t* dl, api_http_stream_t* stream,
+                                           const net_deadline_t* deadline, size_t* buffered)
+{
+    const size_t desc_offset = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t);
     
-    esp_err_t err = esp_https_ota_begin(&ota_config, &g_ota_state.ota_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ HTTPS OTA begin failed: %s", esp_err_to_name(err));
-        return err;
+    *buffered = 0;
+    while (*buffered < desc_offset + sizeof(esp_app_desc_t)) {
+        int n = ota_read(stream, dl->buf + *buffered, OTA_BUFFER_SIZE - *buffered);
+        if (n <= 0) {
+            return net_deadline_over(deadline) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        }
+        *buffered += n;
     }
     
     esp_app_desc_t app_desc;
-    err = esp_https_ota_get_img_desc(g_ota_state.ota_handle, &app_desc);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Failed to get image description: %s", esp_err_to_name(err));
-        esp_https_ota_abort(g_ota_state.ota_handle);
-        return err;
+    memcpy(&app_desc, dl->buf + desc_offset, sizeof(app_desc));
+    if (app_desc.magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        ESP_LOGE(TAG, "❌ Downloaded file is not an application image");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
     }
     
     ESP_LOGI(TAG, "📋 New firmware info:");
     ESP_LOGI(TAG, "  - Version: %s", app_desc.version);
     ESP_LOGI(TAG, "  - Project: %s", app_desc.project_name);
     ESP_LOGI(TAG, "  - Date: %s %s", app_desc.date, app_desc.time);
+    return ESP_OK;
+}
+
+// One request for what is still missing: the whole image, or a Range from
+// the first byte not written yet. ESP_OK once the image is complete
+static esp_err_t ota_download_attempt(ota_download_t* dl, const net_deadline_t* deadline)
+{
+    char headers[48 + API_CACHE_ETAG_SIZE];
     
-    // Download with progress updates
-    int stall_counter = 0;
-    int last_data_read = 0;
-    
-    while (1) {
-        err = esp_https_ota_perform(g_ota_state.ota_handle);
-        if (err != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
-            break;
+    if (dl->written > 0) {
+        int len = snprintf(headers, sizeof(headers), "Range: bytes=%lu-\r\n", dl->written);
+        if (dl->record.validator[0] != '\0') {
+            snprintf(headers + len, sizeof(headers) - len, "If-Range: %s\r\n", dl->record.validator);
         }
-        
-        // Update progress with safe division
-        int data_read = esp_https_ota_get_image_len_read(g_ota_state.ota_handle);
-        int progress = 0;
-        if (update_info->size > 0 && data_read >= 0) {
-            progress = (data_read * 70) / update_info->size; // 0-70% for download
-            // Clamp progress to valid range
-            if (progress > 70) progress = 70;
-            if (progress < 0) progress = 0;
+    }
+    
+    // Same client as the API calls (api_manager_http_open): GitHub answers
+    // with a redirect to its download host, followed there with the same
+    // headers. The redirect target is signed for a short time only, so
+    // every attempt starts again from the release URL. A firmware image
+    // does not compress, so it is asked for as it is.
+    api_http_request_t req = {
+        .url = dl->info->url,
+        .headers = (dl->written > 0) ? headers : NULL,
+        .identity = true,
+        .metrics_label = "ota",
+    };
+    api_http_stream_t* stream = NULL;
+    esp_err_t err = api_manager_http_open(&req, &stream, deadline);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Firmware request failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = ota_download_check_answer(dl, stream);
+    if (err != ESP_OK) {
+        goto done;
+    }
+    
+    size_t buffered = 0;
+    if (dl->written == 0) {
+        err = ota_download_check_header(dl, stream, deadline, &buffered);
+        if (err != ESP_OK) {
+            goto done;
         }
-        
-        // Debug log every 10 iterations to monitor download
-        static int debug_counter = 0;
-        if (++debug_counter % 10 == 0) {
-            ESP_LOGI(TAG, "📊 Download progress: %d bytes / %lu bytes (%d%%)", 
-                     data_read, update_info->size, progress);
+        if (g_ota_state.ota_begun) {
+            esp_ota_abort(g_ota_state.ota_handle);
+            g_ota_state.ota_begun = false;
         }
-        
-        // Check for download stall
-        if (data_read == last_data_read) {
-            stall_counter++;
-            if (stall_counter > 100) { // 5 seconds at 50ms intervals
-                ESP_LOGW(TAG, "⚠️ Download appears stalled, continuing...");
-                stall_counter = 0;
+        err = esp_ota_begin(g_ota_state.update_partition, OTA_WITH_SEQUENTIAL_WRITES, &g_ota_state.ota_handle);
+    } else if (!g_ota_state.ota_begun) {
+        // After a reboot: the partition keeps the bytes before the
+        // checkpoint, the sectors after it are erased as they are written
+        err = esp_ota_resume(g_ota_state.update_partition, OTA_WITH_SEQUENTIAL_WRITES, dl->written,
+                             &g_ota_state.ota_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ OTA begin failed: %s", esp_err_to_name(err));
+        goto done;
+    }
+    g_ota_state.ota_begun = true;
+    
+    while (true) {
+        if (buffered == 0) {
+            int n = ota_read(stream, dl->buf, OTA_BUFFER_SIZE);
+            if (n < 0) {
+                err = net_deadline_over(deadline) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+                goto done;
+            }
+            if (n == 0) {
+                break;
             }
+            buffered = n;
+        }
+        err = esp_ota_write(g_ota_state.ota_handle, dl->buf, buffered);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "❌ OTA write failed: %s", esp_err_to_name(err));
+            goto done;
+        }
+        dl->written += buffered;
+        buffered = 0;
+        ota_download_checkpoint(dl);
+        ota_download_progress(dl);
+    }
+    
+    if (dl->written != dl->info->size) {
+        ESP_LOGW(TAG, "⚠️ Downloaded %lu bytes, release announced %lu", dl->written, dl->info->size);
+    }
+    
+done:
+    api_manager_http_close(stream);
+    return err;
+}
+
+// Lost connections and stalls are worth another request; so is an answer
+// that makes the download start over. Anything else would fail again
+static bool ota_download_retryable(esp_err_t err, const net_deadline_t* deadline)
+{
+    if (net_deadline_over(deadline)) {
+        return false;
+    }
+    return err == ESP_FAIL || err == ESP_ERR_TIMEOUT || err == ESP_ERR_NOT_FINISHED;
+}
+
+// Waits delay_ms, unless the download is cancelled or runs out of time first
+static bool ota_retry_wait(uint32_t delay_ms, const net_deadline_t* deadline)
+{
+    uint32_t left_ms = net_deadline_left_ms(deadline, delay_ms);
+    
+    while (left_ms > 0 && !net_deadline_over(deadline)) {
+        uint32_t slice_ms = (left_ms < NET_CANCEL_SLICE_MS) ? left_ms : NET_CANCEL_SLICE_MS;
+        vTaskDelay(pdMS_TO_TICKS(slice_ms));
+        left_ms -= slice_ms;
+    }
+    return !net_deadline_over(deadline);
+}
+
+static esp_err_t ota_download_firmware(const ota_version_info_t* update_info,
+                                       const net_deadline_t* deadline)
+{
+    ESP_LOGI(TAG, "📥 Downloading firmware from: %s", update_info->url);
+    
+    // Validate firmware size to prevent division by zero and other issues
+    if (update_info->size == 0 || update_info->size > 10 * 1024 * 1024) { // Max 10MB
+        ESP_LOGE(TAG, "❌ Invalid firmware size: %lu bytes", update_info->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    ESP_LOGI(TAG, "📏 Firmware size: %lu bytes (%.2f MB)", update_info->size, 
+             update_info->size / (1024.0 * 1024.0));
+    
+    ota_download_t dl = {
+        .info = update_info,
+        .last_progress = -1,
+    };
+    dl.buf = malloc(OTA_BUFFER_SIZE);
+    if (dl.buf == NULL) {
+        ESP_LOGE(TAG, "❌ Failed to allocate download buffer");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Progress left by an interrupted download of this same image
+    ota_resume_record_t saved;
+    if (ota_resume_load(&saved)) {
+        if (ota_resume_usable(&saved, update_info)) {
+            dl.record = saved;
+            dl.written = saved.written;
+            ESP_LOGI(TAG, "⏯️ %lu of %lu bytes already downloaded", dl.written, update_info->size);
         } else {
-            stall_counter = 0;
-            last_data_read = data_read;
+            ESP_LOGI(TAG, "Saved download progress (%s) does not match, discarded", saved.version);
+            ota_resume_clear();
         }
-        
-        // Update progress only occasionally to reduce SPI conflicts
-        static int last_progress = -1;
-        static uint32_t last_update_time = 0;
-        uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        
-        // Update every 5% or every 2 seconds (LVGL is suspended, so safe now)
-        if (progress != last_progress && 
-            (progress - last_progress >= 5 || current_time - last_update_time > 2000)) {
-            ota_notify_progress(progress);
-            last_progress = progress;
-            last_update_time = current_time;
+    }
+    if (dl.written == 0) {
+        ota_resume_start(&dl);
+    }
+    
+    esp_err_t err;
+    for (int attempt = 0; ; attempt++) {
+        err = ota_download_attempt(&dl, deadline);
+        if (err == ESP_OK || attempt == OTA_MAX_RETRIES || !ota_download_retryable(err, deadline)) {
+            break;
+        }
+        uint32_t delay_ms = OTA_RETRY_DELAY_MS << attempt;
+        ESP_LOGW(TAG, "🔁 Download retry %d/%d in %lu ms, from byte %lu", attempt + 1, OTA_MAX_RETRIES,
+                 delay_ms, dl.written);
+        if (!ota_retry_wait(delay_ms, deadline)) {
+            err = ESP_ERR_TIMEOUT;
+            break;
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(50)); // Minimal delay since LVGL is suspended
     }
     
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ HTTPS OTA perform failed: %s", esp_err_to_name(err));
-        esp_https_ota_abort(g_ota_state.ota_handle);
-        return err;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✅ Firmware download completed");
+    } else if (dl.record.written > 0) {
+        ESP_LOGI(TAG, "💾 %lu bytes kept for the next attempt", dl.record.written);
+    }
+    free(dl.buf);
+    if (err != ESP_OK && g_ota_state.ota_begun) {
+        esp_ota_abort(g_ota_state.ota_handle);
+        g_ota_state.ota_begun = false;
     }
+    return err;
+}
+
+bool ota_resume_pending(const char* current_version)
+{
+    ota_resume_record_t record;
+    const esp_partition_t* update_partition = esp_ota_get_next_update_partition(NULL);
     
-    ESP_LOGI(TAG, "✅ Firmware download completed");
-    return ESP_OK;
+    if (current_version == NULL || !ota_resume_load(&record)) {
+        return false;
+    }
+    
+    // Same comparison as the update check
+    const char* clean_saved = (record.version[0] == 'v') ? record.version + 1 : record.version;
+    const char* clean_current = (current_version[0] == 'v') ? current_version + 1 : current_version;
+    if (update_partition == NULL || record.partition_address != update_partition->address ||
+        strcmp(clean_current, clean_saved) >= 0) {
+        ESP_LOGI(TAG, "Download progress of %s no longer needed, discarded", record.version);
+        ota_resume_clear();
+        return false;
+    }
+    ESP_LOGI(TAG, "⏯️ Download of %s interrupted at %lu of %lu bytes", record.version,
+             record.written, record.size);
+    return true;
 }
 
 static void ota_set_status(ota_status_t status)
@@ -367,15 +767,24 @@ static void ota_set_error(ota_error_t error)
     }
 }
 
+// The callback runs without the mutex: it may block (main_flow waits on
+// errors) and must not hold up ota_get_status() or ota_start_update()
 static void ota_notify_progress(int percentage)
 {
+    ota_progress_callback_t callback = NULL;
+    ota_status_t status = OTA_STATUS_IDLE;
+    ota_error_t error = OTA_ERROR_NONE;
+
     if (xSemaphoreTake(g_ota_state.mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
         g_ota_state.progress_percentage = percentage;
-        if (g_ota_state.progress_callback) {
-            g_ota_state.progress_callback(percentage, g_ota_state.status, g_ota_state.last_error);
-        }
+        callback = g_ota_state.progress_callback;
+        status = g_ota_state.status;
+        error = g_ota_state.last_error;
         xSemaphoreGive(g_ota_state.mutex);
     }
+    if (callback) {
+        callback(percentage, status, error);
+    }
 }
 
 ota_status_t ota_get_status(void)
@@ -404,14 +813,10 @@ esp_err_t ota_cancel_update(void)
         return ESP_ERR_TIMEOUT;
     }
     
+    // The task stops within NET_CANCEL_SLICE_MS or so: it aborts the
+    // partition write and closes its connection itself
     if (g_ota_state.ota_task_handle != NULL) {
-        vTaskDelete(g_ota_state.ota_task_handle);
-        g_ota_state.ota_task_handle = NULL;
-    }
-    
-    if (g_ota_state.ota_handle) {
-        esp_https_ota_abort(g_ota_state.ota_handle);
-        g_ota_state.ota_handle = NULL;
+        net_cancel_trigger(&g_ota_state.cancel);
     }
     
     g_ota_state.status = OTA_STATUS_IDLE;
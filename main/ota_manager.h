@@ -18,9 +18,12 @@ extern "C" {
 #endif
 
 // OTA Manager Configuration
-#define OTA_RECV_TIMEOUT_MS     120000  // 2 minutes timeout for large firmware
+#define OTA_DOWNLOAD_TIMEOUT_MS 600000  // Whole download, connect to last byte (a stalled read gives up after 5 s)
 #define OTA_BUFFER_SIZE         4096    // 4KB buffer for OTA data
 #define OTA_MAX_RETRIES         3       // Maximum download retries
+#define OTA_RETRY_DELAY_MS      2000    // Pause before the first retry, doubled for each further one
+#define OTA_RESUME_NVS_NAMESPACE    "ota_resume"
+#define OTA_RESUME_CHECKPOINT_BYTES (64 * 1024)  // Download progress saved to NVS this often
 #define OTA_SIGNATURE_SIZE      256     // RSA-2048 signature size
 
 // OTA Status
@@ -83,6 +86,19 @@ esp_err_t ota_check_for_updates(const char* current_version, ota_version_info_t*
  */
 esp_err_t ota_start_update(const ota_version_info_t* update_info);
 
+/**
+ * @brief True when a download stopped half way can be resumed
+ *
+ * An interrupted download (lost connection, reboot, power cut) leaves its
+ * progress in NVS: the next ota_start_update() of the same release asks
+ * only for the missing bytes (HTTP Range) and writes them after the ones
+ * already in the update partition. A record of a release that is not
+ * newer than current_version is dropped.
+ *
+ * @param current_version Running firmware version
+ */
+bool ota_resume_pending(const char* current_version);
+
 /**
  * @brief Get current OTA status
  * 
@@ -0,0 +1,229 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: poll_scheduler.c                                   *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Adaptive API polling interval               *
+ ************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "poll_scheduler.h"
+#include "device_config.h"
+#include "fleet_phase.h"
+
+static const char *TAG = "PollSched";
+
+#define POLL_SCHED_DEFAULT_BUDGET_MS   60000UL  // Used when api_interval_ms does not parse
+
+typedef struct {
+    uint32_t interval_ms;       // Adaptive interval (0 = not started)
+    uint32_t min_wait_ms;       // Wait imposed by the budget after the last call
+    int last_count;             // -1 = no baseline yet
+    uint32_t flat_polls;
+    int64_t credit_ms;          // Token bucket, one token = budget_ms
+    int64_t credit_at_ms;       // Last refill
+    uint32_t call_ms[POLL_SCHED_RATE_WINDOW];
+    uint32_t call_head;
+    uint32_t calls;
+    uint32_t changes;
+} poll_sched_state_t;
+
+static poll_sched_state_t s_sched = { .last_count = -1 };
+static portMUX_TYPE s_sched_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t poll_sched_parse(const char *value, uint32_t fallback)
+{
+    char *endptr;
+    unsigned long ms = strtoul(value, &endptr, 10);
+
+    if (endptr == value || *endptr != '\0' || ms == 0) {
+        return fallback;
+    }
+    return (uint32_t)ms;
+}
+
+// Reads the limits from the configuration (they may change over BLE)
+static void poll_sched_limits(uint32_t *budget, uint32_t *floor_ms, uint32_t *ceiling)
+{
+    *budget = poll_sched_parse(api_interval_ms, POLL_SCHED_DEFAULT_BUDGET_MS);
+    *floor_ms = poll_sched_parse(api_interval_min_ms, *budget);
+    *ceiling = poll_sched_parse(api_interval_max_ms, *budget);
+
+    // The budget always lies inside [floor, ceiling]
+    if (*floor_ms > *budget) {
+        *floor_ms = *budget;
+    }
+    if (*ceiling < *budget) {
+        *ceiling = *budget;
+    }
+}
+
+static int64_t poll_sched_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+// Caller holds the lock
+static void poll_sched_refill(uint32_t budget, int64_t now)
+{
+    int64_t cap = (int64_t)budget * POLL_SCHED_BURST;
+
+    if (s_sched.credit_at_ms == 0) {
+        s_sched.credit_ms = cap;    // Boot: full bucket
+    } else {
+        s_sched.credit_ms += now - s_sched.credit_at_ms;
+    }
+    if (s_sched.credit_ms > cap) {
+        s_sched.credit_ms = cap;
+    }
+    s_sched.credit_at_ms = now;
+}
+
+// Caller holds the lock
+static uint32_t poll_sched_rate_per_hour(void)
+{
+    uint32_t n = (s_sched.calls < POLL_SCHED_RATE_WINDOW) ? s_sched.calls : POLL_SCHED_RATE_WINDOW;
+    if (n < 2) {
+        return 0;
+    }
+    uint32_t newest = s_sched.call_ms[(s_sched.call_head + POLL_SCHED_RATE_WINDOW - 1) % POLL_SCHED_RATE_WINDOW];
+    uint32_t oldest = s_sched.call_ms[(s_sched.call_head + POLL_SCHED_RATE_WINDOW - n) % POLL_SCHED_RATE_WINDOW];
+    uint32_t span = newest - oldest;
+    if (span == 0) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)(n - 1) * 3600000ULL) / span);
+}
+
+void poll_scheduler_on_call(void)
+{
+    uint32_t budget, floor_ms, ceiling;
+    int64_t now = poll_sched_now_ms();
+
+    poll_sched_limits(&budget, &floor_ms, &ceiling);
+
+    taskENTER_CRITICAL(&s_sched_lock);
+    poll_sched_refill(budget, now);
+    s_sched.credit_ms -= budget;
+    // Out of saved-up calls: the next one has to wait for the budget
+    s_sched.min_wait_ms = (s_sched.credit_ms < 0) ? (uint32_t)(-s_sched.credit_ms) : 0;
+
+    s_sched.call_ms[s_sched.call_head] = (uint32_t)now;
+    s_sched.call_head = (s_sched.call_head + 1) % POLL_SCHED_RATE_WINDOW;
+    s_sched.calls++;
+    taskEXIT_CRITICAL(&s_sched_lock);
+}
+
+void poll_scheduler_on_result(int count)
+{
+    uint32_t budget, floor_ms, ceiling;
+    bool changed = false;
+
+    if (count < 0) {
+        return;
+    }
+    poll_sched_limits(&budget, &floor_ms, &ceiling);
+
+    taskENTER_CRITICAL(&s_sched_lock);
+    if (s_sched.interval_ms == 0) {
+        s_sched.interval_ms = budget;
+    }
+    if (s_sched.last_count < 0) {
+        // First answer: nothing to compare with yet
+    } else if (count != s_sched.last_count) {
+        // Documents come in bursts: look again soon
+        s_sched.interval_ms = floor_ms;
+        s_sched.flat_polls = 0;
+        s_sched.changes++;
+        changed = true;
+    } else if (++s_sched.flat_polls > POLL_SCHED_FLAT_GRACE) {
+        uint64_t next = (uint64_t)s_sched.interval_ms * POLL_SCHED_STRETCH_PCT / 100;
+        s_sched.interval_ms = (next > ceiling) ? ceiling : (uint32_t)next;
+    }
+    if (s_sched.interval_ms < floor_ms) {
+        s_sched.interval_ms = floor_ms;
+    } else if (s_sched.interval_ms > ceiling) {
+        s_sched.interval_ms = ceiling;
+    }
+    s_sched.last_count = count;
+    uint32_t interval = s_sched.interval_ms;
+    uint32_t flat = s_sched.flat_polls;
+    uint32_t rate = poll_sched_rate_per_hour();
+    taskEXIT_CRITICAL(&s_sched_lock);
+
+    ESP_LOGI(TAG, "📈 Next poll in %lu ms (%s, %lu flat) - %lu calls/h, budget %lu calls/h",
+             interval, changed ? "count changed" : "count flat", flat,
+             rate, (uint32_t)(3600000UL / budget));
+}
+
+uint32_t poll_scheduler_interval_ms(void)
+{
+    uint32_t budget, floor_ms, ceiling;
+    uint32_t interval;
+
+    poll_sched_limits(&budget, &floor_ms, &ceiling);
+
+    taskENTER_CRITICAL(&s_sched_lock);
+    interval = (s_sched.interval_ms != 0) ? s_sched.interval_ms : budget;
+    uint32_t min_wait = s_sched.min_wait_ms;
+    taskEXIT_CRITICAL(&s_sched_lock);
+
+    // Units that booted together drift apart instead of polling in lockstep
+    interval = fleet_skew_interval(interval);
+    if (interval < floor_ms) {
+        interval = floor_ms;
+    } else if (interval > ceiling) {
+        interval = ceiling;
+    }
+    if (interval < min_wait) {
+        interval = min_wait;
+    }
+    return interval;
+}
+
+uint32_t poll_scheduler_ceiling_ms(void)
+{
+    uint32_t budget, floor_ms, ceiling;
+
+    poll_sched_limits(&budget, &floor_ms, &ceiling);
+    return ceiling;
+}
+
+void poll_scheduler_get_stats(poll_sched_stats_t *stats)
+{
+    uint32_t budget, floor_ms, ceiling;
+
+    if (stats == NULL) {
+        return;
+    }
+    poll_sched_limits(&budget, &floor_ms, &ceiling);
+    memset(stats, 0, sizeof(*stats));
+    stats->interval_ms = poll_scheduler_interval_ms();
+    stats->budget_ms = budget;
+    stats->floor_ms = floor_ms;
+    stats->ceiling_ms = ceiling;
+    stats->budget_per_hour = 3600000UL / budget;
+
+    taskENTER_CRITICAL(&s_sched_lock);
+    poll_sched_refill(budget, poll_sched_now_ms());
+    stats->tokens = (s_sched.credit_ms > 0) ? (uint32_t)(s_sched.credit_ms / budget) : 0;
+    stats->calls_per_hour = poll_sched_rate_per_hour();
+    stats->calls = s_sched.calls;
+    stats->changes = s_sched.changes;
+    taskEXIT_CRITICAL(&s_sched_lock);
+}
+
+void poll_scheduler_log_summary(void)
+{
+    poll_sched_stats_t st;
+
+    poll_scheduler_get_stats(&st);
+    ESP_LOGI(TAG, "  polling every %lu ms (floor %lu, budget %lu, ceiling %lu), %lu/h of %lu/h, "
+             "%lu saved call(s), %lu call(s) %lu change(s)",
+             st.interval_ms, st.floor_ms, st.budget_ms, st.ceiling_ms, st.calls_per_hour,
+             st.budget_per_hour, st.tokens, st.calls, st.changes);
+}
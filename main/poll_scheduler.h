@@ -0,0 +1,75 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: poll_scheduler.h                                   *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Adaptive API polling interval               *
+ ************************************************************/
+
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLL_SCHED_STRETCH_PCT      125     // Growth per flat poll (percent)
+#define POLL_SCHED_FLAT_GRACE       2       // Flat polls kept at the current pace after a change
+#define POLL_SCHED_BURST            8       // Calls that may be saved up for busy periods
+#define POLL_SCHED_RATE_WINDOW      16      // Calls used to measure the actual rate
+
+// Snapshot of the scheduler
+typedef struct {
+    uint32_t interval_ms;       // Wait before the next poll
+    uint32_t budget_ms;         // api_interval_ms: long-run average spacing of calls
+    uint32_t floor_ms;          // api_interval_min_ms
+    uint32_t ceiling_ms;        // api_interval_max_ms
+    uint32_t calls_per_hour;    // Measured over the last POLL_SCHED_RATE_WINDOW calls
+    uint32_t budget_per_hour;   // Calls per hour allowed by the budget
+    uint32_t tokens;            // Calls currently saved up (0..POLL_SCHED_BURST)
+    uint32_t calls;             // Calls since boot
+    uint32_t changes;           // Count changes seen since boot
+} poll_sched_stats_t;
+
+/**
+ * @brief Records that a refresh call was started
+ *
+ * Every call (timer, button, reconnect) spends one token of the budget.
+ */
+void poll_scheduler_on_call(void);
+
+/**
+ * @brief Feeds the count returned by a refresh
+ *
+ * A changed count drops the interval to the floor; consecutive flat
+ * counts stretch it towards the ceiling. Errors (count < 0) leave it alone.
+ *
+ * @param count Pending count, -1 on error
+ */
+void poll_scheduler_on_result(int count);
+
+/**
+ * @brief Interval to wait before the next poll
+ *
+ * The adaptive interval, bounded by floor/ceiling and never shorter than
+ * the budget once the saved-up calls are spent.
+ *
+ * @return uint32_t Milliseconds
+ */
+uint32_t poll_scheduler_interval_ms(void);
+
+// api_interval_max_ms: the slowest the device ever polls (push safety net)
+uint32_t poll_scheduler_ceiling_ms(void);
+
+void poll_scheduler_get_stats(poll_sched_stats_t *stats);
+
+// Logs the stats above (part of api_metrics_log_summary())
+void poll_scheduler_log_summary(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLL_SCHEDULER_H
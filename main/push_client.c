@@ -0,0 +1,157 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: push_client.c                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Push notifications (SSE / long-poll)        *
+ ************************************************************/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "push_client.h"
+#include "api_manager.h"
+#include "net_worker.h"
+#include "wifi_manager.h"
+#include "device_config.h"
+#include "global_vars.h"
+
+static const char *TAG = "PushClient";
+
+#define PUSH_IDLE_CHECK_MS         1000    // Wait while Wi-Fi is down or an OTA is running
+
+static TaskHandle_t s_task = NULL;
+static volatile bool s_live = false;
+static net_cancel_token_t s_cancel;
+
+// The stream only runs while nothing else needs the link
+static bool push_can_run(void)
+{
+    return wifi_manager_is_connected() && !ota_in_progress && push_url[0] != '\0';
+}
+
+static void push_deliver(esp_err_t err, int count)
+{
+    net_job_result_t event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = NET_JOB_PUSH_EVENT;
+    event.triggers = 1;
+    event.err = err;
+    event.practices = count;
+    event.editor_practices = -1;
+    net_worker_deliver(&event);
+}
+
+static bool push_on_event(api_push_event_t event, int count, void *ctx)
+{
+    switch (event) {
+        case API_PUSH_OPEN:
+            s_live = true;
+            break;
+        case API_PUSH_COUNT:
+            push_deliver(ESP_OK, count);
+            break;
+        case API_PUSH_CHANGED:
+            push_deliver(ESP_OK, -1);
+            break;
+        case API_PUSH_IDLE:
+        default:
+            break;
+    }
+    return push_can_run();
+}
+
+// Full jitter over [PUSH_RETRY_MIN_MS, min(max, min * 2^attempt)]
+static uint32_t push_backoff_ms(uint32_t attempt)
+{
+    uint32_t window = PUSH_RETRY_MIN_MS;
+
+    for (uint32_t i = 0; i < attempt && window < PUSH_RETRY_MAX_MS; i++) {
+        window *= 2;
+    }
+    if (window > PUSH_RETRY_MAX_MS) {
+        window = PUSH_RETRY_MAX_MS;
+    }
+    return PUSH_RETRY_MIN_MS + esp_random() % (window - PUSH_RETRY_MIN_MS + 1);
+}
+
+static void push_client_task(void *pvParameters)
+{
+    uint32_t attempt = 0;
+
+    ESP_LOGI(TAG, "📡 Push client started for %s", push_url);
+
+    while (1) {
+        if (!push_can_run()) {
+            vTaskDelay(pdMS_TO_TICKS(PUSH_IDLE_CHECK_MS));
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        // No deadline: the stream is meant to stay open, only cancelled
+        net_deadline_t deadline = net_deadline_in(0, &s_cancel);
+        esp_err_t err = api_manager_push_stream(push_url, push_on_event, NULL, &deadline);
+        uint32_t lasted_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+        if (s_live) {
+            s_live = false;
+            // Polling takes over at its normal pace until the stream is back
+            push_deliver(ESP_ERR_INVALID_STATE, -1);
+            ESP_LOGW(TAG, "📡 Push stream ended after %lu ms (%s)", lasted_ms, esp_err_to_name(err));
+        }
+        if (err == ESP_ERR_INVALID_ARG) {
+            ESP_LOGE(TAG, "❌ Push URL unusable, push disabled until reconfigured");
+            break;
+        }
+        if (!push_can_run()) {
+            continue;       // Stopped on purpose: reopen as soon as allowed
+        }
+
+        uint32_t delay;
+        if (err == ESP_ERR_NOT_SUPPORTED) {
+            // The server has no push endpoint: polling alone, check back rarely
+            attempt = 0;
+            delay = PUSH_RETRY_MAX_MS;
+        } else {
+            if (lasted_ms >= PUSH_STABLE_MS) {
+                attempt = 0;
+            }
+            delay = push_backoff_ms(attempt);
+            if (attempt < 16) {
+                attempt++;
+            }
+        }
+        ESP_LOGI(TAG, "⏳ Push reconnect in %lu ms", delay);
+        vTaskDelay(pdMS_TO_TICKS(delay));
+    }
+
+    s_task = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t push_client_start(void)
+{
+    if (s_task != NULL || push_url[0] == '\0') {
+        return ESP_OK;
+    }
+    if (xTaskCreate(push_client_task, "push_client", PUSH_CLIENT_STACK_SIZE, NULL,
+                    PUSH_CLIENT_PRIORITY, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "❌ Failed to create push client task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool push_client_is_live(void)
+{
+    return s_live;
+}
+
+void push_client_cancel(void)
+{
+    net_cancel_trigger(&s_cancel);
+}
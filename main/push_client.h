@@ -0,0 +1,44 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: push_client.h                                      *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Push notifications (SSE / long-poll)        *
+ ************************************************************/
+
+#ifndef PUSH_CLIENT_H
+#define PUSH_CLIENT_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PUSH_CLIENT_STACK_SIZE     8192    // TLS reads happen on this task
+#define PUSH_CLIENT_PRIORITY       3       // Below the network worker
+#define PUSH_RETRY_MIN_MS          2000    // Reconnect backoff: first window
+#define PUSH_RETRY_MAX_MS          300000  // Largest window; also used when the server has no push endpoint
+#define PUSH_STABLE_MS             60000   // A stream that lasted this long resets the backoff
+
+/**
+ * @brief Starts the push task for push_url
+ *
+ * Events are delivered to main_flow_task as NET_JOB_PUSH_EVENT results
+ * (see net_worker.h). Does nothing when push_url is empty.
+ *
+ * @return esp_err_t ESP_OK on success (or when push is not configured)
+ */
+esp_err_t push_client_start(void);
+
+// True while the push stream is open: polling can fall back to its ceiling
+bool push_client_is_live(void);
+
+// Drops the open stream at once (e.g. Wi-Fi lost); it reopens when it can
+void push_client_cancel(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUSH_CLIENT_H
@@ -0,0 +1,235 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: retry_policy.c                                     *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Backoff with jitter for failed API calls    *
+ ************************************************************/
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "retry_policy.h"
+#include "device_config.h"
+#include "fleet_phase.h"
+
+static const char *TAG = "RetryPolicy";
+
+#define RETRY_NVS_KEY          "state"
+#define RETRY_RECORD_VERSION   1
+
+// Per-class retry rule (milliseconds)
+typedef struct {
+    uint32_t min_ms;        // Never retry sooner than this
+    uint32_t base_ms;       // Backoff window of the first retry
+    uint32_t cap_ms;        // Largest backoff window
+} retry_rule_t;
+
+// Network trouble is usually short-lived and worth retrying soon; a
+// rejected token will not fix itself, so auth is never retried quickly.
+static const retry_rule_t s_rules[API_ERR_CLASS_COUNT] = {
+    [API_ERR_NONE]     = {   1000,    5000,   600000 },     // Unclassified: as connect
+    [API_ERR_DNS]      = {   1000,    5000,   600000 },     // 1 s .. 10 min
+    [API_ERR_CONNECT]  = {   1000,    5000,   600000 },     // 1 s .. 10 min
+    [API_ERR_TLS]      = {   5000,   30000,  1800000 },     // 5 s .. 30 min
+    [API_ERR_AUTH]     = { 900000,  900000, 21600000 },     // 15 min .. 6 h
+    [API_ERR_HTTP_4XX] = {  30000,   60000,  3600000 },     // 30 s .. 1 h
+    [API_ERR_HTTP_5XX] = {   2000,   15000,  1800000 },     // 2 s .. 30 min
+    [API_ERR_PARSE]    = {   5000,   30000,  1800000 },     // 5 s .. 30 min
+    [API_ERR_CANCELLED] = {  1000,    5000,   600000 },     // Not a server fault: as connect
+};
+
+// Persisted state (NVS blob)
+typedef struct {
+    uint8_t version;
+    uint8_t error_class;
+    uint16_t attempts;
+    uint32_t fingerprint;       // Configuration the failures belong to
+} retry_record_t;
+
+static retry_record_t s_state;
+static int64_t s_retry_at_us = 0;     // When the next poll is due (0 = nothing scheduled)
+static bool s_loaded = false;
+
+static void retry_persist(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(RETRY_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Cannot open NVS for retry state: %s", esp_err_to_name(err));
+        return;
+    }
+    if (s_state.attempts > 0) {
+        err = nvs_set_blob(handle, RETRY_NVS_KEY, &s_state, sizeof(s_state));
+    } else {
+        err = nvs_erase_key(handle, RETRY_NVS_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Failed to persist retry state: %s", esp_err_to_name(err));
+    }
+}
+
+// Jittered delay for the given attempt (0 = first retry)
+static uint32_t retry_compute_delay(api_error_class_t cls, uint32_t attempt)
+{
+    const retry_rule_t *rule = &s_rules[(cls < API_ERR_CLASS_COUNT) ? cls : API_ERR_NONE];
+    uint64_t window = rule->base_ms;
+
+    for (uint32_t i = 0; i < attempt && window < rule->cap_ms; i++) {
+        window *= 2;
+    }
+    if (window > rule->cap_ms) {
+        window = rule->cap_ms;
+    }
+    if (window <= rule->min_ms) {
+        return rule->min_ms;
+    }
+    return rule->min_ms + (esp_random() % (uint32_t)(window - rule->min_ms + 1));
+}
+
+static void retry_schedule(uint32_t delay_ms)
+{
+    s_retry_at_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    if (s_retry_at_us == 0) {
+        s_retry_at_us = 1;
+    }
+}
+
+// Restores the backoff of the previous boot, so a crash or power loop
+// during an outage keeps backing off instead of retrying immediately
+static void retry_load(void)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(s_state);
+
+    if (s_loaded) {
+        return;
+    }
+    s_loaded = true;
+    memset(&s_state, 0, sizeof(s_state));
+
+    if (nvs_open(RETRY_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    esp_err_t err = nvs_get_blob(handle, RETRY_NVS_KEY, &s_state, &len);
+    nvs_close(handle);
+
+    if (err != ESP_OK || len != sizeof(s_state) || s_state.version != RETRY_RECORD_VERSION ||
+        s_state.error_class >= API_ERR_CLASS_COUNT) {
+        memset(&s_state, 0, sizeof(s_state));
+        return;
+    }
+    if (s_state.fingerprint != device_config_fingerprint()) {
+        // New token/server: the old failures say nothing about it
+        ESP_LOGI(TAG, "🗑️ Configuration changed, dropping persisted backoff");
+        memset(&s_state, 0, sizeof(s_state));
+        retry_persist();
+        return;
+    }
+    if (s_state.attempts > 0) {
+        uint32_t delay = retry_compute_delay((api_error_class_t)s_state.error_class, s_state.attempts - 1);
+        retry_schedule(delay);
+        ESP_LOGW(TAG, "⏳ Restored backoff: %u %s failure(s), first poll in %lu ms",
+                 s_state.attempts, api_manager_error_name((api_error_class_t)s_state.error_class),
+                 delay);
+    }
+}
+
+uint32_t retry_policy_on_failure(api_error_class_t cls, int http_status)
+{
+    retry_load();
+
+    if (cls >= API_ERR_CLASS_COUNT) {
+        cls = API_ERR_NONE;
+    }
+    // One ladder for every class: a flaky link that fails with DNS, then
+    // connect, then a 5xx keeps climbing instead of restarting each time.
+    // Only a success clears it; the class only picks the rule
+    uint32_t delay = retry_compute_delay(cls, s_state.attempts);
+    retry_schedule(delay);
+
+    s_state.version = RETRY_RECORD_VERSION;
+    s_state.error_class = (uint8_t)cls;
+    if (s_state.attempts < UINT16_MAX) {
+        s_state.attempts++;
+    }
+    s_state.fingerprint = device_config_fingerprint();
+    retry_persist();
+
+    if (http_status > 0) {
+        ESP_LOGW(TAG, "⏳ %s failure (HTTP %d) #%u, retry in %lu ms",
+                 api_manager_error_name(cls), http_status, s_state.attempts, delay);
+    } else {
+        ESP_LOGW(TAG, "⏳ %s failure #%u, retry in %lu ms",
+                 api_manager_error_name(cls), s_state.attempts, delay);
+    }
+    return delay;
+}
+
+void retry_policy_on_success(void)
+{
+    retry_load();
+
+    s_retry_at_us = 0;
+    if (s_state.attempts == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "✅ Recovered after %u %s failure(s)", s_state.attempts,
+             api_manager_error_name((api_error_class_t)s_state.error_class));
+    memset(&s_state, 0, sizeof(s_state));
+    retry_persist();
+}
+
+void retry_policy_on_connect(void)
+{
+    retry_load();
+
+    api_error_class_t cls = (api_error_class_t)s_state.error_class;
+    bool network_failure = (s_state.attempts == 0 || cls == API_ERR_DNS ||
+                            cls == API_ERR_CONNECT || cls == API_ERR_NONE);
+    uint32_t phase = fleet_phase_ms(FLEET_SALT_FIRST_POLL, fleet_spread_ms());
+
+    // Failures while the link was down say nothing about the server
+    if (network_failure || retry_policy_delay_ms() < phase) {
+        retry_schedule(phase);
+    }
+    ESP_LOGI(TAG, "📶 Connected, next poll in %lu ms", retry_policy_delay_ms());
+}
+
+void retry_policy_on_call(void)
+{
+    retry_load();
+    s_retry_at_us = 0;
+}
+
+bool retry_policy_pending(void)
+{
+    retry_load();
+    return s_retry_at_us != 0;
+}
+
+uint32_t retry_policy_delay_ms(void)
+{
+    retry_load();
+    if (s_retry_at_us == 0) {
+        return 0;
+    }
+    int64_t left = s_retry_at_us - esp_timer_get_time();
+    return (left > 0) ? (uint32_t)(left / 1000) : 0;
+}
+
+uint32_t retry_policy_attempts(void)
+{
+    retry_load();
+    return s_state.attempts;
+}
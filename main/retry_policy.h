@@ -0,0 +1,63 @@
+/*************************************************************
+ *                     FIRMINIA 3.6.1                          *
+ *  File: retry_policy.h                                     *
+ *  Author: Andrea Mancini     E-mail: biso@biso.it          *
+ *  Description: Backoff with jitter for failed API calls    *
+ ************************************************************/
+
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "api_manager.h"    // Per api_error_class_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RETRY_NVS_NAMESPACE         "retry"
+
+/**
+ * @brief Records a failed refresh and schedules the retry
+ *
+ * The delay is drawn uniformly ("full jitter") from
+ * [min, min(cap, base * 2^attempt)] of the class rule, so devices that
+ * failed together do not retry together. attempt counts every failure
+ * since the last success, whatever its class. The state is persisted to NVS.
+ *
+ * @param cls         Failure class
+ * @param http_status HTTP status for the HTTP classes (logged only)
+ * @return uint32_t   Delay before the retry in milliseconds
+ */
+uint32_t retry_policy_on_failure(api_error_class_t cls, int http_status);
+
+// Records a successful refresh; clears the backoff
+void retry_policy_on_success(void);
+
+/**
+ * @brief Schedules the first poll after boot or a Wi-Fi reconnect
+ *
+ * Replaces the immediate check: the poll lands on this device's fixed slot
+ * of the poll_spread_ms window (see fleet_phase), unless a longer
+ * non-network backoff (e.g. auth) is pending, which is kept.
+ */
+void retry_policy_on_connect(void);
+
+// A refresh was started: the scheduled retry (if any) is consumed
+void retry_policy_on_call(void);
+
+// True while a failure or reconnect has scheduled the next poll
+bool retry_policy_pending(void);
+
+// Time left before the scheduled poll (0 = due or nothing scheduled)
+uint32_t retry_policy_delay_ms(void);
+
+// Consecutive failures since the last success (any class)
+uint32_t retry_policy_attempts(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RETRY_POLICY_H
@@ -234,6 +234,41 @@ static const char* translations[STR_COUNT][LANGUAGE_COUNT] = {
         "Nessun\ndocumento\nin attesa.\nRilassati.", // Italian
         "Aucun\ndocument\nen attente.\nRelax.", // French
         "Ningun\ndocumento\nen espera.\nRelájate."    // Spanish
+    },
+    // STR_CHECKING_BOTH
+    {
+        "Checking\nsignatures and\ndocuments for\n%s...",        // English
+        "Controllo\nfirme e\ndocumenti per\n%s...",               // Italian
+        "Verification\nsignatures et\ndocuments pour\n%s...",     // French
+        "Verificando\nfirmas y\ndocumentos para\n%s..."           // Spanish
+    },
+    // STR_BOTH_LEGEND
+    {
+        "to sign | waiting",            // English
+        "da firmare | in attesa",       // Italian
+        "a signer | en attente",        // French
+        "para firmar | en espera"       // Spanish
+    },
+    // STR_NO_BOTH_PENDING
+    {
+        "Nothing to sign,\nnothing waiting.\nRelax.",              // English
+        "Niente da firmare,\nniente in attesa.\nRilassati.",       // Italian
+        "Rien a signer,\nrien en attente.\nDetendez-vous.",        // French
+        "Nada para firmar,\nnada en espera.\nRelajate."            // Spanish
+    },
+    // STR_LAST_KNOWN
+    {
+        "Last known",                   // English
+        "Ultimo dato noto",             // Italian
+        "Derniere valeur",              // French
+        "Ultimo dato"                   // Spanish
+    },
+    // STR_LAST_KNOWN_AGE
+    {
+        "Last known, %lu min ago",      // English
+        "Dato di %lu min fa",           // Italian
+        "Valeur d'il y a %lu min",      // French
+        "Dato de hace %lu min"          // Spanish
     }
 };
 
@@ -56,6 +56,13 @@ typedef enum {
     STR_EDITOR_DOCUMENTS_WAITING,      // Text without number for editor mode (plural)
     STR_EDITOR_DOCUMENT_WAITING,       // Text without number for editor mode (singular)
     STR_NO_EDITOR_DOCUMENTS,
+    // Both mode strings
+    STR_CHECKING_BOTH,
+    STR_BOTH_LEGEND,                   // Caption under the "signer | editor" counts
+    STR_NO_BOTH_PENDING,
+    // Count restored after a reboot, not refreshed yet
+    STR_LAST_KNOWN,
+    STR_LAST_KNOWN_AGE,                // Format: minutes
     STR_COUNT
 } string_id_t;
 
@@ -5,6 +5,7 @@
  *************************************************************/
 
  #include "wifi_manager.h"
+ #include "net_worker.h"
  #include "esp_wifi.h"
  #include "esp_netif.h"
  #include "esp_event.h"
@@ -30,6 +31,8 @@
          ESP_LOGI(TAG, "IP_EVENT_STA_GOT_IP");
          s_connected = true;
          xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+         // Resolve the API hosts now, so the first poll does not wait on DNS
+         net_worker_post(NET_JOB_DNS_PREWARM);
      }
  }
  